@@ -4,6 +4,12 @@
 #include <string>
 #include "common/shader.h"
 #include "common/render.h"
+#include "common/sampler.h"
+#include "common/light_bvh.h"
+#include "common/path_guiding.h"
+#include "common/camera.h"
+#include "common/cornell_box.h"
+#include "common/render_monitor.h"
 #include "config.h"
 #include <time.h>
 #include <windows.h>
@@ -16,10 +22,30 @@ extern "C"
 __declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001;
 }
 
-void processInput(GLFWwindow *window);
+bool processInput(GLFWwindow *window, Camera& camera, float dt);
 
-int main()
+int main(int argc, char** argv)
 {
+    // --no-guiding: 关闭路径引导，只用BRDF采样，用于对比焦散和间接光的噪声
+    // --ray-stats: 统计每帧的光线数和求交测试数，定期输出 Mrays/s
+    // --timings <file>: 退出时把各个 pass 的 GPU 耗时统计写到 file，后缀为 .json 时写 JSON，否则写 CSV
+    // --reference、--stop-at、--convergence-log、--snapshot、--snapshot-every: 见 common/render_monitor.h
+    bool guiding_enabled = true;
+    bool ray_stats = false;
+    string timings_path;
+    RenderMonitor monitor;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(monitor.parseOption(argc, argv, i))
+            continue;
+        if(string(argv[i]) == "--no-guiding")
+            guiding_enabled = false;
+        else if(string(argv[i]) == "--ray-stats")
+            ray_stats = true;
+        else if(string(argv[i]) == "--timings" && i + 1 < argc)
+            timings_path = argv[++i];
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -41,174 +67,105 @@ int main()
         return -1;
     }
 
-    Shader path_shader(project_path + "src/shader/vs.glsl", project_path + "src/shader/base_fs.glsl");
-    glm::vec3 origin(0.0f, 0.0f, 10.0f);
-    glm::vec3 horizontal(4.0f, 0.0f, 0.0f);
-    glm::vec3 vertical(0.0f, 4.0f, 0.0f);
-    float focal_length = 6.0;   // 摄像机到远平面的距离
-
-    path_shader.bind();
-    path_shader.setVec3("camera.ori", origin);
-    path_shader.setVec3("camera.horizontal", horizontal);
-    path_shader.setVec3("camera.vertical", vertical);
-    path_shader.setVec3("camera.lower_left_corner", origin - horizontal / 2.0f - vertical / 2.0f - glm::vec3(0.0f, 0.0f, focal_length));
-
-    path_shader.setVec3("materials[0].color", 1.0f, 1.0f, 1.0f);    // 白色漫反射
-    path_shader.setFloat("materials[0].specularRate", 0.0f);
-    path_shader.setFloat("materials[0].refraceRate", 0.0f);
-    
-    path_shader.setVec3("materials[1].color", 5.0f, 5.0f, 5.0f);    // 光源
-    path_shader.setBool("materials[1].isEmissive", true);
-
-    path_shader.setVec3("materials[2].color", 1.0f, 0.5f, 0.5f);    // 红色
-
-    path_shader.setVec3("materials[3].color", 0.5f, 1.0f, 1.0f);    // 蓝色
-
-    path_shader.setVec3("materials[4].color", 0.5f, 0.5f, 1.0f);    // 紫色
-
-    path_shader.setVec3("materials[5].color", 1.0f, 1.0f, 1.0f);    // 镜面反射
-    path_shader.setFloat("materials[5].specularRate", 1.0f);
-    path_shader.setFloat("materials[5].refractRate", 0.0f);
-
-    path_shader.setVec3("materials[6].color", 1.0f, 1.0f, 1.0f);    // 折射
-    path_shader.setFloat("materials[6].specularRate", 0.1f);
-    path_shader.setFloat("materials[6].refractRate", 1.0f);
-    path_shader.setFloat("materials[6].refractAngle", 0.1f);
-
-    // 第一个球，散射
-    path_shader.setVec3("spheres[0].center", -1.35f, -1.4f, 2.0f);
-    path_shader.setFloat("spheres[0].radius", 0.6f);
-    path_shader.setUInt("spheres[0].material_id", 0);
-
-    // 第二个球， 镜面反射
-    path_shader.setVec3("spheres[1].center", 0.f, -1.4f, 2.0f);
-    path_shader.setFloat("spheres[1].radius", 0.6f);
-    path_shader.setUInt("spheres[1].material_id", 6);
-
-    // 第三个球， 折射
-    path_shader.setVec3("spheres[2].center", 1.35f, -1.4f, 2.0f);
-    path_shader.setFloat("spheres[2].radius", 0.6f);
-    path_shader.setUInt("spheres[2].material_id", 5);
-
-    // 后面
-    path_shader.setVec3("tris[0].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[0].p1", -2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[0].p2", 2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[0].n0", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[0].n1", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[0].n2", 0.0f, 0.0f, 1.0f);
-    path_shader.setUInt("tris[0].material_id", 4);
-
-    path_shader.setVec3("tris[1].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[1].p1", 2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[1].p2", 2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[1].n0", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[1].n1", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[1].n2", 0.0f, 0.0f, 1.0f);
-    path_shader.setUInt("tris[1].material_id", 4);
-
-    // 左侧面
-    path_shader.setVec3("tris[2].p0", -2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[2].p1", -2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[2].p2", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[2].n0", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[2].n1", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[2].n2", 1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[2].material_id", 2);
-
-    path_shader.setVec3("tris[3].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[3].p1", -2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[3].p2", -2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[3].n0", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[3].n1", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[3].n2", 1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[3].material_id", 2);
-
-    // 右侧面
-    path_shader.setVec3("tris[4].p0", 2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[4].p1", 2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[4].p2", 2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[4].n0", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[4].n1", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[4].n2", -1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[4].material_id", 3);
-
-    path_shader.setVec3("tris[5].p0", 2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[5].p1", 2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[5].p2", 2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[5].n0", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[5].n1", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[5].n2", -1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[5].material_id", 3);
-
-    // 上面
-    path_shader.setVec3("tris[6].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[6].p1", 2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[6].p2", -2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[6].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[6].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[6].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[6].material_id", 0);
-
-    path_shader.setVec3("tris[7].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[7].p1", 2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[7].p2", 2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[7].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[7].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[7].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[7].material_id", 0);
-
-    // 下面
-    path_shader.setVec3("tris[8].p0", -2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[8].p1", -2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[8].p2", 2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[8].n0", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[8].n1", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[8].n2", 0.0f, 1.0f, 0.0f);
-    path_shader.setUInt("tris[8].material_id", 0);
-
-    path_shader.setVec3("tris[9].p0", -2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[9].p1", 2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[9].p2", 2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[9].n0", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[9].n1", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[9].n2", 0.0f, 1.0f, 0.0f);
-    path_shader.setUInt("tris[9].material_id", 0);
-
-    // 顶部光源
-    path_shader.setVec3("tris[10].p0", -0.8f, 2.0f, 1.2f);
-    path_shader.setVec3("tris[10].p1", 0.8f, 2.0f, 2.8f);
-    path_shader.setVec3("tris[10].p2", -0.8f, 2.0f, 2.8f);
-    path_shader.setVec3("tris[10].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[10].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[10].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[10].material_id", 1);
-
-    path_shader.setVec3("tris[11].p0", -0.8f, 2.0f, 1.2f);
-    path_shader.setVec3("tris[11].p1", 0.8f, 2.0f, 1.2f);
-    path_shader.setVec3("tris[11].p2", 0.8f, 2.0f, 2.8f);
-    path_shader.setVec3("tris[11].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[11].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[11].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[11].material_id", 1);
+    Shader path_shader(project_path + "src/shader/vs.glsl", project_path + "src/shader/base_fs.glsl", ray_stats ? "#define RAY_STATS\n" : "");
+    Camera camera = cornellCamera();
+    camera.bind(path_shader);
+
+    // 康奈尔盒，从左到右为漫反射、折射和镜面反射的球
+    setCornellBox(path_shader);
+    setCornellBaseMaterials(path_shader);
+    setCornellSpheres(path_shader, 0, 6, 5);
 
     Render render(SCR_WIDTH, SCR_HEIGHT);
+    if(ray_stats)
+        render.enableRayStats();
+    render.setAdaptive(0.01f, 64);  // 相对误差低于1%的像素不再追踪
+    Sampler sampler(project_path + "cache/sampler_tables.bin");
+    sampler.bind(path_shader, UNIT_SAMPLER);
+
+    // 顶部光源的两个三角形加入光源BVH，其余三角形不发光
+    LightBVH lights;
+    addCornellLights(path_shader, lights, 15.0f);
+    lights.build();
+    lights.bind(path_shader, UNIT_LIGHTS);
+
+    // 场景的包围盒，镜面球和折射球产生的焦散靠BRDF采样很难找到，由学到的入射辐射度分布引导
+    PathGuiding guiding(project_path + "src/shader/base_fs.glsl", glm::vec3(-2.0f, -2.0f, 0.0f), glm::vec3(2.0f, 2.0f, 4.0f), SCR_WIDTH, SCR_HEIGHT);
+    guiding.bind(path_shader, UNIT_GUIDING);
+
+    monitor.init(SCR_WIDTH, SCR_HEIGHT);
 
     unsigned int frame_count = 0;
     const unsigned int frame_time_constraint = 20;   // 每帧最少要花费的时间，ms
+    time_t start = clock();
+    bool converged = false;
+    double last_time = glfwGetTime();
+    double title_time = last_time;
+    double render_start = last_time;    // 这次累积开始的时间
     while (!glfwWindowShouldClose(window))
     {
         time_t begin = clock();
         frame_count ++;
         //printf("%d ", frame_count);
-        processInput(window);
+        double now = glfwGetTime();
+        Camera previous = camera;
+        if(processInput(window, camera, (float)(now - last_time)))
+        {
+            // 重新从头累积，移动前的结果重投影过来，移动中每帧只追踪 Render::MOTION_SPP 个样本
+            camera.bind(path_shader);
+            render.reproject(previous);
+            frame_count = 1;
+            start = clock();
+            converged = false;
+            monitor.reset();
+            render_start = now;
+        }
+        last_time = now;
 
         glClearColor(0.f, 0.0f, 0.f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
         path_shader.bind();
         path_shader.setUInt("frame_count", frame_count);
+        bool trained = false;
+        if(guiding_enabled && guiding.training())
+        {
+            render.timer().begin("guiding");
+            trained = guiding.train(path_shader);
+            render.timer().end();
+        }
+        if(trained)
+        {
+            guiding.bind(path_shader, UNIT_GUIDING);
+            render.reset();
+            converged = false;
+            monitor.reset();
+            render_start = glfwGetTime();
+        }
         render.draw(path_shader);
 
+        // 所有像素都收敛后路径追踪的pass不再产生片元，渲染自动停止
+        if(!converged && render.convergedRatio() >= 1.0f)
+        {
+            converged = true;
+            printf("converged after %u frames, %.1f s\n", frame_count, (float)(clock() - start) / CLOCKS_PER_SEC);
+        }
+
+        if(monitor.update(render, glfwGetTime() - render_start))
+            glfwSetWindowShouldClose(window, true);
+
+        // clock() 只是 CPU 的时间，GPU 的耗时看标题栏
+        if(now - title_time > 0.5)
+        {
+            string title = "GLPathTracer | " + render.timer().summary();
+            string error = monitor.summary();
+            if(!error.empty())
+                title += " | " + error;
+            glfwSetWindowTitle(window, title.c_str());
+            title_time = now;
+        }
+        if(ray_stats && frame_count % 50 == 0)
+            printf("frame %u: %s\n", frame_count, render.rayStatsSummary().c_str());
+
         time_t end = clock();
         if(end - begin < frame_time_constraint)
         {
@@ -219,13 +176,18 @@ int main()
         glfwPollEvents();
     }
 
+    monitor.finish(render);
+    if(!timings_path.empty())
+        render.timer().write(timings_path);
     glfwTerminate();
     return 0;
 
 }
 
-void processInput(GLFWwindow *window)
+// 返回相机是否移动
+bool processInput(GLFWwindow *window, Camera& camera, float dt)
 {
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+    return camera.update(window, dt);
 }
@@ -0,0 +1,495 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "common/shader.h"
+#include "common/render.h"
+#include "common/sampler.h"
+#include "common/light_bvh.h"
+#include "common/albedo_lut.h"
+#include "common/environment.h"
+#include "common/cornell_box.h"
+#include "common/implicit_function.h"
+#include "common/implicit_bricks.h"
+#include "common/implicit_tiles.h"
+#include "common/primitive_bvh.h"
+#include "config.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+
+// 选择使用N卡，笔记本默认使用独显
+extern "C"
+{
+__declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001;
+}
+
+// 固定场景的性能基准，不开窗口，不限帧率，用于发现性能和收敛速度的退化：
+//   cornell   base.cpp 的康奈尔盒，自适应采样与 base.cpp 相同，不训练路径引导
+//   disney    disney.cpp 的三个 Disney BRDF 球
+//   heart     implicit_surface.cpp 的隐式心形曲面
+//   mesh      implicit_fs.glsl 的 BVH 中放一个 MESH_SEGMENTS 细分的圆环网格，顶面发光
+//   lights    disney 场景中顶部的面光源换成 MANY_LIGHTS x MANY_LIGHTS 个小光源
+// 样本序号只由累积的样本数决定，每次运行的样本完全相同。每个场景先渲染（或读取 cache/bench/<scene>.pfm 中的）参考图，
+// 再从零开始累积，记录每帧的耗时、Mrays/s，以及与参考图的 RMSE 第一次低于目标值的时间
+// 用法：benchmark [--scenes a,b,...] [--frames n] [--seconds s] [--target rmse] [--check-interval n] [--reference-frames n] [--update-references]
+//                 [--out results.json] [--baseline baseline.json] [--tolerance t]
+// 与 baseline 相比 ms/frame 或达到目标的时间超过 (1 + tolerance) 倍时返回 1
+
+const char* const SCENES[] = { "cornell", "disney", "heart", "mesh", "lights" };
+const int MESH_SEGMENTS = 256;      // 圆环网格沿大圆的段数，沿小圆为一半，共 MESH_SEGMENTS^2 个三角形
+const int MANY_LIGHTS = 16;
+
+struct Options
+{
+    vector<string> scenes;
+    unsigned int frames = 256;              // 每个场景最多累积的帧数
+    double seconds = 30.0;                  // 每个场景最多累积的时间，不含读回和比较
+    double target = 0.02;                   // RMSE 的目标值
+    unsigned int check_interval = 4;        // 每隔几帧与参考图比较一次
+    unsigned int reference_frames = 1024;
+    bool update_references = false;
+};
+
+struct Result
+{
+    string scene;
+    unsigned int frames = 0;
+    double seconds = 0.0;
+    double ms_per_frame = 0.0;          // 含 glFinish 的墙钟时间
+    double gpu_ms_per_frame = 0.0;      // Render 中各个 pass 的 GPU 耗时之和
+    double mrays = 0.0;                 // 按路径追踪 pass 的 GPU 耗时计算
+    double rays_per_frame = 0.0;
+    double rmse = 0.0;                  // 最后一帧与参考图的 RMSE
+    double time_to_target = -1.0;       // 没有达到目标时为 -1
+    unsigned int frames_to_target = 0;
+};
+
+Result benchCornell(const Options& options);
+Result benchDisney(const Options& options, bool many_lights);
+Result benchImplicit(const Options& options, bool mesh);
+Result measure(const string& scene, Render& render, Shader& shader, float adaptive_threshold, const Options& options);
+void writeResults(const string& path, const vector<Result>& results, const Options& options);
+int compareBaseline(const string& path, const vector<Result>& results, double tolerance);
+
+int main(int argc, char** argv)
+{
+    Options options;
+    string out_path = "benchmark.json";
+    string baseline_path;
+    double tolerance = 0.1;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(string(argv[i]) == "--scenes" && i + 1 < argc)
+        {
+            string list = argv[++i];
+            for(size_t begin = 0, end; begin <= list.size(); begin = end + 1)
+            {
+                end = min(list.find(',', begin), list.size());
+                if(end > begin)
+                    options.scenes.push_back(list.substr(begin, end - begin));
+            }
+        }
+        else if(string(argv[i]) == "--frames" && i + 1 < argc)
+            options.frames = max(1, atoi(argv[++i]));
+        else if(string(argv[i]) == "--seconds" && i + 1 < argc)
+            options.seconds = atof(argv[++i]);
+        else if(string(argv[i]) == "--target" && i + 1 < argc)
+            options.target = atof(argv[++i]);
+        else if(string(argv[i]) == "--check-interval" && i + 1 < argc)
+            options.check_interval = max(1, atoi(argv[++i]));
+        else if(string(argv[i]) == "--reference-frames" && i + 1 < argc)
+            options.reference_frames = max(1, atoi(argv[++i]));
+        else if(string(argv[i]) == "--update-references")
+            options.update_references = true;
+        else if(string(argv[i]) == "--out" && i + 1 < argc)
+            out_path = argv[++i];
+        else if(string(argv[i]) == "--baseline" && i + 1 < argc)
+            baseline_path = argv[++i];
+        else if(string(argv[i]) == "--tolerance" && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+    }
+    if(options.scenes.empty())
+        options.scenes.assign(begin(SCENES), end(SCENES));
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "GLPathTracer benchmark", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    vector<Result> results;
+    for(const string& scene : options.scenes)
+    {
+        if(scene == "cornell")
+            results.push_back(benchCornell(options));
+        else if(scene == "disney" || scene == "lights")
+            results.push_back(benchDisney(options, scene == "lights"));
+        else if(scene == "heart" || scene == "mesh")
+            results.push_back(benchImplicit(options, scene == "mesh"));
+        else
+            std::cout << "ERROR::BENCHMARK::UNKNOWN_SCENE: " << scene << std::endl;
+    }
+
+    writeResults(out_path, results, options);
+    int regressions = baseline_path.empty() ? 0 : compareBaseline(baseline_path, results, tolerance);
+    glfwTerminate();
+    return regressions > 0;
+}
+
+namespace
+{
+    // 三通道的 PF，扫描线从下往上，与纹理的行顺序相同；rgba 每个像素4个float
+    bool writePFM(const string& path, const vector<float>& rgba, int width, int height)
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        if(!file)
+        {
+            std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITABLE: " << path << std::endl;
+            return false;
+        }
+        vector<float> rgb((size_t)width * height * 3);
+        for(size_t i = 0; i < (size_t)width * height; ++i)
+            memcpy(&rgb[i * 3], &rgba[i * 4], 3 * sizeof(float));
+        fprintf(file, "PF\n%d %d\n-1.0\n", width, height);
+        fwrite(rgb.data(), sizeof(float), rgb.size(), file);
+        fclose(file);
+        return true;
+    }
+
+    bool readPFM(const string& path, vector<float>& rgba, int width, int height)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if(!file)
+            return false;
+        char type[3] = {};
+        int w = 0, h = 0;
+        float scale = 0.0f;
+        bool ok = fscanf(file, "%2s %d %d %f", type, &w, &h, &scale) == 4 && strcmp(type, "PF") == 0 && w == width && h == height && scale < 0.0f;
+        fgetc(file);    // scale 之后的一个空白字符
+        vector<float> rgb((size_t)width * height * 3);
+        ok = ok && fread(rgb.data(), sizeof(float), rgb.size(), file) == rgb.size();
+        fclose(file);
+        if(!ok)
+        {
+            std::cout << "ERROR::BENCHMARK::INVALID_REFERENCE: " << path << std::endl;
+            return false;
+        }
+        rgba.assign((size_t)width * height * 4, 1.0f);
+        for(size_t i = 0; i < (size_t)width * height; ++i)
+            memcpy(&rgba[i * 4], &rgb[i * 3], 3 * sizeof(float));
+        return true;
+    }
+
+    double rmse(const vector<float>& a, const vector<float>& b)
+    {
+        double sum = 0.0;
+        size_t pixels = a.size() / 4;
+        for(size_t i = 0; i < pixels; ++i)
+        {
+            for(int c = 0; c < 3; ++c)
+            {
+                double d = (double)a[i * 4 + c] - b[i * 4 + c];
+                sum += d * d;
+            }
+        }
+        return sqrt(sum / (pixels * 3));
+    }
+
+    // 在 JSON 的一行中找 "key": 后面的值，只用于读 writeResults 写出的文件
+    string jsonValue(const string& line, const string& key)
+    {
+        size_t p = line.find("\"" + key + "\":");
+        if(p == string::npos)
+            return "";
+        p = line.find_first_not_of(" ", p + key.size() + 3);
+        if(p == string::npos)
+            return "";
+        if(line[p] == '"')
+            return line.substr(p + 1, line.find('"', p + 1) - p - 1);
+        return line.substr(p, line.find_first_of(",}", p) - p);
+    }
+}
+
+Result benchCornell(const Options& options)
+{
+    Shader path_shader(project_path + "src/shader/vs.glsl", project_path + "src/shader/base_fs.glsl", "#define RAY_STATS\n");
+    cornellCamera().bind(path_shader);
+    setCornellBox(path_shader);
+    setCornellBaseMaterials(path_shader);
+    setCornellSpheres(path_shader, 0, 6, 5);
+
+    Render render(SCR_WIDTH, SCR_HEIGHT);
+    render.enableRayStats();
+    Sampler sampler(project_path + "cache/sampler_tables.bin");
+    sampler.bind(path_shader, UNIT_SAMPLER);
+    LightBVH lights;
+    addCornellLights(path_shader, lights, 15.0f);
+    lights.build();
+    lights.bind(path_shader, UNIT_LIGHTS);
+    return measure("cornell", render, path_shader, 0.01f, options);
+}
+
+// many_lights 时顶部光源的两个三角形改为白色天花板，天花板下方均匀放 MANY_LIGHTS^2 个颜色不同的小三角形光源，总功率与原来相同
+// 小光源只加入光源BVH做下一事件估计，不作为几何体，BSDF 采样打不到它们，光源采样的 MIS 权重为 1
+Result benchDisney(const Options& options, bool many_lights)
+{
+    Shader path_shader(project_path + "src/shader/vs.glsl", project_path + "src/shader/disney_fs.glsl", "#define RAY_STATS\n");
+    cornellCamera().bind(path_shader);
+    setCornellBox(path_shader);
+    setCornellDisneyMaterials(path_shader);
+    setCornellSpheres(path_shader, 5, 6, 7);
+    path_shader.setBool("furnace_test", false);
+    path_shader.setBool("energy_compensation", true);
+
+    Render render(SCR_WIDTH, SCR_HEIGHT);
+    render.enableRayStats();
+    Sampler sampler(project_path + "cache/sampler_tables.bin");
+    sampler.bind(path_shader, UNIT_SAMPLER);
+    AlbedoLut albedo_lut(project_path + "cache/albedo_lut.bin");
+    albedo_lut.bind(path_shader, UNIT_ALBEDO_LUT);
+    Environment environment("");
+    environment.bind(path_shader, UNIT_ENVIRONMENT);
+
+    LightBVH lights;
+    if(many_lights)
+    {
+        path_shader.setUInt("tris[10].material_id", 0);
+        path_shader.setUInt("tris[11].material_id", 0);
+        const float size = 0.1f;
+        const float emission = 10.0f * 2.56f / (MANY_LIGHTS * MANY_LIGHTS * size * size * 0.5f);
+        for(int i = 0; i < MANY_LIGHTS * MANY_LIGHTS; ++i)
+        {
+            float x = -1.8f + 3.6f * (i % MANY_LIGHTS + 0.5f) / MANY_LIGHTS;
+            float z = 0.2f + 3.6f * (i / MANY_LIGHTS + 0.5f) / MANY_LIGHTS;
+            glm::vec3 color(0.5f + 0.5f * (i % 3 == 0), 0.5f + 0.5f * (i % 3 == 1), 0.5f + 0.5f * (i % 3 == 2));
+            lights.addTriangle(glm::vec3(x, 1.99f, z), glm::vec3(x + size, 1.99f, z + size), glm::vec3(x, 1.99f, z + size), color * emission, false);
+        }
+    }
+    else
+    {
+        addCornellLights(path_shader, lights, 10.0f);
+    }
+    lights.build();
+    lights.bind(path_shader, UNIT_LIGHTS);
+    return measure(many_lights ? "lights" : "disney", render, path_shader, 0.0f, options);
+}
+
+// 两个场景都在 implicit_surface.cpp 的 [-2, 2]^3 的盒子里：heart 与 implicit_surface.cpp 默认的场景相同，
+// mesh 没有隐式曲面，中间放一个倾斜的圆环网格，顶面的两个三角形发光
+Result benchImplicit(const Options& options, bool mesh)
+{
+    const glm::vec3 surface_min(-1.5f), surface_max(1.5f);
+    vector<ImplicitFunction> functions(1, ImplicitFunction("(x^2 + 9/4*z^2 + y^2 - 1)^3 - x^2*y^3 - 9/80*z^2*y^3"));
+    ImplicitShaderCache shaders(project_path + "src/shader/vs.glsl", project_path + "src/shader/implicit_fs.glsl", "#define RAY_STATS\n");
+    ImplicitShaderCache tile_shaders(project_path + "src/shader/fullscreen_vs.glsl", project_path + "src/shader/implicit_tiles_fs.glsl");
+    Shader& path_shader = shaders.get(functions);
+    cornellCamera(8.0f).bind(path_shader);     // 与 implicit_surface.cpp 相同，盒子为 [-2, 2]^3
+    path_shader.setVec3("materials[0].color", 1.0f, 1.0f, 1.0f);
+    if(mesh)
+        path_shader.setVec3("materials[1].color", 1.5f, 1.5f, 1.5f);
+    else
+        path_shader.setVec3("materials[1].color", 1.8f, 0.0f, 0.0f);
+    path_shader.setBool("materials[1].isEmissive", true);
+
+    PrimitiveBVH bvh;
+    int center = mesh ? -1 : bvh.addImplicit(glm::mat4(1.0f), surface_min, surface_max, 0, 0, 1);
+    if(mesh)
+    {
+        // 大半径 1.1、小半径 0.4 的圆环，绕 x 轴转 0.6 弧度，法线朝外
+        glm::mat4 transform = glm::rotate(glm::mat4(1.0f), 0.6f, glm::vec3(1.0f, 0.0f, 0.0f));
+        auto point = [&](int i, int j)
+        {
+            float u = 2.0f * PI * i / MESH_SEGMENTS, v = 2.0f * PI * j / (MESH_SEGMENTS / 2);
+            glm::vec3 p((1.1f + 0.4f * cos(v)) * cos(u), 0.4f * sin(v), (1.1f + 0.4f * cos(v)) * sin(u));
+            return glm::vec3(transform * glm::vec4(p, 1.0f));
+        };
+        for(int i = 0; i < MESH_SEGMENTS; ++i)
+        {
+            for(int j = 0; j < MESH_SEGMENTS / 2; ++j)
+            {
+                glm::vec3 p00 = point(i, j), p10 = point(i + 1, j), p01 = point(i, j + 1), p11 = point(i + 1, j + 1);
+                bvh.addTriangle(p00, p01, p11, glm::normalize(glm::cross(p01 - p00, p11 - p00)), 0);
+                bvh.addTriangle(p00, p11, p10, glm::normalize(glm::cross(p11 - p00, p10 - p00)), 0);
+            }
+        }
+    }
+    const int ceiling = mesh ? 1 : 0;
+    // 后面、左侧面、右侧面、上面、下面
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(-2.0f, -2.0f, -2.0f), glm::vec3(2.0f, -2.0f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0);
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(2.0f, -2.0f, -2.0f), glm::vec3(2.0f, 2.0f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0);
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, 2.0f), glm::vec3(-2.0f, -2.0f, 2.0f), glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(1.0f, 0.0f, 0.0f), 0);
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(-2.0f, -2.0f, 2.0f), glm::vec3(-2.0f, -2.0f, -2.0f), glm::vec3(1.0f, 0.0f, 0.0f), 0);
+    bvh.addTriangle(glm::vec3(2.0f, 2.0f, -2.0f), glm::vec3(2.0f, -2.0f, 2.0f), glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(-1.0f, 0.0f, 0.0f), 0);
+    bvh.addTriangle(glm::vec3(2.0f, 2.0f, -2.0f), glm::vec3(2.0f, -2.0f, -2.0f), glm::vec3(2.0f, -2.0f, 2.0f), glm::vec3(-1.0f, 0.0f, 0.0f), 0);
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(-2.0f, 2.0f, 2.0f), glm::vec3(0.0f, -1.0f, 0.0f), ceiling);
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(2.0f, 2.0f, -2.0f), glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, -1.0f, 0.0f), ceiling);
+    bvh.addTriangle(glm::vec3(-2.0f, -2.0f, -2.0f), glm::vec3(-2.0f, -2.0f, 2.0f), glm::vec3(2.0f, -2.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0);
+    bvh.addTriangle(glm::vec3(-2.0f, -2.0f, -2.0f), glm::vec3(2.0f, -2.0f, 2.0f), glm::vec3(2.0f, -2.0f, -2.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0);
+
+    Render render(SCR_WIDTH, SCR_HEIGHT);
+    render.enableRayStats();
+    Sampler sampler(project_path + "cache/sampler_tables.bin");
+    sampler.bind(path_shader, UNIT_SAMPLER);
+    bvh.build();
+    bvh.bind(path_shader, UNIT_BVH);
+    ImplicitBricks bricks;
+    bricks.add(functions[0], surface_min, surface_max);
+    bricks.upload();
+    bricks.bind(path_shader, UNIT_IMPLICIT);
+    ImplicitTiles tiles(SCR_WIDTH, SCR_HEIGHT, center >= 0 ? bvh.slot(center) : -1);
+    tiles.bind(path_shader, UNIT_IMPLICIT_TILES);
+    tiles.build(tile_shaders.get(functions), path_shader);
+    return measure(mesh ? "mesh" : "heart", render, path_shader, 0.0f, options);
+}
+
+// 准备参考图，再从零开始累积到 options.frames 帧或 options.seconds 秒
+// 每帧前后 glFinish，只计路径追踪的时间，读回和比较不计入
+Result measure(const string& scene, Render& render, Shader& shader, float adaptive_threshold, const Options& options)
+{
+    Result result;
+    result.scene = scene;
+    vector<float> reference, color, moment;
+    string reference_path = project_path + "cache/bench/" + scene + ".pfm";
+    if(options.update_references || !readPFM(reference_path, reference, SCR_WIDTH, SCR_HEIGHT))
+    {
+        printf("%s: rendering reference with %u frames\n", scene.c_str(), options.reference_frames);
+        render.setAdaptive(0.0f, 0);
+        render.reset();
+        shader.bind();
+        shader.setUInt("sample_offset", 1 << 20);
+        for(unsigned int i = 1; i <= options.reference_frames; ++i)
+        {
+            shader.bind();
+            shader.setUInt("frame_count", i);
+            render.draw(shader);
+        }
+        render.readAccumulation(reference, moment);
+        std::error_code error;
+        filesystem::create_directories(project_path + "cache/bench", error);
+        writePFM(reference_path, reference, SCR_WIDTH, SCR_HEIGHT);
+        shader.bind();
+        shader.setUInt("sample_offset", 0);
+    }
+
+    render.setAdaptive(adaptive_threshold, 64);
+    render.reset();
+    glFinish();
+    render.timer().clear();
+    render.rayStats().clearHistory();
+    bool done = false;
+    while(!done)
+    {
+        ++result.frames;
+        double begin = glfwGetTime();
+        shader.bind();
+        shader.setUInt("frame_count", result.frames);
+        render.draw(shader);
+        glFinish();
+        result.seconds += glfwGetTime() - begin;
+
+        done = result.frames >= options.frames || result.seconds >= options.seconds;
+        if(result.frames % options.check_interval == 0 || done)
+        {
+            render.readAccumulation(color, moment);
+            result.rmse = rmse(color, reference);
+            if(result.time_to_target < 0.0 && result.rmse <= options.target)
+            {
+                result.time_to_target = result.seconds;
+                result.frames_to_target = result.frames;
+            }
+        }
+    }
+    render.rayStats().poll();
+    result.ms_per_frame = result.seconds * 1e3 / result.frames;
+    for(const GpuTimer::Stats& stats : render.timer().stats())
+        result.gpu_ms_per_frame += stats.avg_ms;
+    result.rays_per_frame = render.rayStats().average().rays();
+    double trace_ms = render.timer().average("trace");
+    result.mrays = trace_ms > 0.0 ? result.rays_per_frame / (trace_ms * 1e3) : 0.0;
+    printf("%s: %u frames, %.2f ms/frame (GPU %.2f), %.2f Mrays/s, RMSE %.4f, ", scene.c_str(), result.frames,
+        result.ms_per_frame, result.gpu_ms_per_frame, result.mrays, result.rmse);
+    if(result.time_to_target >= 0.0)
+        printf("RMSE %.4f after %.2f s (%u frames)\n", options.target, result.time_to_target, result.frames_to_target);
+    else
+        printf("RMSE %.4f not reached\n", options.target);
+    return result;
+}
+
+// 每个场景一行，compareBaseline 按行读取
+void writeResults(const string& path, const vector<Result>& results, const Options& options)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file)
+    {
+        std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITABLE: " << path << std::endl;
+        return;
+    }
+    fprintf(file, "{\n  \"target_rmse\": %g,\n  \"max_frames\": %u,\n  \"max_seconds\": %g,\n  \"scenes\": [\n",
+        options.target, options.frames, options.seconds);
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& r = results[i];
+        fprintf(file, "    {\"scene\": \"%s\", \"frames\": %u, \"seconds\": %.4f, \"ms_per_frame\": %.4f, \"gpu_ms_per_frame\": %.4f, "
+            "\"mrays_per_second\": %.3f, \"rays_per_frame\": %.0f, \"rmse\": %.6f, \"time_to_target\": %.4f, \"frames_to_target\": %u}%s\n",
+            r.scene.c_str(), r.frames, r.seconds, r.ms_per_frame, r.gpu_ms_per_frame, r.mrays, r.rays_per_frame, r.rmse,
+            r.time_to_target, r.frames_to_target, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
+
+// 只比较 baseline 中也有的场景；两边都达到目标时才比较达到目标的时间，只有一边达到时没有达到的一方算退化
+int compareBaseline(const string& path, const vector<Result>& results, double tolerance)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if(!file)
+    {
+        std::cout << "ERROR::BENCHMARK::BASELINE_NOT_FOUND: " << path << std::endl;
+        return 0;
+    }
+    vector<string> lines;
+    char buffer[1024];
+    while(fgets(buffer, sizeof(buffer), file))
+        lines.push_back(buffer);
+    fclose(file);
+
+    int regressions = 0;
+    for(const Result& r : results)
+    {
+        auto line = find_if(lines.begin(), lines.end(), [&](const string& l) { return jsonValue(l, "scene") == r.scene; });
+        if(line == lines.end())
+            continue;
+        double ms = atof(jsonValue(*line, "ms_per_frame").c_str());
+        double time = atof(jsonValue(*line, "time_to_target").c_str());
+        bool slower = ms > 0.0 && r.ms_per_frame > ms * (1.0 + tolerance);
+        bool later = time >= 0.0 && (r.time_to_target < 0.0 || r.time_to_target > time * (1.0 + tolerance));
+        printf("%-8s ms/frame %8.2f -> %8.2f (%+.1f%%), time to target %7.2f -> %7.2f s %s\n", r.scene.c_str(), ms, r.ms_per_frame,
+            ms > 0.0 ? (r.ms_per_frame / ms - 1.0) * 100.0 : 0.0, time, r.time_to_target, slower || later ? "REGRESSION" : "ok");
+        regressions += slower || later;
+    }
+    return regressions;
+}
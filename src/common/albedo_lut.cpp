@@ -0,0 +1,151 @@
+#include "albedo_lut.h"
+#include "../config.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+
+namespace
+{
+    const uint32_t CACHE_MAGIC = 0x31414c47;   // "GLA1"
+    const uint32_t CACHE_VERSION = 1;
+}
+
+AlbedoLut::AlbedoLut(const std::string& cache_path)
+{
+    if(!load(cache_path))
+    {
+        std::cout << "generate albedo lut..." << std::endl;
+        generate();
+        save(cache_path);
+    }
+    upload();
+}
+
+AlbedoLut::~AlbedoLut()
+{
+    glDeleteTextures(1, &lut_texture_);
+    glDeleteTextures(1, &average_texture_);
+}
+
+void AlbedoLut::bind(Shader& shader, GLuint first_unit)
+{
+    shader.bind();
+
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_2D, lut_texture_);
+    shader.setInt("albedoLutTex", first_unit);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+    glBindTexture(GL_TEXTURE_2D, average_texture_);
+    shader.setInt("albedoAvgTex", first_unit + 1);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool AlbedoLut::load(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+        return false;
+
+    uint32_t header[4] = {};
+    bool ok = fread(header, sizeof(header), 1, file) == 1 &&
+        header[0] == CACHE_MAGIC && header[1] == CACHE_VERSION &&
+        header[2] == SIZE && header[3] == SAMPLES;
+    if(ok)
+    {
+        lut_.resize(SIZE * SIZE * 4);
+        average_.resize(SIZE);
+        ok = fread(lut_.data(), sizeof(float), lut_.size(), file) == lut_.size() &&
+            fread(average_.data(), sizeof(float), average_.size(), file) == average_.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+void AlbedoLut::save(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        std::cout << "ERROR::ALBEDO_LUT::CACHE_NOT_WRITABLE: " << path << std::endl;
+        return;
+    }
+    uint32_t header[4] = { CACHE_MAGIC, CACHE_VERSION, SIZE, SAMPLES };
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(lut_.data(), sizeof(float), lut_.size(), file);
+    fwrite(average_.data(), sizeof(float), average_.size(), file);
+    fclose(file);
+}
+
+// 每个像素积分一个网格点，积分本身与 disney_brdf.glsl 共用 microfacet.glsl 中的函数
+void AlbedoLut::generate()
+{
+    Shader shader(project_path + "src/shader/fullscreen_vs.glsl", project_path + "src/shader/albedo_lut_fs.glsl");
+
+    GLuint texture, fbo, vao;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SIZE, SIZE, 0, GL_RGBA, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glGenVertexArrays(1, &vao);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(0, 0, SIZE, SIZE);
+    shader.bind();
+    shader.setInt("lut_size", SIZE);
+    shader.setInt("sample_count", SAMPLES);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    lut_.resize(SIZE * SIZE * 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, lut_.data());
+
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &texture);
+
+    // 梯形公式对 μ 积分，F0 = 1 时镜面反射的反照率为 scale + bias
+    average_.assign(SIZE, 0.0f);
+    for(int j = 0; j < SIZE; ++j)
+    {
+        for(int i = 0; i < SIZE; ++i)
+        {
+            const float* texel = &lut_[(j * SIZE + i) * 4];
+            float mu = (float)i / (SIZE - 1);
+            float weight = (i == 0 || i == SIZE - 1) ? 0.5f : 1.0f;
+            average_[j] += 2.0f * weight * (texel[0] + texel[1]) * mu / (SIZE - 1);
+        }
+    }
+}
+
+void AlbedoLut::upload()
+{
+    glGenTextures(1, &lut_texture_);
+    glBindTexture(GL_TEXTURE_2D, lut_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SIZE, SIZE, 0, GL_RGBA, GL_FLOAT, lut_.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &average_texture_);
+    glBindTexture(GL_TEXTURE_2D, average_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, SIZE, 1, 0, GL_RED, GL_FLOAT, average_.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
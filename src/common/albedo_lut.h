@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <glad/glad.h>
+#include "shader.h"
+
+// Disney BRDF 各波瓣的方向反照率查找表，启动时用 albedo_lut_fs.glsl 在GPU上积分一次并缓存到磁盘
+// 用于按反照率选择采样的波瓣，以及镜面反射多次散射的能量补偿
+class AlbedoLut
+{
+public:
+    static const int SIZE = 32;             // (NdotV, 参数) 两个方向的分辨率，与 disney_brdf.glsl 中的 ALBEDO_LUT_SIZE 一致
+    static const int SAMPLES = 4096;        // 每个网格点的积分样本数
+
+    AlbedoLut(const std::string& cache_path);
+    ~AlbedoLut();
+    // 绑定两张纹理到 first_unit 开始的连续纹理单元上，并设置 shader 中对应的 uniform
+    void bind(Shader& shader, GLuint first_unit);
+
+private:
+    std::vector<float> lut_;        // SIZE * SIZE * 4，通道含义见 albedo_lut_fs.glsl
+    std::vector<float> average_;    // SIZE，镜面反射的平均反照率 Eavg = 2 * ∫ E(μ) μ dμ
+
+    GLuint lut_texture_ = 0;
+    GLuint average_texture_ = 0;
+
+    bool load(const std::string& path);
+    void save(const std::string& path) const;
+    void generate();
+    void upload();
+};
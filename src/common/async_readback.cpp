@@ -0,0 +1,203 @@
+#include "async_readback.h"
+
+#include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+AsyncReadback::~AsyncReadback()
+{
+    stop();
+    if(!pbos_.empty())
+        glDeleteBuffers((GLsizei)pbos_.size(), pbos_.data());
+    for(GLsync fence : fences_)
+    {
+        if(fence)
+            glDeleteSync(fence);
+    }
+}
+
+void AsyncReadback::init(unsigned int width, unsigned int height, int images, int latency, int queue)
+{
+    if(enabled())
+        return;
+    width_ = width;
+    height_ = height;
+    images_ = images;
+    queue_ = queue;
+    pbos_.resize(latency);
+    fences_.assign(latency, 0);
+    callbacks_.resize(latency);
+    glGenBuffers(latency, pbos_.data());
+    for(GLuint pbo : pbos_)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width_ * height_ * 4 * images_ * sizeof(float), NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    worker_ = std::thread(&AsyncReadback::run, this);
+}
+
+void AsyncReadback::submit(const std::vector<GLuint>& textures, Callback done)
+{
+    if(!enabled())
+        return;
+    if(fences_[next_])
+    {
+        ++dropped_;
+        return;
+    }
+    size_t image_size = (size_t)width_ * height_ * 4 * sizeof(float);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[next_]);
+    for(size_t i = 0; i < textures.size() && (int)i < images_; ++i)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, (void*)(i * image_size));
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences_[next_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    callbacks_[next_] = std::move(done);
+    next_ = (next_ + 1) % (int)pbos_.size();
+}
+
+void AsyncReadback::poll()
+{
+    int latency = (int)pbos_.size();
+    for(int k = 0; k < latency; ++k)
+    {
+        int i = (next_ + k) % latency;     // 从最早的开始
+        if(!fences_[i])
+            continue;
+        GLenum status = glClientWaitSync(fences_[i], 0, 0);
+        if(status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+            retrieve(i);
+    }
+}
+
+void AsyncReadback::flush()
+{
+    if(!enabled())
+        return;
+    int latency = (int)pbos_.size();
+    for(int k = 0; k < latency; ++k)
+    {
+        int i = (next_ + k) % latency;
+        if(!fences_[i])
+            continue;
+        while(glClientWaitSync(fences_[i], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        retrieve(i);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return jobs_.empty() && !busy_; });
+}
+
+void AsyncReadback::cancel()
+{
+    for(size_t i = 0; i < fences_.size(); ++i)
+    {
+        if(fences_[i])
+            glDeleteSync(fences_[i]);
+        fences_[i] = 0;
+        callbacks_[i] = nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.clear();
+}
+
+void AsyncReadback::stop()
+{
+    if(!enabled())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    worker_.join();
+    jobs_.clear();
+}
+
+// 栅栏信号已经到达，映射缓冲拷贝出来交给工作线程
+void AsyncReadback::retrieve(int slot)
+{
+    glDeleteSync(fences_[slot]);
+    fences_[slot] = 0;
+
+    size_t count = (size_t)width_ * height_ * 4 * images_;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[slot]);
+    const float* data = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT);
+    if(data)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(queue_ == 0)
+            {
+                dropped_ += (unsigned int)jobs_.size();
+                jobs_.clear();
+            }
+            if(queue_ == 0 || (int)jobs_.size() < queue_)
+            {
+                jobs_.emplace_back();
+                jobs_.back().data.assign(data, data + count);
+                jobs_.back().done = std::move(callbacks_[slot]);
+            }
+            else
+                ++dropped_;
+        }
+        wake_.notify_one();
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    callbacks_[slot] = nullptr;
+}
+
+void AsyncReadback::run()
+{
+    Job job;
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            busy_ = false;
+            if(jobs_.empty())
+                idle_.notify_all();
+            wake_.wait(lock, [this] { return quit_ || !jobs_.empty(); });
+            if(quit_)
+                return;
+            std::swap(job, jobs_.front());
+            jobs_.pop_front();
+            busy_ = true;
+        }
+        job.done(job.data);
+    }
+}
+
+// Windows 上 rename 不会覆盖已有的文件，先删除再改名之间会有一段时间没有文件，MoveFileEx 替换是原子的
+bool writeFileAtomically(const std::string& path, const std::function<bool(FILE*)>& write)
+{
+    std::string temp_path = path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if(!file)
+    {
+        std::cout << "ERROR::FILE::NOT_WRITABLE: " << temp_path << std::endl;
+        return false;
+    }
+    bool ok = write(file) && !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    if(!ok)
+    {
+        std::cout << "ERROR::FILE::WRITE_FAILED: " << temp_path << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    ok = MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    ok = std::rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+    if(!ok)
+        std::cout << "ERROR::FILE::RENAME_FAILED: " << path << std::endl;
+    return ok;
+}
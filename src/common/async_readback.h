@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+
+// 把几张 RGBA32F 纹理异步读回 CPU，交给一个工作线程处理，FrameWriter、Checkpoint 和 ConvergenceTracker 共用
+// submit 把纹理读到 latency 个像素缓冲对象中的一个，poll 在栅栏信号到达后才映射，拷贝出来后交给工作线程，
+// 渲染线程不等待 GPU 也不等待工作线程；所有缓冲都还在读回时 submit 直接跳过
+class AsyncReadback
+{
+public:
+    // 在工作线程上调用，data 为各张纹理前后相接的像素，行从下往上，与纹理相同，可以移走
+    using Callback = std::function<void(std::vector<float>& data)>;
+
+    ~AsyncReadback();
+    // 每次读回 images 张 width x height 的纹理；queue 为 0 时只保留最新的一份，新的一份替换还没处理的，
+    // 否则最多等待 queue 份，超过时丢弃新的一份
+    void init(unsigned int width, unsigned int height, int images, int latency, int queue);
+    bool enabled() const { return worker_.joinable(); }
+    // 在 draw 之后调用，textures 的数量为 init 的 images，读回完成后在工作线程上调用 done
+    void submit(const std::vector<GLuint>& textures, Callback done);
+    // 每帧调用
+    void poll();
+    // 等待所有的读回和处理完成，退出之前调用
+    void flush();
+    // 丢弃还在读回和等待处理的各份，正在处理的一份不受影响
+    void cancel();
+    // 停止工作线程，等待处理的各份丢弃；析构时自动调用，回调用到的成员先于这里析构时要先调用
+    void stop();
+    // submit 跳过以及工作线程跟不上时丢弃的份数
+    unsigned int dropped() const { return dropped_; }
+
+private:
+    struct Job
+    {
+        std::vector<float> data;
+        Callback done;
+    };
+
+    unsigned int width_ = 0, height_ = 0;
+    int images_ = 0, queue_ = 0;
+    std::vector<GLuint> pbos_;
+    std::vector<GLsync> fences_;
+    std::vector<Callback> callbacks_;   // 各个缓冲读回完成后的回调
+    int next_ = 0;
+    std::atomic<unsigned int> dropped_{ 0 };
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable wake_, idle_;
+    bool quit_ = false;
+    bool busy_ = false;
+    std::deque<Job> jobs_;
+
+    void retrieve(int slot);
+    void run();
+};
+
+// 先把 write 写的内容写到 path.tmp，成功后原子地替换 path，进程在任何时候退出 path 都是完整的旧文件或新文件
+bool writeFileAtomically(const std::string& path, const std::function<bool(FILE*)>& write);
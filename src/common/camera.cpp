@@ -0,0 +1,66 @@
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+#include <GLFW/glfw3.h>
+
+Camera::Camera(const glm::vec3& position, float width, float height, float focal_length, float yaw, float pitch)
+    : position_(position), width_(width), height_(height), focal_length_(focal_length), yaw_(yaw), pitch_(pitch)
+{
+}
+
+glm::vec3 Camera::forward() const
+{
+    return glm::vec3(std::sin(yaw_) * std::cos(pitch_), std::sin(pitch_), -std::cos(yaw_) * std::cos(pitch_));
+}
+
+void Camera::bind(Shader& shader, const std::string& name) const
+{
+    glm::vec3 f = forward();
+    glm::vec3 right = glm::normalize(glm::cross(f, glm::vec3(0.0f, 1.0f, 0.0f)));
+    glm::vec3 up = glm::cross(right, f);
+    glm::vec3 horizontal = right * width_;
+    glm::vec3 vertical = up * height_;
+
+    shader.bind();
+    shader.setVec3(name + ".ori", position_);
+    shader.setVec3(name + ".horizontal", horizontal);
+    shader.setVec3(name + ".vertical", vertical);
+    shader.setVec3(name + ".lower_left_corner", position_ + f * focal_length_ - horizontal / 2.0f - vertical / 2.0f);
+}
+
+bool Camera::update(GLFWwindow* window, float dt)
+{
+    bool moved = false;
+
+    // 移动只在水平面内，与俯仰角无关
+    glm::vec3 front(std::sin(yaw_), 0.0f, -std::cos(yaw_));
+    glm::vec3 right(std::cos(yaw_), 0.0f, std::sin(yaw_));
+    glm::vec3 direction(0.0f);
+    if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) direction += front;
+    if(glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) direction -= front;
+    if(glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) direction += right;
+    if(glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) direction -= right;
+    if(glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) direction.y += 1.0f;
+    if(glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) direction.y -= 1.0f;
+    if(direction != glm::vec3(0.0f))
+    {
+        position_ += glm::normalize(direction) * speed * dt;
+        moved = true;
+    }
+
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    bool pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+    if(pressed && dragging_ && (x != cursor_x_ || y != cursor_y_))
+    {
+        yaw_ += (float)(x - cursor_x_) * sensitivity;
+        pitch_ = std::clamp(pitch_ - (float)(y - cursor_y_) * sensitivity, -1.5f, 1.5f);
+        moved = true;
+    }
+    dragging_ = pressed;
+    cursor_x_ = x;
+    cursor_y_ = y;
+
+    return moved;
+}
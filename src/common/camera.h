@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <glm/glm.hpp>
+#include "shader.h"
+
+struct GLFWwindow;
+
+// 可交互的针孔相机，由位置和偏航、俯仰角生成着色器中的 Camera（ori, horizontal, vertical, lower_left_corner）
+// yaw、pitch 都为 0 时看向 -z，成像平面宽 width、高 height，到相机的距离为 focal_length
+class Camera
+{
+public:
+    Camera(const glm::vec3& position, float width, float height, float focal_length, float yaw = 0.0f, float pitch = 0.0f);
+    // 设置 shader 中名为 name 的 Camera 结构体
+    void bind(Shader& shader, const std::string& name = "camera") const;
+    // WASD 前后左右、Q/E 下降上升，按住右键拖动旋转，dt 为距上一次调用的秒数，返回相机是否移动
+    bool update(GLFWwindow* window, float dt);
+
+    glm::vec3 position() const { return position_; }
+    glm::vec3 forward() const;
+
+    float speed = 2.0f;             // 每秒移动的距离
+    float sensitivity = 0.003f;     // 每像素旋转的弧度
+
+private:
+    glm::vec3 position_;
+    float width_;
+    float height_;
+    float focal_length_;
+    float yaw_;
+    float pitch_;
+    bool dragging_ = false;
+    double cursor_x_ = 0.0;
+    double cursor_y_ = 0.0;
+};
@@ -0,0 +1,168 @@
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    const char MAGIC[8] = { 'G', 'L', 'P', 'T', 'C', 'K', 'P', 'T' };
+    const uint32_t VERSION = 1;
+}
+
+bool Checkpoint::init(const std::string& path, unsigned int width, unsigned int height)
+{
+    if(enabled())
+        return true;
+    path_ = path;
+    width_ = width;
+    height_ = height;
+    // 只保留最新的一份，下一个检查点会覆盖它
+    readback_.init(width, height, 4, LATENCY, 0);
+    return true;
+}
+
+void Checkpoint::submit(const Render& render, const State& state)
+{
+    State header = state;
+    header.width = width_;
+    header.height = height_;
+    readback_.submit({ render.accumulationTexture(), render.momentTexture(), render.normalTexture(), render.albedoTexture() },
+        [this, header](std::vector<float>& data)
+    {
+        State full = header;
+        size_t count = (size_t)width_ * height_ * 4;
+        full.color.assign(data.begin(), data.begin() + count);
+        full.moment.assign(data.begin() + count, data.begin() + count * 2);
+        full.normal.assign(data.begin() + count * 2, data.begin() + count * 3);
+        full.albedo.assign(data.begin() + count * 3, data.begin() + count * 4);
+        if(save(path_, full))
+            ++written_;
+    });
+}
+
+void Checkpoint::poll()
+{
+    readback_.poll();
+}
+
+void Checkpoint::flush()
+{
+    readback_.flush();
+}
+
+bool Checkpoint::load(const std::string& path, State& state)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        std::cout << "ERROR::CHECKPOINT::FILE_NOT_FOUND: " << path << std::endl;
+        return false;
+    }
+    char magic[8] = {};
+    uint32_t version = 0, header[5] = {};
+    bool ok = fread(magic, 1, 8, file) == 8 && memcmp(magic, MAGIC, 8) == 0
+        && fread(&version, sizeof(version), 1, file) == 1 && version == VERSION
+        && fread(header, sizeof(uint32_t), 5, file) == 5
+        && fread(&state.scene_hash, sizeof(state.scene_hash), 1, file) == 1
+        && fread(&state.seconds, sizeof(state.seconds), 1, file) == 1;
+    if(ok)
+    {
+        state.width = header[0];
+        state.height = header[1];
+        state.frame_count = header[2];
+        state.sample_offset = header[3];
+        size_t count = (size_t)state.width * state.height * 4;
+        for(std::vector<float>* image : { &state.color, &state.moment, &state.normal, &state.albedo })
+        {
+            image->resize(count);
+            ok = ok && fread(image->data(), sizeof(float), count, file) == count;
+        }
+    }
+    fclose(file);
+    if(!ok)
+        std::cout << "ERROR::CHECKPOINT::INVALID_FILE: " << path << std::endl;
+    return ok;
+}
+
+bool Checkpoint::save(const std::string& path, const State& state)
+{
+    return writeFileAtomically(path, [&](FILE* file) { return write(file, state); });
+}
+
+bool Checkpoint::write(FILE* file, const State& state)
+{
+    uint32_t header[5] = { state.width, state.height, state.frame_count, state.sample_offset, 0 };
+    fwrite(MAGIC, 1, 8, file);
+    fwrite(&VERSION, sizeof(VERSION), 1, file);
+    fwrite(header, sizeof(uint32_t), 5, file);
+    fwrite(&state.scene_hash, sizeof(state.scene_hash), 1, file);
+    fwrite(&state.seconds, sizeof(state.seconds), 1, file);
+    for(const std::vector<float>* image : { &state.color, &state.moment, &state.normal, &state.albedo })
+        fwrite(image->data(), sizeof(float), image->size(), file);
+    return !ferror(file);
+}
+
+// 颜色、二阶矩和 G-buffer 都是每个样本的均值，按 momentTex.y 的样本数加权；合并后从第一份的 sample_offset 继续，
+// 样本序号从合并后的样本数开始，不会与各次运行已用过的重复
+bool Checkpoint::merge(const std::vector<State>& states, State& merged)
+{
+    if(states.empty())
+        return false;
+    const State& first = states[0];
+    for(size_t i = 1; i < states.size(); ++i)
+    {
+        if(states[i].width != first.width || states[i].height != first.height || states[i].scene_hash != first.scene_hash)
+        {
+            std::cout << "ERROR::CHECKPOINT::SCENE_MISMATCH: " << i << std::endl;
+            return false;
+        }
+        for(size_t j = 0; j < i; ++j)
+        {
+            // 相同的 sample_offset 样本完全相同，合并只会让误差看起来更小
+            if(states[i].sample_offset == states[j].sample_offset)
+            {
+                std::cout << "ERROR::CHECKPOINT::SAME_SAMPLE_OFFSET: " << states[i].sample_offset << std::endl;
+                return false;
+            }
+        }
+    }
+
+    merged = State();
+    merged.width = first.width;
+    merged.height = first.height;
+    merged.sample_offset = first.sample_offset;
+    merged.scene_hash = first.scene_hash;
+    size_t pixels = (size_t)first.width * first.height;
+    for(std::vector<float>* image : { &merged.color, &merged.moment, &merged.normal, &merged.albedo })
+        image->assign(pixels * 4, 0.0f);
+    for(const State& state : states)
+    {
+        merged.frame_count = std::max(merged.frame_count, state.frame_count);
+        merged.seconds += state.seconds;
+        for(size_t i = 0; i < pixels * 4; ++i)
+        {
+            float n = state.moment[i / 4 * 4 + 1];
+            merged.color[i] += n * state.color[i];
+            merged.normal[i] += n * state.normal[i];
+            merged.albedo[i] += n * state.albedo[i];
+            merged.moment[i] += i % 4 == 1 ? n : n * state.moment[i];
+        }
+    }
+    for(size_t p = 0; p < pixels; ++p)
+    {
+        float n = merged.moment[p * 4 + 1];
+        if(n <= 0.0f)
+            continue;
+        for(int c = 0; c < 4; ++c)
+        {
+            merged.color[p * 4 + c] /= n;
+            merged.normal[p * 4 + c] /= n;
+            merged.albedo[p * 4 + c] /= n;
+            if(c != 1)
+                merged.moment[p * 4 + c] /= n;
+        }
+    }
+    return true;
+}
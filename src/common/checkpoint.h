@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include "async_readback.h"
+#include "render.h"
+
+// 累积状态的检查点，长时间的渲染中途退出后可以从这里继续
+// 文件为一个固定大小的头，之后是颜色、二阶矩、法线、反照率四张 RGBA32F 图像，行从下往上，与纹理相同
+// 四张纹理由 AsyncReadback 异步读回，在它的工作线程上用 writeFileAtomically 写文件，进程在写的过程中退出也不会破坏已有的检查点
+// 样本序号只由每个像素累积的样本数和 sample_offset 决定，见 accumulate.glsl，关闭 ReSTIR 时恢复后的样本与不中断时完全相同；
+// ReSTIR 的蓄水池不在检查点里，恢复后从空的蓄水池重新开始，结果仍然无偏，但与不中断时不同
+class Checkpoint
+{
+public:
+    static const int LATENCY = 2;       // 同时在读回的份数
+
+    struct State
+    {
+        unsigned int width = 0, height = 0;
+        unsigned int frame_count = 0;       // 主程序的帧数，ReSTIR 按帧取样本
+        unsigned int sample_offset = 0;     // 不同的 sample_offset 的运行可以合并
+        uint64_t scene_hash = 0;            // 见 Shader::hashUniforms
+        double seconds = 0.0;               // 累积到这里花费的时间
+        std::vector<float> color, moment, normal, albedo;
+    };
+
+    bool init(const std::string& path, unsigned int width, unsigned int height);
+    bool enabled() const { return readback_.enabled(); }
+    // 在 draw 之后调用，state 中的图像不需要填，从 render 累积的结果读回
+    void submit(const Render& render, const State& state);
+    // 每帧调用
+    void poll();
+    // 等待所有的读回和写文件完成，退出之前调用
+    void flush();
+    unsigned int written() const { return written_; }
+
+    static bool load(const std::string& path, State& state);
+    static bool save(const std::string& path, const State& state);
+    // 按每个像素的样本数加权合并几次运行的结果，尺寸和场景必须相同，sample_offset 必须互不相同
+    static bool merge(const std::vector<State>& states, State& merged);
+
+private:
+    std::string path_;
+    unsigned int width_ = 0, height_ = 0;
+    std::atomic<unsigned int> written_{ 0 };
+    AsyncReadback readback_;            // 四张图像前后相接，最后析构
+
+    static bool write(FILE* file, const State& state);
+};
@@ -0,0 +1,561 @@
+#include "convergence_tracker.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <glm/glm.hpp>
+
+namespace
+{
+    const float PPD = 67.0f;        // 每度的像素数，0.7 m 外 0.7 m 宽的 3840 像素显示器
+    const float FLIP_QC = 0.7f;
+    const float FLIP_QF = 0.5f;
+    const float FLIP_PC = 0.4f;
+    const float FLIP_PT = 0.95f;
+    const float FLIP_GW = 0.082f;   // 特征检测的高斯宽度，度
+    const glm::vec3 WHITE_D65(0.950428545f, 1.0f, 1.088900371f);
+
+    glm::vec3 linearToXYZ(const glm::vec3& c)
+    {
+        return glm::vec3(0.4124564f * c.r + 0.3575761f * c.g + 0.1804375f * c.b,
+                         0.2126729f * c.r + 0.7151522f * c.g + 0.0721750f * c.b,
+                         0.0193339f * c.r + 0.1191920f * c.g + 0.9503041f * c.b);
+    }
+
+    glm::vec3 XYZToLinear(const glm::vec3& c)
+    {
+        return glm::vec3(3.2404542f * c.x - 1.5371385f * c.y - 0.4985314f * c.z,
+                         -0.9692660f * c.x + 1.8760108f * c.y + 0.0415560f * c.z,
+                         0.0556434f * c.x - 0.2040259f * c.y + 1.0572252f * c.z);
+    }
+
+    glm::vec3 XYZToYCxCz(const glm::vec3& c)
+    {
+        glm::vec3 n = c / WHITE_D65;
+        return glm::vec3(116.0f * n.y - 16.0f, 500.0f * (n.x - n.y), 200.0f * (n.y - n.z));
+    }
+
+    glm::vec3 YCxCzToXYZ(const glm::vec3& c)
+    {
+        float y = (c.x + 16.0f) / 116.0f;
+        return glm::vec3(c.y / 500.0f + y, y, y - c.z / 200.0f) * WHITE_D65;
+    }
+
+    // CIELab 再按 Hunt 效应调整 a、b
+    glm::vec3 XYZToHuntLab(const glm::vec3& c)
+    {
+        const float delta = 6.0f / 29.0f;
+        auto f = [&](float t) { return t > delta * delta * delta ? std::cbrt(t) : t / (3.0f * delta * delta) + 4.0f / 29.0f; };
+        glm::vec3 n = c / WHITE_D65;
+        float L = 116.0f * f(n.y) - 16.0f;
+        float a = 500.0f * (f(n.x) - f(n.y));
+        float b = 200.0f * (f(n.y) - f(n.z));
+        return glm::vec3(L, 0.01f * L * a, 0.01f * L * b);
+    }
+
+    float hyAB(const glm::vec3& x, const glm::vec3& y)
+    {
+        return std::fabs(x.x - y.x) + std::sqrt((x.y - y.y) * (x.y - y.y) + (x.z - y.z) * (x.z - y.z));
+    }
+
+    // 屏幕上显示的颜色，见 displayColor，当作 sRGB 再转回线性
+    glm::vec3 displayLinear(const float* c)
+    {
+        glm::vec3 color = displayColor(glm::vec3(c[0], c[1], c[2]));
+        for(int i = 0; i < 3; ++i)
+            color[i] = color[i] <= 0.04045f ? color[i] / 12.92f : std::pow((color[i] + 0.055f) / 1.055f, 2.4f);
+        return color;
+    }
+
+    // 可分离的卷积，边界取最近的像素；channels 个通道交错存放
+    void convolve(const std::vector<float>& src, std::vector<float>& dst, int width, int height, int channels,
+                  const std::vector<float>& kx, const std::vector<float>& ky)
+    {
+        int rx = (int)kx.size() / 2, ry = (int)ky.size() / 2;
+        std::vector<float> temp(src.size(), 0.0f);
+        dst.assign(src.size(), 0.0f);
+        for(int y = 0; y < height; ++y)
+            for(int x = 0; x < width; ++x)
+                for(int k = -rx; k <= rx; ++k)
+                {
+                    int sx = std::min(std::max(x + k, 0), width - 1);
+                    for(int c = 0; c < channels; ++c)
+                        temp[((size_t)y * width + x) * channels + c] += kx[k + rx] * src[((size_t)y * width + sx) * channels + c];
+                }
+        for(int y = 0; y < height; ++y)
+            for(int k = -ry; k <= ry; ++k)
+            {
+                int sy = std::min(std::max(y + k, 0), height - 1);
+                for(int x = 0; x < width; ++x)
+                    for(int c = 0; c < channels; ++c)
+                        dst[((size_t)y * width + x) * channels + c] += ky[k + ry] * temp[((size_t)sy * width + x) * channels + c];
+            }
+    }
+
+    float halfToFloat(uint16_t h)
+    {
+        uint32_t sign = (h >> 15) & 1, exponent = (h >> 10) & 0x1f, mantissa = h & 0x3ff;
+        float value;
+        if(exponent == 0)
+            value = std::ldexp((float)mantissa, -24);
+        else if(exponent == 31)
+            value = mantissa ? NAN : INFINITY;
+        else
+            value = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+        return sign ? -value : value;
+    }
+}
+
+const char* ConvergenceTracker::metricName(int metric)
+{
+    const char* names[METRIC_COUNT] = { "rmse", "relmse", "flip" };
+    return metric >= 0 && metric < METRIC_COUNT ? names[metric] : "";
+}
+
+int ConvergenceTracker::metricByName(const std::string& name)
+{
+    for(int i = 0; i < METRIC_COUNT; ++i)
+    {
+        if(name == metricName(i))
+            return i;
+    }
+    return -1;
+}
+
+ConvergenceTracker::~ConvergenceTracker()
+{
+    readback_.stop();
+    if(log_)
+        fclose(log_);
+}
+
+bool ConvergenceTracker::init(const std::string& reference_path, unsigned int width, unsigned int height)
+{
+    if(enabled())
+        return true;
+    width_ = width;
+    height_ = height;
+    std::string extension = reference_path.substr(reference_path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    bool ok = false;
+    if(extension == "pfm")
+        ok = loadPFM(reference_path);
+    else if(extension == "exr")
+        ok = loadEXR(reference_path);
+    else
+        std::cout << "ERROR::CONVERGENCE::UNSUPPORTED_FORMAT: " << reference_path << std::endl;
+    if(!ok)
+    {
+        reference_.clear();
+        return false;
+    }
+    reference_flip_ = flipImage(reference_, width_, height_);
+    readback_.init(width_, height_, 2, LATENCY, 0);
+    return true;
+}
+
+void ConvergenceTracker::setStop(int metric, double threshold)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_metric_ = std::min(std::max(metric, 0), METRIC_COUNT - 1);
+    stop_threshold_ = threshold;
+}
+
+bool ConvergenceTracker::setLog(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(log_)
+        fclose(log_);
+    log_ = fopen(path.c_str(), "w");
+    if(!log_)
+    {
+        std::cout << "ERROR::CONVERGENCE::FILE_NOT_WRITABLE: " << path << std::endl;
+        return false;
+    }
+    fprintf(log_, "seconds,spp,rmse,relmse,flip\n");
+    fflush(log_);
+    return true;
+}
+
+void ConvergenceTracker::submit(GLuint color, GLuint moment, double seconds)
+{
+    if(!enabled())
+        return;
+    unsigned int generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation = generation_;
+    }
+    readback_.submit({ color, moment }, [this, seconds, generation](std::vector<float>& data)
+    {
+        Sample sample = evaluate(data, seconds);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(generation != generation_)   // 读回或计算期间调用了 reset
+            return;
+        samples_.push_back(sample);
+        if(stop_threshold_ > 0.0 && sample.errors[stop_metric_] <= stop_threshold_)
+            converged_ = true;
+        if(log_)
+        {
+            fprintf(log_, "%.3f,%.2f,%.6g,%.6g,%.6g\n", sample.seconds, sample.spp, sample.errors[RMSE], sample.errors[REL_MSE], sample.errors[FLIP]);
+            fflush(log_);
+        }
+    });
+}
+
+void ConvergenceTracker::poll()
+{
+    readback_.poll();
+}
+
+void ConvergenceTracker::reset()
+{
+    readback_.cancel();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    samples_.clear();
+    converged_ = false;
+}
+
+std::vector<ConvergenceTracker::Sample> ConvergenceTracker::samples() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_;
+}
+
+bool ConvergenceTracker::last(Sample& sample) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(samples_.empty())
+        return false;
+    sample = samples_.back();
+    return true;
+}
+
+ConvergenceTracker::Sample ConvergenceTracker::evaluate(const std::vector<float>& data, double seconds) const
+{
+    Sample sample;
+    sample.seconds = seconds;
+    size_t pixels = (size_t)width_ * height_;
+    const float* color = data.data();
+    const float* moment = data.data() + pixels * 4;
+    double spp = 0.0, squared = 0.0, relative = 0.0;
+    for(size_t i = 0; i < pixels; ++i)
+    {
+        spp += moment[i * 4 + 1];
+        for(int c = 0; c < 3; ++c)
+        {
+            double r = reference_[i * 4 + c];
+            double d = color[i * 4 + c] - r;
+            squared += d * d;
+            relative += d * d / (r * r + 0.01);
+        }
+    }
+    sample.spp = spp / pixels;
+    sample.errors[RMSE] = std::sqrt(squared / (pixels * 3));
+    sample.errors[REL_MSE] = relative / (pixels * 3);
+    sample.errors[FLIP] = flip(reference_flip_, flipImage(std::vector<float>(color, moment), width_, height_));
+    return sample;
+}
+
+// Portable Float Map，只支持三通道的 PF，扫描线从下往上存储，与纹理相同
+bool ConvergenceTracker::loadPFM(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        std::cout << "ERROR::CONVERGENCE::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+        return false;
+    }
+    char type[3] = {};
+    int width = 0, height = 0;
+    float scale = 0.0f;
+    if(fscanf(file, "%2s %d %d %f", type, &width, &height, &scale) != 4 || strcmp(type, "PF") != 0)
+    {
+        std::cout << "ERROR::CONVERGENCE::INVALID_PFM: " << path << std::endl;
+        fclose(file);
+        return false;
+    }
+    if(width != (int)width_ || height != (int)height_)
+    {
+        std::cout << "ERROR::CONVERGENCE::SIZE_MISMATCH: " << width << "x" << height << std::endl;
+        fclose(file);
+        return false;
+    }
+    fgetc(file);    // 文件头最后的单个空白字符
+
+    std::vector<float> data((size_t)width * height * 3);
+    bool ok = fread(data.data(), sizeof(float), data.size(), file) == data.size();
+    fclose(file);
+    if(!ok)
+    {
+        std::cout << "ERROR::CONVERGENCE::TRUNCATED_PFM: " << path << std::endl;
+        return false;
+    }
+    reference_.assign((size_t)width * height * 4, 1.0f);
+    for(size_t i = 0; i < (size_t)width * height; ++i)
+    {
+        for(int c = 0; c < 3; ++c)
+        {
+            float v = data[i * 3 + c];
+            if(scale > 0.0f)    // scale 为正表示大端序
+            {
+                uint32_t bits;
+                memcpy(&bits, &v, 4);
+                bits = (bits >> 24) | ((bits >> 8) & 0xff00) | ((bits << 8) & 0xff0000) | (bits << 24);
+                memcpy(&v, &bits, 4);
+            }
+            reference_[i * 4 + c] = v;
+        }
+    }
+    return true;
+}
+
+// OpenEXR，只支持单部分、扫描线、不压缩的文件，通道为 HALF 或 FLOAT 的 R、G、B（或只有 Y）
+bool ConvergenceTracker::loadEXR(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        std::cout << "ERROR::CONVERGENCE::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+        return false;
+    }
+    std::vector<char> bytes;
+    char buffer[65536];
+    for(size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0; )
+        bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+
+    size_t p = 0;
+    auto readInt = [&](int32_t& v) { if(p + 4 > bytes.size()) return false; memcpy(&v, &bytes[p], 4); p += 4; return true; };
+    auto readString = [&](std::string& s)
+    {
+        size_t end = p;
+        while(end < bytes.size() && bytes[end])
+            ++end;
+        if(end >= bytes.size())
+            return false;
+        s.assign(&bytes[p], end - p);
+        p = end + 1;
+        return true;
+    };
+
+    int32_t magic = 0, version = 0;
+    if(!readInt(magic) || magic != 20000630 || !readInt(version) || (version & 0x1200))     // 0x200 为分块，0x1000 为多部分
+    {
+        std::cout << "ERROR::CONVERGENCE::UNSUPPORTED_EXR: " << path << std::endl;
+        return false;
+    }
+
+    struct Channel { std::string name; int32_t type; };
+    std::vector<Channel> channels;
+    int32_t window[4] = {};
+    int compression = -1;
+    std::string name, type;
+    while(readString(name) && !name.empty())
+    {
+        int32_t size = 0;
+        if(!readString(type) || !readInt(size) || p + size > bytes.size())
+            break;
+        size_t end = p + size;
+        if(name == "channels")
+        {
+            std::string channel;
+            while(readString(channel) && !channel.empty())
+            {
+                int32_t pixel_type = 0;
+                readInt(pixel_type);
+                p += 12;    // pLinear、保留字节、x/y 采样
+                channels.push_back({ channel, pixel_type });
+            }
+        }
+        else if(name == "compression")
+            compression = (unsigned char)bytes[p];
+        else if(name == "dataWindow")
+            memcpy(window, &bytes[p], 16);
+        p = end;
+    }
+    int width = window[2] - window[0] + 1, height = window[3] - window[1] + 1;
+    if(compression != 0 || channels.empty())
+    {
+        std::cout << "ERROR::CONVERGENCE::UNSUPPORTED_EXR: compression " << compression << std::endl;
+        return false;
+    }
+    if(width != (int)width_ || height != (int)height_)
+    {
+        std::cout << "ERROR::CONVERGENCE::SIZE_MISMATCH: " << width << "x" << height << std::endl;
+        return false;
+    }
+
+    // 通道按名字排序存放；每个通道写到 RGB 的哪一个分量，Y 写到全部
+    std::vector<int> targets;
+    size_t line_bytes = 0;
+    for(const Channel& channel : channels)
+    {
+        targets.push_back(channel.name == "R" ? 0 : channel.name == "G" ? 1 : channel.name == "B" ? 2 : channel.name == "Y" ? 3 : -1);
+        line_bytes += (size_t)width * (channel.type == 1 ? 2 : 4);
+    }
+
+    reference_.assign((size_t)width * height * 4, 1.0f);
+    p += (size_t)height * 8;    // 偏移表，不压缩时块按顺序紧接着存放
+    for(int line = 0; line < height; ++line)
+    {
+        int32_t y = 0, size = 0;
+        if(!readInt(y) || !readInt(size) || (size_t)size != line_bytes || p + size > bytes.size() || y < window[1] || y > window[3])
+        {
+            std::cout << "ERROR::CONVERGENCE::TRUNCATED_EXR: " << path << std::endl;
+            return false;
+        }
+        int row = height - 1 - (y - window[1]);    // EXR 的行从上往下
+        for(size_t c = 0; c < channels.size(); ++c)
+        {
+            for(int x = 0; x < width; ++x)
+            {
+                float v;
+                if(channels[c].type == 1)
+                {
+                    uint16_t h;
+                    memcpy(&h, &bytes[p], 2);
+                    v = halfToFloat(h);
+                    p += 2;
+                }
+                else if(channels[c].type == 2)
+                {
+                    memcpy(&v, &bytes[p], 4);
+                    p += 4;
+                }
+                else
+                {
+                    uint32_t u;
+                    memcpy(&u, &bytes[p], 4);
+                    v = (float)u;
+                    p += 4;
+                }
+                float* pixel = &reference_[((size_t)row * width + x) * 4];
+                if(targets[c] == 3)
+                    pixel[0] = pixel[1] = pixel[2] = v;
+                else if(targets[c] >= 0)
+                    pixel[targets[c]] = v;
+            }
+        }
+    }
+    return true;
+}
+
+ConvergenceTracker::FlipImage ConvergenceTracker::flipImage(const std::vector<float>& rgba, int width, int height)
+{
+    size_t pixels = (size_t)width * height;
+    std::vector<float> opponent(pixels * 3), achromatic(pixels);
+    for(size_t i = 0; i < pixels; ++i)
+    {
+        glm::vec3 c = XYZToYCxCz(linearToXYZ(displayLinear(&rgba[i * 4])));
+        opponent[i * 3] = c.x;
+        opponent[i * 3 + 1] = c.y;
+        opponent[i * 3 + 2] = c.z;
+        achromatic[i] = (c.x + 16.0f) / 116.0f;
+    }
+
+    // 对比敏感度函数：每个通道两个高斯之和，(a1, b1, a2, b2) 依次为亮度、红绿、蓝黄
+    const float csf[3][4] = { { 1.0f, 0.0047f, 0.0f, 1e-5f }, { 1.0f, 0.0053f, 0.0f, 1e-5f }, { 34.1f, 0.04f, 13.5f, 0.025f } };
+    const float pi = 3.14159265f;
+    int radius = (int)std::ceil(3.0f * std::sqrt(0.04f / (2.0f * pi * pi)) * PPD);
+    std::vector<float> filtered(pixels * 3);
+    for(int channel = 0; channel < 3; ++channel)
+    {
+        std::vector<float> plane(pixels), sum(pixels, 0.0f), result;
+        for(size_t i = 0; i < pixels; ++i)
+            plane[i] = opponent[i * 3 + channel];
+        // 二维的核为两个可分离的高斯之和，分别卷积再按整个核的和归一化
+        float total = 0.0f;
+        for(int term = 0; term < 2; ++term)
+        {
+            float a = csf[channel][term * 2], b = csf[channel][term * 2 + 1];
+            if(a == 0.0f)
+                continue;
+            std::vector<float> g(radius * 2 + 1);
+            float g_sum = 0.0f;
+            for(int x = -radius; x <= radius; ++x)
+            {
+                float d = x / PPD;
+                g[x + radius] = std::exp(-pi * pi * d * d / b);
+                g_sum += g[x + radius];
+            }
+            float scale = a * std::sqrt(pi / b);
+            total += scale * g_sum * g_sum;
+            convolve(plane, result, width, height, 1, g, g);
+            for(size_t i = 0; i < pixels; ++i)
+                sum[i] += scale * result[i];
+        }
+        for(size_t i = 0; i < pixels; ++i)
+            filtered[i * 3 + channel] = sum[i] / total;
+    }
+
+    FlipImage features;
+    features.lab.resize(pixels);
+    for(size_t i = 0; i < pixels; ++i)
+    {
+        glm::vec3 linear = XYZToLinear(YCxCzToXYZ(glm::vec3(filtered[i * 3], filtered[i * 3 + 1], filtered[i * 3 + 2])));
+        features.lab[i] = XYZToHuntLab(linearToXYZ(glm::clamp(linear, 0.0f, 1.0f)));
+    }
+
+    // 高斯的一阶、二阶导数检测边缘和点，正负权重分别归一化到 1 和 -1
+    float sigma = 0.5f * FLIP_GW * PPD;
+    int feature_radius = (int)std::ceil(3.0f * sigma);
+    int n = feature_radius * 2 + 1;
+    std::vector<float> g(n), dg(n), ddg(n);
+    float g_sum = 0.0f, dg_pos = 0.0f, ddg_pos = 0.0f, ddg_neg = 0.0f;
+    for(int x = -feature_radius; x <= feature_radius; ++x)
+    {
+        float v = std::exp(-(float)(x * x) / (2.0f * sigma * sigma));
+        g[x + feature_radius] = v;
+        dg[x + feature_radius] = -x * v;
+        ddg[x + feature_radius] = (x * x / (sigma * sigma) - 1.0f) * v;
+        g_sum += v;
+        dg_pos += std::max(0.0f, -x * v);
+        if(ddg[x + feature_radius] > 0.0f)
+            ddg_pos += ddg[x + feature_radius];
+        else
+            ddg_neg -= ddg[x + feature_radius];
+    }
+    for(int i = 0; i < n; ++i)
+    {
+        g[i] /= g_sum;
+        dg[i] /= dg_pos;
+        ddg[i] /= ddg[i] > 0.0f ? ddg_pos : ddg_neg;
+    }
+    std::vector<float> ex, ey, px, py;
+    convolve(achromatic, ex, width, height, 1, dg, g);
+    convolve(achromatic, ey, width, height, 1, g, dg);
+    convolve(achromatic, px, width, height, 1, ddg, g);
+    convolve(achromatic, py, width, height, 1, g, ddg);
+    features.edge.resize(pixels);
+    features.point.resize(pixels);
+    for(size_t i = 0; i < pixels; ++i)
+    {
+        features.edge[i] = std::sqrt(ex[i] * ex[i] + ey[i] * ey[i]);
+        features.point[i] = std::sqrt(px[i] * px[i] + py[i] * py[i]);
+    }
+    return features;
+}
+
+double ConvergenceTracker::flip(const FlipImage& reference, const FlipImage& test)
+{
+    float cmax = std::pow(hyAB(XYZToHuntLab(linearToXYZ(glm::vec3(0, 1, 0))), XYZToHuntLab(linearToXYZ(glm::vec3(0, 0, 1)))), FLIP_QC);
+    double sum = 0.0;
+    for(size_t i = 0; i < reference.lab.size(); ++i)
+    {
+        float color = std::pow(hyAB(reference.lab[i], test.lab[i]), FLIP_QC);
+        if(color < FLIP_PC * cmax)
+            color *= FLIP_PT / (FLIP_PC * cmax);
+        else
+            color = FLIP_PT + (color - FLIP_PC * cmax) / (cmax - FLIP_PC * cmax) * (1.0f - FLIP_PT);
+        float feature = std::max(std::fabs(reference.edge[i] - test.edge[i]), std::fabs(reference.point[i] - test.point[i]));
+        feature = std::pow(feature / std::sqrt(2.0f), FLIP_QF);
+        sum += std::pow(color, 1.0f - feature);
+    }
+    return sum / reference.lab.size();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "async_readback.h"
+
+// 渐进渲染与参考图的误差随时间的变化，用于判断什么时候可以停止渲染，也用于比较不同的积分器
+// 累积的颜色和二阶矩由 AsyncReadback 异步读回，在它的工作线程上计算 RMSE、relMSE 和 FLIP，
+// 渲染线程不等待 GPU 也不做计算；工作线程忙时只保留最新的一份，中间的直接丢弃
+// FLIP 为 Andersson et al. 2020 的 LDR-FLIP，输入为按 output_fs.glsl 色调映射后的图像，观察条件为 67 像素/度
+class ConvergenceTracker
+{
+public:
+    static const int LATENCY = 3;       // 同时在读回的份数
+
+    enum Metric { RMSE = 0, REL_MSE, FLIP, METRIC_COUNT };
+    static const char* metricName(int metric);
+    // 找不到时返回 -1
+    static int metricByName(const std::string& name);
+
+    struct Sample
+    {
+        double seconds = 0.0;   // submit 时调用者给出的渲染时间
+        double spp = 0.0;       // 每个像素平均的样本数
+        double errors[METRIC_COUNT] = {};
+    };
+
+    ~ConvergenceTracker();
+    // 读取参考图，.pfm 或不压缩的扫描线 .exr，尺寸必须为 width x height，成功后启动工作线程
+    bool init(const std::string& reference_path, unsigned int width, unsigned int height);
+    bool enabled() const { return readback_.enabled(); }
+    // metric 的误差不超过 threshold 后 converged() 为 true，threshold 为 0 时一直为 false
+    void setStop(int metric, double threshold);
+    // 每个结果追加一行 CSV 到 path
+    bool setLog(const std::string& path);
+    // 在 draw 之后调用，color、moment 为 Render 累积的结果，seconds 为到目前为止的渲染时间
+    void submit(GLuint color, GLuint moment, double seconds);
+    // 每帧调用
+    void poll();
+    bool converged() const { return converged_; }
+    // 累积的结果清空后调用，丢弃之前所有的结果和还在读回或计算的图像
+    void reset();
+    std::vector<Sample> samples() const;
+    // 没有结果时返回 false
+    bool last(Sample& sample) const;
+
+private:
+    // FLIP 对一张图像需要的量：对比敏感度滤波后按 Hunt 效应调整的 Lab，以及亮度的边缘和点特征的强度
+    struct FlipImage
+    {
+        std::vector<glm::vec3> lab;
+        std::vector<float> edge, point;
+    };
+
+    unsigned int width_ = 0, height_ = 0;
+    std::vector<float> reference_;          // 每个像素4个float，行从下往上，与纹理相同
+    FlipImage reference_flip_;
+
+    mutable std::mutex mutex_;              // 保护下面的成员，回调在工作线程上
+    int stop_metric_ = FLIP;
+    double stop_threshold_ = 0.0;
+    std::atomic<bool> converged_{ false };
+    unsigned int generation_ = 0;           // reset 的次数，之前的结果作废
+    std::vector<Sample> samples_;
+    FILE* log_ = nullptr;
+    AsyncReadback readback_;                // 颜色和二阶矩前后相接
+
+    bool loadPFM(const std::string& path);
+    bool loadEXR(const std::string& path);
+    // data 为颜色和二阶矩前后相接
+    Sample evaluate(const std::vector<float>& data, double seconds) const;
+    static FlipImage flipImage(const std::vector<float>& rgba, int width, int height);
+    static double flip(const FlipImage& reference, const FlipImage& test);
+};
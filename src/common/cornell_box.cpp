@@ -0,0 +1,113 @@
+#include "cornell_box.h"
+
+#include <string>
+
+const CornellWall CORNELL_WALLS[12] =
+{
+    { glm::vec3(-2.0f, 2.0f, 0.0f), glm::vec3(-2.0f, -2.0f, 0.0f), glm::vec3(2.0f, -2.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 4 },     // 后面
+    { glm::vec3(-2.0f, 2.0f, 0.0f), glm::vec3(2.0f, -2.0f, 0.0f), glm::vec3(2.0f, 2.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 4 },
+    { glm::vec3(-2.0f, 2.0f, 4.0f), glm::vec3(-2.0f, -2.0f, 4.0f), glm::vec3(-2.0f, 2.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), 2 },     // 左侧面
+    { glm::vec3(-2.0f, 2.0f, 0.0f), glm::vec3(-2.0f, -2.0f, 4.0f), glm::vec3(-2.0f, -2.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), 2 },
+    { glm::vec3(2.0f, 2.0f, 0.0f), glm::vec3(2.0f, -2.0f, 4.0f), glm::vec3(2.0f, 2.0f, 4.0f), glm::vec3(-1.0f, 0.0f, 0.0f), 3 },      // 右侧面
+    { glm::vec3(2.0f, 2.0f, 0.0f), glm::vec3(2.0f, -2.0f, 0.0f), glm::vec3(2.0f, -2.0f, 4.0f), glm::vec3(-1.0f, 0.0f, 0.0f), 3 },
+    { glm::vec3(-2.0f, 2.0f, 0.0f), glm::vec3(2.0f, 2.0f, 4.0f), glm::vec3(-2.0f, 2.0f, 4.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0 },     // 上面
+    { glm::vec3(-2.0f, 2.0f, 0.0f), glm::vec3(2.0f, 2.0f, 0.0f), glm::vec3(2.0f, 2.0f, 4.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0 },
+    { glm::vec3(-2.0f, -2.0f, 0.0f), glm::vec3(-2.0f, -2.0f, 4.0f), glm::vec3(2.0f, -2.0f, 4.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0 },    // 下面
+    { glm::vec3(-2.0f, -2.0f, 0.0f), glm::vec3(2.0f, -2.0f, 4.0f), glm::vec3(2.0f, -2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0 },
+    { glm::vec3(-0.8f, 1.999f, 1.2f), glm::vec3(0.8f, 1.999f, 2.8f), glm::vec3(-0.8f, 1.999f, 2.8f), glm::vec3(0.0f, -1.0f, 0.0f), 1 },  // 顶部光源
+    { glm::vec3(-0.8f, 1.999f, 1.2f), glm::vec3(0.8f, 1.999f, 1.2f), glm::vec3(0.8f, 1.999f, 2.8f), glm::vec3(0.0f, -1.0f, 0.0f), 1 },
+};
+
+Camera cornellCamera(float z)
+{
+    return Camera(glm::vec3(0.0f, 0.0f, z), 4.0f, 4.0f, 6.0f);
+}
+
+void setCornellBox(Shader& shader)
+{
+    shader.bind();
+    for(int i = 0; i < 12; ++i)
+    {
+        std::string tri = "tris[" + std::to_string(i) + "]";
+        shader.setVec3(tri + ".p0", CORNELL_WALLS[i].p0);
+        shader.setVec3(tri + ".p1", CORNELL_WALLS[i].p1);
+        shader.setVec3(tri + ".p2", CORNELL_WALLS[i].p2);
+        shader.setVec3(tri + ".n0", CORNELL_WALLS[i].normal);
+        shader.setVec3(tri + ".n1", CORNELL_WALLS[i].normal);
+        shader.setVec3(tri + ".n2", CORNELL_WALLS[i].normal);
+        shader.setUInt(tri + ".material_id", CORNELL_WALLS[i].material);
+        shader.setInt(tri + ".light_id", -1);
+    }
+}
+
+void setCornellSpheres(Shader& shader, unsigned int left, unsigned int middle, unsigned int right)
+{
+    const unsigned int materials[3] = { left, middle, right };
+    shader.bind();
+    for(int i = 0; i < 3; ++i)
+    {
+        std::string sphere = "spheres[" + std::to_string(i) + "]";
+        shader.setVec3(sphere + ".center", -1.35f + 1.35f * i, -1.4f, 2.0f);
+        shader.setFloat(sphere + ".radius", 0.6f);
+        shader.setUInt(sphere + ".material_id", materials[i]);
+    }
+}
+
+void setCornellBaseMaterials(Shader& shader)
+{
+    shader.bind();
+    shader.setVec3("materials[0].color", 1.0f, 1.0f, 1.0f);    // 白色漫反射
+    shader.setVec3("materials[1].color", 15.0f, 15.0f, 15.0f);  // 光源，漫反射权重除以了PI，亮度相应调高
+    shader.setBool("materials[1].isEmissive", true);
+    shader.setVec3("materials[2].color", 1.0f, 0.5f, 0.5f);    // 红色
+    shader.setVec3("materials[3].color", 0.5f, 1.0f, 1.0f);    // 蓝色
+    shader.setVec3("materials[4].color", 0.5f, 0.5f, 1.0f);    // 紫色
+
+    shader.setVec3("materials[5].color", 1.0f, 1.0f, 1.0f);    // 镜面反射
+    shader.setFloat("materials[5].specularRate", 1.0f);
+
+    shader.setVec3("materials[6].color", 1.0f, 1.0f, 1.0f);    // 折射
+    shader.setFloat("materials[6].specularRate", 0.1f);
+    shader.setFloat("materials[6].refractRate", 1.0f);
+    shader.setFloat("materials[6].refractAngle", 0.1f);
+}
+
+void setCornellDisneyMaterials(Shader& shader)
+{
+    shader.bind();
+    shader.setVec3("materials[0].baseColor", 1.0f, 1.0f, 1.0f);    // 白色漫反射
+    shader.setVec3("materials[1].baseColor", 1.0f, 1.0f, 1.0f);    // 光源
+    shader.setVec3("materials[1].emissive", 10.0f, 10.0f, 10.0f);
+    shader.setVec3("materials[2].baseColor", 1.0f, 0.5f, 0.5f);    // 红色
+    shader.setVec3("materials[3].baseColor", 0.5f, 1.0f, 1.0f);    // 蓝色
+    shader.setVec3("materials[4].baseColor", 0.5f, 0.5f, 1.0f);    // 紫色
+
+    shader.setVec3("materials[5].baseColor", 1.0f, 1.0f, 1.0f);
+    shader.setFloat("materials[5].metallic", 0.4f);
+    shader.setFloat("materials[5].specular", 0.3f);
+    shader.setFloat("materials[5].specularTint", 0.3f);
+    shader.setFloat("materials[5].roughness", 0.1f);
+    shader.setFloat("materials[5].sheen", 0.5f);
+    shader.setFloat("materials[5].sheenTint", 0.5f);
+
+    shader.setVec3("materials[6].baseColor", 1.0f, 1.0f, 1.0f);
+    shader.setFloat("materials[6].metallic", 0.2f);
+    shader.setFloat("materials[6].specular", 1.0f);
+    shader.setFloat("materials[6].specularTint", 0.5f);
+    shader.setFloat("materials[6].roughness", 0.2f);
+
+    shader.setVec3("materials[7].baseColor", 1.0f, 1.0f, 1.0f);
+    shader.setFloat("materials[7].metallic", 0.2f);
+    shader.setFloat("materials[7].specular", 0.5f);
+    shader.setFloat("materials[7].specularTint", 0.5f);
+    shader.setFloat("materials[7].roughness", 0.3f);
+    shader.setFloat("materials[7].clearcoat", 1.0f);
+    shader.setFloat("materials[7].clearcoatGloss", 0.9f);
+}
+
+void addCornellLights(Shader& shader, LightBVH& lights, float emission)
+{
+    shader.bind();
+    for(int i = 10; i < 12; ++i)
+        shader.setInt("tris[" + std::to_string(i) + "].light_id", lights.addTriangle(CORNELL_WALLS[i].p0, CORNELL_WALLS[i].p1, CORNELL_WALLS[i].p2, glm::vec3(emission)));
+}
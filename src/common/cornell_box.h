@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "shader.h"
+#include "camera.h"
+#include "light_bvh.h"
+
+// base.cpp、disney.cpp 和 benchmark.cpp 共用的康奈尔盒：[-2, 2] x [-2, 2] x [0, 4] 的五个面共 12 个三角形，
+// 最后两个为顶部光源，比天花板略低，避免与天花板共面时交点随机落在其中之一；地面上从左到右放三个球
+struct CornellWall
+{
+    glm::vec3 p0, p1, p2, normal;
+    unsigned int material;
+};
+
+extern const CornellWall CORNELL_WALLS[12];
+
+// 场景外看向 -z 的相机，成像平面 4 x 4，到相机的距离为 6
+Camera cornellCamera(float z = 10.0f);
+// 设置 shader 的 tris[0..11]，light_id 都为 -1，需要顶部光源时再调用 addCornellLights
+void setCornellBox(Shader& shader);
+// 设置 spheres[0..2]，材质从左到右为 left、middle、right
+void setCornellSpheres(Shader& shader, unsigned int left, unsigned int middle, unsigned int right);
+// base_fs.glsl 的 materials[0..6]：白、光源、红、蓝、紫、镜面反射、折射
+void setCornellBaseMaterials(Shader& shader);
+// disney_fs.glsl 的 materials[0..7]：白、光源、红、蓝、紫，以及三个球的 Disney BRDF
+void setCornellDisneyMaterials(Shader& shader);
+// 顶部光源的两个三角形加入 lights 并设置它们的 light_id，emission 与光源材质的亮度相同
+void addCornellLights(Shader& shader, LightBVH& lights, float emission);
@@ -0,0 +1,319 @@
+#include "environment.h"
+#include "parallel.h"
+#include "gl_util.h"
+#include "../config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+    // Vose 别名法，weights 的和为 sum，结果写入 table[2 * i] = 阈值，table[2 * i + 1] = 别名
+    void buildAlias(const float* weights, int n, double sum, float* table, std::vector<int>& small, std::vector<int>& large)
+    {
+        small.clear();
+        large.clear();
+        std::vector<double> scaled(n);
+        for(int i = 0; i < n; ++i)
+        {
+            scaled[i] = sum > 0.0 ? weights[i] * n / sum : 1.0;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+            table[2 * i + 1] = (float)i;
+        }
+        while(!small.empty() && !large.empty())
+        {
+            int s = small.back(); small.pop_back();
+            int l = large.back();
+            table[2 * s] = (float)scaled[s];
+            table[2 * s + 1] = (float)l;
+            scaled[l] -= 1.0 - scaled[s];
+            if(scaled[l] < 1.0)
+            {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // 剩下的概率都是1，误差累积导致的残留也按1处理
+        for(int i : small)
+            table[2 * i] = 1.0f;
+        for(int i : large)
+            table[2 * i] = 1.0f;
+    }
+}
+
+Environment::Environment(const std::string& path)
+{
+    if(path.empty())
+        return;
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    bool ok = false;
+    if(extension == "hdr")
+        ok = loadHDR(path);
+    else if(extension == "pfm")
+        ok = loadPFM(path);
+    else
+        std::cout << "ERROR::ENVIRONMENT::UNSUPPORTED_FORMAT: " << path << std::endl;
+
+    if(!ok)
+    {
+        width_ = height_ = 0;
+        return;
+    }
+    buildAliasTables();
+    upload();
+}
+
+Environment::~Environment()
+{
+    glDeleteTextures(1, &radiance_texture_);
+    glDeleteTextures(1, &conditional_texture_);
+    glDeleteTextures(1, &marginal_texture_);
+}
+
+void Environment::bind(Shader& shader, GLuint first_unit)
+{
+    shader.bind();
+    shader.setBool("use_environment", valid());
+    if(!valid())
+        return;
+    shader.setFloat("env_pdf_scale", pdf_scale_);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_2D, radiance_texture_);
+    shader.setInt("envTex", first_unit);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+    glBindTexture(GL_TEXTURE_2D, conditional_texture_);
+    shader.setInt("envConditionalTex", first_unit + 1);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit + 2);
+    glBindTexture(GL_TEXTURE_2D, marginal_texture_);
+    shader.setInt("envMarginalTex", first_unit + 2);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Radiance RGBE 格式，支持新式的逐通道游程编码，只接受 -Y h +X w 的方向
+bool Environment::loadHDR(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        std::cout << "ERROR::ENVIRONMENT::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    std::vector<unsigned char> data(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+
+    // 文件头以空行结束，之后一行是分辨率
+    size_t pos = 0;
+    auto readLine = [&]() {
+        std::string line;
+        while(pos < data.size() && data[pos] != '\n')
+            line += (char)data[pos++];
+        ++pos;
+        return line;
+    };
+    if(!ok || readLine().compare(0, 2, "#?") != 0)
+    {
+        std::cout << "ERROR::ENVIRONMENT::INVALID_HDR: " << path << std::endl;
+        return false;
+    }
+    while(pos < data.size() && !readLine().empty());
+    if(sscanf(readLine().c_str(), "-Y %d +X %d", &height_, &width_) != 2 || width_ <= 0 || height_ <= 0)
+    {
+        std::cout << "ERROR::ENVIRONMENT::UNSUPPORTED_HDR_ORIENTATION: " << path << std::endl;
+        return false;
+    }
+
+    // 游程编码的扫描线长度不定，只能顺序解码成RGBE，再并行转换为浮点
+    std::vector<unsigned char> rgbe((size_t)width_ * height_ * 4);
+    for(int y = 0; y < height_ && ok; ++y)
+    {
+        unsigned char* row = &rgbe[(size_t)y * width_ * 4];
+        if(pos + 4 > data.size())
+        {
+            ok = false;
+            break;
+        }
+        bool rle = width_ >= 8 && width_ < 32768 && data[pos] == 2 && data[pos + 1] == 2 && ((data[pos + 2] << 8) | data[pos + 3]) == width_;
+        if(!rle)    // 未压缩的扫描线
+        {
+            ok = pos + (size_t)width_ * 4 <= data.size();
+            if(ok)
+                memcpy(row, &data[pos], (size_t)width_ * 4);
+            pos += (size_t)width_ * 4;
+            continue;
+        }
+        pos += 4;
+        for(int channel = 0; channel < 4 && ok; ++channel)
+        {
+            for(int x = 0; x < width_ && ok; )
+            {
+                ok = pos < data.size();
+                if(!ok)
+                    break;
+                int count = data[pos++];
+                if(count > 128)     // 重复 count - 128 次
+                {
+                    count -= 128;
+                    ok = pos < data.size() && x + count <= width_;
+                    for(int i = 0; ok && i < count; ++i)
+                        row[(x + i) * 4 + channel] = data[pos];
+                    ++pos;
+                }
+                else                // 接下来 count 个字节原样复制
+                {
+                    ok = count > 0 && pos + count <= data.size() && x + count <= width_;
+                    for(int i = 0; ok && i < count; ++i)
+                        row[(x + i) * 4 + channel] = data[pos + i];
+                    pos += count;
+                }
+                x += count;
+            }
+        }
+    }
+    if(!ok)
+    {
+        std::cout << "ERROR::ENVIRONMENT::TRUNCATED_HDR: " << path << std::endl;
+        return false;
+    }
+
+    radiance_.resize((size_t)width_ * height_ * 3);
+    parallelFor(0, height_, [&](int first, int last) {
+        for(size_t i = (size_t)first * width_; i < (size_t)last * width_; ++i)
+        {
+            const unsigned char* e = &rgbe[i * 4];
+            float scale = e[3] ? std::ldexp(1.0f, e[3] - 136) : 0.0f;  // 2^(e - 128) / 256
+            radiance_[i * 3] = e[0] * scale;
+            radiance_[i * 3 + 1] = e[1] * scale;
+            radiance_[i * 3 + 2] = e[2] * scale;
+        }
+    });
+    return true;
+}
+
+// Portable Float Map，只支持三通道的 PF，扫描线从下往上存储
+bool Environment::loadPFM(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        std::cout << "ERROR::ENVIRONMENT::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+        return false;
+    }
+    char type[3] = {};
+    float scale = 0.0f;
+    if(fscanf(file, "%2s %d %d %f", type, &width_, &height_, &scale) != 4 || strcmp(type, "PF") != 0 || width_ <= 0 || height_ <= 0)
+    {
+        std::cout << "ERROR::ENVIRONMENT::INVALID_PFM: " << path << std::endl;
+        fclose(file);
+        return false;
+    }
+    fgetc(file);    // 文件头最后的单个空白字符
+
+    std::vector<float> data((size_t)width_ * height_ * 3);
+    bool ok = fread(data.data(), sizeof(float), data.size(), file) == data.size();
+    fclose(file);
+    if(!ok)
+    {
+        std::cout << "ERROR::ENVIRONMENT::TRUNCATED_PFM: " << path << std::endl;
+        return false;
+    }
+
+    // scale 为负表示小端序，否则为大端序
+    bool swap = scale > 0.0f;
+    radiance_.resize(data.size());
+    parallelFor(0, height_, [&](int first, int last) {
+        for(int y = first; y < last; ++y)
+        {
+            const float* src = &data[(size_t)(height_ - 1 - y) * width_ * 3];
+            float* dst = &radiance_[(size_t)y * width_ * 3];
+            for(int i = 0; i < width_ * 3; ++i)
+            {
+                float v = src[i];
+                if(swap)
+                {
+                    uint32_t bits;
+                    memcpy(&bits, &v, 4);
+                    bits = (bits >> 24) | ((bits >> 8) & 0xff00u) | ((bits << 8) & 0xff0000u) | (bits << 24);
+                    memcpy(&v, &bits, 4);
+                }
+                dst[i] = std::isfinite(v) ? std::max(0.0f, v) : 0.0f;
+            }
+        }
+    });
+    return true;
+}
+
+// 每行的条件分布相互独立，并行构建；行的边缘分布只有 height 个元素，单线程构建
+void Environment::buildAliasTables()
+{
+    std::vector<float> weights((size_t)width_ * height_);
+    std::vector<double> row_sums(height_);
+    conditional_.resize((size_t)width_ * height_ * 2);
+    parallelFor(0, height_, [&](int first, int last) {
+        std::vector<int> small, large;
+        for(int y = first; y < last; ++y)
+        {
+            float sin_theta = std::sin(PI * (y + 0.5f) / height_);
+            float* w = &weights[(size_t)y * width_];
+            double sum = 0.0;
+            for(int x = 0; x < width_; ++x)
+            {
+                w[x] = luminance(glm::make_vec3(&radiance_[((size_t)y * width_ + x) * 3])) * sin_theta;
+                sum += w[x];
+            }
+            row_sums[y] = sum;
+            buildAlias(w, width_, sum, &conditional_[(size_t)y * width_ * 2], small, large);
+        }
+    });
+
+    std::vector<float> row_weights(row_sums.begin(), row_sums.end());
+    double total = 0.0;
+    for(double sum : row_sums)
+        total += sum;
+    marginal_.resize(height_ * 2);
+    std::vector<int> small, large;
+    buildAlias(row_weights.data(), height_, total, marginal_.data(), small, large);
+
+    pdf_scale_ = total > 0.0 ? (float)((double)width_ * height_ / total) : 0.0f;
+}
+
+void Environment::upload()
+{
+    glGenTextures(1, &radiance_texture_);
+    glBindTexture(GL_TEXTURE_2D, radiance_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width_, height_, 0, GL_RGB, GL_FLOAT, radiance_.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &conditional_texture_);
+    glBindTexture(GL_TEXTURE_2D, conditional_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width_, height_, 0, GL_RG, GL_FLOAT, conditional_.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &marginal_texture_);
+    glBindTexture(GL_TEXTURE_2D, marginal_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, height_, 1, 0, GL_RG, GL_FLOAT, marginal_.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // 8K贴图的CPU副本有几百MB，上传后不再需要
+    std::vector<float>().swap(radiance_);
+    std::vector<float>().swap(conditional_);
+    std::vector<float>().swap(marginal_);
+}
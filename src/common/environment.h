@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glad/glad.h>
+#include "shader.h"
+
+// 经纬度格式的HDR环境贴图（.hdr / .pfm），按 亮度 * sinθ 构建二维别名表用于O(1)重要性采样
+// 第0行对应 θ = 0（+y方向），u = 0.5 对应 +x 方向，与 environment.glsl 中的映射一致
+class Environment
+{
+public:
+    // path 为空时不加载，bind 后着色器使用默认的常量背景
+    Environment(const std::string& path);
+    ~Environment();
+    bool valid() const { return width_ > 0; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    // 绑定三张纹理到 first_unit 开始的连续纹理单元上，并设置 shader 中对应的 uniform
+    void bind(Shader& shader, GLuint first_unit);
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<float> radiance_;       // width * height * 3，第0行在最上方
+    std::vector<float> conditional_;    // width * height * 2，每行的别名表 (阈值, 别名)
+    std::vector<float> marginal_;       // height * 2，行的别名表
+    float pdf_scale_ = 0.0f;            // 1 / 权重的均值，像素的uv空间pdf = 权重 * pdf_scale_
+
+    GLuint radiance_texture_ = 0;
+    GLuint conditional_texture_ = 0;
+    GLuint marginal_texture_ = 0;
+
+    bool loadHDR(const std::string& path);
+    bool loadPFM(const std::string& path);
+    void buildAliasTables();
+    void upload();
+};
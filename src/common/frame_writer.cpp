@@ -0,0 +1,259 @@
+#include "frame_writer.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+    void putInt(std::vector<uint8_t>& out, uint32_t value)
+    {
+        for(int i = 0; i < 4; ++i)
+            out.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+    void putFloat(std::vector<uint8_t>& out, float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        putInt(out, bits);
+    }
+
+    void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        for(int i = 3; i >= 0; --i)
+            out.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+    void putString(std::vector<uint8_t>& out, const char* s)
+    {
+        out.insert(out.end(), s, s + strlen(s) + 1);
+    }
+
+    // EXR 头中的一个属性：名字、类型、大小、值
+    void putAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value)
+    {
+        putString(out, name);
+        putString(out, type);
+        putInt(out, (uint32_t)value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        static uint32_t table[256] = {};
+        if(!table[1])
+        {
+            for(uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for(int k = 0; k < 8; ++k)
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+        }
+        crc = ~crc;
+        for(size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // PNG 的一个块，长度和 CRC 为大端
+    void putChunk(FILE* file, const char* type, const std::vector<uint8_t>& data)
+    {
+        std::vector<uint8_t> chunk;
+        putBigEndian(chunk, (uint32_t)data.size());
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        fwrite(chunk.data(), 1, chunk.size(), file);
+    }
+}
+
+bool FrameWriter::init(const std::string& path, unsigned int width, unsigned int height)
+{
+    if(enabled())
+        return true;
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if(extension == "pfm")
+        format_ = PFM;
+    else if(extension == "exr")
+        format_ = EXR;
+    else if(extension == "png")
+        format_ = PNG;
+    else
+    {
+        std::cout << "ERROR::FRAME_WRITER::UNSUPPORTED_FORMAT: " << path << std::endl;
+        return false;
+    }
+    path_ = path;
+    sequence_ = path.find('%') != std::string::npos;
+    width_ = width;
+    height_ = height;
+    // 覆盖同一个文件时只有最新的一份有用
+    readback_.init(width, height, 1, LATENCY, sequence_ ? QUEUE : 0);
+    return true;
+}
+
+void FrameWriter::submit(GLuint color, unsigned int frame)
+{
+    readback_.submit({ color }, [this, frame](std::vector<float>& rgba)
+    {
+        std::string path = path_;
+        if(sequence_)
+        {
+            char buffer[1024];
+            snprintf(buffer, sizeof(buffer), path_.c_str(), frame);
+            path = buffer;
+        }
+        bool ok = writeFileAtomically(path, [&](FILE* file)
+        {
+            return format_ == PFM ? writePFM(file, rgba) : format_ == EXR ? writeEXR(file, rgba) : writePNG(file, rgba);
+        });
+        if(ok)
+            ++written_;
+    });
+}
+
+void FrameWriter::poll()
+{
+    readback_.poll();
+}
+
+void FrameWriter::flush()
+{
+    readback_.flush();
+}
+
+// 三通道的 PF，扫描线从下往上，与纹理的行顺序相同
+bool FrameWriter::writePFM(FILE* file, const std::vector<float>& rgba) const
+{
+    size_t pixels = (size_t)width_ * height_;
+    std::vector<float> rgb(pixels * 3);
+    for(size_t i = 0; i < pixels; ++i)
+        memcpy(&rgb[i * 3], &rgba[i * 4], 3 * sizeof(float));
+    fprintf(file, "PF\n%u %u\n-1.0\n", width_, height_);
+    return fwrite(rgb.data(), sizeof(float), rgb.size(), file) == rgb.size();
+}
+
+// 单部分的扫描线 EXR，B、G、R 三个 HALF 通道，不压缩，扫描线从上往下
+bool FrameWriter::writeEXR(FILE* file, const std::vector<float>& rgba) const
+{
+    std::vector<uint8_t> header;
+    putInt(header, 20000630);
+    putInt(header, 2);
+    std::vector<uint8_t> value;
+    for(const char* channel : { "B", "G", "R" })    // 通道按名字排序
+    {
+        putString(value, channel);
+        putInt(value, 1);           // HALF
+        putInt(value, 0);           // pLinear 和保留的3个字节
+        putInt(value, 1);           // xSampling
+        putInt(value, 1);           // ySampling
+    }
+    value.push_back(0);
+    putAttribute(header, "channels", "chlist", value);
+    putAttribute(header, "compression", "compression", { 0 });
+    value.clear();
+    for(uint32_t v : { 0u, 0u, width_ - 1, height_ - 1 })
+        putInt(value, v);
+    putAttribute(header, "dataWindow", "box2i", value);
+    putAttribute(header, "displayWindow", "box2i", value);
+    putAttribute(header, "lineOrder", "lineOrder", { 0 });
+    value.clear();
+    putFloat(value, 1.0f);
+    putAttribute(header, "pixelAspectRatio", "float", value);
+    putAttribute(header, "screenWindowWidth", "float", value);
+    value.clear();
+    putFloat(value, 0.0f);
+    putFloat(value, 0.0f);
+    putAttribute(header, "screenWindowCenter", "v2f", value);
+    header.push_back(0);
+
+    size_t line_size = 8 + (size_t)width_ * 3 * sizeof(uint16_t);
+    uint64_t offset = header.size() + (uint64_t)height_ * 8;
+    for(unsigned int y = 0; y < height_; ++y)
+    {
+        for(int i = 0; i < 8; ++i)
+            header.push_back((uint8_t)(offset >> (8 * i)));
+        offset += line_size;
+    }
+    bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+
+    std::vector<uint8_t> line;
+    line.reserve(line_size);
+    for(unsigned int y = 0; y < height_ && ok; ++y)
+    {
+        line.clear();
+        putInt(line, y);
+        putInt(line, (uint32_t)(line_size - 8));
+        const float* row = &rgba[(size_t)(height_ - 1 - y) * width_ * 4];
+        for(int c = 2; c >= 0; --c)
+        {
+            for(unsigned int x = 0; x < width_; ++x)
+            {
+                uint16_t half = glm::packHalf1x16(row[x * 4 + c]);
+                line.push_back((uint8_t)half);
+                line.push_back((uint8_t)(half >> 8));
+            }
+        }
+        ok = fwrite(line.data(), 1, line.size(), file) == line.size();
+    }
+    return ok;
+}
+
+// 8 位 RGB，按 displayColor 与屏幕上相同；没有 zlib，IDAT 用不压缩的 deflate 块
+bool FrameWriter::writePNG(FILE* file, const std::vector<float>& rgba) const
+{
+    std::vector<uint8_t> raw;
+    raw.reserve((size_t)height_ * (width_ * 3 + 1));
+    for(unsigned int y = 0; y < height_; ++y)
+    {
+        raw.push_back(0);           // 不使用行滤波
+        const float* row = &rgba[(size_t)(height_ - 1 - y) * width_ * 4];
+        for(unsigned int x = 0; x < width_; ++x)
+        {
+            glm::vec3 color = displayColor(glm::vec3(row[x * 4], row[x * 4 + 1], row[x * 4 + 2]));
+            for(int c = 0; c < 3; ++c)
+                raw.push_back((uint8_t)std::min(255.0f, color[c] * 255.0f + 0.5f));
+        }
+    }
+
+    std::vector<uint8_t> data = { 0x78, 0x01 };
+    const size_t BLOCK = 65535;
+    for(size_t begin = 0; begin < raw.size(); begin += BLOCK)
+    {
+        size_t size = std::min(BLOCK, raw.size() - begin);
+        data.push_back(begin + size == raw.size() ? 1 : 0);
+        data.push_back((uint8_t)size);
+        data.push_back((uint8_t)(size >> 8));
+        data.push_back((uint8_t)~size);
+        data.push_back((uint8_t)(~size >> 8));
+        data.insert(data.end(), raw.begin() + begin, raw.begin() + begin + size);
+    }
+    uint32_t a = 1, b = 0;
+    for(uint8_t v : raw)
+    {
+        a = (a + v) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(data, (b << 16) | a);
+
+    const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    fwrite(signature, 1, sizeof(signature), file);
+    std::vector<uint8_t> header;
+    putBigEndian(header, width_);
+    putBigEndian(header, height_);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 });    // 8 位 RGB
+    putChunk(file, "IHDR", header);
+    putChunk(file, "IDAT", data);
+    putChunk(file, "IEND", {});
+    return !ferror(file);
+}
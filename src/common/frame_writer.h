@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include "async_readback.h"
+
+// 把累积的图像定期写到磁盘，用于监视长时间的渲染
+// 纹理由 AsyncReadback 异步读回，在它的工作线程上编码和写文件，渲染线程不等待 GPU 也不等待磁盘
+// 格式由后缀决定：.pfm、.exr（HALF，不压缩）保存线性的 HDR，.png 保存按 output_fs.glsl 色调映射后的 8 位图像
+// 路径中含有 printf 的整数格式（如 frames/%05d.png）时按帧号写成序列，否则每次覆盖同一个文件；都用 writeFileAtomically 写，不会读到一半的图像
+class FrameWriter
+{
+public:
+    static const int LATENCY = 3;       // 同时在读回的份数
+    static const int QUEUE = 4;         // 序列模式下等待写的最多份数，超过时丢弃新的一份
+
+    bool init(const std::string& path, unsigned int width, unsigned int height);
+    bool enabled() const { return readback_.enabled(); }
+    // 在 draw 之后调用，color 为 Render 累积的结果，frame 为序列的帧号
+    void submit(GLuint color, unsigned int frame);
+    // 每帧调用
+    void poll();
+    // 等待所有的读回和写文件完成，退出之前调用
+    void flush();
+    // 写完的文件数，以及缓冲都在读回或写文件跟不上时丢弃的份数
+    unsigned int written() const { return written_; }
+    unsigned int dropped() const { return readback_.dropped(); }
+
+private:
+    enum Format { PFM, EXR, PNG };
+
+    std::string path_;
+    Format format_ = PFM;
+    bool sequence_ = false;
+    unsigned int width_ = 0, height_ = 0;
+    std::atomic<unsigned int> written_{ 0 };
+    AsyncReadback readback_;            // 最后析构，先停止用到上面成员的工作线程
+
+    bool writePFM(FILE* file, const std::vector<float>& rgba) const;
+    bool writeEXR(FILE* file, const std::vector<float>& rgba) const;
+    bool writePNG(FILE* file, const std::vector<float>& rgba) const;
+};
@@ -0,0 +1,20 @@
+#include "gl_util.h"
+
+#include <algorithm>
+
+GLuint createDataTexture(const std::vector<glm::vec4>& texels, int count, int texels_per_item, int per_row)
+{
+    int width = std::min(count, per_row) * texels_per_item;
+    int height = (count + per_row - 1) / per_row;
+    std::vector<glm::vec4> data(width * height, glm::vec4(0.0f));
+    std::copy(texels.begin(), texels.end(), data.begin());
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, data.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "../config.h"
+
+// 把 CPU 上建好的数据上传给着色器时共用的小工具
+
+// 与 accumulate.glsl 中的 luminance() 一致
+inline float luminance(const glm::vec3& c)
+{
+    return 0.3f * c.r + 0.6f * c.g + 0.1f * c.b;
+}
+
+// 与 output_fs.glsl 的 toneMapping 一致，结果还是线性的
+inline glm::vec3 toneMap(const glm::vec3& c)
+{
+    return glm::max(c / (1.0f + luminance(c) / TONE_MAP_LIMIT), glm::vec3(0.0f));
+}
+
+// 屏幕上显示的颜色，饱和的颜色可能超过 1，由调用者截断
+inline glm::vec3 displayColor(const glm::vec3& c)
+{
+    return glm::pow(toneMap(c), glm::vec3(1.0f / DISPLAY_GAMMA));
+}
+
+// 每项占 texels_per_item 个像素、每行 per_row 项的 RGBA32F 纹理，不足一行的部分补 0，最近邻采样，
+// 着色器按同样的布局用 texelFetch 读取，见 light_bvh.glsl、guiding.glsl 和 primitive_bvh.glsl
+GLuint createDataTexture(const std::vector<glm::vec4>& texels, int count, int texels_per_item, int per_row);
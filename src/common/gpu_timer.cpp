@@ -0,0 +1,179 @@
+#include "gpu_timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+GpuTimer::~GpuTimer()
+{
+    for(Pass& pass : passes_)
+        glDeleteQueries(LATENCY, pass.queries);
+}
+
+void GpuTimer::begin(const std::string& pass)
+{
+    if(active_ >= 0)
+    {
+        std::cout << "ERROR::GPU_TIMER::NESTED_BEGIN: " << pass << std::endl;
+        return;
+    }
+    auto it = index_.find(pass);
+    if(it == index_.end())
+    {
+        it = index_.emplace(pass, (int)passes_.size()).first;
+        passes_.emplace_back();
+        passes_.back().name = pass;
+        glGenQueries(LATENCY, passes_.back().queries);
+    }
+
+    Pass& p = passes_[it->second];
+    int slot = frames_ % LATENCY;
+    if(p.pending[slot])
+    {
+        collect(p);
+        if(p.pending[slot])
+        {
+            ++dropped_;
+            return;
+        }
+    }
+    glBeginQuery(GL_TIME_ELAPSED, p.queries[slot]);
+    p.pending[slot] = true;
+    active_ = it->second;
+}
+
+void GpuTimer::end()
+{
+    if(active_ < 0)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    active_ = -1;
+}
+
+void GpuTimer::collect(Pass& pass)
+{
+    for(int i = 0; i < LATENCY; ++i)
+    {
+        if(!pass.pending[i])
+            continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(pass.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available)
+            continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(pass.queries[i], GL_QUERY_RESULT, &ns);
+        pass.pending[i] = false;
+        pass.samples.push_back(ns * 1e-6);
+        if(pass.samples.size() > WINDOW)
+            pass.samples.pop_front();
+    }
+}
+
+void GpuTimer::frame()
+{
+    for(Pass& pass : passes_)
+        collect(pass);
+    ++frames_;
+}
+
+void GpuTimer::clear()
+{
+    for(Pass& pass : passes_)
+    {
+        for(int i = 0; i < LATENCY; ++i)
+        {
+            if(!pass.pending[i])
+                continue;
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(pass.queries[i], GL_QUERY_RESULT, &ns);  // 等待 GPU
+            pass.pending[i] = false;
+        }
+        pass.samples.clear();
+    }
+    dropped_ = 0;
+}
+
+std::vector<GpuTimer::Stats> GpuTimer::stats() const
+{
+    std::vector<Stats> result;
+    for(const Pass& pass : passes_)
+    {
+        Stats s;
+        s.name = pass.name;
+        s.samples = pass.samples.size();
+        if(s.samples > 0)
+        {
+            std::vector<double> sorted(pass.samples.begin(), pass.samples.end());
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0.0;
+            for(double v : sorted)
+                sum += v;
+            s.min_ms = sorted.front();
+            s.avg_ms = sum / sorted.size();
+            s.p99_ms = sorted[(size_t)std::ceil(0.99 * sorted.size()) - 1];
+            s.last_ms = pass.samples.back();
+        }
+        result.push_back(s);
+    }
+    return result;
+}
+
+double GpuTimer::average(const std::string& pass) const
+{
+    auto it = index_.find(pass);
+    if(it == index_.end() || passes_[it->second].samples.empty())
+        return 0.0;
+    double sum = 0.0;
+    for(double v : passes_[it->second].samples)
+        sum += v;
+    return sum / passes_[it->second].samples.size();
+}
+
+std::string GpuTimer::summary() const
+{
+    std::vector<Stats> all = stats();
+    double total = 0.0;
+    for(const Stats& s : all)
+        total += s.avg_ms;
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "gpu %.2f ms", total);
+    std::string result = buffer;
+    for(const Stats& s : all)
+    {
+        snprintf(buffer, sizeof(buffer), " | %s %.2f/%.2f/%.2f", s.name.c_str(), s.min_ms, s.avg_ms, s.p99_ms);
+        result += buffer;
+    }
+    return result + " (min/avg/p99 ms)";
+}
+
+bool GpuTimer::write(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file)
+    {
+        std::cout << "ERROR::GPU_TIMER::FILE_NOT_WRITABLE: " << path << std::endl;
+        return false;
+    }
+    std::vector<Stats> all = stats();
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if(json)
+    {
+        fprintf(file, "{\n  \"frames\": %u,\n  \"dropped\": %u,\n  \"passes\": [\n", frames_, dropped_);
+        for(size_t i = 0; i < all.size(); ++i)
+        {
+            const Stats& s = all[i];
+            fprintf(file, "    {\"name\": \"%s\", \"samples\": %zu, \"min_ms\": %.4f, \"avg_ms\": %.4f, \"p99_ms\": %.4f, \"last_ms\": %.4f}%s\n",
+                s.name.c_str(), s.samples, s.min_ms, s.avg_ms, s.p99_ms, s.last_ms, i + 1 < all.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+    }
+    else
+    {
+        fprintf(file, "pass,samples,min_ms,avg_ms,p99_ms,last_ms\n");
+        for(const Stats& s : all)
+            fprintf(file, "%s,%zu,%.4f,%.4f,%.4f,%.4f\n", s.name.c_str(), s.samples, s.min_ms, s.avg_ms, s.p99_ms, s.last_ms);
+    }
+    fclose(file);
+    return true;
+}
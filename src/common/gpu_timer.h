@@ -0,0 +1,62 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+// 按名字统计每个 pass 的 GPU 耗时，begin/end 之间包一个 GL_TIME_ELAPSED 查询
+// 每个 pass 有 LATENCY 个查询轮流使用，结果在几帧之后可用时再读取，不等待 GPU；轮到的查询还没有结果时这一帧不计时
+// GL_TIME_ELAPSED 查询不能嵌套，begin/end 必须成对且不交叠
+class GpuTimer
+{
+public:
+    static const int LATENCY = 4;       // 每个 pass 的查询个数，即最多允许几帧的延迟
+    static const int WINDOW = 256;      // 滚动统计的样本数
+
+    struct Stats
+    {
+        std::string name;
+        size_t samples = 0;
+        double min_ms = 0.0;
+        double avg_ms = 0.0;
+        double p99_ms = 0.0;
+        double last_ms = 0.0;
+    };
+
+    ~GpuTimer();
+    void begin(const std::string& pass);
+    void end();
+    // 每帧结束时调用，读取已经可用的结果
+    void frame();
+    // 丢弃所有样本，还没有结果的查询等它完成后丢弃，之后只统计新的帧
+    void clear();
+    // 按第一次 begin 的顺序返回各个 pass 最近 WINDOW 个样本的统计
+    std::vector<Stats> stats() const;
+    // 名为 pass 的平均耗时，没有样本时为 0
+    double average(const std::string& pass) const;
+    // 一行的摘要，用于窗口标题：所有 pass 平均值之和以及每个 pass 的 avg/p99
+    std::string summary() const;
+    // 写出 stats()，后缀为 .json 时写 JSON，否则写 CSV
+    bool write(const std::string& path) const;
+    unsigned int frames() const { return frames_; }
+    unsigned int dropped() const { return dropped_; }
+
+private:
+    struct Pass
+    {
+        std::string name;
+        GLuint queries[LATENCY] = {};
+        bool pending[LATENCY] = {};
+        std::deque<double> samples;     // ms
+    };
+
+    std::vector<Pass> passes_;
+    std::map<std::string, int> index_;
+    int active_ = -1;           // 正在计时的 pass，-1 为没有
+    unsigned int frames_ = 0;
+    unsigned int dropped_ = 0;  // 因为查询还没有结果而跳过的次数
+
+    void collect(Pass& pass);
+};
@@ -0,0 +1,183 @@
+#include "implicit_bricks.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    const int SAMPLES = ImplicitBricks::BRICK + 1;     // 砖块每个轴的格点数，相邻砖块共用边界上的格点值但各存一份
+    const float FAR = 1e10f;                            // 没有任何非空格子时的距离
+
+    int cellIndex(int x, int y, int z)
+    {
+        const int n = ImplicitBricks::GRID;
+        return (z * n + y) * n + x;
+    }
+}
+
+ImplicitBricks::~ImplicitBricks()
+{
+    glDeleteTextures(1, &grid_texture_);
+    glDeleteTextures(1, &brick_texture_);
+}
+
+void ImplicitBricks::clear()
+{
+    grid_.clear();
+    bricks_.clear();
+}
+
+int ImplicitBricks::add(const ImplicitFunction& function, const glm::vec3& min, const glm::vec3& max)
+{
+    const int cells = GRID * GRID * GRID;
+    const glm::vec3 cell = (max - min) / (float)GRID;
+    const glm::vec3 voxel = cell / (float)BRICK;
+    const float margin = std::max(cell.x, std::max(cell.y, cell.z));
+    const float diagonal = glm::length(voxel);
+
+    // 区间算术剔除空格子
+    std::vector<char> occupied(cells, 0);
+    parallelFor(0, GRID, [&](int first, int last) {
+        for(int z = first; z < last; ++z)
+            for(int y = 0; y < GRID; ++y)
+                for(int x = 0; x < GRID; ++x)
+                {
+                    glm::vec3 lo = min + glm::vec3((float)x, (float)y, (float)z) * cell;
+                    glm::vec2 range = function.evaluateInterval(lo, lo + cell);
+                    occupied[cellIndex(x, y, z)] = range.x <= 0.0f && range.y >= 0.0f;
+                }
+    });
+    std::vector<int> candidates;
+    for(int i = 0; i < cells; ++i)
+    {
+        if(occupied[i])
+            candidates.push_back(i);
+    }
+
+    // 格点 p 到曲面的距离：最近点在外扩 margin 的盒子里时不小于 |f(p)| / G，否则不小于 margin
+    // 三线性插值的点到各个格点不超过一条体素对角线，每个格点预先减去对角线长，插值结果仍是下界
+    std::vector<float> samples(candidates.size() * SAMPLES * SAMPLES * SAMPLES);
+    parallelFor(0, (int)candidates.size(), [&](int first, int last) {
+        for(int c = first; c < last; ++c)
+        {
+            int index = candidates[c];
+            glm::vec3 lo = min + glm::vec3((float)(index % GRID), (float)(index / GRID % GRID), (float)(index / (GRID * GRID))) * cell;
+            float bound = function.gradientBound(lo - margin, lo + cell + margin);
+            float* brick = &samples[(size_t)c * SAMPLES * SAMPLES * SAMPLES];
+            float nearest = FAR;
+            for(int k = 0; k < SAMPLES; ++k)
+                for(int j = 0; j < SAMPLES; ++j)
+                    for(int i = 0; i < SAMPLES; ++i)
+                    {
+                        float f = std::abs(function.evaluate(lo + glm::vec3((float)i, (float)j, (float)k) * voxel));
+                        float d = bound > 0.0f ? std::min(margin, f / bound) : margin;
+                        float value = d - diagonal;
+                        brick[(k * SAMPLES + j) * SAMPLES + i] = value;
+                        nearest = std::min(nearest, value);
+                    }
+            // 所有格点的下界都为正时格子里一定没有曲面，区间算术高估了
+            if(nearest > 0.0f)
+                occupied[index] = 0;
+        }
+    });
+
+    // 剩下的格子接着之前的曲面编号，空格子记录到最近的非空格子的切比雪夫距离 k，两个格子之间至少隔着 k - 1 个格子
+    const int surface = (int)(grid_.size() / cells);
+    const size_t brick_size = SAMPLES * SAMPLES * SAMPLES;
+    grid_.resize(grid_.size() + cells, glm::vec2(FAR, -1.0f));
+    glm::vec2* grid = &grid_[(size_t)surface * cells];
+    std::vector<int> queue;
+    for(size_t c = 0; c < candidates.size(); ++c)
+    {
+        int index = candidates[c];
+        if(!occupied[index])
+            continue;
+        grid[index] = glm::vec2(0.0f, (float)(bricks_.size() / brick_size));
+        bricks_.insert(bricks_.end(), samples.begin() + c * brick_size, samples.begin() + (c + 1) * brick_size);
+        queue.push_back(index);
+    }
+    const size_t kept = queue.size();
+    std::vector<int> steps(cells, -1);
+    for(int index : queue)
+        steps[index] = 0;
+    for(size_t head = 0; head < queue.size(); ++head)
+    {
+        int index = queue[head];
+        int x = index % GRID, y = index / GRID % GRID, z = index / (GRID * GRID);
+        for(int dz = -1; dz <= 1; ++dz)
+            for(int dy = -1; dy <= 1; ++dy)
+                for(int dx = -1; dx <= 1; ++dx)
+                {
+                    int nx = x + dx, ny = y + dy, nz = z + dz;
+                    if(nx < 0 || ny < 0 || nz < 0 || nx >= GRID || ny >= GRID || nz >= GRID)
+                        continue;
+                    int next = cellIndex(nx, ny, nz);
+                    if(steps[next] >= 0)
+                        continue;
+                    steps[next] = steps[index] + 1;
+                    grid[next].x = (steps[next] - 1) * std::min(cell.x, std::min(cell.y, cell.z));
+                    queue.push_back(next);
+                }
+    }
+
+    printf("implicit bricks %d: %zu of %zu interval candidates kept, %d cells\n", surface, kept, candidates.size(), cells);
+    return surface;
+}
+
+void ImplicitBricks::upload()
+{
+    const size_t brick_size = SAMPLES * SAMPLES * SAMPLES;
+    const size_t count = bricks_.size() / brick_size;
+    const int layers = std::max(1, (int)((count + ATLAS_BRICKS * ATLAS_BRICKS - 1) / (ATLAS_BRICKS * ATLAS_BRICKS)));
+    const int width = ATLAS_BRICKS * SAMPLES;
+    const int depth = layers * SAMPLES;
+    std::vector<float> atlas((size_t)width * width * depth, 0.0f);
+    for(size_t b = 0; b < count; ++b)
+    {
+        const float* brick = &bricks_[b * brick_size];
+        int bx = (int)(b % ATLAS_BRICKS) * SAMPLES;
+        int by = (int)(b / ATLAS_BRICKS % ATLAS_BRICKS) * SAMPLES;
+        int bz = (int)(b / (ATLAS_BRICKS * ATLAS_BRICKS)) * SAMPLES;
+        for(int k = 0; k < SAMPLES; ++k)
+            for(int j = 0; j < SAMPLES; ++j)
+                std::copy(brick + (k * SAMPLES + j) * SAMPLES, brick + (k * SAMPLES + j + 1) * SAMPLES,
+                          atlas.begin() + ((size_t)(bz + k) * width + by + j) * width + bx);
+    }
+
+    const int surfaces = std::max(1, (int)(grid_.size() / (GRID * GRID * GRID)));
+    grid_.resize((size_t)surfaces * GRID * GRID * GRID, glm::vec2(FAR, -1.0f));
+    if(grid_texture_ == 0)
+        glGenTextures(1, &grid_texture_);
+    glBindTexture(GL_TEXTURE_3D, grid_texture_);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RG32F, GRID, GRID, GRID * surfaces, 0, GL_RG, GL_FLOAT, grid_.data());
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    // 砖块内的采样点离边界至少半个纹素，线性插值不会读到相邻的砖块
+    if(brick_texture_ == 0)
+        glGenTextures(1, &brick_texture_);
+    glBindTexture(GL_TEXTURE_3D, brick_texture_);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, width, width, depth, 0, GL_RED, GL_FLOAT, atlas.data());
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void ImplicitBricks::bind(Shader& shader, GLuint first_unit)
+{
+    shader.bind();
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_3D, grid_texture_);
+    shader.setInt("implicitGridTex", first_unit);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+    glBindTexture(GL_TEXTURE_3D, brick_texture_);
+    shader.setInt("implicitBrickTex", first_unit + 1);
+
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+#include "implicit_function.h"
+
+// 隐式曲面的稀疏砖块距离场，着色器先用它做球追踪走到曲面附近，再用 RAA 精确求根，见 implicit_bricks.glsl
+// 包围盒切成 GRID^3 个格子，区间算术证明不含曲面的格子是空的，只记录到最近的非空格子的距离
+// 非空格子各有一个砖块，在 (BRICK + 1)^3 个格点上存到曲面距离的保守下界，所有砖块拼在一张 3D 纹理里
+// 可以放多个曲面，第 i 个曲面的格子在格子纹理中 z 方向的第 i 段
+class ImplicitBricks
+{
+public:
+    static const int GRID = 32;             // 每个轴的格子数
+    static const int BRICK = 8;             // 砖块每个轴的体素数，与 implicit_bricks.glsl 一致
+    static const int ATLAS_BRICKS = 32;     // 图集 x、y 方向各放的砖块数，与 implicit_bricks.glsl 一致
+
+    ~ImplicitBricks();
+    void clear();
+    // 在所有硬件线程上为包围盒 [min, max] 内的曲面构建砖块，返回曲面的编号，加完所有曲面后调用 upload
+    int add(const ImplicitFunction& function, const glm::vec3& min, const glm::vec3& max);
+    void upload();
+    // 绑定两张纹理到 first_unit 开始的连续纹理单元上
+    void bind(Shader& shader, GLuint first_unit);
+    size_t bricks() const { return bricks_.size() / ((BRICK + 1) * (BRICK + 1) * (BRICK + 1)); }
+
+private:
+    std::vector<glm::vec2> grid_;   // 每个格子 (距离下界, 砖块编号)，空格子的编号为 -1
+    std::vector<float> bricks_;     // 每个砖块 (BRICK + 1)^3 个格点
+    GLuint grid_texture_ = 0;
+    GLuint brick_texture_ = 0;
+};
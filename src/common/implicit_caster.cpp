@@ -0,0 +1,145 @@
+#include "implicit_caster.h"
+
+#include <algorithm>
+#include <cmath>
+
+using raa::Float8;
+
+namespace
+{
+    const float EPSILON = 0.00001f;     // 与 implicit_fs.glsl 一致，从曲面上出发的光线不要打到自己
+
+    glm::vec2 intersectBox(const glm::vec3& ori, const glm::vec3& dir, const glm::vec3& lo, const glm::vec3& hi)
+    {
+        glm::vec3 inv = 1.0f / dir;
+        glm::vec3 a = (lo - ori) * inv;
+        glm::vec3 b = (hi - ori) * inv;
+        glm::vec3 near = glm::min(a, b);
+        glm::vec3 far = glm::max(a, b);
+        return glm::vec2(std::max(std::max(near.x, near.y), near.z), std::min(std::min(far.x, far.y), far.z));
+    }
+}
+
+ImplicitCaster::ImplicitCaster(const ImplicitFunction& function, const glm::vec3& min, const glm::vec3& max)
+    : function_(function), min_(min), max_(max)
+{
+}
+
+// 与 refineImplicitRoot 相同的 Illinois 割线法
+float ImplicitCaster::refine(const glm::vec3& ori, const glm::vec3& dir, float a, float b, float fa, float fb) const
+{
+    float t = a;
+    int side = 0;
+    for(int k = 0; k < REFINE_STEPS; ++k)
+    {
+        t = (a * fb - b * fa) / (fb - fa);
+        if(!(t > a && t < b))
+            break;
+        float f = function_.evaluate(ori + t * dir);
+        if(f * fb > 0.0f)
+        {
+            b = t;
+            fb = f;
+            if(side == -1)
+                fa *= 0.5f;
+            side = -1;
+        }
+        else if(f * fa > 0.0f)
+        {
+            a = t;
+            fa = f;
+            if(side == 1)
+                fb *= 0.5f;
+            side = 1;
+        }
+        else
+            break;
+    }
+    return t;
+}
+
+// 栈中的区间都已经缩到可能有根的部分，近的在栈顶；弹出后判断能否直接求根，不能就分成 8 段，
+// 每段按 narrowImplicitInterval 的方法缩小，留下的段从远到近压栈
+bool ImplicitCaster::intersect(const glm::vec3& ori, const glm::vec3& dir, float t_min, float t_max, float& t)
+{
+    glm::vec2 range = intersectBox(ori, dir, min_, max_);
+    float t0 = std::max(range.x, std::max(t_min, EPSILON));
+    float t1 = std::min(range.y, t_max);
+    if(!(t0 < t1))
+        return false;
+
+    const float leaf = (t1 - t0) * std::exp2(-16.0f);
+    const glm::vec3 size = max_ - min_;
+    const float split = std::max(size.x, std::max(size.y, size.z)) / MIN_SPLIT;
+    float stack_lo[LANES * MAX_DEPTH + 1], stack_hi[LANES * MAX_DEPTH + 1];
+    int top = 0;
+    stack_lo[top] = t0;
+    stack_hi[top++] = t1;
+
+    const float offsets[LANES] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+    const Float8 lane_index = Float8::load(offsets);
+    while(top > 0)
+    {
+        --top;
+        float lo = stack_lo[top], hi = stack_hi[top];
+        float f_lo = function_.evaluate(ori + lo * dir);
+        float f_hi = function_.evaluate(ori + hi * dir);
+        bool bracketed = f_lo * f_hi <= 0.0f;
+        if(!bracketed && hi - lo <= leaf)
+        {
+            // 缩小得到的短区间只是仿射形式不能排除，单独求一次还不能排除才算擦过曲面
+            raa::Affine<float> s = raa::toAffine(raa::Interval<float>(lo, hi));
+            raa::Interval<float> r = raa::toInterval(function_.evaluateRange(raa::add(raa::mul(s, dir.x), ori.x), raa::add(raa::mul(s, dir.y), ori.y), raa::add(raa::mul(s, dir.z), ori.z), scalar_values_));
+            intervals_ += 1;
+            if(r.lo > 0.0f || r.hi < 0.0f)
+                continue;
+        }
+        if((bracketed && hi - lo <= split) || hi - lo <= leaf || top + LANES > LANES * MAX_DEPTH)
+        {
+            t = bracketed ? refine(ori, dir, lo, hi, f_lo, f_hi) : (std::abs(f_lo) < std::abs(f_hi) ? lo : hi);
+            return true;
+        }
+
+        // 第 i 段为 [lo + i * step, lo + (i + 1) * step]，最后一段的终点取 hi
+        float step = (hi - lo) / LANES;
+        Float8 a = Float8(lo) + lane_index * Float8(step);
+        Float8 b = raa::select(lane_index < Float8(LANES - 1.0f), a + Float8(step), Float8(hi));
+        raa::Affine<Float8> s = raa::toAffine(raa::Interval<Float8>(a, b));
+        raa::Affine<Float8> r = function_.evaluateRange(raa::add(raa::mul(s, dir.x), ori.x), raa::add(raa::mul(s, dir.y), ori.y), raa::add(raa::mul(s, dir.z), ori.z), values_);
+        intervals_ += LANES;
+
+        // r.x + r.y * ε ± r.z 中 ε ∈ [-1, 1] 线性对应每一段，|r.y| 很小时不缩小，只看整段能否排除
+        raa::Mask8 flat = raa::abs(r.y) <= r.z * Float8(1e-3f);
+        Float8 e0 = (-r.x - r.z) / r.y, e1 = (-r.x + r.z) / r.y;
+        Float8 e_lo = raa::select(flat, Float8(-1.0f), raa::roundDown(raa::min(e0, e1)));
+        Float8 e_hi = raa::select(flat, Float8(1.0f), raa::roundUp(raa::max(e0, e1)));
+        int flat_keep = (raa::abs(r.x) <= raa::addUp(r.z, raa::abs(r.y))).bits() & flat.bits();
+        int narrow_keep = (e_lo <= Float8(1.0f)).bits() & (Float8(-1.0f) <= e_hi).bits() & ~flat.bits();
+        int kept = flat_keep | narrow_keep;
+        if(kept == 0)
+            continue;
+
+        e_lo = raa::max(e_lo, Float8(-1.0f));
+        e_hi = raa::min(e_hi, Float8(1.0f));
+        Float8 half = (b - a) * Float8(0.5f);
+        Float8 narrow_lo = raa::max(a, raa::roundDown(a + (e_lo + Float8(1.0f)) * half));
+        Float8 narrow_hi = raa::min(b, raa::roundUp(a + (e_hi + Float8(1.0f)) * half));
+        float lane_lo[LANES], lane_hi[LANES];
+        narrow_lo.store(lane_lo);
+        narrow_hi.store(lane_hi);
+        for(int i = LANES - 1; i >= 0; --i)
+        {
+            if(kept & (1 << i))
+            {
+                stack_lo[top] = lane_lo[i];
+                stack_hi[top++] = lane_hi[i];
+            }
+        }
+    }
+    return false;
+}
+
+glm::vec3 ImplicitCaster::normal(const glm::vec3& p) const
+{
+    return glm::normalize(function_.evaluateDual(p).gradient);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "implicit_function.h"
+#include "raa.h"
+
+// 在CPU上求光线与隐式曲面的第一个交点，与 implicit_fs.glsl 的 searchImplicitRoot 一样深度优先地用 RAA 排除区间，
+// 但每次把区间等分成 8 段，用 raa::Float8 一次求出 8 段的仿射形式，再各自缩到可能有根的部分
+// 求值的临时空间在对象里，多线程时每个线程用自己的对象
+class ImplicitCaster
+{
+public:
+    static const int LANES = 8;
+    static const int MAX_DEPTH = 8;             // 栈按 8 层留空间，每层至少缩小到 1/8，6 层后就短于整段的 2^-16
+    static const int MIN_SPLIT = 128;           // 端点异号的区间短于包围盒最长边的 1/128 才直接求根，与GPU上一个窗口的 1/IMPLICIT_MIN_SPLIT 相同
+    static const int REFINE_STEPS = 16;         // 与 IMPLICIT_REFINE_STEPS 一致
+
+    ImplicitCaster(const ImplicitFunction& function, const glm::vec3& min, const glm::vec3& max);
+    // dir 必须是单位向量，返回 [t_min, t_max] 中的第一个交点
+    bool intersect(const glm::vec3& ori, const glm::vec3& dir, float t_min, float t_max, float& t);
+    glm::vec3 normal(const glm::vec3& p) const;
+    size_t intervals() const { return intervals_; }     // 累计用 RAA 求值的区间数
+
+private:
+    const ImplicitFunction& function_;
+    glm::vec3 min_, max_;
+    std::vector<raa::Affine<raa::Float8>> values_;
+    std::vector<raa::Affine<float>> scalar_values_;
+    size_t intervals_ = 0;
+
+    float refine(const glm::vec3& ori, const glm::vec3& dir, float a, float b, float fa, float fb) const;
+};
@@ -0,0 +1,540 @@
+#include "implicit_function.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // GLSL 的浮点字面量必须带小数点或指数
+    std::string literal(float value)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.9g", value);
+        std::string s = buffer;
+        if(s.find_first_of(".e") == std::string::npos)
+            s += ".0";
+        return s;
+    }
+
+    // 与 raa.glsl 中的 mul_ia、sqr_ia 一致
+    glm::vec2 mulInterval(const glm::vec2& a, const glm::vec2& b)
+    {
+        float p[4] = { a.x * b.x, a.x * b.y, a.y * b.x, a.y * b.y };
+        return glm::vec2(std::min(std::min(p[0], p[1]), std::min(p[2], p[3])), std::max(std::max(p[0], p[1]), std::max(p[2], p[3])));
+    }
+
+    glm::vec2 sqrInterval(const glm::vec2& a)
+    {
+        float lo = a.x * a.x, hi = a.y * a.y;
+        if(a.x <= 0.0f && a.y >= 0.0f)
+            return glm::vec2(0.0f, std::max(lo, hi));
+        return glm::vec2(std::min(lo, hi), std::max(lo, hi));
+    }
+}
+
+bool ImplicitFunction::compile(const std::string& expression)
+{
+    nodes_.clear();
+    lookup_.clear();
+    root_ = -1;
+    for(std::string& body : bodies_)
+        body.clear();
+    instructions_ = 0;
+    error_.clear();
+
+    cursor_ = expression.c_str();
+    int root = parseSum();
+    skipSpace();
+    if(error_.empty() && *cursor_ != '\0')
+        error_ = std::string("unexpected '") + *cursor_ + "'";
+    if(!error_.empty())
+    {
+        std::cout << "ERROR::IMPLICIT::PARSE_FAILED: " << error_ << " at column " << (cursor_ - expression.c_str()) << " of \"" << expression << "\"" << std::endl;
+        nodes_.clear();
+        lookup_.clear();
+        return false;
+    }
+    root_ = root;
+
+    bodies_[(int)Mode::Float] = emit(Mode::Float);
+    bodies_[(int)Mode::Dual] = emit(Mode::Dual);
+    bodies_[(int)Mode::RAA] = emit(Mode::RAA, &instructions_);
+    bodies_[(int)Mode::IA] = emit(Mode::IA);
+    return true;
+}
+
+std::string ImplicitFunction::glsl(const std::string& suffix) const
+{
+    std::string code;
+    code += "float implicitValue" + suffix + "(vec3 p)\n{\n" + bodies_[(int)Mode::Float] + "}\n\n";
+    code += "vec4 implicitDual" + suffix + "(vec3 p)\n{\n" + bodies_[(int)Mode::Dual] + "}\n\n";
+    code += "vec3 implicitRAA" + suffix + "(vec3 x, vec3 y, vec3 z)\n{\n" + bodies_[(int)Mode::RAA] + "}\n\n";
+    code += "vec2 implicitIA" + suffix + "(vec2 x, vec2 y, vec2 z)\n{\n" + bodies_[(int)Mode::IA] + "}\n";
+    return code;
+}
+
+float ImplicitFunction::evaluate(const glm::vec3& p) const
+{
+    if(!valid())
+        return 0.0f;
+    // 操作数的编号总是小于结果的编号，按编号顺序求值即可
+    std::vector<float> values(root_ + 1);
+    for(int i = 0; i <= root_; ++i)
+    {
+        const Node& n = nodes_[i];
+        switch(n.op)
+        {
+        case Op::Const: values[i] = n.value; break;
+        case Op::X:     values[i] = p.x; break;
+        case Op::Y:     values[i] = p.y; break;
+        case Op::Z:     values[i] = p.z; break;
+        case Op::Add:   values[i] = values[n.a] + values[n.b]; break;
+        case Op::Sub:   values[i] = values[n.a] - values[n.b]; break;
+        case Op::Mul:   values[i] = values[n.a] * values[n.b]; break;
+        }
+    }
+    return values[root_];
+}
+
+ImplicitFunction::Dual ImplicitFunction::evaluateDual(const glm::vec3& p) const
+{
+    if(!valid())
+        return Dual();
+    // 每个节点同时记录值和对 x y z 的偏导，乘法按乘积法则传播
+    std::vector<Dual> values(root_ + 1);
+    for(int i = 0; i <= root_; ++i)
+    {
+        const Node& n = nodes_[i];
+        Dual& v = values[i];
+        switch(n.op)
+        {
+        case Op::Const: v = { n.value, glm::vec3(0.0f) }; break;
+        case Op::X:     v = { p.x, glm::vec3(1.0f, 0.0f, 0.0f) }; break;
+        case Op::Y:     v = { p.y, glm::vec3(0.0f, 1.0f, 0.0f) }; break;
+        case Op::Z:     v = { p.z, glm::vec3(0.0f, 0.0f, 1.0f) }; break;
+        case Op::Add:   v = { values[n.a].value + values[n.b].value, values[n.a].gradient + values[n.b].gradient }; break;
+        case Op::Sub:   v = { values[n.a].value - values[n.b].value, values[n.a].gradient - values[n.b].gradient }; break;
+        case Op::Mul:
+        {
+            const Dual& a = values[n.a];
+            const Dual& b = values[n.b];
+            v = { a.value * b.value, a.value * b.gradient + b.value * a.gradient };
+            break;
+        }
+        }
+    }
+    return values[root_];
+}
+
+glm::vec2 ImplicitFunction::evaluateInterval(const glm::vec3& min, const glm::vec3& max) const
+{
+    if(!valid())
+        return glm::vec2(0.0f);
+    std::vector<glm::vec2> values(root_ + 1);
+    for(int i = 0; i <= root_; ++i)
+    {
+        const Node& n = nodes_[i];
+        switch(n.op)
+        {
+        case Op::Const: values[i] = glm::vec2(n.value); break;
+        case Op::X:     values[i] = glm::vec2(min.x, max.x); break;
+        case Op::Y:     values[i] = glm::vec2(min.y, max.y); break;
+        case Op::Z:     values[i] = glm::vec2(min.z, max.z); break;
+        case Op::Add:   values[i] = values[n.a] + values[n.b]; break;
+        case Op::Sub:   values[i] = values[n.a] - glm::vec2(values[n.b].y, values[n.b].x); break;
+        case Op::Mul:   values[i] = n.a == n.b ? sqrInterval(values[n.a]) : mulInterval(values[n.a], values[n.b]); break;
+        }
+    }
+    return values[root_];
+}
+
+float ImplicitFunction::gradientBound(const glm::vec3& min, const glm::vec3& max) const
+{
+    if(!valid())
+        return 0.0f;
+    // 每个节点记录值的区间和三个偏导的区间，乘积法则中的乘法和加法都换成区间运算
+    struct IntervalDual
+    {
+        glm::vec2 value;
+        glm::vec2 gradient[3];
+    };
+    std::vector<IntervalDual> values(root_ + 1);
+    for(int i = 0; i <= root_; ++i)
+    {
+        const Node& n = nodes_[i];
+        IntervalDual& v = values[i];
+        for(int k = 0; k < 3; ++k)
+            v.gradient[k] = glm::vec2(0.0f);
+        switch(n.op)
+        {
+        case Op::Const: v.value = glm::vec2(n.value); break;
+        case Op::X:     v.value = glm::vec2(min.x, max.x); v.gradient[0] = glm::vec2(1.0f); break;
+        case Op::Y:     v.value = glm::vec2(min.y, max.y); v.gradient[1] = glm::vec2(1.0f); break;
+        case Op::Z:     v.value = glm::vec2(min.z, max.z); v.gradient[2] = glm::vec2(1.0f); break;
+        case Op::Add:
+            v.value = values[n.a].value + values[n.b].value;
+            for(int k = 0; k < 3; ++k)
+                v.gradient[k] = values[n.a].gradient[k] + values[n.b].gradient[k];
+            break;
+        case Op::Sub:
+            v.value = values[n.a].value - glm::vec2(values[n.b].value.y, values[n.b].value.x);
+            for(int k = 0; k < 3; ++k)
+                v.gradient[k] = values[n.a].gradient[k] - glm::vec2(values[n.b].gradient[k].y, values[n.b].gradient[k].x);
+            break;
+        case Op::Mul:
+        {
+            const IntervalDual& a = values[n.a];
+            const IntervalDual& b = values[n.b];
+            if(n.a == n.b)
+            {
+                v.value = sqrInterval(a.value);
+                for(int k = 0; k < 3; ++k)
+                    v.gradient[k] = 2.0f * mulInterval(a.value, a.gradient[k]);
+            }
+            else
+            {
+                v.value = mulInterval(a.value, b.value);
+                for(int k = 0; k < 3; ++k)
+                    v.gradient[k] = mulInterval(a.value, b.gradient[k]) + mulInterval(b.value, a.gradient[k]);
+            }
+            break;
+        }
+        }
+    }
+
+    float sum = 0.0f;
+    for(int k = 0; k < 3; ++k)
+    {
+        float m = std::max(std::abs(values[root_].gradient[k].x), std::abs(values[root_].gradient[k].y));
+        sum += m * m;
+    }
+    return std::sqrt(sum);
+}
+
+void ImplicitFunction::skipSpace()
+{
+    while(*cursor_ == ' ' || *cursor_ == '\t')
+        ++cursor_;
+}
+
+int ImplicitFunction::parseSum()
+{
+    int left = parseProduct();
+    while(error_.empty())
+    {
+        skipSpace();
+        char c = *cursor_;
+        if(c != '+' && c != '-')
+            break;
+        ++cursor_;
+        int right = parseProduct();
+        if(!error_.empty())
+            break;
+        left = c == '+' ? add(left, right) : sub(left, right);
+    }
+    return left;
+}
+
+int ImplicitFunction::parseProduct()
+{
+    int left = parseUnary();
+    while(error_.empty())
+    {
+        skipSpace();
+        char c = *cursor_;
+        if(c != '*' && c != '/')
+            break;
+        ++cursor_;
+        int right = parseUnary();
+        if(!error_.empty())
+            break;
+        if(c == '*')
+            left = mul(left, right);
+        else if(nodes_[right].op != Op::Const || nodes_[right].value == 0.0f)
+            error_ = "divisor must be a non-zero constant";
+        else
+            left = mul(left, constant(1.0f / nodes_[right].value));
+    }
+    return left;
+}
+
+int ImplicitFunction::parseUnary()
+{
+    skipSpace();
+    if(*cursor_ == '-')
+    {
+        ++cursor_;
+        int a = parseUnary();
+        return error_.empty() ? neg(a) : -1;
+    }
+    if(*cursor_ == '+')
+    {
+        ++cursor_;
+        return parseUnary();
+    }
+    return parsePower();
+}
+
+int ImplicitFunction::parsePower()
+{
+    int base = parsePrimary();
+    skipSpace();
+    if(!error_.empty() || *cursor_ != '^')
+        return base;
+    ++cursor_;
+    int exponent = parseUnary();    // 右结合
+    if(!error_.empty())
+        return -1;
+    const Node& e = nodes_[exponent];
+    if(e.op != Op::Const || e.value < 0.0f || e.value != std::floor(e.value) || e.value > 64.0f)
+    {
+        error_ = "exponent must be a constant integer in [0, 64]";
+        return -1;
+    }
+    return power(base, (int)e.value);
+}
+
+int ImplicitFunction::parsePrimary()
+{
+    skipSpace();
+    char c = *cursor_;
+    if(c == '(')
+    {
+        ++cursor_;
+        int a = parseSum();
+        skipSpace();
+        if(!error_.empty())
+            return -1;
+        if(*cursor_ != ')')
+        {
+            error_ = "missing ')'";
+            return -1;
+        }
+        ++cursor_;
+        return a;
+    }
+    if(c == 'x' || c == 'y' || c == 'z')
+    {
+        ++cursor_;
+        return node(c == 'x' ? Op::X : (c == 'y' ? Op::Y : Op::Z));
+    }
+    if((c >= '0' && c <= '9') || c == '.')
+    {
+        char* end = nullptr;
+        float value = strtof(cursor_, &end);
+        cursor_ = end;
+        return constant(value);
+    }
+    error_ = c == '\0' ? "unexpected end of expression" : std::string("unexpected '") + c + "'";
+    return -1;
+}
+
+int ImplicitFunction::node(Op op, int a, int b, float value)
+{
+    char key[64];
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    snprintf(key, sizeof(key), "%d %d %d %08x", (int)op, a, b, op == Op::Const ? bits : 0u);
+    auto it = lookup_.find(key);
+    if(it != lookup_.end())
+        return it->second;
+
+    Node n = { op, a, b, value };
+    nodes_.push_back(n);
+    int id = (int)nodes_.size() - 1;
+    lookup_[key] = id;
+    return id;
+}
+
+int ImplicitFunction::add(int a, int b)
+{
+    if(nodes_[a].op == Op::Const && nodes_[b].op == Op::Const)
+        return constant(nodes_[a].value + nodes_[b].value);
+    if(nodes_[a].op == Op::Const || (nodes_[b].op != Op::Const && b < a))
+        std::swap(a, b);
+    if(isConst(b, 0.0f))
+        return a;
+    // (a + c1) + c2 = a + (c1 + c2)
+    if(nodes_[b].op == Op::Const && nodes_[a].op == Op::Add && nodes_[nodes_[a].b].op == Op::Const)
+        return add(nodes_[a].a, constant(nodes_[nodes_[a].b].value + nodes_[b].value));
+    return node(Op::Add, a, b);
+}
+
+int ImplicitFunction::sub(int a, int b)
+{
+    if(a == b)
+        return constant(0.0f);
+    if(nodes_[b].op == Op::Const)
+        return add(a, constant(-nodes_[b].value));
+    if(nodes_[a].op == Op::Const)
+        return add(neg(b), a);
+    return node(Op::Sub, a, b);
+}
+
+int ImplicitFunction::mul(int a, int b)
+{
+    if(nodes_[a].op == Op::Const && nodes_[b].op == Op::Const)
+        return constant(nodes_[a].value * nodes_[b].value);
+    if(nodes_[a].op == Op::Const || (nodes_[b].op != Op::Const && b < a))
+        std::swap(a, b);
+    if(isConst(b, 0.0f))
+        return constant(0.0f);
+    if(isConst(b, 1.0f))
+        return a;
+    // (a * c1) * c2 = a * (c1 * c2)
+    if(nodes_[b].op == Op::Const && nodes_[a].op == Op::Mul && nodes_[nodes_[a].b].op == Op::Const)
+        return mul(nodes_[a].a, constant(nodes_[nodes_[a].b].value * nodes_[b].value));
+    return node(Op::Mul, a, b);
+}
+
+// 平方-乘，a^n 只需要 O(log n) 次乘法，中间的幂与其他地方出现的同一个幂共用
+int ImplicitFunction::power(int a, int n)
+{
+    if(n == 0)
+        return constant(1.0f);
+    if(n == 1)
+        return a;
+    int half = power(a, n / 2);
+    int square = mul(half, half);
+    return n % 2 ? mul(square, a) : square;
+}
+
+std::string ImplicitFunction::emit(Mode mode, size_t* count) const
+{
+    std::vector<bool> used(nodes_.size(), false);
+    std::vector<int> stack(1, root_);
+    while(!stack.empty())
+    {
+        int i = stack.back();
+        stack.pop_back();
+        if(used[i])
+            continue;
+        used[i] = true;
+        if(nodes_[i].a >= 0)
+            stack.push_back(nodes_[i].a);
+        if(nodes_[i].b >= 0)
+            stack.push_back(nodes_[i].b);
+    }
+
+    const char* types[] = { "float", "vec4", "vec3", "vec2" };
+    const char* type = types[(int)mode];
+    auto name = [&](int i) -> std::string
+    {
+        switch(nodes_[i].op)
+        {
+        case Op::Const: return literal(nodes_[i].value);
+        case Op::X:     return mode == Mode::Float ? "p.x" : (mode == Mode::Dual ? "vec4(p.x, 1.0, 0.0, 0.0)" : "x");
+        case Op::Y:     return mode == Mode::Float ? "p.y" : (mode == Mode::Dual ? "vec4(p.y, 0.0, 1.0, 0.0)" : "y");
+        case Op::Z:     return mode == Mode::Float ? "p.z" : (mode == Mode::Dual ? "vec4(p.z, 0.0, 0.0, 1.0)" : "z");
+        default:        return "v" + std::to_string(i);
+        }
+    };
+
+    std::string code;
+    size_t lines = 0;
+    for(size_t i = 0; i < nodes_.size(); ++i)
+    {
+        const Node& n = nodes_[i];
+        if(!used[i] || n.a < 0)
+            continue;
+        std::string a = name(n.a), b = name(n.b);
+        bool constant_b = nodes_[n.b].op == Op::Const;
+        std::string rhs;
+        if(mode == Mode::Float || mode == Mode::Dual)
+        {
+            // 对偶数的加减和数乘就是 vec4 的运算，常数只加在值上
+            if(n.op == Op::Add && constant_b && mode == Mode::Dual)
+                rhs = a + " + vec4(" + b + ", 0.0, 0.0, 0.0)";
+            else if(n.op == Op::Mul && !constant_b && mode == Mode::Dual)
+                rhs = (n.a == n.b ? "sqr_dual(" + a : "mul_dual(" + a + ", " + b) + ")";
+            else
+            {
+                const char* op = n.op == Op::Add ? " + " : (n.op == Op::Sub ? " - " : " * ");
+                rhs = a + op + (constant_b ? "(" + b + ")" : b);
+            }
+        }
+        else
+        {
+            const char* suffix = mode == Mode::RAA ? "_raa" : "_ia";
+            const char* num_suffix = mode == Mode::RAA ? "" : "_ia";
+            if(n.op == Op::Add)
+                rhs = constant_b ? std::string("add_num") + num_suffix + "(" + a + ", " + b + ")" : "add" + std::string(suffix) + "(" + a + ", " + b + ")";
+            else if(n.op == Op::Sub)
+                rhs = "sub" + std::string(suffix) + "(" + a + ", " + b + ")";
+            else if(constant_b)
+                rhs = std::string("mul_num") + num_suffix + "(" + a + ", " + b + ")";
+            else if(n.a == n.b)
+                rhs = "sqr" + std::string(suffix) + "(" + a + ")";     // 平方比一般的乘法紧
+            else
+                rhs = "mul" + std::string(suffix) + "(" + a + ", " + b + ")";
+        }
+        code += "    " + std::string(type) + " v" + std::to_string(i) + " = " + rhs + ";\n";
+        ++lines;
+    }
+
+    std::string result = name(root_);
+    if(nodes_[root_].op == Op::Const)
+    {
+        if(mode == Mode::Dual)
+            result = "vec4(" + result + ", 0.0, 0.0, 0.0)";
+        else if(mode == Mode::RAA)
+            result = "vec3(" + result + ", 0.0, 0.0)";
+        else if(mode == Mode::IA)
+            result = "vec2(" + result + ")";
+    }
+    code += "    return " + result + ";\n";
+
+    if(count)
+        *count = lines;
+    return code;
+}
+
+ImplicitShaderCache::ImplicitShaderCache(const std::string& vertex_path, const std::string& fragment_path, const std::string& defines)
+    : vertex_path_(vertex_path), fragment_path_(fragment_path), defines_(defines)
+{
+}
+
+// 每个函数按编号加后缀生成一组函数，再生成按编号分派的 implicitValue(id, p) 等
+Shader& ImplicitShaderCache::get(const std::vector<ImplicitFunction>& functions)
+{
+    std::string code;
+    size_t instructions = 0;
+    for(size_t i = 0; i < functions.size(); ++i)
+    {
+        code += functions[i].glsl(std::to_string(i)) + "\n";
+        instructions += functions[i].instructions();
+    }
+    // 编号无效时返回不含根的值
+    const char* dispatchers[][3] =
+    {
+        { "float implicitValue(int id, vec3 p)", "implicitValue%zu(p)", "1.0" },
+        { "vec4 implicitDual(int id, vec3 p)", "implicitDual%zu(p)", "vec4(1.0, 0.0, 0.0, 0.0)" },
+        { "vec3 implicitRAA(int id, vec3 x, vec3 y, vec3 z)", "implicitRAA%zu(x, y, z)", "vec3(1.0, 0.0, 0.0)" },
+        { "vec2 implicitIA(int id, vec2 x, vec2 y, vec2 z)", "implicitIA%zu(x, y, z)", "vec2(1.0)" },
+    };
+    for(const auto& dispatcher : dispatchers)
+    {
+        code += std::string(dispatcher[0]) + "\n{\n    switch(id)\n    {\n";
+        for(size_t i = 0; i < functions.size(); ++i)
+        {
+            char call[64];
+            snprintf(call, sizeof(call), dispatcher[1], i);
+            code += "    case " + std::to_string(i) + ": return " + call + ";\n";
+        }
+        code += "    }\n    return " + std::string(dispatcher[2]) + ";\n}\n\n";
+    }
+
+    auto it = shaders_.find(code);
+    if(it != shaders_.end())
+        return it->second;
+
+    Shader& shader = shaders_[code];
+    shader.addInclude("implicit_function.glsl", code);
+    shader.init(vertex_path_, fragment_path_, defines_);
+    printf("implicit shader variant %zu: %zu functions, %zu RAA instructions\n", shaders_.size(), functions.size(), instructions);
+    return shader;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "raa.h"
+#include "shader.h"
+
+// 隐式曲面 f(x, y, z) = 0 的表达式编译器
+// 支持 + - * / ^、括号、数字和 x y z，除数必须是常数，指数必须是非负整数
+// 解析时折叠常数、合并公共子表达式，得到一个有向无环图，再按拓扑序生成专用的 GLSL：
+//   float implicitValue(vec3 p)                     函数值
+//   vec4 implicitDual(vec3 p)                       前向自动微分，一遍得到 (f, ∂f/∂x, ∂f/∂y, ∂f/∂z)，见 dual.glsl
+//   vec3 implicitRAA(vec3 x, vec3 y, vec3 z)        约化仿射算术，x y z 为同一个噪声符号的仿射形式，见 raa.glsl
+//   vec2 implicitIA(vec2 x, vec2 y, vec2 z)         区间算术，x y z 为一个包围盒
+class ImplicitFunction
+{
+public:
+    // 对偶数：值和对 x y z 的梯度
+    struct Dual
+    {
+        float value = 0.0f;
+        glm::vec3 gradient = glm::vec3(0.0f);
+    };
+
+    ImplicitFunction() {}
+    explicit ImplicitFunction(const std::string& expression) { compile(expression); }
+    // 解析失败时输出错误并返回 false，之前的结果被清空
+    bool compile(const std::string& expression);
+    bool valid() const { return root_ >= 0; }
+    // 生成的 GLSL，函数名加上 suffix，由 ImplicitShaderCache 拼接后作为 "implicit_function.glsl" 被 implicit_fs.glsl 包含
+    std::string glsl(const std::string& suffix) const;
+    // 与 GLSL 中 implicitValue、implicitDual 相同的求值，用于CPU端的预处理和验证
+    float evaluate(const glm::vec3& p) const;
+    Dual evaluateDual(const glm::vec3& p) const;
+    // 包围盒 [min, max] 上函数值的区间，与 implicitIA 相同
+    glm::vec2 evaluateInterval(const glm::vec3& min, const glm::vec3& max) const;
+    // 包围盒上 |∇f| 的上界，用区间算术求对偶数，f 在盒内是这个常数的 Lipschitz 函数
+    float gradientBound(const glm::vec3& min, const glm::vec3& max) const;
+    // 与 implicitRAA、implicitIA 相同的运算，V 为 raa::Affine<T> 或 raa::Interval<T>，T 为 float 或 raa::Float8，每一步都向外舍入
+    // values 是求值用的临时空间，反复调用时传同一个可以避免分配
+    template<class V> V evaluateRange(const V& x, const V& y, const V& z, std::vector<V>& values) const;
+    size_t instructions() const { return instructions_; }   // 生成的 implicitRAA 中的运算条数
+
+private:
+    enum class Op { Const, X, Y, Z, Add, Sub, Mul };
+    struct Node
+    {
+        Op op;
+        int a, b;       // 操作数，Add、Mul 中的常数总是 b
+        float value;    // Const 的值
+    };
+
+    std::vector<Node> nodes_;
+    std::map<std::string, int> lookup_;     // 节点的键 -> 编号，用于合并公共子表达式
+    int root_ = -1;
+    std::string bodies_[4];     // 按 Mode 的顺序，四个函数的函数体
+    size_t instructions_ = 0;
+
+    // 递归下降解析
+    const char* cursor_ = nullptr;
+    std::string error_;
+    int parseSum();
+    int parseProduct();
+    int parseUnary();
+    int parsePower();
+    int parsePrimary();
+    void skipSpace();
+
+    // 建立节点时先化简，化简后已经存在的节点直接复用
+    int node(Op op, int a = -1, int b = -1, float value = 0.0f);
+    int constant(float value) { return node(Op::Const, -1, -1, value); }
+    int add(int a, int b);
+    int sub(int a, int b);
+    int mul(int a, int b);
+    int neg(int a) { return mul(a, constant(-1.0f)); }
+    int power(int a, int n);
+    bool isConst(int a, float value) const { return nodes_[a].op == Op::Const && nodes_[a].value == value; }
+
+    // 按拓扑序生成根节点依赖的所有节点，每个节点一行
+    enum class Mode { Float, Dual, RAA, IA };
+    std::string emit(Mode mode, size_t* count = nullptr) const;
+};
+
+template<class V> V ImplicitFunction::evaluateRange(const V& x, const V& y, const V& z, std::vector<V>& values) const
+{
+    if(!valid())
+        return V(0.0f);
+    // 与生成的 GLSL 一样，常数操作数用 add_num、mul_num，两个操作数相同时用平方
+    values.resize(root_ + 1);
+    for(int i = 0; i <= root_; ++i)
+    {
+        const Node& n = nodes_[i];
+        bool constant_b = n.b >= 0 && nodes_[n.b].op == Op::Const;
+        switch(n.op)
+        {
+        case Op::Const: values[i] = V(n.value); break;
+        case Op::X:     values[i] = x; break;
+        case Op::Y:     values[i] = y; break;
+        case Op::Z:     values[i] = z; break;
+        case Op::Add:   values[i] = constant_b ? raa::add(values[n.a], nodes_[n.b].value) : raa::add(values[n.a], values[n.b]); break;
+        case Op::Sub:   values[i] = raa::sub(values[n.a], values[n.b]); break;
+        case Op::Mul:
+            if(constant_b)
+                values[i] = raa::mul(values[n.a], nodes_[n.b].value);
+            else
+                values[i] = n.a == n.b ? raa::sqr(values[n.a]) : raa::mul(values[n.a], values[n.b]);
+            break;
+        }
+    }
+    return values[root_];
+}
+
+// 场景中的一组隐式函数编译成 fragment_path 的一个着色器变体，第 i 个函数的编号为 i，
+// 着色器中用 implicitValue(id, p) 等按编号调用，生成代码相同的函数组共用同一个变体
+class ImplicitShaderCache
+{
+public:
+    // defines 插入到每个变体的片元着色器中，见 Shader::init
+    ImplicitShaderCache(const std::string& vertex_path, const std::string& fragment_path, const std::string& defines = "");
+    Shader& get(const std::vector<ImplicitFunction>& functions);
+    size_t size() const { return shaders_.size(); }
+
+private:
+    std::string vertex_path_;
+    std::string fragment_path_;
+    std::string defines_;
+    std::map<std::string, Shader> shaders_;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// implicit_surface 和 implicit_bench 共用的预设曲面，包围盒都在 [-1.5, 1.5]^3 之内
+const char* const SURFACES[] =
+{
+    "(x^2 + 9/4*z^2 + y^2 - 1)^3 - x^2*y^3 - 9/80*z^2*y^3",     // 心形
+    "x^2 + y^2 + z^2 - 1",                                          // 球
+    "(x^2 + y^2 + z^2 + 0.9^2 - 0.35^2)^2 - 4*0.9^2*(x^2 + z^2)",   // 圆环
+    "x^4 + y^4 + z^4 - 1",                                          // 圆角立方体
+};
+
+// 所有预设曲面的局部包围盒
+const glm::vec3 SURFACE_MIN(-1.5f);
+const glm::vec3 SURFACE_MAX(1.5f);
@@ -0,0 +1,85 @@
+#include "implicit_tiles.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+ImplicitTiles::ImplicitTiles(unsigned int width, unsigned int height, int primitive)
+    : columns_((width + TILE - 1) / TILE), rows_((height + TILE - 1) / TILE), primitive_(primitive)
+{
+    // 没有 build 之前不剔除
+    std::vector<float> full((size_t)columns_ * rows_ * 2);
+    for(size_t i = 0; i < full.size(); i += 2)
+    {
+        full[i] = 0.0f;
+        full[i + 1] = 1e8f;
+    }
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, columns_, rows_, 0, GL_RG, GL_FLOAT, full.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::IMPLICIT_TILES::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenVertexArrays(1, &vao_);
+}
+
+ImplicitTiles::~ImplicitTiles()
+{
+    glDeleteFramebuffers(1, &fbo_);
+    glDeleteTextures(1, &texture_);
+    glDeleteVertexArrays(1, &vao_);
+}
+
+// 每块一个片元，画完读回统计空块的比例，只在相机或曲面改变时调用，同步读回的开销可以接受
+void ImplicitTiles::build(Shader& tile_shader, const Shader& shader)
+{
+    tile_shader.copyUniformsFrom(shader);
+    tile_shader.bind();
+    tile_shader.setInt("implicit_tile_primitive", primitive_);
+
+    GLint vao = 0, viewport[4];
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glViewport(0, 0, columns_, rows_);
+    glBindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(vao);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    std::vector<float> ranges((size_t)columns_ * rows_ * 2);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, ranges.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    int empty = 0, bounded = 0;
+    double length = 0.0;
+    for(size_t i = 0; i < ranges.size(); i += 2)
+    {
+        if(ranges[i] > ranges[i + 1])
+            ++empty;
+        else if(ranges[i + 1] < 1e7f)
+        {
+            ++bounded;
+            length += ranges[i + 1] - ranges[i];
+        }
+    }
+    printf("implicit tiles: %d of %d empty, mean depth range %.3f\n", empty, columns_ * rows_, bounded ? length / bounded : 0.0);
+}
+
+void ImplicitTiles::bind(Shader& shader, GLuint unit)
+{
+    shader.bind();
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    shader.setInt("implicitTileTex", unit);
+    shader.setInt("implicit_tile_primitive", primitive_);
+    glActiveTexture(GL_TEXTURE0);
+}
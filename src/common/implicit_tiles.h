@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "shader.h"
+
+// 主光线与一个隐式曲面的按块剔除：屏幕每 TILE x TILE 个像素一块，用 implicit_tiles_fs.glsl 对整块的光束做区间算术，
+// 求出块内所有主光线与曲面的交点可能在的 t 范围存到一张小纹理里，implicit_fs.glsl 的主光线只在这个范围内求根
+// 范围只与相机和曲面有关，两者改变后调用 build 重新计算
+class ImplicitTiles
+{
+public:
+    static const int TILE = 8;      // 与 implicit_fs.glsl、implicit_tiles_fs.glsl 中的 IMPLICIT_TILE 一致
+
+    // primitive 为 PrimitiveBVH::slot 返回的图元位置
+    ImplicitTiles(unsigned int width, unsigned int height, int primitive);
+    ~ImplicitTiles();
+    // tile_shader 为 implicit_tiles_fs.glsl 与 shader 使用同一组函数的变体，相机和 PrimitiveBVH 等场景参数从 shader 复制
+    void build(Shader& tile_shader, const Shader& shader);
+    // 绑定范围纹理到 unit 上，并设置要剔除的图元
+    void bind(Shader& shader, GLuint unit);
+
+private:
+    int columns_, rows_;
+    int primitive_;
+    GLuint texture_ = 0;
+    GLuint fbo_ = 0;
+    GLuint vao_ = 0;
+};
@@ -0,0 +1,245 @@
+#include "light_bvh.h"
+#include "gl_util.h"
+#include "../config.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int BINS = 12;
+
+    float angleBetween(const glm::vec3& a, const glm::vec3& b)
+    {
+        return std::acos(glm::clamp(glm::dot(a, b), -1.0f, 1.0f));
+    }
+
+}
+
+// 两个朝向锥的并，Conty Estevez & Kulla 2018 中的 Union(a, b)
+void LightBVH::LightBounds::merge(const LightBounds& other)
+{
+    if(other.energy <= 0.0f && other.min.x > other.max.x)
+        return;
+    if(energy <= 0.0f && min.x > max.x)
+    {
+        *this = other;
+        return;
+    }
+
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+    energy += other.energy;
+
+    const LightBounds* a = this;
+    const LightBounds* b = &other;
+    LightBounds copy = *this;
+    if(theta_o < other.theta_o)
+    {
+        a = &other;
+        b = &copy;
+    }
+    glm::vec3 axis_a = a->axis, axis_b = b->axis;
+    float theta_o_a = a->theta_o, theta_o_b = b->theta_o;
+    theta_e = std::max(theta_e, other.theta_e);
+
+    float theta_d = angleBetween(axis_a, axis_b);
+    if(std::min(theta_d + theta_o_b, PI) <= theta_o_a)
+    {
+        axis = axis_a;
+        theta_o = theta_o_a;
+        return;
+    }
+
+    float theta = (theta_o_a + theta_d + theta_o_b) * 0.5f;
+    glm::vec3 ortho = axis_b - axis_a * glm::dot(axis_a, axis_b);
+    if(theta >= PI || glm::length(ortho) < 1e-6f)
+    {
+        axis = axis_a;
+        theta_o = PI;
+        return;
+    }
+    // 把 axis_a 向 axis_b 旋转 theta - theta_o_a
+    float rotation = theta - theta_o_a;
+    axis = glm::normalize(axis_a * std::cos(rotation) + glm::normalize(ortho) * std::sin(rotation));
+    theta_o = theta;
+}
+
+float LightBVH::LightBounds::cost() const
+{
+    glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+    float area = 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    float theta_w = std::min(theta_o + theta_e, PI);
+    float orientation = 2.0f * PI * (1.0f - std::cos(theta_o)) +
+        PI / 2.0f * (2.0f * theta_w * std::sin(theta_o) - std::cos(theta_o - 2.0f * theta_w) - 2.0f * theta_o * std::sin(theta_o) + std::cos(theta_o));
+    return energy * std::max(area, 1e-8f) * orientation;
+}
+
+int LightBVH::addTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& emission, bool hittable)
+{
+    Light light;
+    light.p0 = p0;
+    light.p1 = p1;
+    light.p2 = p2;
+    light.emission = emission;
+    light.hittable = hittable;
+    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    light.area = 0.5f * glm::length(n);
+
+    light.bounds.min = glm::min(p0, glm::min(p1, p2));
+    light.bounds.max = glm::max(p0, glm::max(p1, p2));
+    light.bounds.axis = light.area > 0.0f ? glm::normalize(n) : glm::vec3(0.0f, 0.0f, 1.0f);
+    light.bounds.theta_o = 0.0f;
+    light.bounds.theta_e = PI / 2.0f;
+    light.bounds.energy = luminance(emission) * light.area * PI;
+    lights_.push_back(light);
+    return (int)lights_.size() - 1;
+}
+
+void LightBVH::build()
+{
+    nodes_.clear();
+    if(lights_.empty())
+        return;
+    std::vector<int> indices(lights_.size());
+    for(size_t i = 0; i < indices.size(); ++i)
+        indices[i] = (int)i;
+    nodes_.reserve(lights_.size() * 2 - 1);
+    buildRecursive(indices, 0, (int)indices.size(), -1);
+    upload();
+}
+
+// 在三个轴上按分桶的 SAOH 选择划分，找不到有效划分时按中位数切开
+int LightBVH::buildRecursive(std::vector<int>& indices, int begin, int end, int parent)
+{
+    int index = (int)nodes_.size();
+    nodes_.emplace_back();
+    nodes_[index].parent = parent;
+
+    LightBounds bounds, centroid_bounds;
+    for(int i = begin; i < end; ++i)
+    {
+        const LightBounds& b = lights_[indices[i]].bounds;
+        bounds.merge(b);
+        glm::vec3 c = (b.min + b.max) * 0.5f;
+        centroid_bounds.min = glm::min(centroid_bounds.min, c);
+        centroid_bounds.max = glm::max(centroid_bounds.max, c);
+    }
+    nodes_[index].bounds = bounds;
+
+    if(end - begin == 1)
+    {
+        nodes_[index].light = indices[begin];
+        lights_[indices[begin]].leaf = index;
+        return index;
+    }
+
+    glm::vec3 extent = bounds.max - bounds.min;
+    float max_extent = std::max(extent.x, std::max(extent.y, extent.z));
+    float best_cost = 1e30f;
+    int best_axis = -1, best_split = 0;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        float lo = centroid_bounds.min[axis], hi = centroid_bounds.max[axis];
+        if(hi - lo <= 0.0f)
+            continue;
+
+        LightBounds bins[BINS];
+        for(int i = begin; i < end; ++i)
+        {
+            const LightBounds& b = lights_[indices[i]].bounds;
+            float c = (b.min[axis] + b.max[axis]) * 0.5f;
+            int bin = std::min(BINS - 1, (int)(BINS * (c - lo) / (hi - lo)));
+            bins[bin].merge(b);
+        }
+        // 细长的包围盒沿短轴划分的代价更高
+        float regularization = max_extent / std::max(extent[axis], 1e-8f);
+        for(int split = 1; split < BINS; ++split)
+        {
+            LightBounds left, right;
+            for(int i = 0; i < split; ++i)
+                left.merge(bins[i]);
+            for(int i = split; i < BINS; ++i)
+                right.merge(bins[i]);
+            float cost = regularization * (left.cost() + right.cost());
+            if(cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    int mid = (begin + end) / 2;
+    if(best_axis >= 0)
+    {
+        float lo = centroid_bounds.min[best_axis], hi = centroid_bounds.max[best_axis];
+        int* middle = std::partition(&indices[begin], &indices[begin] + (end - begin), [&](int i) {
+            const LightBounds& b = lights_[i].bounds;
+            float c = (b.min[best_axis] + b.max[best_axis]) * 0.5f;
+            return std::min(BINS - 1, (int)(BINS * (c - lo) / (hi - lo))) < best_split;
+        });
+        mid = (int)(middle - &indices[0]);
+    }
+    if(mid == begin || mid == end)
+        mid = (begin + end) / 2;
+
+    int left = buildRecursive(indices, begin, mid, index);
+    int right = buildRecursive(indices, mid, end, index);
+    nodes_[index].left = left;
+    nodes_[index].right = right;
+    return index;
+}
+
+LightBVH::~LightBVH()
+{
+    glDeleteTextures(1, &node_texture_);
+    glDeleteTextures(1, &light_texture_);
+}
+
+void LightBVH::bind(Shader& shader, GLuint first_unit)
+{
+    shader.bind();
+    shader.setInt("light_count", (int)lights_.size());
+    if(nodes_.empty())
+        return;
+
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_2D, node_texture_);
+    shader.setInt("lightNodeTex", first_unit);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+    glBindTexture(GL_TEXTURE_2D, light_texture_);
+    shader.setInt("lightTex", first_unit + 1);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void LightBVH::upload()
+{
+    glDeleteTextures(1, &node_texture_);
+    glDeleteTextures(1, &light_texture_);
+
+    std::vector<glm::vec4> texels;
+    texels.reserve(nodes_.size() * 4);
+    for(const Node& node : nodes_)
+    {
+        const LightBounds& b = node.bounds;
+        texels.push_back(glm::vec4(b.min, b.energy));
+        texels.push_back(glm::vec4(b.max, b.theta_o));
+        texels.push_back(glm::vec4(b.axis, b.theta_e));
+        texels.push_back(glm::vec4((float)node.left, (float)node.right, (float)node.parent, (float)node.light));
+    }
+    node_texture_ = createDataTexture(texels, (int)nodes_.size(), 4, ITEMS_PER_ROW);
+
+    texels.clear();
+    for(const Light& light : lights_)
+    {
+        texels.push_back(glm::vec4(light.p0, light.area));
+        texels.push_back(glm::vec4(light.p1, (float)light.leaf));
+        texels.push_back(glm::vec4(light.p2, light.hittable ? 1.0f : 0.0f));
+        texels.push_back(glm::vec4(light.emission, 0.0f));
+    }
+    light_texture_ = createDataTexture(texels, (int)lights_.size(), 4, ITEMS_PER_ROW);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+
+// 发光三角形的层次包围结构，Conty Estevez & Kulla 2018 "Importance Sampling of Many Lights with Adaptive Tree Splitting"
+// 节点记录功率、包围盒和朝向锥，着色器中按各子树对着色点的估计贡献随机下降选出一个光源，见 light_bvh.glsl
+class LightBVH
+{
+public:
+    static const int ITEMS_PER_ROW = 1024;  // 纹理每行的节点/光源数，每个占4个像素，与 light_bvh.glsl 一致
+
+    // 单面发光，发光的一侧为 (p1 - p0) x (p2 - p0) 的方向，返回光源编号
+    // hittable 为 false 时光源只用于下一事件估计，不在场景的几何体中，BSDF 采样打不到它，光源采样的 MIS 权重为 1
+    int addTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& emission, bool hittable = true);
+    int size() const { return (int)lights_.size(); }
+    // 构建并上传，之后再添加的光源需要重新调用
+    void build();
+    // 绑定两张纹理到 first_unit 开始的连续纹理单元上，并设置 shader 中对应的 uniform
+    void bind(Shader& shader, GLuint first_unit);
+    ~LightBVH();
+
+private:
+    // 包围盒 + 朝向锥：axis 为中心方向，theta_o 为法线的张角，theta_e 为法线之外的发光张角
+    struct LightBounds
+    {
+        glm::vec3 min = glm::vec3(1e30f);
+        glm::vec3 max = glm::vec3(-1e30f);
+        glm::vec3 axis = glm::vec3(0.0f, 0.0f, 1.0f);
+        float theta_o = 0.0f;
+        float theta_e = 0.0f;
+        float energy = 0.0f;
+
+        void merge(const LightBounds& other);
+        float cost() const;     // SAOH 中的 E * M_A * M_Ω
+    };
+
+    struct Light
+    {
+        glm::vec3 p0, p1, p2;
+        glm::vec3 emission;
+        float area;
+        bool hittable;
+        LightBounds bounds;
+        int leaf = -1;
+    };
+
+    struct Node
+    {
+        LightBounds bounds;
+        int left = -1;
+        int right = -1;
+        int parent = -1;
+        int light = -1;     // 叶节点对应的光源
+    };
+
+    std::vector<Light> lights_;
+    std::vector<Node> nodes_;
+    GLuint node_texture_ = 0;
+    GLuint light_texture_ = 0;
+
+    int buildRecursive(std::vector<int>& indices, int begin, int end, int parent);
+    void upload();
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// CPU 上预处理和基准共用的多线程工具，不依赖 OpenGL
+
+// 把 [begin, end) 平均分给所有硬件线程，func(first, last) 处理其中连续的一段
+inline void parallelFor(int begin, int end, const std::function<void(int, int)>& func)
+{
+    int threads = std::max(1, (int)std::thread::hardware_concurrency());
+    int chunk = (end - begin + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for(int first = begin; first < end; first += chunk)
+        workers.emplace_back(func, first, std::min(end, first + chunk));
+    for(auto& worker : workers)
+        worker.join();
+}
+
+// 单调时钟的秒数，只用于求时间差
+inline double wallSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,80 @@
+#include "path_guiding.h"
+#include "../config.h"
+
+PathGuiding::PathGuiding(const std::string& fragment_path, const glm::vec3& min, const glm::vec3& max, unsigned int width, unsigned int height)
+    : tree_(min, max), width_(width), height_(height)
+{
+    record_shader_.init(project_path + "src/shader/fullscreen_vs.glsl", fragment_path, "#define GUIDING_RECORD\n");
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    GLenum draw_buffers[RECORD_VERTICES * 2];
+    for(int i = 0; i < RECORD_VERTICES * 2; ++i)
+    {
+        glGenTextures(1, &textures_[i]);
+        glBindTexture(GL_TEXTURE_2D, textures_[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width_, height_, 0, GL_RGBA, GL_FLOAT, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures_[i], 0);
+        draw_buffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    }
+    glDrawBuffers(RECORD_VERTICES * 2, draw_buffers);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::PATH_GUIDING::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenVertexArrays(1, &vao_);
+}
+
+PathGuiding::~PathGuiding()
+{
+    glDeleteFramebuffers(1, &fbo_);
+    glDeleteTextures(RECORD_VERTICES * 2, textures_);
+    glDeleteVertexArrays(1, &vao_);
+}
+
+bool PathGuiding::train(Shader& shader)
+{
+    if(!training())
+        return false;
+
+    // 记录pass与主着色器共用场景参数和当前的引导分布
+    record_shader_.copyUniformsFrom(shader);
+    GLint vao = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    record_shader_.bind();
+    glBindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(vao);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    positions_.resize(width_ * height_ * 4);
+    directions_.resize(width_ * height_ * 4);
+    for(int v = 0; v < RECORD_VERTICES; ++v)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures_[v * 2]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, positions_.data());
+        glBindTexture(GL_TEXTURE_2D, textures_[v * 2 + 1]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, directions_.data());
+        for(size_t i = 0; i < positions_.size(); i += 4)
+        {
+            float pdf = directions_[i + 3];
+            if(pdf <= 0.0f)
+                continue;
+            tree_.record(glm::vec3(positions_[i], positions_[i + 1], positions_[i + 2]),
+                glm::vec3(directions_[i], directions_[i + 1], directions_[i + 2]), positions_[i + 3], pdf);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if(++frames_ < (1u << iteration_))
+        return false;
+    tree_.refine(iteration_);
+    printf("path guiding iteration %u: %zu spatial nodes, %zu directional nodes\n", iteration_, tree_.spatialNodes(), tree_.directionalNodes());
+    ++iteration_;
+    frames_ = 0;
+    return true;
+}
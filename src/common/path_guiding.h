@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+#include "sd_tree.h"
+
+// 在渐进累积的过程中在线学习 SDTree
+// 训练时每帧额外追踪一遍路径，把漫反射顶点的入射辐射度读回 CPU 记录到树中；第 k 次迭代持续 2^k 帧，
+// 结束时细分并上传，之后用新的分布从头累积，之前迭代的结果噪声更大，直接丢弃（Müller et al. 2017）
+class PathGuiding
+{
+public:
+    static const int RECORD_VERTICES = 3;       // 与 base_fs.glsl 中的 GUIDING_RECORD_VERTICES 一致
+    static const unsigned int ITERATIONS = 8;   // 之后树不再变化，一直累积
+
+    // fragment_path 为积分器，需要支持 GUIDING_RECORD，见 base_fs.glsl；min, max 为场景的包围盒
+    PathGuiding(const std::string& fragment_path, const glm::vec3& min, const glm::vec3& max, unsigned int width, unsigned int height);
+    ~PathGuiding();
+    // 训练结束前每帧在 shader 设置好参数后调用，返回 true 表示刚完成一次迭代，调用者需要重新 bind 并清空累积的结果
+    bool train(Shader& shader);
+    bool training() const { return iteration_ < ITERATIONS; }
+    unsigned int iteration() const { return iteration_; }
+    void bind(Shader& shader, GLuint first_unit) { tree_.bind(shader, first_unit); }
+
+private:
+    SDTree tree_;
+    Shader record_shader_;
+    GLuint fbo_ = 0;
+    GLuint vao_ = 0;
+    GLuint textures_[RECORD_VERTICES * 2] = {};
+    unsigned int width_;
+    unsigned int height_;
+    unsigned int iteration_ = 0;
+    unsigned int frames_ = 0;   // 本次迭代已经训练的帧数
+    std::vector<float> positions_;
+    std::vector<float> directions_;
+};
@@ -0,0 +1,233 @@
+#include "primitive_bvh.h"
+#include "gl_util.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int BINS = 12;
+    const float TRIANGLE_COST = 1.0f;
+    const float IMPLICIT_COST = 8.0f;   // 一次 RAA 求根大致相当于几个三角形求交
+
+    float area(const glm::vec3& min, const glm::vec3& max)
+    {
+        glm::vec3 e = glm::max(max - min, glm::vec3(0.0f));
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    float cost(const glm::vec4& head)
+    {
+        return head.x > 0.5f ? IMPLICIT_COST : TRIANGLE_COST;
+    }
+
+}
+
+// 三角形：(0, 材质, -, -) (p0) (p1) (p2) (法线) (-)
+int PrimitiveBVH::addTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& normal, int material)
+{
+    Primitive p;
+    p.texels[0] = glm::vec4(0.0f, (float)material, 0.0f, 0.0f);
+    p.texels[1] = glm::vec4(p0, 0.0f);
+    p.texels[2] = glm::vec4(p1, 0.0f);
+    p.texels[3] = glm::vec4(p2, 0.0f);
+    p.texels[4] = glm::vec4(normal, 0.0f);
+    p.texels[5] = glm::vec4(0.0f);
+    p.min = glm::min(p0, glm::min(p1, p2));
+    p.max = glm::max(p0, glm::max(p1, p2));
+    primitives_.push_back(p);
+    return (int)primitives_.size() - 1;
+}
+
+// 隐式曲面：(1, 材质, 函数, 砖块) 世界到局部的 3x4 矩阵的三行 (局部包围盒的 min) (max)
+int PrimitiveBVH::addImplicit(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max, int function, int bricks, int material)
+{
+    glm::mat4 inverse = glm::transpose(glm::inverse(transform));   // 转置后列就是原矩阵的行
+    Primitive p;
+    p.texels[0] = glm::vec4(1.0f, (float)material, (float)function, (float)bricks);
+    p.texels[1] = inverse[0];
+    p.texels[2] = inverse[1];
+    p.texels[3] = inverse[2];
+    p.texels[4] = glm::vec4(min, 0.0f);
+    p.texels[5] = glm::vec4(max, 0.0f);
+
+    // 局部包围盒的8个角变换后的包围盒
+    p.min = glm::vec3(1e30f);
+    p.max = glm::vec3(-1e30f);
+    for(int i = 0; i < 8; ++i)
+    {
+        glm::vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+        glm::vec3 world = glm::vec3(transform * glm::vec4(corner, 1.0f));
+        p.min = glm::min(p.min, world);
+        p.max = glm::max(p.max, world);
+    }
+    primitives_.push_back(p);
+    return (int)primitives_.size() - 1;
+}
+
+void PrimitiveBVH::build()
+{
+    nodes_.clear();
+    if(primitives_.empty())
+        return;
+    std::vector<int> indices(primitives_.size());
+    for(size_t i = 0; i < indices.size(); ++i)
+        indices[i] = (int)i;
+    nodes_.reserve(primitives_.size() * 2);
+    buildRecursive(indices, 0, (int)indices.size());
+    link(0, -1);
+    upload(indices);
+
+    slots_.resize(indices.size());
+    for(size_t i = 0; i < indices.size(); ++i)
+        slots_[indices[i]] = (int)i;
+}
+
+// 在三个轴上按分桶的 SAH 选择划分，隐式曲面的求交代价按 IMPLICIT_COST 计，找不到有效划分时按中位数切开
+int PrimitiveBVH::buildRecursive(std::vector<int>& indices, int begin, int end)
+{
+    int index = (int)nodes_.size();
+    nodes_.emplace_back();
+
+    glm::vec3 min(1e30f), max(-1e30f), centroid_min(1e30f), centroid_max(-1e30f);
+    for(int i = begin; i < end; ++i)
+    {
+        const Primitive& p = primitives_[indices[i]];
+        min = glm::min(min, p.min);
+        max = glm::max(max, p.max);
+        glm::vec3 c = (p.min + p.max) * 0.5f;
+        centroid_min = glm::min(centroid_min, c);
+        centroid_max = glm::max(centroid_max, c);
+    }
+    nodes_[index].min = min;
+    nodes_[index].max = max;
+    if(end - begin == 1)
+    {
+        nodes_[index].primitive = begin;
+        return index;
+    }
+
+    float best_cost = 1e30f;
+    int best_axis = -1, best_split = 0;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        float lo = centroid_min[axis], hi = centroid_max[axis];
+        if(hi - lo <= 0.0f)
+            continue;
+
+        glm::vec3 bin_min[BINS], bin_max[BINS];
+        float bin_cost[BINS] = {};
+        for(int b = 0; b < BINS; ++b)
+        {
+            bin_min[b] = glm::vec3(1e30f);
+            bin_max[b] = glm::vec3(-1e30f);
+        }
+        for(int i = begin; i < end; ++i)
+        {
+            const Primitive& p = primitives_[indices[i]];
+            float c = (p.min[axis] + p.max[axis]) * 0.5f;
+            int bin = std::min(BINS - 1, (int)(BINS * (c - lo) / (hi - lo)));
+            bin_min[bin] = glm::min(bin_min[bin], p.min);
+            bin_max[bin] = glm::max(bin_max[bin], p.max);
+            bin_cost[bin] += cost(p.texels[0]);
+        }
+        for(int split = 1; split < BINS; ++split)
+        {
+            glm::vec3 left_min(1e30f), left_max(-1e30f), right_min(1e30f), right_max(-1e30f);
+            float left_cost = 0.0f, right_cost = 0.0f;
+            for(int b = 0; b < split; ++b)
+            {
+                left_min = glm::min(left_min, bin_min[b]);
+                left_max = glm::max(left_max, bin_max[b]);
+                left_cost += bin_cost[b];
+            }
+            for(int b = split; b < BINS; ++b)
+            {
+                right_min = glm::min(right_min, bin_min[b]);
+                right_max = glm::max(right_max, bin_max[b]);
+                right_cost += bin_cost[b];
+            }
+            if(left_cost == 0.0f || right_cost == 0.0f)
+                continue;
+            float c = area(left_min, left_max) * left_cost + area(right_min, right_max) * right_cost;
+            if(c < best_cost)
+            {
+                best_cost = c;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    int mid = (begin + end) / 2;
+    if(best_axis >= 0)
+    {
+        float lo = centroid_min[best_axis], hi = centroid_max[best_axis];
+        int* middle = std::partition(&indices[begin], &indices[begin] + (end - begin), [&](int i) {
+            const Primitive& p = primitives_[i];
+            float c = (p.min[best_axis] + p.max[best_axis]) * 0.5f;
+            return std::min(BINS - 1, (int)(BINS * (c - lo) / (hi - lo))) < best_split;
+        });
+        mid = (int)(middle - &indices[0]);
+    }
+    if(mid == begin || mid == end)
+        mid = (begin + end) / 2;
+
+    buildRecursive(indices, begin, mid);
+    int right = buildRecursive(indices, mid, end);
+    nodes_[index].right = right;
+    return index;
+}
+
+void PrimitiveBVH::link(int node, int miss)
+{
+    nodes_[node].miss = miss;
+    if(nodes_[node].primitive >= 0)
+        return;
+    link(node + 1, nodes_[node].right);
+    link(nodes_[node].right, miss);
+}
+
+PrimitiveBVH::~PrimitiveBVH()
+{
+    glDeleteTextures(1, &node_texture_);
+    glDeleteTextures(1, &primitive_texture_);
+}
+
+// 节点：(min, 跳过子树后的下一个节点) (max, 叶节点的图元，内部节点为 -1)，图元按叶节点的顺序重新排列
+void PrimitiveBVH::upload(const std::vector<int>& order)
+{
+    std::vector<glm::vec4> node_texels;
+    node_texels.reserve(nodes_.size() * 2);
+    for(const Node& node : nodes_)
+    {
+        node_texels.push_back(glm::vec4(node.min, (float)node.miss));
+        node_texels.push_back(glm::vec4(node.max, (float)node.primitive));
+    }
+
+    std::vector<glm::vec4> primitive_texels;
+    primitive_texels.reserve(order.size() * PRIMITIVE_TEXELS);
+    for(int i : order)
+        primitive_texels.insert(primitive_texels.end(), primitives_[i].texels, primitives_[i].texels + PRIMITIVE_TEXELS);
+
+    glDeleteTextures(1, &node_texture_);
+    glDeleteTextures(1, &primitive_texture_);
+    node_texture_ = createDataTexture(node_texels, (int)nodes_.size(), 2, ITEMS_PER_ROW);
+    primitive_texture_ = createDataTexture(primitive_texels, (int)order.size(), PRIMITIVE_TEXELS, ITEMS_PER_ROW);
+}
+
+void PrimitiveBVH::bind(Shader& shader, GLuint first_unit)
+{
+    shader.bind();
+    shader.setInt("primitive_count", size());
+
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_2D, node_texture_);
+    shader.setInt("bvhNodeTex", first_unit);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+    glBindTexture(GL_TEXTURE_2D, primitive_texture_);
+    shader.setInt("primitiveTex", first_unit + 1);
+
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+
+// 三角形和隐式曲面共用的层次包围盒，按分桶的 SAH 构建，每个叶节点一个图元
+// 节点按深度优先的顺序存放，每个节点记录跳过整棵子树后的下一个节点，着色器中不用栈就能遍历，见 implicit_fs.glsl 的 hitWorld
+// 隐式曲面是一个实例：局部空间中的包围盒、到世界空间的变换、ImplicitShaderCache 中的函数编号和 ImplicitBricks 中的曲面编号
+class PrimitiveBVH
+{
+public:
+    static const int ITEMS_PER_ROW = 512;   // 纹理每行的节点/图元数，与 primitive_bvh.glsl 一致
+    static const int PRIMITIVE_TEXELS = 6;  // 每个图元占的像素数，与 primitive_bvh.glsl 一致
+
+    // 单面三角形，从 normal 一侧才能打到，返回图元编号
+    int addTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& normal, int material);
+    // transform 把局部空间变换到世界空间，必须可逆
+    int addImplicit(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max, int function, int bricks, int material);
+    int size() const { return (int)primitives_.size(); }
+    // build 之后第 primitive 个图元在纹理中的位置，着色器中按这个位置访问图元
+    int slot(int primitive) const { return slots_[primitive]; }
+    // 构建并上传，之后再添加的图元需要重新调用
+    void build();
+    // 绑定两张纹理到 first_unit 开始的连续纹理单元上
+    void bind(Shader& shader, GLuint first_unit);
+    ~PrimitiveBVH();
+
+private:
+    struct Primitive
+    {
+        glm::vec4 texels[PRIMITIVE_TEXELS];
+        glm::vec3 min, max;     // 世界空间的包围盒
+    };
+
+    struct Node
+    {
+        glm::vec3 min, max;
+        int right = -1;     // 左子节点紧跟在父节点之后
+        int miss = -1;      // 跳过这棵子树后的下一个节点，-1 表示遍历结束
+        int primitive = -1; // 叶节点的图元，按叶节点的顺序重新编号
+    };
+
+    std::vector<Primitive> primitives_;
+    std::vector<Node> nodes_;
+    std::vector<int> slots_;
+    GLuint node_texture_ = 0;
+    GLuint primitive_texture_ = 0;
+
+    int buildRecursive(std::vector<int>& indices, int begin, int end);
+    void link(int node, int miss);
+    void upload(const std::vector<int>& order);
+};
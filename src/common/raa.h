@@ -0,0 +1,239 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// CPU 端的区间算术和约化仿射算术（RAA），运算与 shader/raa.glsl 一一对应，只有头文件
+// 每一步都向外舍入：下界往下、上界往上各多放至少一个 ulp，RAA 中心和系数的舍入误差计入误差项，
+// 所以结果一定包含实数运算下的取值范围，GLSL 版本没有这个保证
+// T 为 float 时一次算一个区间，为 Float8 时一次算 8 个，8 个通道可以是同一条光线上的 8 段，也可以是 8 条光线
+// 编译时打开 AVX2（GCC/Clang -mavx2，MSVC /arch:AVX2）时 Float8 使用 AVX2 指令，否则是逐通道的循环
+namespace raa
+{
+#ifdef __AVX2__
+    struct Mask8
+    {
+        __m256 m;
+        int bits() const { return _mm256_movemask_ps(m); }   // 第 i 位为第 i 个通道
+    };
+
+    struct Float8
+    {
+        __m256 v;
+
+        Float8() : v(_mm256_setzero_ps()) {}
+        Float8(float f) : v(_mm256_set1_ps(f)) {}
+        Float8(__m256 m) : v(m) {}
+        static Float8 load(const float* p) { return _mm256_loadu_ps(p); }
+        void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+        friend Float8 operator+(const Float8& a, const Float8& b) { return _mm256_add_ps(a.v, b.v); }
+        friend Float8 operator-(const Float8& a, const Float8& b) { return _mm256_sub_ps(a.v, b.v); }
+        friend Float8 operator*(const Float8& a, const Float8& b) { return _mm256_mul_ps(a.v, b.v); }
+        friend Float8 operator/(const Float8& a, const Float8& b) { return _mm256_div_ps(a.v, b.v); }
+        friend Float8 operator-(const Float8& a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+        friend Mask8 operator<(const Float8& a, const Float8& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+        friend Mask8 operator<=(const Float8& a, const Float8& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+    };
+
+    inline Mask8 operator&(const Mask8& a, const Mask8& b) { return { _mm256_and_ps(a.m, b.m) }; }
+    inline Float8 min(const Float8& a, const Float8& b) { return _mm256_min_ps(a.v, b.v); }
+    inline Float8 max(const Float8& a, const Float8& b) { return _mm256_max_ps(a.v, b.v); }
+    inline Float8 abs(const Float8& a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+    inline Float8 select(const Mask8& m, const Float8& a, const Float8& b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+#else
+    struct Mask8
+    {
+        bool m[8];
+        int bits() const
+        {
+            int b = 0;
+            for(int i = 0; i < 8; ++i)
+                b |= m[i] << i;
+            return b;
+        }
+    };
+
+    struct Float8
+    {
+        float v[8];
+
+        Float8() : Float8(0.0f) {}
+        Float8(float f) { std::fill(v, v + 8, f); }
+        static Float8 load(const float* p) { Float8 r; std::copy(p, p + 8, r.v); return r; }
+        void store(float* p) const { std::copy(v, v + 8, p); }
+
+        template<class F> static Float8 map(const Float8& a, const Float8& b, F f)
+        {
+            Float8 r;
+            for(int i = 0; i < 8; ++i)
+                r.v[i] = f(a.v[i], b.v[i]);
+            return r;
+        }
+        template<class F> static Mask8 compare(const Float8& a, const Float8& b, F f)
+        {
+            Mask8 r;
+            for(int i = 0; i < 8; ++i)
+                r.m[i] = f(a.v[i], b.v[i]);
+            return r;
+        }
+
+        friend Float8 operator+(const Float8& a, const Float8& b) { return map(a, b, [](float x, float y) { return x + y; }); }
+        friend Float8 operator-(const Float8& a, const Float8& b) { return map(a, b, [](float x, float y) { return x - y; }); }
+        friend Float8 operator*(const Float8& a, const Float8& b) { return map(a, b, [](float x, float y) { return x * y; }); }
+        friend Float8 operator/(const Float8& a, const Float8& b) { return map(a, b, [](float x, float y) { return x / y; }); }
+        friend Float8 operator-(const Float8& a) { return map(a, a, [](float x, float) { return -x; }); }
+        friend Mask8 operator<(const Float8& a, const Float8& b) { return compare(a, b, [](float x, float y) { return x < y; }); }
+        friend Mask8 operator<=(const Float8& a, const Float8& b) { return compare(a, b, [](float x, float y) { return x <= y; }); }
+    };
+
+    inline Mask8 operator&(const Mask8& a, const Mask8& b)
+    {
+        Mask8 r;
+        for(int i = 0; i < 8; ++i)
+            r.m[i] = a.m[i] && b.m[i];
+        return r;
+    }
+    inline Float8 min(const Float8& a, const Float8& b) { return Float8::map(a, b, [](float x, float y) { return y < x ? y : x; }); }
+    inline Float8 max(const Float8& a, const Float8& b) { return Float8::map(a, b, [](float x, float y) { return x < y ? y : x; }); }
+    inline Float8 abs(const Float8& a) { return Float8::map(a, a, [](float x, float) { return std::fabs(x); }); }
+    inline Float8 select(const Mask8& m, const Float8& a, const Float8& b)
+    {
+        Float8 r;
+        for(int i = 0; i < 8; ++i)
+            r.v[i] = m.m[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+#endif
+
+    // 与 Float8 同名的标量版本，模板中的运算对两种类型写法相同
+    inline float min(float a, float b) { return std::min(a, b); }
+    inline float max(float a, float b) { return std::max(a, b); }
+    inline float abs(float a) { return std::fabs(a); }
+    inline float select(bool m, float a, float b) { return m ? a : b; }
+
+    // 舍入到最近时 |x| * 2^-23 不小于 x 处的一个 ulp，FLT_MIN 兜住 0 和非规格化数（FTZ 打开时也成立）
+    template<class T> T roundingError(const T& x) { return max(abs(x) * (1.0f / 8388608.0f), T(FLT_MIN)); }
+    template<class T> T roundUp(const T& x) { return x + roundingError(x); }
+    template<class T> T roundDown(const T& x) { return x - roundingError(x); }
+    // 两个非负数的和、积的上界
+    template<class T> T addUp(const T& a, const T& b) { return roundUp(a + b); }
+    template<class T> T mulUp(const T& a, const T& b) { return roundUp(a * b); }
+
+    // [lo, hi]
+    template<class T> struct Interval
+    {
+        T lo, hi;
+
+        Interval() {}
+        Interval(const T& v) : lo(v), hi(v) {}
+        Interval(const T& lo, const T& hi) : lo(lo), hi(hi) {}
+    };
+
+    // x + y * ε + z * [-1, 1]，ε ∈ [-1, 1] 是所有变量共享的噪声符号，z >= 0
+    template<class T> struct Affine
+    {
+        T x, y, z;
+
+        Affine() {}
+        Affine(const T& v) : x(v), y(0.0f), z(0.0f) {}
+        Affine(const T& x, const T& y, const T& z) : x(x), y(y), z(z) {}
+    };
+
+    // ---------------- 区间算术，对应 raa.glsl 的 *_ia ----------------
+
+    // 带常数的运算中 C 为 float 或与 T 相同，Float8 时可以每个通道一个常数
+    template<class T, class C> Interval<T> add(const Interval<T>& a, const C& c) { return { roundDown(a.lo + c), roundUp(a.hi + c) }; }
+    template<class T> Interval<T> add(const Interval<T>& a, const Interval<T>& b) { return { roundDown(a.lo + b.lo), roundUp(a.hi + b.hi) }; }
+    template<class T> Interval<T> sub(const Interval<T>& a, const Interval<T>& b) { return { roundDown(a.lo - b.hi), roundUp(a.hi - b.lo) }; }
+
+    template<class T, class C> Interval<T> mul(const Interval<T>& a, const C& c)
+    {
+        T p0 = a.lo * c, p1 = a.hi * c;
+        return { roundDown(min(p0, p1)), roundUp(max(p0, p1)) };
+    }
+
+    template<class T> Interval<T> mul(const Interval<T>& a, const Interval<T>& b)
+    {
+        T p0 = a.lo * b.lo, p1 = a.lo * b.hi, p2 = a.hi * b.lo, p3 = a.hi * b.hi;
+        return { roundDown(min(min(p0, p1), min(p2, p3))), roundUp(max(max(p0, p1), max(p2, p3))) };
+    }
+
+    template<class T> Interval<T> sqr(const Interval<T>& a)
+    {
+        T s0 = a.lo * a.lo, s1 = a.hi * a.hi;
+        T hi = roundUp(max(s0, s1));
+        T lo = select((a.lo <= T(0.0f)) & (T(0.0f) <= a.hi), T(0.0f), roundDown(min(s0, s1)));
+        return { lo, hi };
+    }
+
+    // ---------------- 约化仿射算术，对应 raa.glsl 中不带后缀的运算 ----------------
+
+    // IAtoRAA
+    template<class T> Affine<T> toAffine(const Interval<T>& a)
+    {
+        T x = (a.lo + a.hi) * 0.5f;
+        T y = (a.hi - a.lo) * 0.5f;
+        return { x, y, addUp(roundingError(x), roundingError(y)) };
+    }
+
+    // raa_radius
+    template<class T> T radius(const Affine<T>& a) { return addUp(abs(a.y), a.z); }
+
+    template<class T> Interval<T> toInterval(const Affine<T>& a)
+    {
+        T r = radius(a);
+        return { roundDown(a.x - r), roundUp(a.x + r) };
+    }
+
+    template<class T, class C> Affine<T> add(const Affine<T>& a, const C& c)
+    {
+        T x = a.x + c;
+        return { x, a.y, addUp(a.z, roundingError(x)) };
+    }
+
+    template<class T, class C> Affine<T> mul(const Affine<T>& a, const C& c)
+    {
+        T x = a.x * c, y = a.y * c;
+        return { x, y, addUp(mulUp(a.z, T(abs(c))), addUp(roundingError(x), roundingError(y))) };
+    }
+
+    template<class T> Affine<T> add(const Affine<T>& a, const Affine<T>& b)
+    {
+        T x = a.x + b.x, y = a.y + b.y;
+        return { x, y, addUp(addUp(a.z, b.z), addUp(roundingError(x), roundingError(y))) };
+    }
+
+    template<class T> Affine<T> sub(const Affine<T>& a, const Affine<T>& b)
+    {
+        T x = a.x - b.x, y = a.y - b.y;
+        return { x, y, addUp(addUp(a.z, b.z), addUp(roundingError(x), roundingError(y))) };
+    }
+
+    template<class T> Affine<T> mul(const Affine<T>& a, const Affine<T>& b)
+    {
+        T x = a.x * b.x;
+        T p = a.x * b.y, q = a.y * b.x;
+        T y = p + q;
+        T error = addUp(roundingError(x), addUp(addUp(roundingError(p), roundingError(q)), roundingError(y)));
+        T z = addUp(mulUp(abs(a.x), b.z), mulUp(abs(b.x), a.z));
+        z = addUp(z, mulUp(addUp(abs(a.y), a.z), addUp(abs(b.y), b.z)));
+        return { x, y, addUp(z, error) };
+    }
+
+    // ε^2 ∈ [0, 1] 写成 0.5 + 0.5 * [-1, 1]，与 sqr_raa 相同
+    template<class T> Affine<T> sqr(const Affine<T>& a)
+    {
+        T xx = a.x * a.x, half_yy = a.y * a.y * 0.5f;
+        T x = xx + half_yy;
+        T y = a.x * a.y * 2.0f;
+        T error = addUp(addUp(roundingError(xx), roundingError(half_yy)), addUp(roundingError(x), roundingError(y)));
+        T z = addUp(roundUp(half_yy), mulUp(addUp(abs(a.x), abs(a.y)), a.z * 2.0f));
+        z = addUp(z, mulUp(a.z, a.z));
+        return { x, y, addUp(z, error) };
+    }
+}
@@ -0,0 +1,304 @@
+#include "ray_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+const char* RayStats::metricName(int metric)
+{
+    const char* names[HEATMAP_COUNT] = { "off", "bounces", "shadow", "boxes", "primitives", "iterations", "steps" };
+    return metric >= 0 && metric < HEATMAP_COUNT ? names[metric] : "off";
+}
+
+int RayStats::metricByName(const std::string& name)
+{
+    for(int i = 0; i < HEATMAP_COUNT; ++i)
+    {
+        if(name == metricName(i))
+            return i;
+    }
+    return HEATMAP_OFF;
+}
+
+RayStats::~RayStats()
+{
+    if(!enabled())
+        return;
+    glDeleteTextures(2, textures_);
+    glDeleteTextures(2, block_textures_);
+    glDeleteFramebuffers(1, &fbo_);
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(LATENCY, pbos_);
+    for(GLsync fence : fences_)
+    {
+        if(fence)
+            glDeleteSync(fence);
+    }
+}
+
+void RayStats::init(unsigned int width, unsigned int height)
+{
+    if(enabled())
+        return;
+    columns_ = (width + BLOCK - 1) / BLOCK;
+    rows_ = (height + BLOCK - 1) / BLOCK;
+
+    auto create = [](unsigned int w, unsigned int h)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, w, h, 0, GL_RGBA, GL_FLOAT, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    };
+    for(int i = 0; i < 2; ++i)
+    {
+        textures_[i] = create(width, height);
+        block_textures_[i] = create(columns_, rows_);
+    }
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, block_textures_[0], 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, block_textures_[1], 0);
+    const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, draw_buffers);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::RAY_STATS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glGenVertexArrays(1, &vao_);
+
+    glGenBuffers(LATENCY, pbos_);
+    for(GLuint pbo : pbos_)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)columns_ * rows_ * 8 * sizeof(float), NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    reduce_shader_.init("../../../../src/shader/fullscreen_vs.glsl", "../../../../src/shader/ray_stats_fs.glsl");
+}
+
+void RayStats::attach(GLuint fbo)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, textures_[0], 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT5, GL_TEXTURE_2D, textures_[1], 0);
+    const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3,
+        GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5 };
+    glDrawBuffers(6, draw_buffers);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RayStats::clear()
+{
+    const GLfloat zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 4, zero);
+    glClearBufferfv(GL_COLOR, 5, zero);
+}
+
+void RayStats::reduce()
+{
+    // 所有缓冲都还在等待读回时这一帧不统计
+    if(fences_[next_])
+        return;
+
+    GLint vao = 0, viewport[4];
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glViewport(0, 0, columns_, rows_);
+    for(int i = 0; i < 2; ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, textures_[i]);
+    }
+    reduce_shader_.bind();
+    reduce_shader_.setInt("rayStatsTex", 0);
+    reduce_shader_.setInt("primitiveStatsTex", 1);
+    glBindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(vao);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    // 读到像素缓冲对象里立即返回，两张结果前后相接
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[next_]);
+    for(int i = 0; i < 2; ++i)
+    {
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glReadPixels(0, 0, columns_, rows_, GL_RGBA, GL_FLOAT, (void*)((size_t)i * columns_ * rows_ * 4 * sizeof(float)));
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    fences_[next_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next_ = (next_ + 1) % LATENCY;
+}
+
+void RayStats::poll()
+{
+    for(int k = 0; k < LATENCY; ++k)
+    {
+        int i = (next_ + k) % LATENCY;     // 从最早的开始
+        if(!fences_[i])
+            continue;
+        GLenum status = glClientWaitSync(fences_[i], 0, 0);
+        if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+        glDeleteSync(fences_[i]);
+        fences_[i] = 0;
+
+        size_t count = (size_t)columns_ * rows_ * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[i]);
+        const float* data = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * 2 * sizeof(float), GL_MAP_READ_BIT);
+        if(data)
+        {
+            Counters c;
+            for(size_t j = 0; j < count; j += 4)
+            {
+                c.primary += data[j];
+                c.bounce += data[j + 1];
+                c.shadow += data[j + 2];
+                c.box += data[j + 3];
+                c.primitive += data[count + j];
+                c.iterations += data[count + j + 1];
+                c.steps += data[count + j + 2];
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            history_.push_back(c);
+            if(history_.size() > WINDOW)
+                history_.pop_front();
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+void RayStats::clearHistory()
+{
+    for(GLsync& fence : fences_)
+    {
+        if(fence)
+            glDeleteSync(fence);
+        fence = 0;
+    }
+    history_.clear();
+}
+
+RayStats::Counters RayStats::average() const
+{
+    Counters sum;
+    for(const Counters& c : history_)
+    {
+        sum.primary += c.primary;
+        sum.bounce += c.bounce;
+        sum.shadow += c.shadow;
+        sum.box += c.box;
+        sum.primitive += c.primitive;
+        sum.iterations += c.iterations;
+        sum.steps += c.steps;
+    }
+    double n = history_.empty() ? 1.0 : (double)history_.size();
+    sum.primary /= n;
+    sum.bounce /= n;
+    sum.shadow /= n;
+    sum.box /= n;
+    sum.primitive /= n;
+    sum.iterations /= n;
+    sum.steps /= n;
+    return sum;
+}
+
+std::string RayStats::summary(double trace_ms) const
+{
+    Counters c = average();
+    double rays = c.rays();
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%.2f Mrays/s, %.2f M rays/frame (primary %.2f, bounce %.2f, shadow %.2f), %.1f boxes/ray, %.1f primitives/ray",
+        trace_ms > 0.0 ? rays / (trace_ms * 1e3) : 0.0, rays * 1e-6, c.primary * 1e-6, c.bounce * 1e-6, c.shadow * 1e-6,
+        rays > 0.0 ? c.box / rays : 0.0, rays > 0.0 ? c.primitive / rays : 0.0);
+    std::string result = buffer;
+    if(c.iterations > 0.0 && rays > 0.0)
+    {
+        snprintf(buffer, sizeof(buffer), ", %.1f root iterations/ray, %.1f march steps/ray", c.iterations / rays, c.steps / rays);
+        result += buffer;
+    }
+    return result;
+}
+
+double RayStats::metricAverage(int metric) const
+{
+    Counters c = average();
+    const double values[HEATMAP_COUNT] = { 0.0, c.bounce, c.shadow, c.box, c.primitive, c.iterations, c.steps };
+    if(metric <= HEATMAP_OFF || metric >= HEATMAP_COUNT || c.primary <= 0.0)
+        return 0.0;
+    return values[metric] / c.primary;
+}
+
+void RayStats::bindHeatmap(Shader& shader, GLuint first_unit, int metric) const
+{
+    shader.bind();
+    shader.setInt("heatmap", enabled() ? metric : HEATMAP_OFF);
+    if(!enabled() || metric == HEATMAP_OFF)
+        return;
+    for(int i = 0; i < 2; ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + first_unit + i);
+        glBindTexture(GL_TEXTURE_2D, textures_[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    shader.setInt("heatmapRayTex", first_unit);
+    shader.setInt("heatmapPrimitiveTex", first_unit + 1);
+    // 平均值显示在色带的中间，还没有读回结果的前几帧固定按 16 显示
+    double mean = metricAverage(metric);
+    shader.setFloat("heatmap_scale", mean > 0.0 ? (float)(2.0 * mean) : 16.0f);
+}
+
+bool RayStats::writeHeatmap(const std::string& path, int metric, double* mean, double* max) const
+{
+    if(!enabled() || metric <= HEATMAP_OFF || metric >= HEATMAP_COUNT)
+        return false;
+    GLint width = 0, height = 0;
+    glBindTexture(GL_TEXTURE_2D, textures_[0]);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    std::vector<float> rays((size_t)width * height * 4), primitives(rays.size());
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, rays.data());
+    glBindTexture(GL_TEXTURE_2D, textures_[1]);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, primitives.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // 纹理的行从下往上，与 PFM 的扫描线顺序相同
+    std::vector<float> values((size_t)width * height);
+    double sum = 0.0, largest = 0.0;
+    size_t counted = 0;
+    for(size_t i = 0; i < values.size(); ++i)
+    {
+        float primary = rays[i * 4];
+        float count = metric <= HEATMAP_BOXES ? rays[i * 4 + metric] : primitives[i * 4 + metric - HEATMAP_PRIMITIVES];
+        values[i] = primary > 0.0f ? count / primary : 0.0f;
+        if(primary > 0.0f)
+        {
+            sum += values[i];
+            largest = std::max(largest, (double)values[i]);
+            ++counted;
+        }
+    }
+    if(mean)
+        *mean = counted ? sum / counted : 0.0;
+    if(max)
+        *max = largest;
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        std::cout << "ERROR::RAY_STATS::FILE_NOT_WRITABLE: " << path << std::endl;
+        return false;
+    }
+    fprintf(file, "Pf\n%d %d\n-1.0\n", width, height);  // scale 为负表示小端序
+    fwrite(values.data(), sizeof(float), values.size(), file);
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <glad/glad.h>
+#include "shader.h"
+
+// 每帧光线数和求交测试数的统计，积分器需要用 "#define RAY_STATS\n" 编译，见 ray_stats.glsl
+// GL 3.3 没有原子计数器，积分器把每个像素的计数写到两张额外的纹理上，这里按 BLOCK x BLOCK 的块求和后
+// 用 LATENCY 个像素缓冲对象轮流异步读回，栅栏信号到达后才映射，不等待 GPU
+class RayStats
+{
+public:
+    static const int BLOCK = 8;         // 与 ray_stats_fs.glsl 中的 RAY_STATS_BLOCK 一致
+    static const int LATENCY = 4;
+    static const int WINDOW = 64;       // 滚动平均的帧数
+
+    // 热度图显示的量，都按每个像素本帧的主光线数平均，与 output_fs.glsl 中的 heatmap 对应
+    enum Metric
+    {
+        HEATMAP_OFF = 0,
+        HEATMAP_BOUNCES,        // 反弹光线，即路径长度
+        HEATMAP_SHADOW,         // 阴影光线
+        HEATMAP_BOXES,          // BVH 包围盒测试
+        HEATMAP_PRIMITIVES,     // 图元求交测试
+        HEATMAP_ITERATIONS,     // 隐式曲面区间求根的迭代
+        HEATMAP_STEPS,          // 砖块距离场的追踪步数
+        HEATMAP_COUNT
+    };
+    static const char* metricName(int metric);
+    // 按名字查找，找不到时返回 HEATMAP_OFF
+    static int metricByName(const std::string& name);
+
+    // 一帧的计数
+    struct Counters
+    {
+        double primary = 0.0;
+        double bounce = 0.0;
+        double shadow = 0.0;
+        double box = 0.0;
+        double primitive = 0.0;
+        double iterations = 0.0;
+        double steps = 0.0;
+        double rays() const { return primary + bounce + shadow; }
+    };
+
+    ~RayStats();
+    void init(unsigned int width, unsigned int height);
+    bool enabled() const { return fbo_ != 0; }
+    // 两张计数纹理挂到 fbo 的第 4、5 个颜色附件上，fbo 的前四个附件为 accumulate.glsl 的输出
+    void attach(GLuint fbo);
+    // 在已绑定的 fbo 上把计数清零，路径追踪之前调用，被模板跳过的像素计为 0
+    void clear();
+    // 路径追踪之后调用，求和并开始异步读回
+    void reduce();
+    // 每帧调用，取回已经完成的读回
+    void poll();
+    // 最近 WINDOW 帧平均每帧的计数
+    Counters average() const;
+    // 丢弃已有的计数和还没有读回的结果，之后只统计新的帧
+    void clearHistory();
+    // 一行的摘要，trace_ms 为路径追踪的 pass 每帧的 GPU 耗时
+    std::string summary(double trace_ms) const;
+    // 最近 WINDOW 帧中 metric 每条主光线的平均值
+    double metricAverage(int metric) const;
+    // 绑定逐像素的两张计数纹理到 first_unit 开始的两个纹理单元，并设置 output_fs.glsl 的热度图参数
+    void bindHeatmap(Shader& shader, GLuint first_unit, int metric) const;
+    // 最近一帧 metric 每个像素每条主光线的值写成单通道的 PFM，会等待 GPU 完成；mean、max 返回有主光线的像素的平均值和最大值
+    bool writeHeatmap(const std::string& path, int metric, double* mean = nullptr, double* max = nullptr) const;
+
+private:
+    unsigned int columns_ = 0, rows_ = 0;
+    GLuint textures_[2] = {};           // 逐像素的计数
+    GLuint block_textures_[2] = {};     // 按块求和的结果
+    GLuint fbo_ = 0;
+    GLuint vao_ = 0;
+    GLuint pbos_[LATENCY] = {};
+    GLsync fences_[LATENCY] = {};
+    int next_ = 0;
+    Shader reduce_shader_;
+    std::deque<Counters> history_;
+};
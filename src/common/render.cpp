@@ -1,6 +1,8 @@
 #include "render.h"
 #include "../config.h"
 
+#include <algorithm>
+
 Render::Render(unsigned int width, unsigned int height) : width_(width), height_(height)
 {
     // 配置vao
@@ -33,63 +35,480 @@ Render::Render(unsigned int width, unsigned int height) : width_(width), height_
 
     glBindBuffer(GL_ARRAY_BUFFER, 0); 
 
-    // 配置fbo
-    glGenFramebuffers(1, &path_fbo_);
-    glGenFramebuffers(1, &temp_fbo_);
+    // 配置fbo，路径追踪的结果、二阶矩和第一个交点的法线、反照率同时写入四个颜色附件
+    path_fbo_ = createFeatureFramebuffer(path_texture_, path_moment_texture_, path_normal_texture_, path_albedo_texture_);
+    glGenRenderbuffers(1, &stencil_rbo_);
+    glBindRenderbuffer(GL_RENDERBUFFER, stencil_rbo_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, stencil_rbo_);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);   // 纹理初始内容未定义，必须清零
 
-    glBindFramebuffer(GL_FRAMEBUFFER, path_fbo_);
-    glGenTextures(1, &path_texture_);
-    glBindTexture(GL_TEXTURE_2D, path_texture_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, path_texture_, 0);
-    
-    glBindFramebuffer(GL_FRAMEBUFFER, temp_fbo_);
-    glGenTextures(1, &temp_texture_);
-    glBindTexture(GL_TEXTURE_2D, temp_texture_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, temp_texture_, 0);
+    temp_fbo_ = createFeatureFramebuffer(temp_texture_, temp_moment_texture_, temp_normal_texture_, temp_albedo_texture_);
+    glClear(GL_COLOR_BUFFER_BIT);
+    history_fbo_ = createFeatureFramebuffer(history_texture_, history_moment_texture_, history_normal_texture_, history_albedo_texture_);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glGenFramebuffers(2, denoise_fbo_);
+    for(int i = 0; i < 2; ++i)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, denoise_fbo_[i]);
+        denoise_texture_[i] = createTexture();
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, denoise_texture_[i], 0);
+    }
     
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    glGenQueries(1, &converged_query_);
+
     output_shader_.init("../../../../src/shader/vs.glsl", "../../../../src/shader/output_fs.glsl");
+    output_shader_.bind();
+    output_shader_.setFloat("tone_map_limit", TONE_MAP_LIMIT);
+    output_shader_.setFloat("display_gamma", DISPLAY_GAMMA);
     temp_shader_.init("../../../../src/shader/vs.glsl", "../../../../src/shader/temp_fs.glsl");
+    converge_shader_.init("../../../../src/shader/vs.glsl", "../../../../src/shader/converge_fs.glsl");
+    atrous_shader_.init("../../../../src/shader/vs.glsl", "../../../../src/shader/atrous_fs.glsl");
+    reproject_shader_.init("../../../../src/shader/vs.glsl", "../../../../src/shader/reproject_fs.glsl");
 }
 
 Render::~Render()
 {
     glDeleteFramebuffers(1, &path_fbo_);
     glDeleteFramebuffers(1, &temp_fbo_);
+    glDeleteFramebuffers(1, &history_fbo_);
+    glDeleteFramebuffers(2, denoise_fbo_);
+    GLuint textures[] = { path_texture_, temp_texture_, path_moment_texture_, temp_moment_texture_,
+        path_normal_texture_, temp_normal_texture_, path_albedo_texture_, temp_albedo_texture_, denoise_texture_[0], denoise_texture_[1],
+        history_texture_, history_moment_texture_, history_normal_texture_, history_albedo_texture_ };
+    glDeleteTextures(14, textures);
+    glDeleteRenderbuffers(1, &stencil_rbo_);
+    glDeleteQueries(1, &converged_query_);
+    if(restir_enabled_)
+    {
+        glDeleteFramebuffers(1, &restir_initial_fbo_);
+        glDeleteFramebuffers(1, &restir_spatial_fbo_);
+        GLuint restir_textures[] = { reservoir_sample_texture_[0], reservoir_sample_texture_[1],
+            reservoir_weight_texture_[0], reservoir_weight_texture_[1], g_position_texture_, g_normal_texture_ };
+        glDeleteTextures(6, restir_textures);
+    }
+}
+
+GLuint Render::createTexture()
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width_, height_, 0, GL_RGBA, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// 新建一个帧缓冲并绑定，颜色、二阶矩、法线和反照率四个附件与 accumulate.glsl 的输出对应
+GLuint Render::createFeatureFramebuffer(GLuint& color, GLuint& moment, GLuint& normal, GLuint& albedo)
+{
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    color = createTexture();
+    moment = createTexture();
+    normal = createTexture();
+    albedo = createTexture();
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, moment, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, normal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, albedo, 0);
+    const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+    glDrawBuffers(4, draw_buffers);
+    return fbo;
+}
+
+void Render::readAccumulation(std::vector<float>& color, std::vector<float>& moment)
+{
+    color.resize(width_ * height_ * 4);
+    moment.resize(width_ * height_ * 4);
+    glBindTexture(GL_TEXTURE_2D, temp_texture_);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, color.data());
+    glBindTexture(GL_TEXTURE_2D, temp_moment_texture_);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, moment.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Render::loadAccumulation(const std::vector<float>& color, const std::vector<float>& moment,
+                              const std::vector<float>& normal, const std::vector<float>& albedo)
+{
+    const std::vector<float>* images[] = { &color, &moment, &normal, &albedo };
+    for(const std::vector<float>* image : images)
+    {
+        if(image->size() != (size_t)width_ * height_ * 4)
+        {
+            std::cout << "ERROR::RENDER::SIZE_MISMATCH: " << image->size() / 4 << " pixels" << std::endl;
+            return;
+        }
+    }
+    reset();
+    GLuint textures[] = { temp_texture_, temp_moment_texture_, temp_normal_texture_, temp_albedo_texture_ };
+    for(int i = 0; i < 4; ++i)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, GL_RGBA, GL_FLOAT, images[i]->data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Render::enableRayStats()
+{
+    ray_stats_.init(width_, height_);
+    ray_stats_.attach(path_fbo_);
+}
+
+void Render::setHeatmap(int metric)
+{
+    if(metric != RayStats::HEATMAP_OFF && !ray_stats_.enabled())
+    {
+        std::cout << "ERROR::RENDER::RAY_STATS_NOT_ENABLED: heatmap " << RayStats::metricName(metric) << std::endl;
+        return;
+    }
+    heatmap_ = std::min(std::max(metric, 0), RayStats::HEATMAP_COUNT - 1);
+}
+
+void Render::setDenoise(int iterations)
+{
+    denoise_iterations_ = std::max(0, iterations);
+}
+
+void Render::readDenoised(std::vector<float>& color)
+{
+    color.resize(width_ * height_ * 4);
+    glBindTexture(GL_TEXTURE_2D, denoise_iterations_ > 0 && denoised_texture_ ? denoised_texture_ : temp_texture_);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, color.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// 累积的颜色、二阶矩和 G-buffer 作为第一次的输入，之后两张纹理来回滤波，返回最后一次的输出
+GLuint Render::drawDenoise()
+{
+    glActiveTexture(GL_TEXTURE0 + UNIT_MOMENT);
+    glBindTexture(GL_TEXTURE_2D, temp_moment_texture_);
+    glActiveTexture(GL_TEXTURE0 + UNIT_FEATURES);
+    glBindTexture(GL_TEXTURE_2D, temp_normal_texture_);
+    glActiveTexture(GL_TEXTURE0 + UNIT_FEATURES + 1);
+    glBindTexture(GL_TEXTURE_2D, temp_albedo_texture_);
+    atrous_shader_.bind();
+    atrous_shader_.setInt("imgTex", UNIT_IMAGE);
+    atrous_shader_.setInt("momentTex", UNIT_MOMENT);
+    atrous_shader_.setInt("normalTex", UNIT_FEATURES);
+    atrous_shader_.setInt("albedoTex", UNIT_FEATURES + 1);
+
+    GLuint input = temp_texture_;
+    for(int i = 0; i < denoise_iterations_; ++i)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, denoise_fbo_[i % 2]);
+        glActiveTexture(GL_TEXTURE0 + UNIT_IMAGE);
+        glBindTexture(GL_TEXTURE_2D, input);
+        atrous_shader_.setInt("step_size", 1 << i);
+        atrous_shader_.setBool("first_pass", i == 0);
+        atrous_shader_.setBool("last_pass", i == denoise_iterations_ - 1);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        input = denoise_texture_[i % 2];
+    }
+    glActiveTexture(GL_TEXTURE0);
+    return input;
+}
+
+void Render::enableReSTIR(const std::string& fragment_path)
+{
+    if(restir_enabled_)
+        return;
+    restir_enabled_ = true;
+    restir_initial_shader_.init("../../../../src/shader/vs.glsl", fragment_path, "#define RESTIR_PASS 1\n");
+    restir_spatial_shader_.init("../../../../src/shader/vs.glsl", fragment_path, "#define RESTIR_PASS 2\n");
+    restir_shade_shader_.init("../../../../src/shader/vs.glsl", fragment_path, "#define RESTIR_PASS 3\n");
+
+    for(int i = 0; i < 2; ++i)
+    {
+        reservoir_sample_texture_[i] = createTexture();
+        reservoir_weight_texture_[i] = createTexture();
+    }
+    g_position_texture_ = createTexture();
+    g_normal_texture_ = createTexture();
+
+    glGenFramebuffers(1, &restir_initial_fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, restir_initial_fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reservoir_sample_texture_[0], 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, reservoir_weight_texture_[0], 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, g_position_texture_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, g_normal_texture_, 0);
+    const GLenum initial_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+    glDrawBuffers(4, initial_buffers);
+
+    glGenFramebuffers(1, &restir_spatial_fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, restir_spatial_fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reservoir_sample_texture_[1], 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, reservoir_weight_texture_[1], 0);
+    const GLenum spatial_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, spatial_buffers);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    reset();
+}
+
+void Render::setReSTIR(bool enable)
+{
+    if(enable && !restir_enabled_)
+    {
+        std::cout << "ERROR::RENDER::RESTIR_NOT_ENABLED" << std::endl;
+        return;
+    }
+    if(enable != restir_)
+    {
+        restir_ = enable;
+        reset();
+    }
+}
+
+void Render::reset()
+{
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    GLuint fbos[] = { path_fbo_, temp_fbo_, restir_initial_fbo_, restir_spatial_fbo_ };
+    for(GLuint fbo : fbos)
+    {
+        if(fbo == 0)
+            continue;
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    converged_pixels_ = 0;
+}
+
+// 移动前累积的结果交换到 history 留给 draw 中的重投影，连续调用时保留第一次的历史和相机
+void Render::reproject(const Camera& previous)
+{
+    if(!moved_)
+    {
+        std::swap(temp_fbo_, history_fbo_);
+        std::swap(temp_texture_, history_texture_);
+        std::swap(temp_moment_texture_, history_moment_texture_);
+        std::swap(temp_normal_texture_, history_normal_texture_);
+        std::swap(temp_albedo_texture_, history_albedo_texture_);
+        previous.bind(reproject_shader_, "previous_camera");
+        moved_ = true;
+    }
+    reset();
+}
+
+// 蓄水池和 G-buffer 绑定到 UNIT_RESTIR 开始的四个纹理单元
+void Render::bindReSTIR(Shader& shader, int reservoir)
+{
+    GLuint textures[] = { reservoir_sample_texture_[reservoir], reservoir_weight_texture_[reservoir], g_position_texture_, g_normal_texture_ };
+    const char* names[] = { "reservoirSampleTex", "reservoirWeightTex", "gPositionTex", "gNormalTex" };
+    shader.bind();
+    for(int i = 0; i < 4; ++i)
+    {
+        glActiveTexture(GL_TEXTURE0 + UNIT_RESTIR + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        shader.setInt(names[i], UNIT_RESTIR + i);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// 主着色器上设置的场景参数复制到各个pass，再依次做初始采样+时间复用、空间复用
+void Render::drawReSTIR(Shader& shader)
+{
+    restir_initial_shader_.copyUniformsFrom(shader);
+    restir_spatial_shader_.copyUniformsFrom(shader);
+    restir_shade_shader_.copyUniformsFrom(shader);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, restir_initial_fbo_);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+    {
+        bindReSTIR(restir_initial_shader_, 1);  // 上一帧空间复用的结果作为历史
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, restir_spatial_fbo_);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+    {
+        bindReSTIR(restir_spatial_shader_, 0);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
+
+    bindReSTIR(restir_shade_shader_, 1);
+}
+
+const std::vector<std::string>& Render::frameUniforms()
+{
+    static const std::vector<std::string> names = { "imgTex", "momentTex", "normalTex", "albedoTex",
+        "adaptive_threshold", "adaptive_min_samples", "adaptive_max_scale", "motion_spp" };
+    return names;
+}
+
+void Render::setAdaptive(float threshold, unsigned int min_samples)
+{
+    adaptive_threshold_ = threshold;
+    adaptive_min_samples_ = min_samples;
+}
+
+// 在 path_fbo_ 的模板缓冲中把已收敛的像素标记为1，同时用遮挡查询统计其数量
+void Render::markConverged()
+{
+    // 只在结果可用时读取上一次的查询，不等待GPU
+    if(query_pending_)
+    {
+        GLuint available = 0;
+        glGetQueryObjectuiv(converged_query_, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(available)
+        {
+            glGetQueryObjectuiv(converged_query_, GL_QUERY_RESULT, &converged_pixels_);
+            query_pending_ = false;
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, path_fbo_);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, 1, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    glActiveTexture(GL_TEXTURE0 + UNIT_MOMENT);
+    glBindTexture(GL_TEXTURE_2D, temp_moment_texture_);
+    glActiveTexture(GL_TEXTURE0 + UNIT_IMAGE);
+    glBindTexture(GL_TEXTURE_2D, temp_texture_);
+    converge_shader_.bind();
+    converge_shader_.setInt("imgTex", UNIT_IMAGE);
+    converge_shader_.setInt("momentTex", UNIT_MOMENT);
+    converge_shader_.setFloat("adaptive_threshold", adaptive_threshold_);
+    converge_shader_.setFloat("adaptive_min_samples", (float)adaptive_min_samples_);
+
+    bool begin_query = !query_pending_;
+    if(begin_query)
+        glBeginQuery(GL_SAMPLES_PASSED, converged_query_);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    if(begin_query)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        query_pending_ = true;
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDisable(GL_STENCIL_TEST);
 }
 
 void Render::draw(Shader& shader)
 {
+    // ReSTIR 每帧每像素只有一个样本，不做自适应采样；刚移动时累积的结果已清空，也不需要
+    bool adaptive = adaptive_threshold_ > 0.0f && !restir_ && !moved_;
+    if(adaptive)
+    {
+        timer_.begin("converge");
+        markConverged();
+        timer_.end();
+    }
+    if(restir_)
+    {
+        timer_.begin("restir");
+        drawReSTIR(shader);
+        timer_.end();
+    }
+    Shader& path_shader = restir_ ? restir_shade_shader_ : shader;
+
     glBindFramebuffer(GL_FRAMEBUFFER, path_fbo_);
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) // 检测帧缓冲是否完整
     {
+        if(ray_stats_.enabled())
+            ray_stats_.clear();
+        if(adaptive)    // 跳过模板为1的像素
+        {
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_EQUAL, 0, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        }
+        glActiveTexture(GL_TEXTURE0 + UNIT_FEATURES);
+        glBindTexture(GL_TEXTURE_2D, temp_normal_texture_);
+        glActiveTexture(GL_TEXTURE0 + UNIT_FEATURES + 1);
+        glBindTexture(GL_TEXTURE_2D, temp_albedo_texture_);
+        glActiveTexture(GL_TEXTURE0 + UNIT_MOMENT);
+        glBindTexture(GL_TEXTURE_2D, temp_moment_texture_);
+        glActiveTexture(GL_TEXTURE0 + UNIT_IMAGE);
         glBindTexture(GL_TEXTURE_2D, temp_texture_);
-        shader.bind();
+        path_shader.bind();
+        path_shader.setInt("imgTex", UNIT_IMAGE);
+        path_shader.setInt("momentTex", UNIT_MOMENT);
+        path_shader.setInt("normalTex", UNIT_FEATURES);
+        path_shader.setInt("albedoTex", UNIT_FEATURES + 1);
+        path_shader.setFloat("adaptive_threshold", adaptive ? adaptive_threshold_ : 0.0f);
+        path_shader.setFloat("adaptive_min_samples", (float)adaptive_min_samples_);
+        path_shader.setFloat("adaptive_max_scale", std::min(4.0f, 1.0f / std::max(1e-3f, 1.0f - convergedRatio())));
+        path_shader.setInt("motion_spp", moved_ ? MOTION_SPP : 0);
+        timer_.begin("trace");
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        timer_.end();
+        glDisable(GL_STENCIL_TEST);
+        if(ray_stats_.enabled() && !restir_)
+            ray_stats_.reduce();
     }
 
+    // 通常只是复制到 temp，移动后的这一帧改为与重投影的历史合并
     glBindFramebuffer(GL_FRAMEBUFFER, temp_fbo_);
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) // 检测帧缓冲是否完整
     {
+        glActiveTexture(GL_TEXTURE0 + UNIT_FEATURES);
+        glBindTexture(GL_TEXTURE_2D, path_normal_texture_);
+        glActiveTexture(GL_TEXTURE0 + UNIT_FEATURES + 1);
+        glBindTexture(GL_TEXTURE_2D, path_albedo_texture_);
+        glActiveTexture(GL_TEXTURE0 + UNIT_MOMENT);
+        glBindTexture(GL_TEXTURE_2D, path_moment_texture_);
+        glActiveTexture(GL_TEXTURE0 + UNIT_IMAGE);
         glBindTexture(GL_TEXTURE_2D, path_texture_);
-        temp_shader_.bind();
+        Shader& copy_shader = moved_ ? reproject_shader_ : temp_shader_;
+        if(moved_)
+        {
+            reproject_shader_.copyUniformsFrom(shader);
+            GLuint history[] = { history_texture_, history_moment_texture_, history_normal_texture_, history_albedo_texture_ };
+            const char* names[] = { "historyTex", "historyMomentTex", "historyNormalTex", "historyAlbedoTex" };
+            for(int i = 0; i < 4; ++i)
+            {
+                glActiveTexture(GL_TEXTURE0 + UNIT_HISTORY + i);
+                glBindTexture(GL_TEXTURE_2D, history[i]);
+                reproject_shader_.setInt(names[i], UNIT_HISTORY + i);
+            }
+            glActiveTexture(GL_TEXTURE0);
+            moved_ = false;
+        }
+        copy_shader.bind();
+        copy_shader.setInt("imgTex", UNIT_IMAGE);
+        copy_shader.setInt("momentTex", UNIT_MOMENT);
+        copy_shader.setInt("normalTex", UNIT_FEATURES);
+        copy_shader.setInt("albedoTex", UNIT_FEATURES + 1);
+        timer_.begin("resolve");
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        timer_.end();
+    }
+
+    GLuint output = temp_texture_;
+    if(denoise_iterations_ > 0)
+    {
+        timer_.begin("denoise");
+        output = denoised_texture_ = drawDenoise();
+        timer_.end();
     }
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) // 检测帧缓冲是否完整
     {
-        glBindTexture(GL_TEXTURE_2D, path_texture_);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, output);
+        ray_stats_.bindHeatmap(output_shader_, UNIT_HEATMAP, heatmap_);
         output_shader_.bind();
+        timer_.begin("display");
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        timer_.end();
     }
+    timer_.frame();
+    if(ray_stats_.enabled())
+        ray_stats_.poll();
 }
\ No newline at end of file
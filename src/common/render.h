@@ -2,6 +2,11 @@
 
 #include <glad/glad.h>
 #include "shader.h"
+#include "camera.h"
+#include "gpu_timer.h"
+#include "ray_stats.h"
+
+#include <vector>
 
 class Render
 {
@@ -10,17 +15,119 @@ private:
     GLuint temp_fbo_ = 0;
     GLuint path_texture_ = 0;
     GLuint temp_texture_ = 0;
+    GLuint path_moment_texture_ = 0;    // x: 亮度平方的均值, y: 样本数
+    GLuint temp_moment_texture_ = 0;
+    GLuint path_normal_texture_ = 0;    // 第一个交点的法线和距离，见 accumulate.glsl
+    GLuint temp_normal_texture_ = 0;
+    GLuint path_albedo_texture_ = 0;    // 第一个交点的反照率
+    GLuint temp_albedo_texture_ = 0;
+    GLuint stencil_rbo_ = 0;            // 标记已收敛的像素
+    GLuint converged_query_ = 0;
     GLuint VAO_ = 0;
     GLuint VBO_ = 0;
     GLuint EBO_ = 0;
     unsigned int width_;
     unsigned int height_;
 
+    // 自适应采样，threshold 为 0 时关闭
+    float adaptive_threshold_ = 0.0f;
+    unsigned int adaptive_min_samples_ = 64;
+    bool query_pending_ = false;
+    unsigned int converged_pixels_ = 0;
+
+    GpuTimer timer_;
+    RayStats ray_stats_;
+
     Shader output_shader_;
     Shader temp_shader_;
+    Shader converge_shader_;
+
+    // à-trous 降噪，两张纹理轮流作为输入和输出，iterations 为 0 时关闭
+    int denoise_iterations_ = 0;
+    int heatmap_ = RayStats::HEATMAP_OFF;
+    GLuint denoise_fbo_[2] = {};
+    GLuint denoise_texture_[2] = {};
+    GLuint denoised_texture_ = 0;       // 最近一次降噪的结果
+    Shader atrous_shader_;
+
+    // 相机移动后的重投影，history 与 temp 的结构相同，移动时两者交换，见 reproject_fs.glsl
+    bool moved_ = false;                // reproject 之后还没有 draw
+    GLuint history_fbo_ = 0;
+    GLuint history_texture_ = 0;
+    GLuint history_moment_texture_ = 0;
+    GLuint history_normal_texture_ = 0;
+    GLuint history_albedo_texture_ = 0;
+    Shader reproject_shader_;
+
+    // ReSTIR DI，第一个pass输出初始蓄水池和 G-buffer，第二个pass做空间复用，其结果作为下一帧的历史
+    bool restir_enabled_ = false;
+    bool restir_ = false;
+    GLuint restir_initial_fbo_ = 0;
+    GLuint restir_spatial_fbo_ = 0;
+    GLuint reservoir_sample_texture_[2] = {};   // 0: 初始+时间复用, 1: 空间复用
+    GLuint reservoir_weight_texture_[2] = {};
+    GLuint g_position_texture_ = 0;
+    GLuint g_normal_texture_ = 0;
+    Shader restir_initial_shader_;
+    Shader restir_spatial_shader_;
+    Shader restir_shade_shader_;
+
+    GLuint createTexture();
+    void markConverged();
+    GLuint createFeatureFramebuffer(GLuint& color, GLuint& moment, GLuint& normal, GLuint& albedo);
+    void bindReSTIR(Shader& shader, int reservoir);
+    void drawReSTIR(Shader& shader);
+    GLuint drawDenoise();
 
 public:
+    static const int MOTION_SPP = 1;    // 相机移动的那一帧每个像素的样本数，保证交互时的帧率
+
     Render(unsigned int width, unsigned int height);
     ~Render();
     void draw(Shader& shader);
-};
\ No newline at end of file
+    // 像素亮度的相对标准误差低于 threshold 且至少有 min_samples 个样本后不再追踪
+    void setAdaptive(float threshold, unsigned int min_samples);
+    // 用 fragment_path 编译 ReSTIR 的三个pass，积分器需要 #include "restir.glsl"，见 disney_fs.glsl
+    void enableReSTIR(const std::string& fragment_path);
+    // 开启后 draw 中的路径追踪换成 ReSTIR 的直接光照，切换时清空累积的结果
+    void setReSTIR(bool enable);
+    bool restir() const { return restir_; }
+    // draw 每帧在路径追踪的着色器上设置的 uniform，不是场景的参数，计算场景的哈希时忽略
+    static const std::vector<std::string>& frameUniforms();
+    // 清空累积的图像、二阶矩和蓄水池
+    void reset();
+    // 相机移动后、下一次 draw 之前调用，previous 为移动前的相机；与 reset 一样清空累积的结果，
+    // 但下一次 draw 只追踪 MOTION_SPP 个样本，再把移动前的结果重投影过来合并，不会闪回噪声很大的图像
+    void reproject(const Camera& previous);
+    // 已收敛像素的比例，由遮挡查询异步得到，会延迟一帧
+    float convergedRatio() const { return (float)converged_pixels_ / (width_ * height_); }
+    // 累积的图像、二阶矩和第一个交点的法线、反照率，draw 之后有效，下一次 draw 会覆盖；需要异步读回时使用，见 ConvergenceTracker
+    GLuint accumulationTexture() const { return temp_texture_; }
+    GLuint momentTexture() const { return temp_moment_texture_; }
+    GLuint normalTexture() const { return temp_normal_texture_; }
+    GLuint albedoTexture() const { return temp_albedo_texture_; }
+    // 读回累积的图像和二阶矩，每个像素4个float，会等待GPU完成
+    void readAccumulation(std::vector<float>& color, std::vector<float>& moment);
+    // 用之前读回的四张图像代替累积的结果，下一次 draw 从这里继续累积，用于从检查点恢复，见 Checkpoint
+    void loadAccumulation(const std::vector<float>& color, const std::vector<float>& moment,
+                          const std::vector<float>& normal, const std::vector<float>& albedo);
+    // 显示前对累积的图像做 iterations 次 à-trous 滤波，0 为关闭，见 atrous_fs.glsl；累积的结果本身不变
+    void setDenoise(int iterations);
+    int denoiseIterations() const { return denoise_iterations_; }
+    // draw 中各个 pass 的 GPU 耗时：converge、restir、trace、resolve、denoise、display，调用者也可以用它给自己的 pass 计时
+    GpuTimer& timer() { return timer_; }
+    // 统计路径追踪的 pass 每帧的光线数和求交测试数，传给 draw 的积分器需要用 "#define RAY_STATS\n" 编译，
+    // ReSTIR 的 pass 不计数，见 ray_stats.glsl
+    void enableRayStats();
+    bool rayStatsEnabled() const { return ray_stats_.enabled(); }
+    RayStats& rayStats() { return ray_stats_; }
+    // Mrays/s 和每条光线的平均测试数，按 trace pass 的 GPU 耗时计算
+    std::string rayStatsSummary() const { return ray_stats_.summary(timer_.average("trace")); }
+    // 显示最近一帧的逐像素开销热度图代替图像，metric 见 RayStats::Metric，HEATMAP_OFF 为关闭；需要先 enableRayStats
+    void setHeatmap(int metric);
+    int heatmap() const { return heatmap_; }
+    // 把当前热度图的量写成 PFM，见 RayStats::writeHeatmap
+    bool writeHeatmap(const std::string& path, double* mean = nullptr, double* max = nullptr) const { return ray_stats_.writeHeatmap(path, heatmap_, mean, max); }
+    // 读回最近一帧降噪后的图像，没有开启降噪时与 readAccumulation 的颜色相同
+    void readDenoised(std::vector<float>& color);
+};
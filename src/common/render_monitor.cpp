@@ -0,0 +1,103 @@
+#include "render_monitor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+bool RenderMonitor::parseOption(int argc, char** argv, int& i)
+{
+    std::string option = argv[i];
+    if(option == "--reference" && i + 1 < argc)
+        reference_path_ = argv[++i];
+    else if(option == "--convergence-log" && i + 1 < argc)
+        convergence_log_ = argv[++i];
+    else if(option == "--snapshot" && i + 1 < argc)
+        snapshot_path_ = argv[++i];
+    else if(option == "--snapshot-every" && i + 1 < argc)
+        snapshot_interval_ = std::max(1, atoi(argv[++i]));
+    else if(option == "--stop-at" && i + 2 < argc)
+    {
+        stop_metric_ = ConvergenceTracker::metricByName(argv[++i]);
+        stop_threshold_ = atof(argv[++i]);
+        if(stop_metric_ < 0)
+        {
+            std::cout << "ERROR::MONITOR::UNKNOWN_METRIC: " << argv[i - 1] << std::endl;
+            stop_metric_ = ConvergenceTracker::FLIP;
+            stop_threshold_ = 0.0;
+        }
+    }
+    else
+        return false;
+    return true;
+}
+
+void RenderMonitor::init(unsigned int width, unsigned int height, unsigned int frame)
+{
+    frame_ = frame;
+    if(!reference_path_.empty() && convergence_.init(reference_path_, width, height))
+    {
+        convergence_.setStop(stop_metric_, stop_threshold_);
+        if(!convergence_log_.empty())
+            convergence_.setLog(convergence_log_);
+    }
+    if(!snapshot_path_.empty())
+        snapshot_.init(snapshot_path_, width, height);
+}
+
+void RenderMonitor::reset()
+{
+    convergence_.reset();
+    accumulated_ = 0;
+    stopped_ = false;
+}
+
+bool RenderMonitor::update(const Render& render, double seconds)
+{
+    ++frame_;
+    ++accumulated_;
+    if(convergence_.enabled())
+    {
+        if(accumulated_ % CONVERGENCE_INTERVAL == 0)
+            convergence_.submit(render.accumulationTexture(), render.momentTexture(), seconds);
+        convergence_.poll();
+        ConvergenceTracker::Sample error;
+        if(!stopped_ && convergence_.converged() && convergence_.last(error))
+        {
+            printf("converged: %s %.4g after %.1f s, %.0f spp\n", ConvergenceTracker::metricName(stop_metric_),
+                error.errors[stop_metric_], error.seconds, error.spp);
+            stopped_ = true;
+        }
+    }
+    if(snapshot_.enabled())
+    {
+        if(frame_ % snapshot_interval_ == 0)
+            snapshot_.submit(render.accumulationTexture(), frame_);
+        snapshot_.poll();
+    }
+    return stopped_;
+}
+
+void RenderMonitor::finish(const Render& render)
+{
+    if(!snapshot_.enabled())
+        return;
+    if(frame_ % snapshot_interval_ != 0)
+    {
+        snapshot_.flush();      // 空出一个缓冲，最后一帧不会被跳过
+        snapshot_.submit(render.accumulationTexture(), frame_);
+    }
+    snapshot_.flush();
+    printf("snapshots: %u written, %u dropped\n", snapshot_.written(), snapshot_.dropped());
+}
+
+std::string RenderMonitor::summary() const
+{
+    ConvergenceTracker::Sample error;
+    if(!convergence_.last(error))
+        return "";
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "%.0f spp: RMSE %.4f, relMSE %.4f, FLIP %.4f", error.spp,
+        error.errors[ConvergenceTracker::RMSE], error.errors[ConvergenceTracker::REL_MSE], error.errors[ConvergenceTracker::FLIP]);
+    return buffer;
+}
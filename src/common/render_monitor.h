@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include "convergence_tracker.h"
+#include "frame_writer.h"
+#include "render.h"
+
+// base.cpp 和 disney.cpp 共用的监视长时间渲染的选项，以及每帧驱动 ConvergenceTracker 和 FrameWriter 的部分
+//   --reference <file>: 定期与参考图（.pfm 或不压缩的 .exr）比较，在后台计算 RMSE、relMSE 和 FLIP，显示在标题栏
+//   --stop-at <metric> <value>: metric（rmse、relmse、flip）不超过 value 时退出，需要 --reference
+//   --convergence-log <file>: 每次比较的时间、样本数和误差写成 CSV
+//   --snapshot <file>: 定期在后台把累积的图像写到 file（.pfm、.exr、.png），含 %d 时按帧号写成序列，退出时再写一次
+//   --snapshot-every <n>: 每隔 n 帧写一次，默认 SNAPSHOT_INTERVAL
+class RenderMonitor
+{
+public:
+    static const unsigned int CONVERGENCE_INTERVAL = 16;   // 每隔几帧与参考图比较一次
+    static const unsigned int SNAPSHOT_INTERVAL = 64;      // 默认每隔几帧写一次 --snapshot
+
+    // argv[i] 是上面的选项时读入它的参数，i 移到最后一个参数上并返回 true
+    bool parseOption(int argc, char** argv, int& i);
+    // 创建 OpenGL 上下文之后调用；frame 为已经渲染的帧数，从检查点继续时快照的帧号接着编
+    void init(unsigned int width, unsigned int height, unsigned int frame = 0);
+    // 累积的结果清空后调用
+    void reset();
+    // 每帧 draw 之后调用，seconds 为这次累积的渲染时间，误差达到 --stop-at 后返回 true
+    bool update(const Render& render, double seconds);
+    // 退出之前调用，写最后一帧的快照并输出统计
+    void finish(const Render& render);
+    // 标题栏上显示的最近一次的误差，还没有结果时为空
+    std::string summary() const;
+
+private:
+    std::string reference_path_, convergence_log_, snapshot_path_;
+    int stop_metric_ = ConvergenceTracker::FLIP;
+    double stop_threshold_ = 0.0;
+    unsigned int snapshot_interval_ = SNAPSHOT_INTERVAL;
+    unsigned int frame_ = 0;            // 快照的帧号，只增不减，累积的结果清空时也不从头开始
+    unsigned int accumulated_ = 0;      // 这次累积的帧数
+    bool stopped_ = false;
+
+    ConvergenceTracker convergence_;
+    FrameWriter snapshot_;
+};
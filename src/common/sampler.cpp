@@ -0,0 +1,356 @@
+#include "sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+    const uint32_t CACHE_MAGIC = 0x31534c47;   // "GLS1"
+    const uint32_t CACHE_VERSION = 1;
+
+    uint32_t reverseBits(uint32_t x)
+    {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    uint32_t hash(uint32_t x)
+    {
+        // https://github.com/skeeto/hash-prospector
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // Owen 扰乱，Burley 2020 "Practical Hash-based Owen Scrambling"
+    uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+    {
+        x = reverseBits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return reverseBits(x);
+    }
+
+    // Sobol 序列的前两维，两维组成(0,2)序列
+    uint32_t sobol2D(uint32_t index, int dim)
+    {
+        if(dim == 0)
+            return reverseBits(index);
+
+        uint32_t v = 1u << 31;
+        uint32_t result = 0;
+        for(; index; index >>= 1, v ^= v >> 1)
+        {
+            if(index & 1u)
+                result ^= v;
+        }
+        return result;
+    }
+
+    // 二维格 {(1, h), (0, n)} 上最短向量的长度（Gauss 约化）
+    double shortestVector(int64_t h, int64_t n)
+    {
+        int64_t ax = 1, ay = h, bx = 0, by = n;
+        auto len2 = [](int64_t x, int64_t y) { return x * x + y * y; };
+        if(len2(ax, ay) > len2(bx, by))
+        {
+            std::swap(ax, bx);
+            std::swap(ay, by);
+        }
+        while(true)
+        {
+            int64_t dot = ax * bx + ay * by;
+            int64_t k = (int64_t)std::llround((double)dot / (double)len2(ax, ay));
+            bx -= k * ax;
+            by -= k * ay;
+            if(len2(bx, by) >= len2(ax, ay))
+                break;
+            std::swap(ax, bx);
+            std::swap(ay, by);
+        }
+        return std::sqrt((double)len2(ax, ay));
+    }
+}
+
+Sampler::Sampler(const std::string& cache_path)
+{
+    if(!load(cache_path))
+    {
+        std::cout << "generate sampler tables..." << std::endl;
+        generateSobol();
+        generateRank1();
+        generateBlueNoise();
+        save(cache_path);
+    }
+    upload();
+}
+
+Sampler::~Sampler()
+{
+    glDeleteTextures(1, &sobol_texture_);
+    glDeleteTextures(1, &rank1_texture_);
+    glDeleteTextures(1, &blue_noise_texture_);
+}
+
+void Sampler::bind(Shader& shader, GLuint first_unit)
+{
+    shader.bind();
+    shader.setInt("sampler_type", (int)type_);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_2D, sobol_texture_);
+    shader.setInt("sobolTex", first_unit);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+    glBindTexture(GL_TEXTURE_2D, rank1_texture_);
+    shader.setInt("rank1Tex", first_unit + 1);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit + 2);
+    glBindTexture(GL_TEXTURE_2D, blue_noise_texture_);
+    shader.setInt("blueNoiseTex", first_unit + 2);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool Sampler::load(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+        return false;
+
+    uint32_t header[5] = {};
+    bool ok = fread(header, sizeof(header), 1, file) == 1 &&
+        header[0] == CACHE_MAGIC && header[1] == CACHE_VERSION &&
+        header[2] == SAMPLES && header[3] == DIMS && header[4] == BLUE_NOISE_SIZE;
+    if(ok)
+    {
+        sobol_.resize(DIMS * SAMPLES);
+        rank1_.resize(DIMS);
+        blue_noise_.resize(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE);
+        ok = fread(sobol_.data(), sizeof(uint32_t), sobol_.size(), file) == sobol_.size() &&
+            fread(rank1_.data(), sizeof(uint32_t), rank1_.size(), file) == rank1_.size() &&
+            fread(blue_noise_.data(), sizeof(float), blue_noise_.size(), file) == blue_noise_.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+void Sampler::save(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        std::cout << "ERROR::SAMPLER::CACHE_NOT_WRITABLE: " << path << std::endl;
+        return;
+    }
+    uint32_t header[5] = { CACHE_MAGIC, CACHE_VERSION, SAMPLES, DIMS, BLUE_NOISE_SIZE };
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(sobol_.data(), sizeof(uint32_t), sobol_.size(), file);
+    fwrite(rank1_.data(), sizeof(uint32_t), rank1_.size(), file);
+    fwrite(blue_noise_.data(), sizeof(float), blue_noise_.size(), file);
+    fclose(file);
+}
+
+// 每两维一组，使用Sobol的前两维（二维投影分层最好），组与组之间用不同的Owen扰乱和下标异或打乱来去相关
+// 下标异或只会交换对齐的 2^k 块，因此任意 2^k 长的前缀仍然是 (0,k,2)-网
+void Sampler::generateSobol()
+{
+    sobol_.resize(DIMS * SAMPLES);
+    for(int pair = 0; pair < DIMS / 2; ++pair)
+    {
+        uint32_t shuffle = pair == 0 ? 0 : hash(pair * 0x9e3779b9u) & (SAMPLES - 1);
+        for(int d = 0; d < 2; ++d)
+        {
+            int dim = pair * 2 + d;
+            uint32_t seed = hash(dim + 0x68bc21ebu);
+            for(int i = 0; i < SAMPLES; ++i)
+            {
+                sobol_[dim * SAMPLES + i] = nestedUniformScramble(sobol2D(i ^ shuffle, d), seed);
+            }
+        }
+    }
+}
+
+// Korobov 形式的 rank-1 格 z = (1, g, g^2, ...) mod N，相隔k维的二维投影等价于生成向量(1, g^k)
+// 搜索使这些投影最短向量最长的 g，着色器中按基2逆序的下标取点，任意 2^m 长的前缀也构成格
+void Sampler::generateRank1()
+{
+    const int64_t n = SAMPLES;
+    const int max_stride = 8;
+    int64_t best_g = 1;
+    double best_quality = 0;
+    for(int64_t g = 3; g < n; g += 2)
+    {
+        double quality = 1e30;
+        int64_t h = 1;
+        for(int k = 1; k <= max_stride && quality > best_quality; ++k)
+        {
+            h = h * g % n;
+            quality = std::min(quality, shortestVector(h, n));
+        }
+        if(quality > best_quality)
+        {
+            best_quality = quality;
+            best_g = g;
+        }
+    }
+
+    rank1_.resize(DIMS);
+    int64_t z = 1;
+    for(int d = 0; d < DIMS; ++d)
+    {
+        rank1_[d] = (uint32_t)z;
+        z = z * best_g % n;
+    }
+}
+
+// Ulichney 的 void-and-cluster 算法生成蓝噪声阈值图，结果为 (rank + 0.5) / (size * size)
+void Sampler::generateBlueNoise()
+{
+    const int size = BLUE_NOISE_SIZE;
+    const int count = size * size;
+    const float sigma = 1.5f;
+
+    // 环面上的高斯核
+    std::vector<float> kernel(count);
+    for(int y = 0; y < size; ++y)
+    {
+        for(int x = 0; x < size; ++x)
+        {
+            int dx = std::min(x, size - x);
+            int dy = std::min(y, size - y);
+            kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+        }
+    }
+
+    std::vector<char> pattern(count, 0);
+    std::vector<float> energy(count, 0.0f);
+    auto splat = [&](int p, float sign) {
+        int px = p % size, py = p / size;
+        for(int y = 0; y < size; ++y)
+        {
+            const float* row = &kernel[((y - py + size) % size) * size];
+            for(int x = 0; x < size; ++x)
+                energy[y * size + x] += sign * row[(x - px + size) % size];
+        }
+    };
+    // value 为 1 时找能量最大的 1（最紧的簇），为 0 时找能量最小的 0（最大的空洞）
+    auto extreme = [&](char value) {
+        int best = -1;
+        for(int p = 0; p < count; ++p)
+        {
+            if(pattern[p] != value)
+                continue;
+            if(best < 0 || (value ? energy[p] > energy[best] : energy[p] < energy[best]))
+                best = p;
+        }
+        return best;
+    };
+
+    // 初始的随机点集，反复把最紧的簇移动到最大的空洞直到稳定
+    const int initial = count / 10;
+    uint32_t state = 1;
+    for(int placed = 0; placed < initial;)
+    {
+        state = hash(state + placed);
+        int p = state % count;
+        if(pattern[p])
+            continue;
+        pattern[p] = 1;
+        splat(p, 1.0f);
+        placed++;
+    }
+    while(true)
+    {
+        int cluster = extreme(1);
+        pattern[cluster] = 0;
+        splat(cluster, -1.0f);
+        int void_ = extreme(0);
+        pattern[void_] = 1;
+        splat(void_, 1.0f);
+        if(void_ == cluster)
+            break;
+    }
+
+    std::vector<int> rank(count, 0);
+    std::vector<char> prototype = pattern;
+    std::vector<float> prototype_energy = energy;
+
+    // 阶段1：从初始点集中逐个去掉最紧的簇
+    for(int r = initial - 1; r >= 0; --r)
+    {
+        int cluster = extreme(1);
+        pattern[cluster] = 0;
+        splat(cluster, -1.0f);
+        rank[cluster] = r;
+    }
+
+    // 阶段2：从初始点集开始填充最大的空洞，直到一半
+    pattern = prototype;
+    energy = prototype_energy;
+    for(int r = initial; r < count / 2; ++r)
+    {
+        int void_ = extreme(0);
+        pattern[void_] = 1;
+        splat(void_, 1.0f);
+        rank[void_] = r;
+    }
+
+    // 阶段3：之后 0 变为少数，能量改为由 0 产生，每次把最紧的 0 簇置为 1
+    energy.assign(count, 0.0f);
+    for(int p = 0; p < count; ++p)
+    {
+        if(!pattern[p])
+            splat(p, 1.0f);
+    }
+    for(int r = count / 2; r < count; ++r)
+    {
+        int best = -1;
+        for(int p = 0; p < count; ++p)
+        {
+            if(!pattern[p] && (best < 0 || energy[p] > energy[best]))
+                best = p;
+        }
+        pattern[best] = 1;
+        splat(best, -1.0f);
+        rank[best] = r;
+    }
+
+    blue_noise_.resize(count);
+    for(int p = 0; p < count; ++p)
+        blue_noise_[p] = (rank[p] + 0.5f) / count;
+}
+
+void Sampler::upload()
+{
+    glGenTextures(1, &sobol_texture_);
+    glBindTexture(GL_TEXTURE_2D, sobol_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, SAMPLES, DIMS, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, sobol_.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &rank1_texture_);
+    glBindTexture(GL_TEXTURE_2D, rank1_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, DIMS, 1, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, rank1_.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &blue_noise_texture_);
+    glBindTexture(GL_TEXTURE_2D, blue_noise_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, 0, GL_RED, GL_FLOAT, blue_noise_.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
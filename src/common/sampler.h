@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glad/glad.h>
+#include "shader.h"
+
+// 着色器中 rand() 的数据来源，与 sampler.glsl 中的 SAMPLER_* 对应
+enum class SamplerType
+{
+    Hash = 0,   // wang_hash，每个维度独立哈希
+    Sobol = 1,  // Owen 扰乱的 Sobol 序列 + 蓝噪声旋转
+    Rank1 = 2,  // rank-1 (Kronecker) 序列 + 蓝噪声旋转
+};
+
+// 低差异序列采样表，启动时在CPU上生成并缓存到磁盘，以纹理的形式上传给着色器
+class Sampler
+{
+public:
+    static const int SAMPLES = 4096;        // Sobol 表的长度，超过后换一组扰乱继续循环
+    static const int DIMS = 64;             // 维度数，与 sampler.glsl 中的 SAMPLER_DIMS 一致
+    static const int BLUE_NOISE_SIZE = 64;  // 蓝噪声纹理的边长
+
+    Sampler(const std::string& cache_path);
+    ~Sampler();
+    void setType(SamplerType type) { type_ = type; }
+    SamplerType type() const { return type_; }
+    // 绑定三张纹理到 first_unit 开始的连续纹理单元上，并设置 shader 中对应的 uniform
+    void bind(Shader& shader, GLuint first_unit);
+
+private:
+    SamplerType type_ = SamplerType::Sobol;
+    std::vector<uint32_t> sobol_;       // DIMS * SAMPLES
+    std::vector<uint32_t> rank1_;       // DIMS
+    std::vector<float> blue_noise_;     // BLUE_NOISE_SIZE * BLUE_NOISE_SIZE
+
+    GLuint sobol_texture_ = 0;
+    GLuint rank1_texture_ = 0;
+    GLuint blue_noise_texture_ = 0;
+
+    bool load(const std::string& path);
+    void save(const std::string& path) const;
+    void generateSobol();
+    void generateRank1();
+    void generateBlueNoise();
+    void upload();
+};
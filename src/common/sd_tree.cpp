@@ -0,0 +1,219 @@
+#include "sd_tree.h"
+#include "gl_util.h"
+#include "../config.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const float SPATIAL_THRESHOLD = 12000.0f;   // 叶节点在第 k 次迭代的样本数超过 c * sqrt(2^k) 时切分
+    const float FLUX_THRESHOLD = 0.01f;         // 方向上能量占比超过 ρ 的区域继续细分
+    const int MAX_QUAD_DEPTH = 20;
+
+    // 圆柱坐标映射是保面积的，单位正方形上的pdf除以 4π 就是立体角上的pdf
+    glm::vec2 directionToSquare(const glm::vec3& d)
+    {
+        float phi = std::atan2(d.y, d.x);
+        if(phi < 0.0f)
+            phi += 2.0f * PI;
+        return glm::clamp(glm::vec2((d.z + 1.0f) * 0.5f, phi / (2.0f * PI)), glm::vec2(0.0f), glm::vec2(1.0f));
+    }
+
+}
+
+float SDTree::QuadTree::total() const
+{
+    const QuadNode& root = nodes[0];
+    return root.sum[0] + root.sum[1] + root.sum[2] + root.sum[3];
+}
+
+void SDTree::QuadTree::record(glm::vec2 p, float value)
+{
+    int node = 0;
+    while(true)
+    {
+        int x = p.x < 0.5f ? 0 : 1;
+        int y = p.y < 0.5f ? 0 : 1;
+        int q = x + 2 * y;
+        nodes[node].sum[q] += value;
+        if(nodes[node].child[q] == 0)
+            return;
+        node = nodes[node].child[q];
+        p = p * 2.0f - glm::vec2((float)x, (float)y);
+    }
+}
+
+SDTree::QuadTree SDTree::QuadTree::refined(float threshold) const
+{
+    QuadTree result;
+    float total = this->total();
+    if(total <= 0.0f)   // 没有样本时保留原来的结构
+    {
+        result.nodes = nodes;
+        for(QuadNode& node : result.nodes)
+            std::fill(node.sum, node.sum + 4, 0.0f);
+        return result;
+    }
+
+    // old_node 为旧树中对应的节点，旧树在这里已经是叶时为 -1，能量按面积平分
+    struct Item
+    {
+        int old_node;
+        int new_node;
+        int depth;
+        float sum[4];
+    };
+    std::vector<Item> stack;
+    Item root = { 0, 0, 1, { nodes[0].sum[0], nodes[0].sum[1], nodes[0].sum[2], nodes[0].sum[3] } };
+    stack.push_back(root);
+    while(!stack.empty())
+    {
+        Item item = stack.back();
+        stack.pop_back();
+        for(int q = 0; q < 4; ++q)
+        {
+            if(item.sum[q] <= total * threshold || item.depth >= MAX_QUAD_DEPTH)
+                continue;
+
+            Item child;
+            int old_child = item.old_node >= 0 ? nodes[item.old_node].child[q] : 0;
+            child.old_node = old_child > 0 ? old_child : -1;
+            child.new_node = (int)result.nodes.size();
+            child.depth = item.depth + 1;
+            for(int k = 0; k < 4; ++k)
+                child.sum[k] = child.old_node >= 0 ? nodes[child.old_node].sum[k] : item.sum[q] * 0.25f;
+            result.nodes.emplace_back();
+            result.nodes[item.new_node].child[q] = child.new_node;
+            stack.push_back(child);
+        }
+    }
+    return result;
+}
+
+SDTree::SDTree(const glm::vec3& min, const glm::vec3& max) : min_(min), max_(max)
+{
+    spatial_.emplace_back();
+    dtrees_.emplace_back();
+}
+
+SDTree::~SDTree()
+{
+    glDeleteTextures(1, &spatial_texture_);
+    glDeleteTextures(1, &quad_texture_);
+}
+
+size_t SDTree::directionalNodes() const
+{
+    size_t count = 0;
+    for(const DirectionalTree& d : dtrees_)
+        count += d.sampling.nodes.size();
+    return count;
+}
+
+void SDTree::record(const glm::vec3& position, const glm::vec3& direction, float radiance, float pdf)
+{
+    if(!(pdf > 0.0f) || !std::isfinite(radiance))
+        return;
+
+    glm::vec3 p = glm::clamp((position - min_) / (max_ - min_), glm::vec3(0.0f), glm::vec3(1.0f));
+    int node = 0;
+    while(spatial_[node].axis >= 0)
+    {
+        int axis = spatial_[node].axis;
+        int side = p[axis] < 0.5f ? 0 : 1;
+        p[axis] = p[axis] * 2.0f - (float)side;
+        node = spatial_[node].child[side];
+    }
+
+    DirectionalTree& d = dtrees_[spatial_[node].dtree];
+    d.building.record(directionToSquare(direction), radiance / pdf);
+    d.samples += 1.0f;
+}
+
+void SDTree::refine(unsigned int iteration)
+{
+    // 空间：两个子节点复制父节点的方向分布，样本数按各一半估计，新加入的子节点在同一个循环里继续检查
+    float threshold = SPATIAL_THRESHOLD * std::sqrt(std::pow(2.0f, (float)iteration));
+    for(size_t i = 0; i < spatial_.size(); ++i)
+    {
+        if(spatial_[i].axis >= 0 || dtrees_[spatial_[i].dtree].samples <= threshold)
+            continue;
+
+        DirectionalTree d = dtrees_[spatial_[i].dtree];
+        d.samples *= 0.5f;
+        dtrees_[spatial_[i].dtree] = d;
+        dtrees_.push_back(d);
+
+        SpatialNode left, right;
+        left.depth = right.depth = spatial_[i].depth + 1;
+        left.dtree = spatial_[i].dtree;
+        right.dtree = (int)dtrees_.size() - 1;
+        spatial_[i].axis = spatial_[i].depth % 3;
+        spatial_[i].child[0] = (int)spatial_.size();
+        spatial_[i].child[1] = (int)spatial_.size() + 1;
+        spatial_.push_back(left);
+        spatial_.push_back(right);
+    }
+
+    // 方向：这次记录的分布用于采样，并按它细分出下一次记录用的结构；没有样本的叶节点保留旧的分布
+    for(DirectionalTree& d : dtrees_)
+    {
+        if(d.building.total() > 0.0f)
+            d.sampling = d.building;
+        d.building = d.building.refined(FLUX_THRESHOLD);
+        d.samples = 0.0f;
+    }
+    learned_ = true;
+    upload();
+}
+
+void SDTree::bind(Shader& shader, GLuint first_unit)
+{
+    shader.bind();
+    shader.setBool("guiding_enabled", learned_);
+    if(!learned_)
+        return;
+    shader.setVec3("guiding_min", min_);
+    shader.setVec3("guiding_max", max_);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_2D, spatial_texture_);
+    shader.setInt("guidingSpatialTex", first_unit);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+    glBindTexture(GL_TEXTURE_2D, quad_texture_);
+    shader.setInt("guidingQuadTex", first_unit + 1);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// 所有叶节点的采样四叉树拼接到同一张纹理中，子节点编号换成全局编号
+void SDTree::upload()
+{
+    glDeleteTextures(1, &spatial_texture_);
+    glDeleteTextures(1, &quad_texture_);
+
+    std::vector<int> offsets(dtrees_.size());
+    std::vector<glm::vec4> texels;
+    int count = 0;
+    for(size_t i = 0; i < dtrees_.size(); ++i)
+    {
+        offsets[i] = count;
+        for(const QuadNode& node : dtrees_[i].sampling.nodes)
+        {
+            texels.push_back(glm::vec4(node.sum[0], node.sum[1], node.sum[2], node.sum[3]));
+            glm::vec4 child(0.0f);
+            for(int q = 0; q < 4; ++q)
+                child[q] = node.child[q] > 0 ? (float)(node.child[q] + count) : 0.0f;
+            texels.push_back(child);
+        }
+        count += (int)dtrees_[i].sampling.nodes.size();
+    }
+    quad_texture_ = createDataTexture(texels, count, 2, ITEMS_PER_ROW);
+
+    texels.clear();
+    for(const SpatialNode& node : spatial_)
+        texels.push_back(glm::vec4((float)node.axis, (float)node.child[0], (float)node.child[1], (float)offsets[node.dtree]));
+    spatial_texture_ = createDataTexture(texels, (int)spatial_.size(), 1, ITEMS_PER_ROW);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+
+// 空间-方向树，Müller et al. 2017 "Practical Path Guiding for Efficient Light-Transport Simulation"
+// 空间上是沿 x/y/z 轮流从中点切开的二叉树，每个叶节点有一棵方向四叉树，记录入射辐射度在 (cosθ, φ) 参数化的单位正方形上的分布
+// 每次迭代用上一次学到的四叉树采样，新样本记录到另一棵结构细分过的四叉树中，迭代结束时交换，见 guiding.glsl
+class SDTree
+{
+public:
+    static const int ITEMS_PER_ROW = 1024;  // 纹理每行的节点数，与 guiding.glsl 一致
+
+    SDTree(const glm::vec3& min, const glm::vec3& max);
+    ~SDTree();
+    // radiance 为沿 direction 方向入射的辐射度的亮度，pdf 为采到该方向的立体角pdf
+    void record(const glm::vec3& position, const glm::vec3& direction, float radiance, float pdf);
+    // 结束第 iteration 次迭代：新记录的分布用于之后的采样，按这次的样本数细分空间、按能量分布细分方向，然后上传
+    void refine(unsigned int iteration);
+    // 绑定两张纹理到 first_unit 开始的连续纹理单元上，还没有学到分布时只关闭引导
+    void bind(Shader& shader, GLuint first_unit);
+    size_t spatialNodes() const { return spatial_.size(); }
+    size_t directionalNodes() const;
+
+private:
+    struct QuadNode
+    {
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };  // 四个子区域的能量，编号为 x + 2 * y
+        int child[4] = { 0, 0, 0, 0 };              // 0 表示叶，根节点不会是任何节点的子节点
+    };
+
+    struct QuadTree
+    {
+        std::vector<QuadNode> nodes = std::vector<QuadNode>(1);
+
+        float total() const;
+        void record(glm::vec2 p, float value);
+        // 能量占比超过 threshold 的区域继续细分，返回结构细分后、能量清零的树
+        QuadTree refined(float threshold) const;
+    };
+
+    struct DirectionalTree
+    {
+        QuadTree sampling;
+        QuadTree building;
+        float samples = 0.0f;   // 本次迭代记录的样本数
+    };
+
+    struct SpatialNode
+    {
+        int axis = -1;      // 叶节点为 -1
+        int child[2] = { 0, 0 };
+        int depth = 0;
+        int dtree = 0;
+    };
+
+    glm::vec3 min_;
+    glm::vec3 max_;
+    std::vector<SpatialNode> spatial_;
+    std::vector<DirectionalTree> dtrees_;
+    bool learned_ = false;
+    GLuint spatial_texture_ = 0;
+    GLuint quad_texture_ = 0;
+
+    void upload();
+};
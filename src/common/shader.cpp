@@ -1,8 +1,10 @@
 #include "shader.h"
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
@@ -11,43 +13,22 @@ Shader::Shader()
 
 }
 
-Shader::Shader(const string &vertexPath, const string& fragmentPath) 
+Shader::Shader(const string &vertexPath, const string& fragmentPath, const string& defines) 
 {
-    init(vertexPath, fragmentPath);
+    init(vertexPath, fragmentPath, defines);
 }   
 
 
 // constructor generates the shader on the fly
-void Shader::init(const string &vertexPath, const string& fragmentPath)
+void Shader::init(const string &vertexPath, const string& fragmentPath, const string& defines)
 {
     // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try
-    {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    }
-    catch (std::ifstream::failure& e)
+    std::string vertexCode = loadSource(vertexPath);
+    std::string fragmentCode = loadSource(fragmentPath);
+    if (!defines.empty())
     {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        std::cout << e.code().message() << std::endl;
+        size_t line_end = fragmentCode.find('\n');
+        fragmentCode.insert(line_end == std::string::npos ? fragmentCode.size() : line_end + 1, defines);
     }
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -74,6 +55,148 @@ void Shader::init(const string &vertexPath, const string& fragmentPath)
     glDeleteShader(fragment);
 }
 
+void Shader::copyUniformsFrom(const Shader& other)
+{
+    GLint count = 0;
+    glGetProgramiv(other.ID, GL_ACTIVE_UNIFORMS, &count);
+    glUseProgram(ID);
+    for (GLint i = 0; i < count; ++i)
+    {
+        char name[256];
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(other.ID, i, sizeof(name), NULL, &size, &type, name);
+
+        // 基本类型的数组只返回第0个元素的名字，逐个元素复制
+        std::string base = name;
+        if (size > 1 && base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+            base.erase(base.size() - 3);
+        for (GLint element = 0; element < size; ++element)
+        {
+            std::string element_name = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+            GLint src = glGetUniformLocation(other.ID, element_name.c_str());
+            GLint dst = glGetUniformLocation(ID, element_name.c_str());
+            if (src < 0 || dst < 0)
+                continue;
+
+            GLfloat f[16];
+            GLint n[4];
+            GLuint u[4];
+            switch (type)
+            {
+            case GL_FLOAT:      glGetUniformfv(other.ID, src, f); glUniform1fv(dst, 1, f); break;
+            case GL_FLOAT_VEC2: glGetUniformfv(other.ID, src, f); glUniform2fv(dst, 1, f); break;
+            case GL_FLOAT_VEC3: glGetUniformfv(other.ID, src, f); glUniform3fv(dst, 1, f); break;
+            case GL_FLOAT_VEC4: glGetUniformfv(other.ID, src, f); glUniform4fv(dst, 1, f); break;
+            case GL_FLOAT_MAT4: glGetUniformfv(other.ID, src, f); glUniformMatrix4fv(dst, 1, GL_FALSE, f); break;
+            case GL_UNSIGNED_INT:       glGetUniformuiv(other.ID, src, u); glUniform1uiv(dst, 1, u); break;
+            case GL_UNSIGNED_INT_VEC2:  glGetUniformuiv(other.ID, src, u); glUniform2uiv(dst, 1, u); break;
+            case GL_INT_VEC2:
+            case GL_BOOL_VEC2:  glGetUniformiv(other.ID, src, n); glUniform2iv(dst, 1, n); break;
+            case GL_INT_VEC3:
+            case GL_BOOL_VEC3:  glGetUniformiv(other.ID, src, n); glUniform3iv(dst, 1, n); break;
+            default:            // int、bool 和各种 sampler
+                glGetUniformiv(other.ID, src, n); glUniform1iv(dst, 1, n); break;
+            }
+        }
+    }
+}
+
+uint64_t Shader::hashUniforms(const std::vector<std::string>& ignored) const
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&](const void* data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ ((const unsigned char*)data)[i]) * 0x100000001b3ull;
+    };
+    GLint count = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        char name[256];
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, i, sizeof(name), NULL, &size, &type, name);
+        std::string base = name;
+        if (size > 1 && base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+            base.erase(base.size() - 3);
+        if (std::find(ignored.begin(), ignored.end(), base) != ignored.end())
+            continue;
+        for (GLint element = 0; element < size; ++element)
+        {
+            std::string element_name = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+            GLint location = glGetUniformLocation(ID, element_name.c_str());
+            if (location < 0)
+                continue;
+            mix(element_name.c_str(), element_name.size() + 1);
+            // 缓冲按最大的 mat4 开，没有写到的部分为 0
+            GLfloat f[16] = {};
+            GLint n[16] = {};
+            GLuint u[16] = {};
+            switch (type)
+            {
+            case GL_FLOAT:
+            case GL_FLOAT_VEC2:
+            case GL_FLOAT_VEC3:
+            case GL_FLOAT_VEC4:
+            case GL_FLOAT_MAT4: glGetUniformfv(ID, location, f); mix(f, sizeof(f)); break;
+            case GL_UNSIGNED_INT:
+            case GL_UNSIGNED_INT_VEC2:  glGetUniformuiv(ID, location, u); mix(u, sizeof(u)); break;
+            default:            glGetUniformiv(ID, location, n); mix(n, sizeof(n)); break;
+            }
+        }
+    }
+    return hash;
+}
+
+// 读取着色器源码，并展开其中的 #include "xxx.glsl"，路径相对于当前文件所在目录
+std::string Shader::loadSource(const std::string& path)
+{
+    std::string code;
+    std::ifstream shaderFile;
+    // ensure ifstream objects can throw exceptions:
+    shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try
+    {
+        shaderFile.open(path);
+        std::stringstream shaderStream;
+        shaderStream << shaderFile.rdbuf();
+        shaderFile.close();
+        code = shaderStream.str();
+    }
+    catch (std::ifstream::failure& e)
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+        std::cout << e.code().message() << std::endl;
+        return code;
+    }
+
+    std::string dir = path.substr(0, path.find_last_of("/\\") + 1);
+    std::stringstream in(code);
+    std::string out, line;
+    while (std::getline(in, line))
+    {
+        size_t pos = line.find("#include");
+        if (pos != std::string::npos && line.find_first_not_of(" \t") == pos)
+        {
+            size_t begin = line.find('"', pos);
+            size_t end = line.find('"', begin + 1);
+            if (begin != std::string::npos && end != std::string::npos)
+            {
+                std::string name = line.substr(begin + 1, end - begin - 1);
+                auto it = includes.find(name);
+                out += it != includes.end() ? it->second : loadSource(dir + name);
+                out += "\n";
+                continue;
+            }
+        }
+        out += line;
+        out += "\n";
+    }
+    return out;
+}
+
 // utility function for checking shader compilation/linking errors.
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
 {
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
 
@@ -8,8 +11,15 @@ class Shader
 {
 public:
     Shader();
-    Shader(const std::string &vertexPath, const std::string& fragmentPath);
-    void init(const std::string &vertexPath, const std::string& fragmentPath);
+    // defines 插入到片元着色器的 #version 之后，用于从同一份源码编译出不同的变体，如 "#define RESTIR_PASS 1\n"
+    Shader(const std::string &vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+    void init(const std::string &vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+    // 在 init 之前调用，源码中的 #include "name" 展开为 code 而不读取文件，用于运行时生成的代码
+    void addInclude(const std::string& name, const std::string& code) { includes[name] = code; }
+    // 把 other 中所有同名的 uniform 的当前值复制过来，用于让同一场景的多个pass共享主着色器上设置的参数
+    void copyUniformsFrom(const Shader& other);
+    // 所有 uniform 的名字和当前值的 64 位 FNV-1a 哈希，ignored 中的不计入；用于判断两次运行的场景参数是否相同，纹理的内容不包括在内
+    uint64_t hashUniforms(const std::vector<std::string>& ignored = {}) const;
     inline void bind();
     inline void unbind();
     inline void setBool(const std::string& name, bool value) const;
@@ -22,6 +32,8 @@ public:
 
 private:
     unsigned int ID = 0;
+    std::map<std::string, std::string> includes;
+    std::string loadSource(const std::string& path);
     void checkCompileErrors(unsigned int shader, std::string type);
 };
 
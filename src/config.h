@@ -12,3 +12,23 @@ const std::string project_path = "../../../../";
 const unsigned int SCR_WIDTH = 600;
 const unsigned int SCR_HEIGHT = 600;
 
+// 显示时的色调映射 c / (1 + luminance / TONE_MAP_LIMIT) 和 gamma，Render 传给 output_fs.glsl，
+// 写 PNG、计算 FLIP 和 SSIM 时用 gl_util.h 中的 displayColor，两边一致
+const float TONE_MAP_LIMIT = 1.5f;
+const float DISPLAY_GAMMA = 2.2f;
+
+// 纹理单元的分配，Render 占用前两个
+const unsigned int UNIT_IMAGE = 0;      // 上一帧累积的颜色
+const unsigned int UNIT_MOMENT = 1;     // 上一帧累积的二阶矩和样本数
+const unsigned int UNIT_SAMPLER = 2;    // Sampler 的三张采样表
+const unsigned int UNIT_ALBEDO_LUT = 5; // AlbedoLut 的反照率表和平均反照率
+const unsigned int UNIT_ENVIRONMENT = 7;    // Environment 的辐射度和两张别名表
+const unsigned int UNIT_LIGHTS = 10;        // LightBVH 的节点和光源
+const unsigned int UNIT_RESTIR = 12;        // ReSTIR 的两张蓄水池纹理和两张 G-buffer
+const unsigned int UNIT_GUIDING = 16;       // SDTree 的空间树和方向四叉树
+const unsigned int UNIT_IMPLICIT = 18;      // ImplicitBricks 的格子和砖块图集
+const unsigned int UNIT_BVH = 20;           // PrimitiveBVH 的节点和图元
+const unsigned int UNIT_IMPLICIT_TILES = 22;    // ImplicitTiles 每块主光线的 t 范围
+const unsigned int UNIT_FEATURES = 23;      // Render 累积的第一个交点的法线和反照率
+const unsigned int UNIT_HISTORY = 25;       // Render 重投影时相机移动前累积的四张纹理
+const unsigned int UNIT_HEATMAP = 29;       // RayStats 逐像素的两张计数纹理，显示热度图时使用
@@ -4,8 +4,19 @@
 #include <string>
 #include "common/shader.h"
 #include "common/render.h"
+#include "common/sampler.h"
+#include "common/light_bvh.h"
+#include "common/albedo_lut.h"
+#include "common/environment.h"
+#include "common/cornell_box.h"
+#include "common/render_monitor.h"
+#include "common/checkpoint.h"
+#include "common/gl_util.h"
 #include "config.h"
 #include <time.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
 #include <windows.h>
 
 using namespace std;
@@ -16,10 +27,94 @@ extern "C"
 __declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001;
 }
 
-void processInput(GLFWwindow *window);
+const int DENOISE_ITERATIONS = 5;    // à-trous 的次数，最后一次的间隔为 16 像素
+const unsigned int CHECKPOINT_INTERVAL = 256;   // 默认每隔几帧写一次 --checkpoint
+const unsigned int SEED_STRIDE = 1u << 24;      // --seed 每加1样本序号错开的距离，远大于一个像素能累积的样本数
 
-int main()
+void processInput(GLFWwindow *window, Render& render);
+void reportFurnace(Render& render, unsigned int frame_count, time_t start);
+void compareReSTIR(Render& render, Shader& path_shader);
+void compareDenoiser(Render& render, Shader& path_shader, double target_ssim);
+bool mergeCheckpoints(const string& output, const vector<string>& inputs);
+uint64_t sceneHash(const Shader& path_shader, const Render& render);
+double ssim(const vector<float>& a, const vector<float>& b, int width, int height);
+
+int main(int argc, char** argv)
 {
+    // --furnace: 白炉测试，去掉墙面和光源，球体改为白色金属，定期输出与1的偏差以及收敛情况
+    // --no-compensation: 关闭镜面反射多次散射的能量补偿
+    // --env <file>: 使用 .hdr / .pfm 经纬度环境贴图代替常量背景
+    // --restir: 启动时使用 ReSTIR 计算直接光照，运行中按 R 切换
+    // --restir-compare: 对比 ReSTIR 与逐像素光源采样的直接光照在相同时间内的误差后退出
+    // --denoise: 启动时打开 à-trous 降噪，运行中按 D 切换
+    // --denoise-compare [ssim]: 输出降噪前后与参考图的 SSIM 达到 ssim（默认 0.95）分别需要的样本数后退出
+    // --ray-stats: 统计每帧的光线数和求交测试数，定期输出 Mrays/s，ReSTIR 开启时不统计
+    // --timings <file>: 退出时把各个 pass 的 GPU 耗时统计写到 file，后缀为 .json 时写 JSON，否则写 CSV
+    // --reference、--stop-at、--convergence-log、--snapshot、--snapshot-every: 见 common/render_monitor.h
+    // --checkpoint <file>: 定期在后台把累积的状态写到 file，退出时再写一次
+    // --checkpoint-every <n>: 每隔 n 帧写一次，默认 CHECKPOINT_INTERVAL
+    // --resume <file>: 从检查点继续累积，场景参数和尺寸必须与写检查点时相同
+    // --seed <n>: 样本序号错开 n * SEED_STRIDE，不同 seed 的检查点可以合并；--resume 时使用检查点中的
+    // --merge <output> <input>...: 按样本数加权合并几个检查点写到 output 后退出，必须是最后一个参数
+    bool furnace = false;
+    bool compensation = true;
+    bool restir = false;
+    bool restir_compare = false;
+    bool denoise = false;
+    double denoise_compare = 0.0;
+    string env_path;
+    bool ray_stats = false;
+    string timings_path;
+    RenderMonitor monitor;
+    string checkpoint_path, resume_path;
+    unsigned int checkpoint_interval = CHECKPOINT_INTERVAL;
+    unsigned int sample_offset = 0;
+    string merge_output;
+    vector<string> merge_inputs;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(monitor.parseOption(argc, argv, i))
+            continue;
+        if(string(argv[i]) == "--furnace")
+            furnace = true;
+        else if(string(argv[i]) == "--no-compensation")
+            compensation = false;
+        else if(string(argv[i]) == "--env" && i + 1 < argc)
+            env_path = argv[++i];
+        else if(string(argv[i]) == "--restir")
+            restir = true;
+        else if(string(argv[i]) == "--restir-compare")
+            restir_compare = true;
+        else if(string(argv[i]) == "--denoise")
+            denoise = true;
+        else if(string(argv[i]) == "--ray-stats")
+            ray_stats = true;
+        else if(string(argv[i]) == "--timings" && i + 1 < argc)
+            timings_path = argv[++i];
+        else if(string(argv[i]) == "--checkpoint" && i + 1 < argc)
+            checkpoint_path = argv[++i];
+        else if(string(argv[i]) == "--checkpoint-every" && i + 1 < argc)
+            checkpoint_interval = max(1, atoi(argv[++i]));
+        else if(string(argv[i]) == "--resume" && i + 1 < argc)
+            resume_path = argv[++i];
+        else if(string(argv[i]) == "--seed" && i + 1 < argc)
+            sample_offset = (unsigned int)atoi(argv[++i]) * SEED_STRIDE;
+        else if(string(argv[i]) == "--merge" && i + 2 < argc)
+        {
+            merge_output = argv[++i];
+            merge_inputs.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        else if(string(argv[i]) == "--denoise-compare")
+        {
+            denoise_compare = 0.95;
+            if(i + 1 < argc && atof(argv[i + 1]) > 0.0)
+                denoise_compare = atof(argv[++i]);
+        }
+    }
+    if(!merge_output.empty())
+        return mergeCheckpoints(merge_output, merge_inputs) ? 0 : 1;
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -41,182 +136,133 @@ int main()
         return -1;
     }
 
-    Shader path_shader(project_path + "src/shader/vs.glsl", project_path + "src/shader/disney_fs.glsl");
-    glm::vec3 origin(0.0f, 0.0f, 10.0f);
-    glm::vec3 horizontal(4.0f, 0.0f, 0.0f);
-    glm::vec3 vertical(0.0f, 4.0f, 0.0f);
-    float focal_length = 6.0;   // 摄像机到远平面的距离
+    Shader path_shader(project_path + "src/shader/vs.glsl", project_path + "src/shader/disney_fs.glsl", ray_stats ? "#define RAY_STATS\n" : "");
+    cornellCamera().bind(path_shader);
 
-    path_shader.bind();
-    path_shader.setVec3("camera.ori", origin);
-    path_shader.setVec3("camera.horizontal", horizontal);
-    path_shader.setVec3("camera.vertical", vertical);
-    path_shader.setVec3("camera.lower_left_corner", origin - horizontal / 2.0f - vertical / 2.0f - glm::vec3(0.0f, 0.0f, focal_length));
-
-    path_shader.setVec3("materials[0].baseColor", 1.0f, 1.0f, 1.0f);    // 白色漫反射
-    path_shader.setFloat("materials[0].metallic", 0.0f);
-    
-    path_shader.setVec3("materials[1].baseColor", 1.0f, 1.0f, 1.0f);    // 光源
-    path_shader.setVec3("materials[1].emissive", 10.0, 10.0, 10.0);
-    path_shader.setFloat("material[0].metallic", 0.0f);
-
-    path_shader.setVec3("materials[2].baseColor", 1.0f, 0.5f, 0.5f);    // 红色
-
-    path_shader.setVec3("materials[3].baseColor", 0.5f, 1.0f, 1.0f);    // 蓝色
-
-    path_shader.setVec3("materials[4].baseColor", 0.5f, 0.5f, 1.0f);    // 紫色
-
-    path_shader.setVec3("materials[5].baseColor", 1.0f, 1.0f, 1.0f);
-    path_shader.setFloat("materials[5].metallic", 0.4f);
-    path_shader.setFloat("materials[5].specular", 0.3f);
-    path_shader.setFloat("materials[5].specularTint", 0.3f);
-    path_shader.setFloat("materials[5].roughness", 0.1f);
-
-    path_shader.setVec3("materials[6].baseColor", 1.0f, 1.0f, 1.0f);
-    path_shader.setFloat("materials[6].metallic", 0.2f);
-    path_shader.setFloat("materials[6].specular", 1.0f);
-    path_shader.setFloat("materials[6].specularTint", 0.5f);
-    path_shader.setFloat("materials[6].roughness", 0.2f);
-
-    path_shader.setVec3("materials[7].baseColor", 1.0f, 1.0f, 1.0f);
-    path_shader.setFloat("materials[7].metallic", 0.2f);
-    path_shader.setFloat("materials[7].specular", 0.5f);
-    path_shader.setFloat("materials[7].specularTint", 0.5f);
-    path_shader.setFloat("materials[7].roughness", 0.3f);
-
-    // 第一个球
-    path_shader.setVec3("spheres[0].center", -1.35f, -1.4f, 2.0f);
-    path_shader.setFloat("spheres[0].radius", 0.6f);
-    path_shader.setUInt("spheres[0].material_id", 5);
-
-    // 第二个球
-    path_shader.setVec3("spheres[1].center", 0.f, -1.4f, 2.0f);
-    path_shader.setFloat("spheres[1].radius", 0.6f);
-    path_shader.setUInt("spheres[1].material_id", 6);
-
-    // 第三个球
-    path_shader.setVec3("spheres[2].center", 1.35f, -1.4f, 2.0f);
-    path_shader.setFloat("spheres[2].radius", 0.6f);
-    path_shader.setUInt("spheres[2].material_id", 7);
-
-    // 后面
-    path_shader.setVec3("tris[0].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[0].p1", -2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[0].p2", 2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[0].n0", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[0].n1", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[0].n2", 0.0f, 0.0f, 1.0f);
-    path_shader.setUInt("tris[0].material_id", 4);
-
-    path_shader.setVec3("tris[1].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[1].p1", 2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[1].p2", 2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[1].n0", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[1].n1", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[1].n2", 0.0f, 0.0f, 1.0f);
-    path_shader.setUInt("tris[1].material_id", 4);
-
-    // 左侧面
-    path_shader.setVec3("tris[2].p0", -2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[2].p1", -2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[2].p2", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[2].n0", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[2].n1", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[2].n2", 1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[2].material_id", 2);
-
-    path_shader.setVec3("tris[3].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[3].p1", -2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[3].p2", -2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[3].n0", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[3].n1", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[3].n2", 1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[3].material_id", 2);
-
-    // 右侧面
-    path_shader.setVec3("tris[4].p0", 2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[4].p1", 2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[4].p2", 2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[4].n0", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[4].n1", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[4].n2", -1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[4].material_id", 3);
-
-    path_shader.setVec3("tris[5].p0", 2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[5].p1", 2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[5].p2", 2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[5].n0", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[5].n1", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[5].n2", -1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[5].material_id", 3);
-
-    // 上面
-    path_shader.setVec3("tris[6].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[6].p1", 2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[6].p2", -2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[6].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[6].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[6].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[6].material_id", 0);
-
-    path_shader.setVec3("tris[7].p0", -2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[7].p1", 2.0f, 2.0f, 0.0f);
-    path_shader.setVec3("tris[7].p2", 2.0f, 2.0f, 4.0f);
-    path_shader.setVec3("tris[7].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[7].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[7].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[7].material_id", 0);
-
-    // 下面
-    path_shader.setVec3("tris[8].p0", -2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[8].p1", -2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[8].p2", 2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[8].n0", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[8].n1", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[8].n2", 0.0f, 1.0f, 0.0f);
-    path_shader.setUInt("tris[8].material_id", 0);
-
-    path_shader.setVec3("tris[9].p0", -2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[9].p1", 2.0f, -2.0f, 4.0f);
-    path_shader.setVec3("tris[9].p2", 2.0f, -2.0f, 0.0f);
-    path_shader.setVec3("tris[9].n0", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[9].n1", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[9].n2", 0.0f, 1.0f, 0.0f);
-    path_shader.setUInt("tris[9].material_id", 0);
-
-    // 顶部光源
-    path_shader.setVec3("tris[10].p0", -0.8f, 2.0f, 1.2f);
-    path_shader.setVec3("tris[10].p1", 0.8f, 2.0f, 2.8f);
-    path_shader.setVec3("tris[10].p2", -0.8f, 2.0f, 2.8f);
-    path_shader.setVec3("tris[10].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[10].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[10].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[10].material_id", 1);
-
-    path_shader.setVec3("tris[11].p0", -0.8f, 2.0f, 1.2f);
-    path_shader.setVec3("tris[11].p1", 0.8f, 2.0f, 1.2f);
-    path_shader.setVec3("tris[11].p2", 0.8f, 2.0f, 2.8f);
-    path_shader.setVec3("tris[11].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[11].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[11].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[11].material_id", 1);
+    // 康奈尔盒，三个球为不同参数的 Disney BRDF
+    setCornellBox(path_shader);
+    setCornellDisneyMaterials(path_shader);
+    setCornellSpheres(path_shader, 5, 6, 7);
+
+    path_shader.setBool("furnace_test", furnace);
+    path_shader.setBool("energy_compensation", compensation);
+    if(furnace)     // 三个白色金属球，粗糙度依次增大，能量守恒时应与背景一致
+    {
+        for(int i = 5; i <= 7; ++i)
+        {
+            string material = "materials[" + to_string(i) + "]";
+            path_shader.setVec3(material + ".baseColor", 1.0f, 1.0f, 1.0f);
+            path_shader.setFloat(material + ".metallic", 1.0f);
+            path_shader.setFloat(material + ".roughness", 0.2f + 0.4f * (i - 5));
+            path_shader.setFloat(material + ".sheen", 0.0f);
+            path_shader.setFloat(material + ".clearcoat", 0.0f);
+        }
+    }
 
     Render render(SCR_WIDTH, SCR_HEIGHT);
+    if(ray_stats)
+        render.enableRayStats();
+    Sampler sampler(project_path + "cache/sampler_tables.bin");
+    sampler.bind(path_shader, UNIT_SAMPLER);
+    AlbedoLut albedo_lut(project_path + "cache/albedo_lut.bin");
+    albedo_lut.bind(path_shader, UNIT_ALBEDO_LUT);
+    Environment environment(env_path);
+    environment.bind(path_shader, UNIT_ENVIRONMENT);
+
+    // 顶部光源的两个三角形加入光源BVH，其余三角形不发光
+    LightBVH lights;
+    addCornellLights(path_shader, lights, 10.0f);
+    lights.build();
+    lights.bind(path_shader, UNIT_LIGHTS);
+
+    render.enableReSTIR(project_path + "src/shader/disney_fs.glsl");
+    render.setReSTIR(restir);
+    if(restir_compare)
+    {
+        compareReSTIR(render, path_shader);
+        glfwTerminate();
+        return 0;
+    }
+    if(denoise_compare > 0.0)
+    {
+        compareDenoiser(render, path_shader, denoise_compare);
+        glfwTerminate();
+        return 0;
+    }
+    render.setDenoise(denoise ? DENOISE_ITERATIONS : 0);
 
     unsigned int frame_count = 0;
     const unsigned int frame_time_constraint = 20;   // 每帧最少要花费的时间，ms
+    time_t start = clock();
+    double title_time = glfwGetTime();
+    double render_start = title_time;   // 这次累积开始的时间
+
+    Checkpoint checkpoint;
+    if(!checkpoint_path.empty())
+        checkpoint.init(checkpoint_path, SCR_WIDTH, SCR_HEIGHT);
+    Checkpoint::State resumed;
+    if(!resume_path.empty() && Checkpoint::load(resume_path, resumed))
+    {
+        if(resumed.width != SCR_WIDTH || resumed.height != SCR_HEIGHT || resumed.scene_hash != sceneHash(path_shader, render))
+            std::cout << "ERROR::DISNEY::CHECKPOINT_MISMATCH: " << resume_path << std::endl;
+        else
+        {
+            render.loadAccumulation(resumed.color, resumed.moment, resumed.normal, resumed.albedo);
+            frame_count = resumed.frame_count;
+            sample_offset = resumed.sample_offset;
+            render_start -= resumed.seconds;
+            printf("resumed from %s: frame %u, %.1f s\n", resume_path.c_str(), frame_count, resumed.seconds);
+        }
+    }
+    monitor.init(SCR_WIDTH, SCR_HEIGHT, frame_count);
+    path_shader.bind();
+    path_shader.setUInt("sample_offset", sample_offset);
+    Checkpoint::State checkpoint_state;
+    checkpoint_state.sample_offset = sample_offset;
     while (!glfwWindowShouldClose(window))
     {
         time_t begin = clock();
         frame_count ++;
         //printf("%d ", frame_count);
-        processInput(window);
+        bool restir_state = render.restir();
+        processInput(window, render);
+        if(render.restir() != restir_state)     // 切换 ReSTIR 时累积的结果已经清空
+        {
+            monitor.reset();
+            render_start = glfwGetTime();
+        }
 
         glClearColor(0.f, 0.0f, 0.f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
         path_shader.bind();
         path_shader.setUInt("frame_count", frame_count);
         render.draw(path_shader);
+        if(furnace && frame_count % 50 == 0)
+            reportFurnace(render, frame_count, start);
+        if(ray_stats && frame_count % 50 == 0)
+            printf("frame %u: %s\n", frame_count, render.rayStatsSummary().c_str());
+        if(monitor.update(render, glfwGetTime() - render_start))
+            glfwSetWindowShouldClose(window, true);
+        checkpoint_state.frame_count = frame_count;
+        checkpoint_state.seconds = glfwGetTime() - render_start;
+        if(checkpoint.enabled())
+        {
+            if(frame_count % checkpoint_interval == 0)
+            {
+                checkpoint_state.scene_hash = sceneHash(path_shader, render);
+                checkpoint.submit(render, checkpoint_state);
+            }
+            checkpoint.poll();
+        }
+        if(glfwGetTime() - title_time > 0.5)
+        {
+            string title = "GLPathTracer | " + render.timer().summary();
+            string error = monitor.summary();
+            if(!error.empty())
+                title += " | " + error;
+            glfwSetWindowTitle(window, title.c_str());
+            title_time = glfwGetTime();
+        }
 
         time_t end = clock();
         if(end - begin < frame_time_constraint)
@@ -228,13 +274,270 @@ int main()
         glfwPollEvents();
     }
 
+    monitor.finish(render);
+    if(checkpoint.enabled())
+    {
+        if(frame_count % checkpoint_interval != 0)
+        {
+            checkpoint.flush();
+            checkpoint_state.scene_hash = sceneHash(path_shader, render);
+            checkpoint.submit(render, checkpoint_state);
+        }
+        checkpoint.flush();
+        printf("checkpoint: frame %u, %.1f s, %u written\n", checkpoint_state.frame_count, checkpoint_state.seconds, checkpoint.written());
+    }
+    if(!timings_path.empty())
+        render.timer().write(timings_path);
     glfwTerminate();
     return 0;
 
 }
 
-void processInput(GLFWwindow *window)
+// 统计白炉测试的结果：能量守恒的BRDF在白色环境中应处处为1，偏差只来自噪声和BRDF本身的能量损失/增益
+void reportFurnace(Render& render, unsigned int frame_count, time_t start)
+{
+    vector<float> color, moment;
+    render.readAccumulation(color, moment);
+
+    double deviation = 0.0, max_deviation = 0.0, rel_error = 0.0, spp = 0.0;
+    size_t pixels = color.size() / 4;
+    for(size_t i = 0; i < pixels; ++i)
+    {
+        float lum = 0.3f * color[i * 4] + 0.6f * color[i * 4 + 1] + 0.1f * color[i * 4 + 2];
+        float n = moment[i * 4 + 1];
+        float variance = moment[i * 4] - lum * lum;
+        deviation += fabs(lum - 1.0f);
+        max_deviation = max(max_deviation, (double)fabs(lum - 1.0f));
+        if(n > 1 && lum > 0)
+            rel_error += sqrt(max(0.0f, variance) / (n - 1)) / lum;
+        spp += n;
+    }
+    printf("furnace frame %u, %.1f s: mean |1-L| %.4f, max |1-L| %.4f, rel. std. error %.4f, %.0f spp\n",
+        frame_count, (float)(clock() - start) / CLOCKS_PER_SEC,
+        deviation / pixels, max_deviation, rel_error / pixels, spp / pixels);
+}
+
+// 对比直接光照的两种估计方式：先用逐像素光源采样累积足够多帧作为参考，再分别从零开始累积，
+// 每帧输出累计耗时和相对均方误差，1/(relMSE * 秒) 越大说明单位时间内的质量越高
+void compareReSTIR(Render& render, Shader& path_shader)
+{
+    const unsigned int reference_frames = 512;
+    const unsigned int frames = 32;
+    vector<float> reference, color, moment;
+
+    path_shader.bind();
+    path_shader.setBool("direct_only", true);
+    path_shader.setUInt("sample_offset", 1 << 20);
+    render.setReSTIR(false);
+    render.reset();
+    for(unsigned int i = 1; i <= reference_frames; ++i)
+    {
+        path_shader.bind();
+        path_shader.setUInt("frame_count", i);
+        render.draw(path_shader);
+    }
+    render.readAccumulation(reference, moment);
+    path_shader.bind();
+    path_shader.setUInt("sample_offset", 0);
+
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        render.setReSTIR(mode == 1);
+        render.reset();
+        double total = 0.0;
+        for(unsigned int i = 1; i <= frames; ++i)
+        {
+            glFinish();
+            double begin = glfwGetTime();
+            path_shader.bind();
+            path_shader.setUInt("frame_count", reference_frames + i);
+            render.draw(path_shader);
+            glFinish();
+            total += glfwGetTime() - begin;
+
+            render.readAccumulation(color, moment);
+            double rel_mse = 0.0;
+            size_t pixels = color.size() / 4;
+            for(size_t p = 0; p < pixels; ++p)
+            {
+                for(int c = 0; c < 3; ++c)
+                {
+                    double r = reference[p * 4 + c];
+                    double d = color[p * 4 + c] - r;
+                    rel_mse += d * d / (r * r + 1e-2);
+                }
+            }
+            rel_mse /= pixels * 3;
+            printf("%s frame %2u: %8.1f ms, relMSE %.5f, 1/(relMSE*s) %.1f\n",
+                mode == 1 ? "restir" : "nee   ", i, total * 1000.0, rel_mse, 1.0 / (rel_mse * total));
+        }
+    }
+
+    path_shader.bind();
+    path_shader.setBool("direct_only", false);
+    render.setReSTIR(false);
+}
+
+// 先用足够多的样本累积参考图，再从零开始累积，每帧比较不降噪和降噪后的图像与参考图的 SSIM，
+// 输出两者第一次达到 target_ssim 时的平均样本数
+void compareDenoiser(Render& render, Shader& path_shader, double target_ssim)
+{
+    const unsigned int reference_frames = 512;
+    const unsigned int frames = 64;
+    vector<float> reference, raw, denoised, moment;
+
+    render.setDenoise(0);
+    path_shader.bind();
+    path_shader.setUInt("sample_offset", 1 << 20);
+    render.reset();
+    for(unsigned int i = 1; i <= reference_frames; ++i)
+    {
+        path_shader.bind();
+        path_shader.setUInt("frame_count", i);
+        render.draw(path_shader);
+    }
+    render.readAccumulation(reference, moment);
+    path_shader.bind();
+    path_shader.setUInt("sample_offset", 0);
+
+    render.setDenoise(DENOISE_ITERATIONS);
+    render.reset();
+    double raw_spp = 0.0, denoised_spp = 0.0;
+    for(unsigned int i = 1; i <= frames && (raw_spp == 0.0 || denoised_spp == 0.0); ++i)
+    {
+        path_shader.bind();
+        path_shader.setUInt("frame_count", reference_frames + i);
+        render.draw(path_shader);
+        render.readAccumulation(raw, moment);
+        render.readDenoised(denoised);
+
+        double spp = 0.0;
+        for(size_t p = 1; p < moment.size(); p += 4)
+            spp += moment[p];
+        spp /= moment.size() / 4;
+        double raw_ssim = ssim(raw, reference, SCR_WIDTH, SCR_HEIGHT);
+        double denoised_ssim = ssim(denoised, reference, SCR_WIDTH, SCR_HEIGHT);
+        printf("frame %2u, %5.0f spp: SSIM %.4f, denoised %.4f\n", i, spp, raw_ssim, denoised_ssim);
+        if(raw_spp == 0.0 && raw_ssim >= target_ssim)
+            raw_spp = spp;
+        if(denoised_spp == 0.0 && denoised_ssim >= target_ssim)
+            denoised_spp = spp;
+    }
+    // 0 表示在 frames 帧内没有达到
+    printf("SSIM %.3f reached at %.0f spp without denoising, %.0f spp with denoising\n", target_ssim, raw_spp, denoised_spp);
+    render.setDenoise(0);
+}
+
+// 两张线性颜色的图像按 output_fs.glsl 色调映射（见 gl_util.h 的 toneMap）并做 gamma 校正后，在亮度上计算平均 SSIM（Wang et al. 2004）
+// 11x11、σ = 1.5 的高斯窗口，可分离地在行和列上各卷积一次
+double ssim(const vector<float>& a, const vector<float>& b, int width, int height)
+{
+    const int radius = 5;
+    float window[2 * radius + 1];
+    float total = 0.0f;
+    for(int i = -radius; i <= radius; ++i)
+        total += window[i + radius] = exp(-0.5f * i * i / (1.5f * 1.5f));
+    for(float& w : window)
+        w /= total;
+
+    auto display = [](const vector<float>& image, size_t p)
+    {
+        return pow(luminance(toneMap(glm::vec3(image[p * 4], image[p * 4 + 1], image[p * 4 + 2]))), 1.0f / DISPLAY_GAMMA);
+    };
+    size_t pixels = (size_t)width * height;
+    // 0: x, 1: y, 2: x^2, 3: y^2, 4: xy
+    vector<float> maps[5], blurred[5];
+    for(int k = 0; k < 5; ++k)
+    {
+        maps[k].resize(pixels);
+        blurred[k].assign(pixels, 0.0f);
+    }
+    for(size_t p = 0; p < pixels; ++p)
+    {
+        float x = display(a, p), y = display(b, p);
+        maps[0][p] = x;
+        maps[1][p] = y;
+        maps[2][p] = x * x;
+        maps[3][p] = y * y;
+        maps[4][p] = x * y;
+    }
+    vector<float> row(pixels);
+    for(int k = 0; k < 5; ++k)
+    {
+        for(int y = 0; y < height; ++y)
+            for(int x = 0; x < width; ++x)
+            {
+                float s = 0.0f;
+                for(int i = -radius; i <= radius; ++i)
+                    s += window[i + radius] * maps[k][y * width + min(max(x + i, 0), width - 1)];
+                row[y * width + x] = s;
+            }
+        for(int y = 0; y < height; ++y)
+            for(int x = 0; x < width; ++x)
+            {
+                float s = 0.0f;
+                for(int i = -radius; i <= radius; ++i)
+                    s += window[i + radius] * row[min(max(y + i, 0), height - 1) * width + x];
+                blurred[k][y * width + x] = s;
+            }
+    }
+
+    const double c1 = 0.01 * 0.01, c2 = 0.03 * 0.03;
+    double sum = 0.0;
+    for(size_t p = 0; p < pixels; ++p)
+    {
+        double mx = blurred[0][p], my = blurred[1][p];
+        double vx = blurred[2][p] - mx * mx, vy = blurred[3][p] - my * my, cxy = blurred[4][p] - mx * my;
+        sum += (2.0 * mx * my + c1) * (2.0 * cxy + c2) / ((mx * mx + my * my + c1) * (vx + vy + c2));
+    }
+    return sum / pixels;
+}
+
+void processInput(GLFWwindow *window, Render& render)
 {
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+
+    // R 切换 ReSTIR，只在按下的那一帧生效
+    static bool r_pressed = false;
+    bool r_down = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if(r_down && !r_pressed)
+        render.setReSTIR(!render.restir());
+    r_pressed = r_down;
+
+    // D 切换降噪，只影响显示，累积的结果不变
+    static bool d_pressed = false;
+    bool d_down = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    if(d_down && !d_pressed)
+        render.setDenoise(render.denoiseIterations() > 0 ? 0 : DENOISE_ITERATIONS);
+    d_pressed = d_down;
+}
+
+bool mergeCheckpoints(const string& output, const vector<string>& inputs)
+{
+    vector<Checkpoint::State> states(inputs.size());
+    for(size_t i = 0; i < inputs.size(); ++i)
+    {
+        if(!Checkpoint::load(inputs[i], states[i]))
+            return false;
+    }
+    Checkpoint::State merged;
+    if(!Checkpoint::merge(states, merged) || !Checkpoint::save(output, merged))
+        return false;
+    double spp = 0.0;
+    for(size_t i = 0; i < merged.moment.size(); i += 4)
+        spp += merged.moment[i + 1];
+    printf("merged %zu checkpoints into %s: %.0f spp, %.1f s\n", inputs.size(), output.c_str(), spp / (merged.width * merged.height), merged.seconds);
+    return true;
+}
+
+// 检查点的场景哈希：场景的参数都在 path_shader 的 uniform 上，再混入 ReSTIR 的开关，开关时累积的是不同的量
+// 保存检查点时重新计算，运行中改过的 uniform 也能反映出来；帧号、样本序号和 Render 每帧设置的 uniform 不算在内
+uint64_t sceneHash(const Shader& path_shader, const Render& render)
+{
+    vector<string> ignored = Render::frameUniforms();
+    ignored.push_back("frame_count");
+    ignored.push_back("sample_offset");
+    uint64_t hash = path_shader.hashUniforms(ignored);
+    return (hash ^ (render.restir() ? 1u : 0u)) * 0x100000001b3ull;     // 与 hashUniforms 相同的 FNV-1a
 }
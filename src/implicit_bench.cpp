@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/implicit_function.h"
+#include "common/implicit_caster.h"
+#include "common/raa.h"
+#include "common/parallel.h"
+#include "common/implicit_presets.h"
+
+using namespace std;
+using raa::Affine;
+using raa::Float8;
+using raa::Interval;
+
+// 不需要 OpenGL 的隐式曲面基准，在CPU上测 raa.h 和 ImplicitCaster：
+//   1. 随机包围盒上的区间算术、随机光线段上的 RAA，标量和 Float8 各测一遍，单线程，单位为每秒求值的区间数
+//   2. 每个区间上取若干点，检查点上的取值范围与整个区间的结果相交，不相交说明舍入不对
+//   3. ImplicitCaster 对 implicit_surface 的主光线求交，所有线程
+// 用法：implicit_bench [--surface "<expr>"] [--seconds s]
+
+// 与 implicit_surface.cpp 相同的分辨率和摄像机
+const int WIDTH = 600;
+const int HEIGHT = 600;
+
+const int BOXES = 4096;             // 必须是 8 的倍数
+const int CHECK_POINTS = 16;
+
+namespace
+{
+    // 反复调用 pass 直到超过 seconds 秒，返回每秒处理的区间数，pass 每次处理 count 个
+    double throughput(double seconds, size_t count, const function<void()>& pass)
+    {
+        pass();     // 预热
+        size_t done = 0;
+        double begin = wallSeconds(), elapsed = 0.0;
+        while(elapsed < seconds)
+        {
+            pass();
+            done += count;
+            elapsed = wallSeconds() - begin;
+        }
+        return done / elapsed;
+    }
+
+    // 把 8 个标量的第 i 个放到第 i 个通道
+    Float8 gather(const vector<float>& values, size_t first)
+    {
+        return Float8::load(&values[first]);
+    }
+
+    struct Segments
+    {
+        vector<float> ox, oy, oz, dx, dy, dz, t0, t1;
+    };
+}
+
+void benchmarkKernels(const ImplicitFunction& function, double seconds);
+void benchmarkCaster(const ImplicitFunction& function);
+
+int main(int argc, char** argv)
+{
+    vector<string> expressions(begin(SURFACES), end(SURFACES));
+    double seconds = 1.0;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(string(argv[i]) == "--surface" && i + 1 < argc)
+            expressions.assign(1, argv[++i]);
+        else if(string(argv[i]) == "--seconds" && i + 1 < argc)
+            seconds = atof(argv[++i]);
+    }
+
+#ifdef __AVX2__
+    printf("raa::Float8: AVX2\n");
+#else
+    printf("raa::Float8: scalar fallback, compile with AVX2 enabled for SIMD\n");
+#endif
+    for(const string& expression : expressions)
+    {
+        ImplicitFunction function(expression);
+        if(!function.valid())
+            continue;
+        printf("\n%s (%zu RAA instructions)\n", expression.c_str(), function.instructions());
+        benchmarkKernels(function, seconds);
+        benchmarkCaster(function);
+    }
+    return 0;
+}
+
+void benchmarkKernels(const ImplicitFunction& function, double seconds)
+{
+    mt19937 rng(1);
+    uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    // 包围盒：中心在曲面的包围盒内，边长在 [0.01, 0.5]
+    vector<float> lo[3], hi[3];
+    for(int k = 0; k < 3; ++k)
+    {
+        lo[k].resize(BOXES);
+        hi[k].resize(BOXES);
+    }
+    for(int i = 0; i < BOXES; ++i)
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            float center = SURFACE_MIN[k] + (SURFACE_MAX[k] - SURFACE_MIN[k]) * uniform(rng);
+            float size = 0.01f + 0.49f * uniform(rng);
+            lo[k][i] = center - 0.5f * size;
+            hi[k][i] = center + 0.5f * size;
+        }
+    }
+
+    // 光线段：起点在包围盒内，方向均匀，长度在 [0.01, 0.5]
+    Segments s;
+    for(int i = 0; i < BOXES; ++i)
+    {
+        float z = 1.0f - 2.0f * uniform(rng), phi = 6.2831853f * uniform(rng);
+        float r = sqrt(max(0.0f, 1.0f - z * z));
+        s.ox.push_back(SURFACE_MIN.x + 3.0f * uniform(rng));
+        s.oy.push_back(SURFACE_MIN.y + 3.0f * uniform(rng));
+        s.oz.push_back(SURFACE_MIN.z + 3.0f * uniform(rng));
+        s.dx.push_back(r * cos(phi));
+        s.dy.push_back(r * sin(phi));
+        s.dz.push_back(z);
+        float t = uniform(rng);
+        s.t0.push_back(t);
+        s.t1.push_back(t + 0.01f + 0.49f * uniform(rng));
+    }
+
+    volatile float sink = 0.0f;     // 防止求值被优化掉
+    vector<Interval<float>> interval_values;
+    vector<Interval<Float8>> interval8_values;
+    vector<Affine<float>> affine_values;
+    vector<Affine<Float8>> affine8_values;
+
+    double ia = throughput(seconds, BOXES, [&]() {
+        float sum = 0.0f;
+        for(int i = 0; i < BOXES; ++i)
+        {
+            Interval<float> x(lo[0][i], hi[0][i]), y(lo[1][i], hi[1][i]), z(lo[2][i], hi[2][i]);
+            sum += function.evaluateRange(x, y, z, interval_values).lo;
+        }
+        sink = sink + sum;
+    });
+    double ia8 = throughput(seconds, BOXES, [&]() {
+        Float8 sum(0.0f);
+        for(int i = 0; i < BOXES; i += 8)
+        {
+            Interval<Float8> x(gather(lo[0], i), gather(hi[0], i)), y(gather(lo[1], i), gather(hi[1], i)), z(gather(lo[2], i), gather(hi[2], i));
+            sum = sum + function.evaluateRange(x, y, z, interval8_values).lo;
+        }
+        float lanes[8];
+        sum.store(lanes);
+        sink = sink + lanes[0];
+    });
+
+    // RAA 的一个通道是一条光线上的一段，Float8 时是 8 条不同的光线；方向对每条光线是常数，Float8 时逐通道乘
+    double raa1 = throughput(seconds, BOXES, [&]() {
+        float sum = 0.0f;
+        for(int i = 0; i < BOXES; ++i)
+        {
+            Affine<float> t = raa::toAffine(Interval<float>(s.t0[i], s.t1[i]));
+            Affine<float> r = function.evaluateRange(raa::add(raa::mul(t, s.dx[i]), s.ox[i]), raa::add(raa::mul(t, s.dy[i]), s.oy[i]), raa::add(raa::mul(t, s.dz[i]), s.oz[i]), affine_values);
+            sum += r.z;
+        }
+        sink = sink + sum;
+    });
+    double raa8 = throughput(seconds, BOXES, [&]() {
+        Float8 sum(0.0f);
+        for(int i = 0; i < BOXES; i += 8)
+        {
+            Affine<Float8> t = raa::toAffine(Interval<Float8>(gather(s.t0, i), gather(s.t1, i)));
+            Affine<Float8> r = function.evaluateRange(raa::add(raa::mul(t, gather(s.dx, i)), gather(s.ox, i)),
+                                                      raa::add(raa::mul(t, gather(s.dy, i)), gather(s.oy, i)),
+                                                      raa::add(raa::mul(t, gather(s.dz, i)), gather(s.oz, i)), affine8_values);
+            sum = sum + r.z;
+        }
+        float lanes[8];
+        sum.store(lanes);
+        sink = sink + lanes[0];
+    });
+    printf("  IA:  %.2f M intervals/s scalar, %.2f M intervals/s Float8 (%.1fx)\n", ia * 1e-6, ia8 * 1e-6, ia8 / ia);
+    printf("  RAA: %.2f M intervals/s scalar, %.2f M intervals/s Float8 (%.1fx)\n", raa1 * 1e-6, raa8 * 1e-6, raa8 / raa1);
+
+    // 点上的区间由退化的输入区间求出，同样向外舍入，一定包含实数运算的函数值
+    int ia_errors = 0, raa_errors = 0;
+    for(int i = 0; i < BOXES; ++i)
+    {
+        Interval<float> box = function.evaluateRange(Interval<float>(lo[0][i], hi[0][i]), Interval<float>(lo[1][i], hi[1][i]), Interval<float>(lo[2][i], hi[2][i]), interval_values);
+        Affine<float> t = raa::toAffine(Interval<float>(s.t0[i], s.t1[i]));
+        Interval<float> ray = raa::toInterval(function.evaluateRange(raa::add(raa::mul(t, s.dx[i]), s.ox[i]), raa::add(raa::mul(t, s.dy[i]), s.oy[i]), raa::add(raa::mul(t, s.dz[i]), s.oz[i]), affine_values));
+        for(int k = 0; k < CHECK_POINTS; ++k)
+        {
+            Interval<float> p[3];
+            for(int c = 0; c < 3; ++c)
+                p[c] = Interval<float>(lo[c][i] + (hi[c][i] - lo[c][i]) * uniform(rng));
+            Interval<float> f = function.evaluateRange(p[0], p[1], p[2], interval_values);
+            ia_errors += f.hi < box.lo || f.lo > box.hi;
+
+            Interval<float> u(s.t0[i] + (s.t1[i] - s.t0[i]) * uniform(rng));
+            Interval<float> g = function.evaluateRange(raa::add(raa::mul(u, s.dx[i]), s.ox[i]), raa::add(raa::mul(u, s.dy[i]), s.oy[i]), raa::add(raa::mul(u, s.dz[i]), s.oz[i]), interval_values);
+            raa_errors += g.hi < ray.lo || g.lo > ray.hi;
+        }
+    }
+    printf("  enclosure check: %d IA and %d RAA violations in %d points\n", ia_errors, raa_errors, BOXES * CHECK_POINTS);
+}
+
+void benchmarkCaster(const ImplicitFunction& function)
+{
+    glm::vec3 origin(0.0f, 0.0f, 8.0f);
+    glm::vec3 horizontal(4.0f, 0.0f, 0.0f);
+    glm::vec3 vertical(0.0f, 4.0f, 0.0f);
+    glm::vec3 lower_left_corner = origin - horizontal / 2.0f - vertical / 2.0f - glm::vec3(0.0f, 0.0f, 6.0f);
+
+    vector<size_t> hits(HEIGHT, 0), intervals(HEIGHT, 0);
+    double begin = wallSeconds();
+    parallelFor(0, HEIGHT, [&](int first, int last) {
+        ImplicitCaster caster(function, SURFACE_MIN, SURFACE_MAX);
+        for(int y = first; y < last; ++y)
+        {
+            size_t before = caster.intervals();
+            for(int x = 0; x < WIDTH; ++x)
+            {
+                float u = (x + 0.5f) / (WIDTH - 1), v = (y + 0.5f) / (HEIGHT - 1);
+                glm::vec3 dir = glm::normalize(lower_left_corner + u * horizontal + v * vertical - origin);
+                float t;
+                hits[y] += caster.intersect(origin, dir, 0.0f, 1e8f, t);
+            }
+            intervals[y] = caster.intervals() - before;
+        }
+    });
+    double elapsed = wallSeconds() - begin;
+
+    size_t hit_count = 0, interval_count = 0;
+    for(int y = 0; y < HEIGHT; ++y)
+    {
+        hit_count += hits[y];
+        interval_count += intervals[y];
+    }
+    double rays = (double)WIDTH * HEIGHT;
+    printf("  caster: %.2f M rays/s, %.2f M intervals/s on %u threads, %.1f intervals per ray, %zu hits\n",
+           rays / elapsed * 1e-6, interval_count / elapsed * 1e-6, max(1u, thread::hardware_concurrency()), interval_count / rays, hit_count);
+}
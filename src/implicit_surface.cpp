@@ -1,12 +1,23 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "common/shader.h"
 #include "common/render.h"
+#include "common/sampler.h"
+#include "common/implicit_function.h"
+#include "common/implicit_bricks.h"
+#include "common/implicit_caster.h"
+#include "common/implicit_tiles.h"
+#include "common/primitive_bvh.h"
+#include "common/implicit_presets.h"
 #include "config.h"
 #include <time.h>
 #include <windows.h>
+#include <glm/gtc/matrix_transform.hpp>
 
 using namespace std;
 
@@ -16,10 +27,56 @@ extern "C"
 __declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001;
 }
 
-void processInput(GLFWwindow *window);
+int processInput(GLFWwindow *window, Render& render);
+void reportEvaluations(Render& render, unsigned int frame_count);
+void buildBricks(ImplicitBricks& bricks, const vector<ImplicitFunction>& functions);
+int validatePrimaryHits(Render& render, Shader& shader, const ImplicitFunction& function, const glm::vec3& origin, const glm::vec3& horizontal, const glm::vec3& vertical, const glm::vec3& lower_left_corner);
 
-int main()
+int main(int argc, char** argv)
 {
+    // --surface "<expr>": 中间的曲面；--instances n: 在地面上再放 n 个缩小的预设曲面，用于测试多个隐式曲面的场景
+    // --validate: 主光线的交点与CPU上的 ImplicitCaster 比较后退出，有不一致的像素时返回 1
+    // --no-tiles: 不按块剔除中间曲面的主光线，用于比较
+    // --ray-stats: 统计每帧的光线数、包围盒和图元的测试数，定期输出 Mrays/s
+    // --evaluations: 定期读回累积纹理，输出每条光线的 RAA 求值次数，读回会阻塞，只用于调试
+    // --heatmap <metric>: 显示逐像素开销的热度图，metric 为 bounces、shadow、boxes、primitives、iterations、steps，隐含 --ray-stats；运行时按 H 切换
+    // --heatmap-dump <file>: 渲染一帧后把热度图的量写成 PFM 并退出，默认的量为 iterations
+    string expression = SURFACES[0];
+    int instances = 0;
+    bool validate = false;
+    bool tile_culling = true;
+    bool ray_stats = false;
+    bool evaluations = false;
+    int heatmap = RayStats::HEATMAP_OFF;
+    string heatmap_dump;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(string(argv[i]) == "--surface" && i + 1 < argc)
+            expression = argv[++i];
+        else if(string(argv[i]) == "--instances" && i + 1 < argc)
+            instances = max(0, atoi(argv[++i]));
+        else if(string(argv[i]) == "--validate")
+            validate = true;
+        else if(string(argv[i]) == "--no-tiles")
+            tile_culling = false;
+        else if(string(argv[i]) == "--ray-stats")
+            ray_stats = true;
+        else if(string(argv[i]) == "--evaluations")
+            evaluations = true;
+        else if(string(argv[i]) == "--heatmap" && i + 1 < argc)
+        {
+            heatmap = RayStats::metricByName(argv[++i]);
+            if(heatmap == RayStats::HEATMAP_OFF)
+                std::cout << "ERROR::IMPLICIT::UNKNOWN_HEATMAP: " << argv[i] << std::endl;
+            ray_stats = true;
+        }
+        else if(string(argv[i]) == "--heatmap-dump" && i + 1 < argc)
+        {
+            heatmap_dump = argv[++i];
+            ray_stats = true;
+        }
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -41,7 +98,18 @@ int main()
         return -1;
     }
 
-    Shader path_shader(project_path + "src/shader/vs.glsl", project_path + "src/shader/implicit_fs.glsl");
+    // 第 0 个函数是中间的曲面，数字键切换；有小曲面时之后依次是各个预设曲面
+    // 每个函数一组砖块，编号与函数相同
+    const int preset_count = sizeof(SURFACES) / sizeof(SURFACES[0]);
+    vector<ImplicitFunction> functions(1, ImplicitFunction(expression));
+    if(!functions[0].valid())
+        functions[0].compile(SURFACES[0]);
+    for(int i = 0; i < preset_count && instances > 0; ++i)
+        functions.emplace_back(SURFACES[i]);
+    ImplicitShaderCache shaders(project_path + "src/shader/vs.glsl", project_path + "src/shader/implicit_fs.glsl", ray_stats ? "#define RAY_STATS\n" : "");
+    ImplicitShaderCache tile_shaders(project_path + "src/shader/fullscreen_vs.glsl", project_path + "src/shader/implicit_tiles_fs.glsl");
+    Shader* current = &shaders.get(functions);
+    Shader& path_shader = *current;
     glm::vec3 origin(0.0f, 0.0f, 8.0f);
     glm::vec3 horizontal(4.0f, 0.0f, 0.0f);
     glm::vec3 vertical(0.0f, 4.0f, 0.0f);
@@ -51,7 +119,8 @@ int main()
     path_shader.setVec3("camera.ori", origin);
     path_shader.setVec3("camera.horizontal", horizontal);
     path_shader.setVec3("camera.vertical", vertical);
-    path_shader.setVec3("camera.lower_left_corner", origin - horizontal / 2.0f - vertical / 2.0f - glm::vec3(0.0f, 0.0f, focal_length));
+    glm::vec3 lower_left_corner = origin - horizontal / 2.0f - vertical / 2.0f - glm::vec3(0.0f, 0.0f, focal_length);
+    path_shader.setVec3("camera.lower_left_corner", lower_left_corner);
 
     path_shader.setVec3("materials[0].color", 1.0f, 1.0f, 1.0f);    // 白色漫反射
     path_shader.setFloat("materials[0].specularRate", 0.0f);
@@ -62,95 +131,73 @@ int main()
     path_shader.setFloat("materials[1].refraceRate", 0.0f);
     path_shader.setBool("materials[1].isEmissive", true);
 
-    path_shader.setVec3("aabb_min", -1.5f, -1.5f, -1.5f);
-    path_shader.setVec3("aabb_max", 1.5f, 1.5f, 1.5f);
-
+    PrimitiveBVH bvh;
+    int center = bvh.addImplicit(glm::mat4(1.0f), SURFACE_MIN, SURFACE_MAX, 0, 0, 1);
+    // 小曲面排成网格，缩小到 0.2 倍放在地面上，绕 y 轴转不同的角度
+    int columns = (int)ceil(sqrt((float)instances));
+    for(int i = 0; i < instances; ++i)
+    {
+        float spacing = 3.6f / columns;
+        glm::vec3 position(-1.8f + spacing * (i % columns + 0.5f), -2.0f + 0.3f, -1.8f + spacing * (i / columns + 0.5f));
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+        transform = glm::rotate(transform, 0.7f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+        transform = glm::scale(transform, glm::vec3(0.2f));
+        int function = 1 + i % preset_count;
+        bvh.addImplicit(transform, SURFACE_MIN, SURFACE_MAX, function, function, 0);
+    }
     // 后面
-    path_shader.setVec3("tris[0].p0", -2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[0].p1", -2.0f, -2.0f, -2.0f);
-    path_shader.setVec3("tris[0].p2", 2.0f, -2.0f, -2.0f);
-    path_shader.setVec3("tris[0].n0", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[0].n1", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[0].n2", 0.0f, 0.0f, 1.0f);
-    path_shader.setUInt("tris[0].material_id", 0);
-
-    path_shader.setVec3("tris[1].p0", -2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[1].p1", 2.0f, -2.0f, -2.0f);
-    path_shader.setVec3("tris[1].p2", 2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[1].n0", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[1].n1", 0.0f, 0.0f, 1.0f);
-    path_shader.setVec3("tris[1].n2", 0.0f, 0.0f, 1.0f);
-    path_shader.setUInt("tris[1].material_id", 0);
-
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(-2.0f, -2.0f, -2.0f), glm::vec3(2.0f, -2.0f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0);
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(2.0f, -2.0f, -2.0f), glm::vec3(2.0f, 2.0f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0);
     // 左侧面
-    path_shader.setVec3("tris[2].p0", -2.0f, 2.0f, 2.0f);
-    path_shader.setVec3("tris[2].p1", -2.0f, -2.0f, 2.0f);
-    path_shader.setVec3("tris[2].p2", -2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[2].n0", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[2].n1", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[2].n2", 1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[2].material_id", 0);
-
-    path_shader.setVec3("tris[3].p0", -2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[3].p1", -2.0f, -2.0f, 2.0f);
-    path_shader.setVec3("tris[3].p2", -2.0f, -2.0f, -2.0f);
-    path_shader.setVec3("tris[3].n0", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[3].n1", 1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[3].n2", 1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[3].material_id", 0);
-
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, 2.0f), glm::vec3(-2.0f, -2.0f, 2.0f), glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(1.0f, 0.0f, 0.0f), 0);
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(-2.0f, -2.0f, 2.0f), glm::vec3(-2.0f, -2.0f, -2.0f), glm::vec3(1.0f, 0.0f, 0.0f), 0);
     // 右侧面
-    path_shader.setVec3("tris[4].p0", 2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[4].p1", 2.0f, -2.0f, 2.0f);
-    path_shader.setVec3("tris[4].p2", 2.0f, 2.0f, 2.0f);
-    path_shader.setVec3("tris[4].n0", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[4].n1", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[4].n2", -1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[4].material_id", 0);
-
-    path_shader.setVec3("tris[5].p0", 2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[5].p1", 2.0f, -2.0f, -2.0f);
-    path_shader.setVec3("tris[5].p2", 2.0f, -2.0f, 2.0f);
-    path_shader.setVec3("tris[5].n0", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[5].n1", -1.0f, 0.0f, 0.0f);
-    path_shader.setVec3("tris[5].n2", -1.0f, 0.0f, 0.0f);
-    path_shader.setUInt("tris[5].material_id", 0);
-
+    bvh.addTriangle(glm::vec3(2.0f, 2.0f, -2.0f), glm::vec3(2.0f, -2.0f, 2.0f), glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(-1.0f, 0.0f, 0.0f), 0);
+    bvh.addTriangle(glm::vec3(2.0f, 2.0f, -2.0f), glm::vec3(2.0f, -2.0f, -2.0f), glm::vec3(2.0f, -2.0f, 2.0f), glm::vec3(-1.0f, 0.0f, 0.0f), 0);
     // 上面
-    path_shader.setVec3("tris[6].p0", -2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[6].p1", 2.0f, 2.0f, 2.0f);
-    path_shader.setVec3("tris[6].p2", -2.0f, 2.0f, 2.0f);
-    path_shader.setVec3("tris[6].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[6].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[6].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[6].material_id", 0);
-
-    path_shader.setVec3("tris[7].p0", -2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[7].p1", 2.0f, 2.0f, -2.0f);
-    path_shader.setVec3("tris[7].p2", 2.0f, 2.0f, 2.0f);
-    path_shader.setVec3("tris[7].n0", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[7].n1", 0.0f, -1.0f, 0.0f);
-    path_shader.setVec3("tris[7].n2", 0.0f, -1.0f, 0.0f);
-    path_shader.setUInt("tris[7].material_id", 0);
-
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(-2.0f, 2.0f, 2.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0);
+    bvh.addTriangle(glm::vec3(-2.0f, 2.0f, -2.0f), glm::vec3(2.0f, 2.0f, -2.0f), glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, -1.0f, 0.0f), 0);
     // 下面
-    path_shader.setVec3("tris[8].p0", -2.0f, -2.0f, -2.0f);
-    path_shader.setVec3("tris[8].p1", -2.0f, -2.0f, 2.0f);
-    path_shader.setVec3("tris[8].p2", 2.0f, -2.0f, 2.0f);
-    path_shader.setVec3("tris[8].n0", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[8].n1", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[8].n2", 0.0f, 1.0f, 0.0f);
-    path_shader.setUInt("tris[8].material_id", 0);
-
-    path_shader.setVec3("tris[9].p0", -2.0f, -2.0f, -2.0f);
-    path_shader.setVec3("tris[9].p1", 2.0f, -2.0f, 2.0f);
-    path_shader.setVec3("tris[9].p2", 2.0f, -2.0f, -2.0f);
-    path_shader.setVec3("tris[9].n0", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[9].n1", 0.0f, 1.0f, 0.0f);
-    path_shader.setVec3("tris[9].n2", 0.0f, 1.0f, 0.0f);
-    path_shader.setUInt("tris[9].material_id", 0);
+    bvh.addTriangle(glm::vec3(-2.0f, -2.0f, -2.0f), glm::vec3(-2.0f, -2.0f, 2.0f), glm::vec3(2.0f, -2.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0);
+    bvh.addTriangle(glm::vec3(-2.0f, -2.0f, -2.0f), glm::vec3(2.0f, -2.0f, 2.0f), glm::vec3(2.0f, -2.0f, -2.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0);
 
     Render render(SCR_WIDTH, SCR_HEIGHT);
+    if(ray_stats)
+        render.enableRayStats();
+    if(!heatmap_dump.empty() && heatmap == RayStats::HEATMAP_OFF)
+        heatmap = RayStats::HEATMAP_ITERATIONS;
+    render.setHeatmap(heatmap);
+    Sampler sampler(project_path + "cache/sampler_tables.bin");
+    sampler.bind(path_shader, UNIT_SAMPLER);
+    bvh.build();
+    bvh.bind(path_shader, UNIT_BVH);
+    ImplicitBricks bricks;
+    buildBricks(bricks, functions);
+    bricks.bind(path_shader, UNIT_IMPLICIT);
+    // 只有中间的曲面占屏幕的大部分，按块剔除它的主光线
+    ImplicitTiles tiles(SCR_WIDTH, SCR_HEIGHT, tile_culling ? bvh.slot(center) : -1);
+    tiles.bind(path_shader, UNIT_IMPLICIT_TILES);
+    tiles.build(tile_shaders.get(functions), path_shader);
+
+    if(validate)
+    {
+        int mismatches = validatePrimaryHits(render, path_shader, functions[0], origin, horizontal, vertical, lower_left_corner);
+        glfwTerminate();
+        return mismatches > 0;
+    }
+
+    if(!heatmap_dump.empty())
+    {
+        current->bind();
+        current->setUInt("frame_count", 1);
+        render.draw(*current);
+        double mean = 0.0, max = 0.0;
+        bool written = render.writeHeatmap(heatmap_dump, &mean, &max);
+        if(written)
+            printf("heatmap %s: mean %.2f max %.2f per primary ray, written to %s\n", RayStats::metricName(heatmap), mean, max, heatmap_dump.c_str());
+        glfwTerminate();
+        return written ? 0 : 1;
+    }
 
     unsigned int frame_count = 0;
     const unsigned int frame_time_constraint = 50;   // 每帧最少要花费的时间，ms
@@ -159,13 +206,33 @@ int main()
         time_t begin = clock();
         frame_count ++;
         //printf("%d ", frame_count);
-        processInput(window);
+        int surface = processInput(window, render);
+        if(surface >= 0 && functions[0].compile(SURFACES[surface]))
+        {
+            // 场景参数不变，从当前的变体复制到新的变体上，砖块重建在原来的纹理里
+            Shader* next = &shaders.get(functions);
+            if(next != current)
+            {
+                next->copyUniformsFrom(*current);
+                current = next;
+                buildBricks(bricks, functions);
+                tiles.build(tile_shaders.get(functions), *current);
+                render.reset();
+            }
+        }
 
         glClearColor(0.f, 0.0f, 0.f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        path_shader.bind();
-        path_shader.setUInt("frame_count", frame_count);
-        render.draw(path_shader);
+        current->bind();
+        current->setUInt("frame_count", frame_count);
+        render.draw(*current);
+        if(frame_count % 50 == 0)
+        {
+            if(evaluations)
+                reportEvaluations(render, frame_count);
+            if(render.rayStatsEnabled())
+                printf("implicit frame %u: %s\n", frame_count, render.rayStatsSummary().c_str());
+        }
 
         time_t end = clock();
         if(end - begin < frame_time_constraint)
@@ -182,8 +249,107 @@ int main()
 
 }
 
-void processInput(GLFWwindow *window)
+// implicit_fs.glsl 把每个样本的 implicitRAA 次数和进入包围盒的光线数累积在 momentTex.zw 中
+void reportEvaluations(Render& render, unsigned int frame_count)
+{
+    vector<float> color, moment;
+    render.readAccumulation(color, moment);
+
+    double evaluations = 0.0, rays = 0.0, samples = 0.0;
+    for(size_t i = 0; i < moment.size(); i += 4)
+    {
+        evaluations += moment[i + 2] * moment[i + 1];
+        rays += moment[i + 3] * moment[i + 1];
+        samples += moment[i + 1];
+    }
+    if(rays > 0.0)
+        printf("implicit frame %u: %.2f RAA evaluations per ray, %.2f rays per sample\n", frame_count, evaluations / rays, rays / samples);
+}
+
+void buildBricks(ImplicitBricks& bricks, const vector<ImplicitFunction>& functions)
+{
+    bricks.clear();
+    for(const ImplicitFunction& function : functions)
+        bricks.add(function, SURFACE_MIN, SURFACE_MAX);
+    bricks.upload();
+}
+
+// 在 implicit_fs.glsl 的 primary_hits 模式下画一帧，每个像素中心的主光线在CPU上再求一遍与中间曲面的交点，逐像素比较
+// 两边都打到中间的曲面时比较 t 和法线；CPU打到而GPU先打到别的图元是被遮挡，不算不一致
+int validatePrimaryHits(Render& render, Shader& shader, const ImplicitFunction& function, const glm::vec3& origin, const glm::vec3& horizontal, const glm::vec3& vertical, const glm::vec3& lower_left_corner)
+{
+    shader.bind();
+    shader.setBool("primary_hits", true);
+    render.reset();
+    render.draw(shader);
+    vector<float> color, moment;
+    render.readAccumulation(color, moment);
+    shader.bind();
+    shader.setBool("primary_hits", false);
+
+    ImplicitCaster caster(function, SURFACE_MIN, SURFACE_MAX);
+    int both = 0, only_gpu = 0, only_cpu = 0, occluded = 0, far = 0;
+    double max_dt = 0.0, sum_dt = 0.0, max_dcos = 0.0;
+    time_t begin = clock();
+    for(unsigned int y = 0; y < SCR_HEIGHT; ++y)
+    {
+        for(unsigned int x = 0; x < SCR_WIDTH; ++x)
+        {
+            float u = (x + 0.5f) / (SCR_WIDTH - 1), v = (y + 0.5f) / (SCR_HEIGHT - 1);
+            glm::vec3 dir = glm::normalize(lower_left_corner + u * horizontal + v * vertical - origin);
+            float t;
+            bool cpu = caster.intersect(origin, dir, 0.0f, 1e8f, t);
+
+            const float* gpu = &color[(y * SCR_WIDTH + x) * 4];
+            bool gpu_hit = gpu[0] >= 0.0f && abs(gpu[1]) < 0.5f;
+            if(cpu && gpu_hit)
+            {
+                double dt = abs(gpu[0] - t);
+                double dcos = abs(gpu[2] - abs(glm::dot(caster.normal(origin + t * dir), dir)));
+                ++both;
+                sum_dt += dt;
+                max_dt = max(max_dt, dt);
+                max_dcos = max(max_dcos, dcos);
+                far += dt > 1e-3 * t;
+            }
+            else if(cpu && gpu[0] >= 0.0f && gpu[0] < t)
+                ++occluded;
+            else if(cpu)
+                ++only_cpu;
+            else if(gpu_hit)
+                ++only_gpu;
+        }
+    }
+    double seconds = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+    printf("validate: %d pixels hit by both, |dt| max %.2e mean %.2e, %d with |dt| > 1e-3 t, normal cosine max difference %.2e\n",
+           both, max_dt, both ? sum_dt / both : 0.0, far, max_dcos);
+    printf("validate: %d only on GPU, %d only on CPU, %d occluded on GPU; CPU %.2f M intervals in %.2f s\n",
+           only_gpu, only_cpu, occluded, caster.intervals() * 1e-6, seconds);
+    return far + only_gpu + only_cpu;
+}
+
+// 返回这一帧按下的数字键对应的预设曲面，没有按下时返回 -1
+int processInput(GLFWwindow *window, Render& render)
 {
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+
+    // H 依次切换热度图的量，只在按下的那一帧生效，需要 --ray-stats
+    static bool h_pressed = false;
+    bool h_down = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    if(h_down && !h_pressed && render.rayStatsEnabled())
+    {
+        render.setHeatmap((render.heatmap() + 1) % RayStats::HEATMAP_COUNT);
+        printf("heatmap: %s\n", RayStats::metricName(render.heatmap()));
+    }
+    h_pressed = h_down;
+
+    const int count = sizeof(SURFACES) / sizeof(SURFACES[0]);
+    for(int i = 0; i < count; ++i)
+    {
+        if(glfwGetKey(window, GLFW_KEY_1 + i) == GLFW_PRESS)
+            return i;
+    }
+    return -1;
 }
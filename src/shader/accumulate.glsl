@@ -0,0 +1,105 @@
+// 多帧混合与自适应采样，被各个积分器和 converge_fs.glsl #include
+// momentTex.x 为亮度平方的均值，momentTex.y 为该像素已累积的样本数，momentTex.zw 为 sample_stats 每个样本的均值
+// normalTex、albedoTex 为第一个交点的法线、深度和反照率每个样本的均值，albedoTex.w 为主光线打到物体的比例，
+// 供 atrous_fs.glsl 降噪和 reproject_fs.glsl 重投影
+
+uniform sampler2D imgTex;           // 上一帧累积的颜色
+uniform sampler2D momentTex;        // 上一帧累积的二阶矩
+uniform float adaptive_threshold;   // 相对标准误差的阈值，为0时关闭自适应采样
+uniform float adaptive_min_samples; // 估计方差前至少需要的样本数
+uniform float adaptive_max_scale;   // 单个像素最多可分到的样本倍数，已收敛像素越多越大，总预算保持不变
+uniform uint sample_offset;         // 加到样本序号上，让参考图和对比的渲染使用互不相关的样本
+uniform sampler2D normalTex;        // 上一帧累积的第一个交点的法线和到相机的距离，没打到的样本为 0
+uniform sampler2D albedoTex;        // 上一帧累积的第一个交点的反照率，没打到或打到光源的样本为 1
+uniform int motion_spp;             // 相机移动时 Render 设置的每帧样本数，为0时用积分器自己的
+
+// 只用到其中的工具函数、自己声明输出的pass（如 ReSTIR 的前两个pass）在 #include 之前定义 ACCUMULATE_NO_OUTPUT
+#ifndef ACCUMULATE_NO_OUTPUT
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragMoment;
+layout(location = 2) out vec4 FragNormal;
+layout(location = 3) out vec4 FragAlbedo;
+#ifdef RAY_STATS
+layout(location = 4) out vec4 FragRayStats;         // 本帧的计数，不累积，见 ray_stats.glsl
+layout(location = 5) out vec4 FragPrimitiveStats;
+#endif
+#endif
+
+#include "ray_stats.glsl"
+
+// 积分器可以在这里累加本帧所有样本的统计量（如隐式曲面的求值次数），accumulate 时与二阶矩一样按样本平均
+vec2 sample_stats = vec2(0);
+
+// 积分器在每个样本的主光线打到物体时调用 recordFirstHit，accumulate 时与颜色一样按样本平均
+vec4 first_hit_normal = vec4(0);    // 法线和距离之和
+vec4 first_hit_albedo = vec4(0);    // 反照率之和，w 为打到的样本数
+
+void recordFirstHit(vec3 normal, float depth, vec3 albedo)
+{
+    first_hit_normal += vec4(normal, depth);
+    first_hit_albedo += vec4(albedo, 1.0);
+}
+
+float luminance(vec3 c)
+{
+    return 0.3*c.x + 0.6*c.y + 0.1*c.z;
+}
+
+// 像素均值的相对标准误差 sqrt(Var / n) / mean
+float relativeError(vec3 mean, vec4 moment)
+{
+    float n = moment.y;
+    if(n < max(adaptive_min_samples, 2.0))
+        return INFINITY;
+    float l = luminance(mean);
+    float variance = max(0.0, moment.x - l * l) * n / (n - 1.0);
+    return sqrt(variance / n) / (l + 0.01);
+}
+
+// 按误差分配本帧的样本数，误差越大的像素分到越多的样本
+int adaptiveSpp(int base_spp)
+{
+    if(motion_spp > 0)
+        return motion_spp;
+    if(adaptive_threshold <= 0.0)
+        return base_spp;
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    float error = relativeError(texelFetch(imgTex, p, 0).rgb, texelFetch(momentTex, p, 0));
+    if(error == INFINITY)
+        return base_spp;
+    return int(clamp(ceil(base_spp * error / adaptive_threshold), 1.0, adaptive_max_scale * base_spp));
+}
+
+// 当前像素已累积的样本数，用作采样器的样本序号
+uint accumulatedSamples()
+{
+    return uint(texelFetch(momentTex, ivec2(gl_FragCoord.xy), 0).y) + sample_offset;
+}
+
+#ifndef ACCUMULATE_NO_OUTPUT
+// sum 和 lum2_sum 分别为本帧 spp 个样本的颜色之和与亮度平方之和
+void accumulate(vec3 sum, float lum2_sum, int spp)
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    vec3 mean = texelFetch(imgTex, p, 0).rgb;
+    vec4 moment = texelFetch(momentTex, p, 0);
+    float n = moment.y + float(spp);
+    mean += (sum - float(spp) * mean) / n;
+    moment.x += (lum2_sum - float(spp) * moment.x) / n;
+    moment.zw += (sample_stats - float(spp) * moment.zw) / n;
+    FragColor = vec4(mean, 1.0);
+    FragMoment = vec4(moment.x, n, moment.zw);
+
+    vec4 normal = texelFetch(normalTex, p, 0);
+    vec4 albedo = texelFetch(albedoTex, p, 0);
+    normal += (first_hit_normal - float(spp) * normal) / n;
+    albedo.rgb += (first_hit_albedo.rgb + (float(spp) - first_hit_albedo.w) - float(spp) * albedo.rgb) / n;
+    albedo.w += (first_hit_albedo.w - float(spp) * albedo.w) / n;
+    FragNormal = normal;
+    FragAlbedo = albedo;
+#ifdef RAY_STATS
+    FragRayStats = ray_stats;
+    FragPrimitiveStats = ray_stats_primitives;
+#endif
+}
+#endif
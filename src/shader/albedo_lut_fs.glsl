@@ -0,0 +1,71 @@
+#version 330 core
+
+// 预计算 Disney BRDF 各波瓣的方向反照率，由 common/albedo_lut.cpp 在启动时绘制一次
+// 像素 (i, j) 对应 NdotV = i / (size - 1)，参数 = j / (size - 1)
+// r, g: 镜面反射的 scale 和 bias，Schlick Fresnel 对 F0 是线性的，反照率 = F0 * r + g
+// b: 漫反射（不含 baseColor），参数为粗糙度
+// a: 清漆层（强度为1），参数为清漆层的光泽度
+
+#define PI 3.141592653
+
+#include "sampling.glsl"
+#include "microfacet.glsl"
+
+uniform int lut_size;
+uniform int sample_count;
+
+out vec4 FragColor;
+
+float radicalInverse(uint i)
+{
+    i = (i << 16u) | (i >> 16u);
+    i = ((i & 0x55555555u) << 1u) | ((i & 0xAAAAAAAAu) >> 1u);
+    i = ((i & 0x33333333u) << 2u) | ((i & 0xCCCCCCCCu) >> 2u);
+    i = ((i & 0x0F0F0F0Fu) << 4u) | ((i & 0xF0F0F0F0u) >> 4u);
+    i = ((i & 0x00FF00FFu) << 8u) | ((i & 0xFF00FF00u) >> 8u);
+    return float(i) * 2.3283064365386963e-10;
+}
+
+void main()
+{
+    vec2 grid = floor(gl_FragCoord.xy) / float(lut_size - 1);
+    float NdotV = max(grid.x, 0.001);
+    float param = grid.y;
+    vec3 V = vec3(sqrt(1.0 - NdotV * NdotV), 0.0, NdotV);
+
+    float alpha = roughnessToAlpha(param);
+    float clearcoat_alpha = clearcoatGlossToAlpha(param);
+    vec4 sum = vec4(0);
+    for(int i = 0; i < sample_count; ++i)
+    {
+        vec2 xi = vec2((float(i) + 0.5) / float(sample_count), radicalInverse(uint(i)));
+
+        // 可见法线采样下 f * NdotL / pdf = F * G1(L)
+        vec3 H = sampleGGXVNDF(V, alpha, xi);
+        vec3 L = reflect(-V, H);
+        if(L.z > 0)
+        {
+            float G1 = smithG_GGX(L.z, alpha) * 2.0 * L.z;
+            float FH = SchlickFresnel(dot(L, H));
+            sum.r += (1.0 - FH) * G1;
+            sum.g += FH * G1;
+        }
+
+        // 余弦采样下 f * NdotL / pdf = Fd
+        L = sampleCosineHemisphere(xi);
+        H = normalize(L + V);
+        sum.b += diffuseFresnel(L.z, NdotV, dot(L, H), param);
+
+        // GTR1 采样下 f * NdotL / pdf = Gr * Fr * NdotL * LdotH / NdotH
+        H = sampleGTR1(clearcoat_alpha, xi);
+        L = reflect(-V, H);
+        if(L.z > 0)
+        {
+            float LdotH = dot(L, H);
+            float Gr = smithG_GGX(L.z, 0.25) * smithG_GGX(NdotV, 0.25);
+            float Fr = mix(0.04, 1.0, SchlickFresnel(LdotH));
+            sum.a += Gr * Fr * L.z * LdotH / H.z;
+        }
+    }
+    FragColor = sum / float(sample_count);
+}
@@ -0,0 +1,98 @@
+#version 330
+
+// 边缘保持的 à-trous 小波滤波（SVGF，Schied et al. 2017），Render 在累积之后、output_fs.glsl 之前执行若干次，第 i 次的间隔为 2^i
+// 滤波的是除以第一个交点反照率后的光照，最后一次再乘回反照率，纹理的细节不会被滤掉
+// 亮度的边缘权重按累积均值的方差缩放，方差随样本数下降，收敛后几乎不再滤波
+
+#define DENOISE_SIGMA_DEPTH 1.0         // 深度差相对于按梯度外推的深度差的容许倍数
+#define DENOISE_SIGMA_NORMAL 128.0      // 法线夹角余弦的指数
+#define DENOISE_SIGMA_LUMINANCE 4.0     // 亮度差相对于标准差的容许倍数
+#define DENOISE_MIN_ALBEDO 0.01         // 反照率接近 0 的通道不去除反照率
+
+layout(location = 0) out vec4 FragColor;   // 光照和方差，最后一次为颜色
+
+uniform sampler2D imgTex;       // 第一次为累积的颜色，之后为上一次输出的光照和方差
+uniform sampler2D momentTex;    // 累积的二阶矩，第一次用来估计方差
+uniform sampler2D normalTex;    // 累积的第一个交点的法线和距离
+uniform sampler2D albedoTex;    // 累积的第一个交点的反照率
+uniform int step_size;
+uniform bool first_pass;
+uniform bool last_pass;
+
+float luminance(vec3 c)
+{
+    return 0.3*c.x + 0.6*c.y + 0.1*c.z;
+}
+
+vec3 albedoAt(ivec2 p)
+{
+    return max(texelFetch(albedoTex, p, 0).rgb, vec3(DENOISE_MIN_ALBEDO));
+}
+
+// 第 p 个像素的光照和方差，第一次由累积的颜色和二阶矩算出
+vec4 illumination(ivec2 p)
+{
+    vec4 c = texelFetch(imgTex, p, 0);
+    if(!first_pass)
+        return c;
+    vec4 moment = texelFetch(momentTex, p, 0);
+    float l = luminance(c.rgb);
+    // 均值的方差为 Var / n，样本太少时当作方差很大，只按几何特征滤波
+    float variance = moment.y > 1.0 ? max(0.0, moment.x - l * l) / (moment.y - 1.0) : 1e4;
+    vec3 albedo = albedoAt(p);
+    float a = luminance(albedo);
+    return vec4(c.rgb / albedo, variance / (a * a));
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(imgTex, 0);
+    vec4 center = illumination(p);
+    vec4 g = texelFetch(normalTex, p, 0);
+    vec3 normal = dot(g.xyz, g.xyz) > 0.0 ? normalize(g.xyz) : vec3(0);
+
+    // 方差先做 3x3 的高斯平滑，深度梯度取两侧差值中较小的一个，不跨过边缘
+    float variance = 0.0;
+    for(int y = -1; y <= 1; ++y)
+    {
+        for(int x = -1; x <= 1; ++x)
+        {
+            ivec2 q = clamp(p + ivec2(x, y), ivec2(0), size - 1);
+            variance += illumination(q).a * float((2 - abs(x)) * (2 - abs(y))) / 16.0;
+        }
+    }
+    float gradient_x = min(abs(texelFetch(normalTex, min(p + ivec2(1, 0), size - 1), 0).w - g.w), abs(texelFetch(normalTex, max(p - ivec2(1, 0), ivec2(0)), 0).w - g.w));
+    float gradient_y = min(abs(texelFetch(normalTex, min(p + ivec2(0, 1), size - 1), 0).w - g.w), abs(texelFetch(normalTex, max(p - ivec2(0, 1), ivec2(0)), 0).w - g.w));
+    float gradient = max(gradient_x, gradient_y);
+    float phi_luminance = DENOISE_SIGMA_LUMINANCE * sqrt(variance) + 1e-6;
+    float l = luminance(center.rgb);
+
+    const float kernel[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+    vec3 sum = center.rgb * kernel[0] * kernel[0];
+    float sum_variance = center.a * kernel[0] * kernel[0] * kernel[0] * kernel[0];
+    float sum_weight = kernel[0] * kernel[0];
+    for(int y = -2; y <= 2; ++y)
+    {
+        for(int x = -2; x <= 2; ++x)
+        {
+            ivec2 q = p + ivec2(x, y) * step_size;
+            if((x == 0 && y == 0) || any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size)))
+                continue;
+            vec4 c = illumination(q);
+            vec4 gq = texelFetch(normalTex, q, 0);
+            vec3 nq = dot(gq.xyz, gq.xyz) > 0.0 ? normalize(gq.xyz) : vec3(0);
+
+            float w_depth = exp(-abs(g.w - gq.w) / (DENOISE_SIGMA_DEPTH * gradient * length(vec2(x, y)) * float(step_size) + 1e-3));
+            float w_normal = pow(max(0.0, dot(normal, nq)), DENOISE_SIGMA_NORMAL);
+            float w_luminance = exp(-abs(l - luminance(c.rgb)) / phi_luminance);
+            float w = kernel[abs(x)] * kernel[abs(y)] * w_depth * w_normal * w_luminance;
+            sum += c.rgb * w;
+            sum_variance += c.a * w * w;
+            sum_weight += w;
+        }
+    }
+
+    vec4 result = vec4(sum / sum_weight, sum_variance / (sum_weight * sum_weight));
+    FragColor = last_pass ? vec4(result.rgb * albedoAt(p), 1.0) : result;
+}
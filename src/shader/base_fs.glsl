@@ -8,7 +8,8 @@
 #define INFINITY 100000000.0
 #define PI 3.141592653
 #define EPSILON 0.00001
-#define PDF (1.0 / (2 * PI))
+#define COSINE_SAMPLING 1   // 漫反射使用余弦加权采样，置0则退回均匀半球采样，用于对比收敛速度
+#define GUIDING_FRACTION 0.5    // 漫反射表面上有学到的分布时，按引导分布采样方向的概率
 
 struct Material
 {
@@ -50,6 +51,7 @@ struct Triangle
     vec3 p0, p1, p2;    // 位置
     vec3 n0, n1, n2;    // 法线
     uint material_id;
+    int light_id;       // 在光源BVH中的编号，不发光时为 -1
 };
 
 struct Intersection
@@ -58,65 +60,28 @@ struct Intersection
     float t;
     vec3 normal;
     Material material;
+    int light_id;
 };
 
 uniform Material materials[7];
 uniform uint frame_count;
-uniform sampler2D imgTex;
 uniform Camera camera;
 uniform Sphere spheres[3];
 uniform Triangle tris[12];
 
 in vec2 TexCoords;
-out vec4 FragColor;
-
-uint static_seed;
-
-// 生成随机数https://blog.demofox.org/2020/05/25/casual-shadertoy-path-tracing-1-basic-camera-diffuse-emissive/
-uint seed = uint(
-    uint((gl_FragCoord.x * 0.5 + 0.5) * WIDTH)  * uint(1973) + 
-    uint((gl_FragCoord.y * 0.5 + 0.5) * HEIGHT) * uint(9277) + 
-    uint(frame_count + static_seed) * uint(26699)) | uint(1);
-
-uint wang_hash(inout uint seed) {
-    seed = uint(seed ^ uint(61)) ^ uint(seed >> uint(16));
-    seed *= uint(9);
-    seed = seed ^ (seed >> 4);
-    seed *= uint(0x27d4eb2d);
-    seed = seed ^ (seed >> 15);
-    return seed;
-}
- 
-float rand() {
-    return float(wang_hash(seed)) / 4294967296.0;
-}
 
-// 半球面均匀采样
-vec3 sampleHemisphere()
-{
-    float z = rand();
-    float r = max(0, sqrt(1 - z*z));
-    float phi = 2.0 * PI * rand();
-    return vec3(r * cos(phi), r * sin(phi), z);
-}
+// GUIDING_RECORD 由 PathGuiding 编译记录训练样本的pass时定义，此时输出的是路径顶点而不是颜色
+#ifdef GUIDING_RECORD
+#define ACCUMULATE_NO_OUTPUT
+#endif
+#include "accumulate.glsl"
 
-// 将半球上的光线方向转换为世界方向
-vec3 toWorld(vec3 v, vec3 normal)
-{
-    vec3 B, C;
-	if (abs(normal.x) > abs(normal.y))
-	{
-		float inv_len = 1.0 / sqrt(normal.x * normal.x + normal.z * normal.z);
-		C = vec3(normal.z * inv_len, 0.0f, -normal.x * inv_len);
-	}
-	else
-	{
-		float inv_len = 1.0f / sqrt(normal.y * normal.y + normal.z * normal.z);
-		C = vec3(0.0f, normal.z * inv_len, -normal.y * inv_len);
-	}
-	B = cross(C, normal);
-	return B * v.x + C * v.y + normal * v.z;
-}
+#define SAMPLER_BOUNCE_DIMS 7     // 选择反射类型1维，是否引导1维，方向2维，光源采样3维
+#include "sampler.glsl"
+#include "sampling.glsl"
+#include "light_bvh.glsl"
+#include "guiding.glsl"
 
 bool hitSphere(Ray ray, Sphere sphere, float t_min, float t_max, out Intersection inter)
 {
@@ -146,6 +111,7 @@ bool hitSphere(Ray ray, Sphere sphere, float t_min, float t_max, out Intersectio
     inter.position = pointAt(root, ray);
     inter.normal = (inter.position - sphere.center) / sphere.radius;
     inter.material = materials[sphere.material_id];
+    inter.light_id = -1;
 
     if(dot(inter.normal, ray.dir) > 0)  // 如果光源打到球的内部
     {
@@ -193,6 +159,7 @@ bool hitTriangle(Ray ray, Triangle tri, float t_min, float t_max, out Intersecti
     inter.position = pointAt(t, ray);
     inter.material = materials[tri.material_id];
     inter.normal = norm;
+    inter.light_id = tri.light_id;
 
     return true;
 }
@@ -203,6 +170,7 @@ bool hitWorld(Ray ray, out Intersection inter)
     bool if_tag = false;
     for(int i = 0; i < 12; ++i)
     {
+        COUNT_PRIMITIVE();
         Intersection inter_temp;
         if(hitTriangle(ray, tris[i], 0, closet_inter_t, inter_temp))
         {
@@ -213,6 +181,7 @@ bool hitWorld(Ray ray, out Intersection inter)
     }
     for(int i = 0; i < 3; ++i)
     {
+        COUNT_PRIMITIVE();
         Intersection inter_temp;
         if(hitSphere(ray, spheres[i], 0, closet_inter_t, inter_temp))
         {
@@ -225,6 +194,67 @@ bool hitWorld(Ray ray, out Intersection inter)
     return if_tag;
 }
 
+float pdfDiffuse(float NdotL)
+{
+#if COSINE_SAMPLING
+    return pdfCosineHemisphere(NdotL);
+#else
+    return NdotL > 0.0 ? pdfHemisphere() : 0.0;
+#endif
+}
+
+// 漫反射表面上余弦采样与引导分布按 GUIDING_FRACTION 混合（单样本MIS）后的pdf，guide 为 guidingTree 的结果
+float pdfScatter(vec3 N, vec3 L, int guide)
+{
+    float pdf = pdfDiffuse(dot(N, L));
+    if(guide < 0)
+        return pdf;
+    return mix(pdf, pdfGuiding(guide, L), GUIDING_FRACTION);
+}
+
+// 漫反射表面上通过光源BVH选择一个发光三角形做下一事件估计，与BRDF采样之间按幂启发式加权
+vec3 sampleAreaLight(Intersection inter, int guide)
+{
+    vec3 N = inter.normal;
+    LightSample s;
+    if(!sampleLight(inter.position, N, vec3(rand(), rand(), rand()), s))
+        return vec3(0);
+    float NdotL = dot(N, s.L);
+    if(NdotL <= 0.0)
+        return vec3(0);
+
+    Ray shadow_ray;
+    shadow_ray.ori = inter.position + N * 1e-4;
+    shadow_ray.dir = s.L;
+    Intersection occluder;
+    COUNT_RAY(RAY_SHADOW);
+    if(hitWorld(shadow_ray, occluder) && occluder.t < s.dist - 1e-3)
+        return vec3(0);
+
+    float weight = s.hittable ? powerHeuristic(s.pdf, pdfScatter(N, s.L, guide)) : 1.0;
+    return inter.material.color / PI * NdotL * s.emission * weight / s.pdf;
+}
+
+#ifdef GUIDING_RECORD
+#define GUIDING_RECORD_VERTICES 3   // 每条路径记录的漫反射顶点数，与 PathGuiding::RECORD_VERTICES 一致
+
+// 漫反射顶点的位置、采样方向、pdf，以及从该方向入射的辐射度
+vec3 record_position[GUIDING_RECORD_VERTICES];
+vec3 record_direction[GUIDING_RECORD_VERTICES];
+float record_pdf[GUIDING_RECORD_VERTICES];
+vec3 record_throughput[GUIDING_RECORD_VERTICES];   // 相机到该顶点采样方向上的吞吐量
+vec3 record_radiance[GUIDING_RECORD_VERTICES];
+int record_count = 0;
+
+// 路径上新增的贡献 contribution 换算成之前各顶点沿采样方向的入射辐射度
+// 打到光源时记录MIS加权后的值：下一事件估计已经覆盖的直接光不需要引导，分布集中在它覆盖不好的方向上
+void recordRadiance(vec3 contribution)
+{
+    for(int j = 0; j < record_count; ++j)
+        record_radiance[j] += contribution / max(record_throughput[j], vec3(1e-6));
+}
+#endif
+
 vec3 trace(Intersection inter, Ray ray)
 {
     // 如果打到光源
@@ -233,34 +263,77 @@ vec3 trace(Intersection inter, Ray ray)
 
     vec3 indir_filtration = vec3(1);
     vec3 result = vec3(0);
+    float pdf = 0.0;
+    bool light_sampled = false; // 上一次弹射是否对光源做了下一事件估计
 
     for(int i = 0; i < DEPTH; ++i)
     {
+        startBounce(i);
+        light_sampled = false;
 
         vec3 wi;
+        vec3 weight;    // brdf * cos / pdf
         float r = rand();
         if(r < inter.material.specularRate) // 完全镜面反射
         {
             wi = reflect(ray.dir, inter.normal);
+            weight = inter.material.color;
         }
         else if(r > inter.material.specularRate && r < inter.material.refractRate)  // 完全折射
         {
             wi = refract(ray.dir, inter.normal, inter.material.refractAngle);
+            weight = inter.material.color;
         }
         else
         {
-            wi = toWorld(sampleHemisphere(), inter.normal);    //  得到一条光线的方向
+            int guide = guidingTree(inter.position);
+            float r_guide = rand();
+            vec2 xi = vec2(rand(), rand());
+            if(guide >= 0 && r_guide < GUIDING_FRACTION)
+                wi = sampleGuiding(guide, xi);
+            else
+#if COSINE_SAMPLING
+                wi = toWorld(sampleCosineHemisphere(xi), inter.normal);    //  得到一条光线的方向
+#else
+                wi = toWorld(sampleHemisphere(xi), inter.normal);
+#endif
+
+            // 引导分布可能采到表面以下的方向，光源采样要在路径终止之前完成
+            if(light_count > 0 && !inter.material.isEmissive)
+            {
+                vec3 direct = sampleAreaLight(inter, guide) * indir_filtration;
+                result += direct;
+                light_sampled = true;
+#ifdef GUIDING_RECORD
+                recordRadiance(direct);
+#endif
+            }
+
+            float NdotL = dot(wi, inter.normal);
+            pdf = pdfScatter(inter.normal, wi, guide);
+            if(pdf <= 0.0 || NdotL <= 0.0) break;
+            weight = inter.material.color / PI * NdotL / pdf; // lambert brdf = color / PI
+#ifdef GUIDING_RECORD
+            if(record_count < GUIDING_RECORD_VERTICES)
+            {
+                record_position[record_count] = inter.position;
+                record_direction[record_count] = wi;
+                record_pdf[record_count] = pdf;
+                record_throughput[record_count] = indir_filtration * weight;
+                record_radiance[record_count] = vec3(0);
+                ++record_count;
+            }
+#endif
         }
 
-        float NdotL = dot(wi, inter.normal);
-
         if(!inter.material.isEmissive)  // 把光源也看做反射项，但是光源的color太大，默认作为vec3（1）
-            indir_filtration *= inter.material.color;
+            indir_filtration *= weight;
 
         ray.dir = wi;
         ray.ori = inter.position;
         
         Intersection new_inter;
+        COUNT_RAY(RAY_BOUNCE);
         if(!hitWorld(ray, new_inter))
         {
             break;
@@ -268,7 +341,13 @@ vec3 trace(Intersection inter, Ray ray)
         
         if(new_inter.material.isEmissive)
         {
-            result += new_inter.material.color * indir_filtration * NdotL / PDF;
+            float mis = 1.0;
+            if(light_sampled && new_inter.light_id >= 0)
+                mis = powerHeuristic(pdf, pdfLight(inter.position, inter.normal, new_inter.light_id, new_inter.position));
+            result += new_inter.material.color * mis * indir_filtration;
+#ifdef GUIDING_RECORD
+            recordRadiance(new_inter.material.color * mis * indir_filtration);
+#endif
             //break;
         }
         inter = new_inter;
@@ -277,28 +356,57 @@ vec3 trace(Intersection inter, Ray ray)
     return result;
 }
 
+#ifdef GUIDING_RECORD
+// 每个像素追踪一条路径，输出前 GUIDING_RECORD_VERTICES 个漫反射顶点：(位置, 入射辐射度的亮度), (采样方向, pdf)，pdf 为 0 表示没有该顶点
+layout(location = 0) out vec4 GuidingRecord[GUIDING_RECORD_VERTICES * 2];
 
 void main()
 {
+    initSampler(uvec2(gl_FragCoord.xy), frame_count | 0x80000000u);  // 与累积用的样本序号错开
     float u = (gl_FragCoord.x - 0.5 + rand()) / (WIDTH - 1);
     float v = (gl_FragCoord.y - 0.5 + rand()) / (HEIGHT - 1);
     Ray ray;
     ray.ori = camera.ori;
     ray.dir = normalize(camera.lower_left_corner + u * camera.horizontal + v * camera.vertical - camera.ori);
 
+    Intersection inter;
+    if(hitWorld(ray, inter))
+        trace(inter, ray);
+
+    for(int j = 0; j < GUIDING_RECORD_VERTICES; ++j)
+    {
+        bool valid = j < record_count;
+        GuidingRecord[j * 2] = valid ? vec4(record_position[j], luminance(record_radiance[j])) : vec4(0);
+        GuidingRecord[j * 2 + 1] = valid ? vec4(record_direction[j], record_pdf[j]) : vec4(0);
+    }
+}
+#else
+void main()
+{
     vec3 color = vec3(0);
-    int spp = 10;
-    static_seed = 0u;
-    for(int i = 0; i < 10; ++i)
+    float lum2 = 0.0;
+    int spp = adaptiveSpp(10);
+    uint first_sample = accumulatedSamples();
+    for(int i = 0; i < spp; ++i)
     {
+        initSampler(uvec2(gl_FragCoord.xy), first_sample + uint(i));
+        float u = (gl_FragCoord.x - 0.5 + rand()) / (WIDTH - 1);
+        float v = (gl_FragCoord.y - 0.5 + rand()) / (HEIGHT - 1);
+        Ray ray;
+        ray.ori = camera.ori;
+        ray.dir = normalize(camera.lower_left_corner + u * camera.horizontal + v * camera.vertical - camera.ori);
+
         Intersection inter;
+        COUNT_RAY(RAY_PRIMARY);
         if(hitWorld(ray, inter))
         {
-            color += trace(inter, ray) / spp;
+            recordFirstHit(inter.normal, inter.t, inter.material.isEmissive ? vec3(1) : inter.material.color);
+            vec3 c = trace(inter, ray);
+            color += c;
+            lum2 += luminance(c) * luminance(c);
         }
-        static_seed ++;
     }
 
-    vec3 textureColor = texture(imgTex, TexCoords).rgb;
-    FragColor = vec4(mix(textureColor, color, 1.0 / float(frame_count)), 1.0);
-}
\ No newline at end of file
+    accumulate(color, lum2, spp);
+}
+#endif
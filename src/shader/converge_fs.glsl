@@ -0,0 +1,17 @@
+#version 330 core
+
+#define INFINITY 100000000.0
+
+in vec2 TexCoords;
+
+#include "accumulate.glsl"
+
+// 只保留已收敛的像素，由 Render 写入模板缓冲并计数
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    if(relativeError(texelFetch(imgTex, p, 0).rgb, texelFetch(momentTex, p, 0)) > adaptive_threshold)
+        discard;
+    FragColor = vec4(0);
+    FragMoment = vec4(0);
+}
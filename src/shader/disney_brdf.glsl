@@ -0,0 +1,165 @@
+// Disney BRDF 的求值、重要性采样与pdf，需要在 Material、accumulate.glsl、sampler.glsl、sampling.glsl 之后 #include
+// https://github.com/wdas/brdf/blob/main/src/brdfs/disney.brdf
+// https://media.disneyanimation.com/uploads/production/publication_asset/48/asset/s2012_pbs_disney_brdf_notes_v3.pdf
+
+#include "microfacet.glsl"
+
+#define ALBEDO_LUT_SIZE 32   // 与 common/albedo_lut.h 中的 AlbedoLut::SIZE 一致
+
+uniform sampler2D albedoLutTex;     // (NdotV, 粗糙度或清漆光泽度) -> (镜面 scale, 镜面 bias, 漫反射, 清漆)，见 albedo_lut_fs.glsl
+uniform sampler2D albedoAvgTex;     // 粗糙度 -> 镜面反射在半球上的平均反照率
+uniform bool energy_compensation;   // 补偿镜面反射多次散射损失的能量
+
+// 查找表的网格点在像素中心
+vec4 albedoLut(float NdotV, float param)
+{
+    vec2 uv = (vec2(NdotV, param) * float(ALBEDO_LUT_SIZE - 1) + 0.5) / float(ALBEDO_LUT_SIZE);
+    return texture(albedoLutTex, uv);
+}
+
+float specularAlpha(in Material material)
+{
+    return roughnessToAlpha(material.roughness);
+}
+
+float clearcoatAlpha(in Material material)
+{
+    return clearcoatGlossToAlpha(material.clearcoatGloss);
+}
+
+vec3 tintColor(in Material material)
+{
+    vec3 Cdlin = material.baseColor;
+    float Cdlum = 0.3 * Cdlin.r + 0.6 * Cdlin.g  + 0.1 * Cdlin.b;
+    return (Cdlum > 0) ? (Cdlin/Cdlum) : (vec3(1));
+}
+
+// 0° 镜面反射颜色
+vec3 specularColor(in Material material)
+{
+    vec3 Cspec = material.specular * mix(vec3(1), tintColor(material), material.specularTint);
+    return mix(0.08*Cspec, material.baseColor, material.metallic);
+}
+
+float specularAverageAlbedo(float roughness)
+{
+    return texture(albedoAvgTex, vec2((roughness * float(ALBEDO_LUT_SIZE - 1) + 0.5) / float(ALBEDO_LUT_SIZE), 0.5)).r;
+}
+
+// 多次散射的 Fresnel 项，Favg 为 Schlick Fresnel 在半球上的余弦加权平均
+vec3 multiScatterFresnel(vec3 Cspec0, float Eavg)
+{
+    vec3 Favg = Cspec0 + (1.0 - Cspec0) / 21.0;
+    return Favg * Favg * Eavg / (1.0 - Favg * (1.0 - Eavg));
+}
+
+// Kulla-Conty 2017 的多次散射项，补足单次散射微表面模型在高粗糙度下损失的能量
+vec3 multiScatter(float NdotL, float NdotV, vec3 Cspec0, float roughness)
+{
+    float Eavg = specularAverageAlbedo(roughness);
+    if(Eavg >= 1.0) return vec3(0);
+    float Ev = dot(albedoLut(NdotV, roughness).rg, vec2(1));
+    float El = dot(albedoLut(NdotL, roughness).rg, vec2(1));
+    return multiScatterFresnel(Cspec0, Eavg) * (1.0 - Ev) * (1.0 - El) / (PI * (1.0 - Eavg));
+}
+
+vec3 brdf(vec3 V, vec3 N, vec3 L, in Material material)
+{
+    // 预计算常用数值
+    float NdotL = dot(N, L);
+    float NdotV = dot(N, V);
+    if(NdotL < 0 || NdotV < 0) return vec3(0);
+    vec3 H = normalize(L + V);
+    float NdotH = dot(N, H);
+    float LdotH = dot(L, H);
+
+    vec3 Cdlin = material.baseColor;
+    vec3 Cspec0 = specularColor(material);
+    vec3 Csheen = mix(vec3(1), tintColor(material), material.sheenTint);
+
+    // 漫反射
+    float Fd = diffuseFresnel(NdotL, NdotV, LdotH, material.roughness);
+    float FH = SchlickFresnel(LdotH);
+    vec3 Fsheen = FH * material.sheen * Csheen;
+    vec3 diffuse = Fd * Cdlin / PI + Fsheen;
+
+    // 镜面反射，G 与 D 使用同一个 alpha，和可见法线采样的pdf保持一致
+    float alpha = specularAlpha(material);
+    float Ds = GTR2(NdotH, alpha);
+    vec3 Fs = mix(Cspec0, vec3(1), FH);
+    float Gs = smithG_GGX(NdotL, alpha);
+    Gs *= smithG_GGX(NdotV, alpha);
+    vec3 specular = Gs * Fs * Ds;
+    if(energy_compensation)
+        specular += multiScatter(NdotL, NdotV, Cspec0, material.roughness);
+
+    // 清漆层
+    float Dr = GTR1(NdotH, clearcoatAlpha(material));
+    float Fr = mix(0.04, 1.0, FH);
+    float Gr = smithG_GGX(NdotL, 0.25) * smithG_GGX(NdotV, 0.25);
+    float clearcoat = 0.25 * material.clearcoat * Gr * Fr * Dr;
+
+    return diffuse * (1.0 - material.metallic) + specular + vec3(clearcoat);
+}
+
+// 按各波瓣在视线方向上的反照率分配采样概率，返回 (漫反射+sheen+多次散射, 镜面反射, 清漆层)
+vec3 lobeProbabilities(vec3 V, vec3 N, in Material material)
+{
+    float NdotV = max(dot(N, V), 0.0);
+    vec4 E = albedoLut(NdotV, material.roughness);
+    vec3 Cspec0 = specularColor(material);
+    float FV = SchlickFresnel(NdotV);
+
+    float sheen = material.sheen * FV * luminance(mix(vec3(1), tintColor(material), material.sheenTint));
+    float diffuse = (1.0 - material.metallic) * (luminance(material.baseColor) * E.b + sheen);
+    float specular = luminance(Cspec0 * E.r + vec3(E.g));
+    // 多次散射项接近余弦分布，由漫反射波瓣负责采样
+    if(energy_compensation)
+        diffuse += luminance(multiScatterFresnel(Cspec0, specularAverageAlbedo(material.roughness))) * max(0.0, 1.0 - E.r - E.g);
+    float clearcoat = material.clearcoat > 0.0 ? material.clearcoat * albedoLut(NdotV, material.clearcoatGloss).a : 0.0;
+
+    float total = diffuse + specular + clearcoat;
+    if(total <= 0.0)
+        return vec3(1, 0, 0);
+    return vec3(diffuse, specular, clearcoat) / total;
+}
+
+vec3 sampleBRDF(vec3 V, vec3 N, in Material material)
+{
+    vec3 p = lobeProbabilities(V, N, material);
+    float r = rand();
+    vec2 xi = vec2(rand(), rand());
+
+    if(r < p.x)
+    {
+        return toWorld(sampleCosineHemisphere(xi), N);
+    }
+
+    vec3 H;
+    if(r < p.x + p.y)
+        H = sampleGGXVNDF(toLocal(V, N), specularAlpha(material), xi);
+    else
+        H = sampleGTR1(clearcoatAlpha(material), xi);
+    return reflect(-V, toWorld(H, N));
+}
+
+float pdfBRDF(vec3 V, vec3 N, vec3 L, in Material material)
+{
+    float NdotL = dot(N, L);
+    float NdotV = dot(N, V);
+    if(NdotL < 0 || NdotV <= 0) return 0.0;
+
+    vec3 H = normalize(L + V);
+    float NdotH = dot(N, H);
+    float LdotH = dot(L, H);
+
+    // 可见法线采样的pdf: G1(V) * D / (4 * NdotV)
+    float alpha = specularAlpha(material);
+    float pdf_specular = smithG_GGX(NdotV, alpha) * GTR2(NdotH, alpha) * 0.5;
+    float pdf_clearcoat = GTR1(NdotH, clearcoatAlpha(material)) * NdotH / (4.0 * LdotH);
+    float pdf_diffuse = pdfCosineHemisphere(NdotL);
+
+    vec3 p = lobeProbabilities(V, N, material);
+    float pdf = p.x * pdf_diffuse + p.y * pdf_specular + p.z * pdf_clearcoat;
+    return max(0, pdf);
+}
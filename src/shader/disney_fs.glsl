@@ -8,7 +8,6 @@
 #define INFINITY 100000000.0
 #define PI 3.141592653
 #define EPSILON 0.00001
-#define PDF (1.0 / (2 * PI))
 
 struct Material
 {
@@ -18,73 +17,12 @@ struct Material
     float specular;     // 镜面反射的强度
     float specularTint;     // 控制镜面反射的颜色，在baseColor和vec(1)之间插值
     float roughness;    // 粗糙度
+    float sheen;        // 边缘的绒毛光泽，用于布料
+    float sheenTint;    // 控制sheen的颜色，在vec(1)和baseColor之间插值
+    float clearcoat;    // 清漆层的强度
+    float clearcoatGloss;   // 清漆层的光泽度
 };
 
-float SchlickFresnel(float u)
-{
-    float m = clamp(1-u, 0, 1);
-    float m2 = m * m;
-    return m2 * m2 * m;
-}
-
-float GTR1(float NdotH, float a) {
-    if (a >= 1) return 1/PI;
-    float a2 = a*a;
-    float t = 1 + (a2-1)*NdotH*NdotH;
-    return (a2-1) / (PI*log(a2)*t);
-}
-
-float GTR2(float NdotH, float a) {
-    float a2 = a*a;
-    float t = 1 + (a2-1)*NdotH*NdotH;
-    if(t == 0.0) return 0.0;
-    return a2 / (PI * t*t);
-}
-
-float smithG_GGX(float NdotV, float alphaG) {
-    float a = alphaG*alphaG;
-    float b = NdotV*NdotV;
-    return 1 / (NdotV + sqrt(a + b - a*b));
-}
-
-// https://github.com/wdas/brdf/blob/main/src/brdfs/disney.brdf
-// https://media.disneyanimation.com/uploads/production/publication_asset/48/asset/s2012_pbs_disney_brdf_notes_v3.pdf
-// 只实现漫反射和镜面反射
-vec3 brdf(vec3 V, vec3 N, vec3 L, in Material material)
-{
-    // 预计算常用数值
-    float NdotL = dot(N, L);
-    float NdotV = dot(N, V);
-    if(NdotL < 0 || NdotV < 0) return vec3(0);
-    vec3 H = normalize(L + V);
-    float NdotH = dot(N, H);
-    float LdotH = dot(L, H);
-
-    vec3 Cdlin = material.baseColor;
-    float Cdlum = 0.3 * Cdlin.r + 0.6 * Cdlin.g  + 0.1 * Cdlin.b;
-    vec3 Ctint = (Cdlum > 0) ? (Cdlin/Cdlum) : (vec3(1)); 
-    vec3 Cspec = material.specular * mix(vec3(1), Ctint, material.specularTint);
-    vec3 Cspec0 = mix(0.08*Cspec, Cdlin, material.metallic); // 0° 镜面反射颜色
-
-    // 漫反射
-    float Fd90 = 0.5 + 2.0 * LdotH * LdotH * material.roughness;
-    float FL = SchlickFresnel(NdotL);
-    float FV = SchlickFresnel(NdotV);
-    float Fd = mix(1.0, Fd90, FL) * mix(1.0, Fd90, FV);
-    vec3 diffuse = Fd * Cdlin / PI;
-
-    // 镜面反射
-    float alpha = material.roughness * material.roughness;
-    float Ds = GTR2(NdotH, alpha);
-    float FH = SchlickFresnel(LdotH);
-    vec3 Fs = mix(Cspec0, vec3(1), FH);
-    float Gs = smithG_GGX(NdotL, material.roughness);
-    Gs *= smithG_GGX(NdotV, material.roughness);
-    vec3 specular = Gs * Fs * Ds;
-    
-    return diffuse * (1.0 - material.metallic) + specular;
-}
-
 struct Ray
 {
     vec3 ori;
@@ -116,6 +54,7 @@ struct Triangle
     vec3 p0, p1, p2;    // 位置
     vec3 n0, n1, n2;    // 法线
     uint material_id;
+    int light_id;       // 在光源BVH中的编号，不发光时为 -1
 };
 
 struct Intersection
@@ -124,133 +63,33 @@ struct Intersection
     float t;
     vec3 normal;
     Material material;
+    int material_id;
+    int light_id;
 };
 
 uniform Material materials[8];
 uniform uint frame_count;
-uniform sampler2D imgTex;
 uniform Camera camera;
 uniform Sphere spheres[3];
 uniform Triangle tris[12];
+uniform bool furnace_test;  // 白炉测试：场景中只保留球体，环境光为1，能量守恒的BRDF应当与背景融为一体
+uniform bool direct_only;   // 只计算面光源的直接光照，用于和 ReSTIR 对比
 
 in vec2 TexCoords;
-out vec4 FragColor;
-
-uint static_seed;
-
-// 生成随机数https://blog.demofox.org/2020/05/25/casual-shadertoy-path-tracing-1-basic-camera-diffuse-emissive/
-uint seed = uint(
-    uint((gl_FragCoord.x * 0.5 + 0.5) * WIDTH)  * uint(1973) + 
-    uint((gl_FragCoord.y * 0.5 + 0.5) * HEIGHT) * uint(9277) + 
-    uint(frame_count + static_seed) * uint(26699)) | uint(1);
-
-uint wang_hash(inout uint seed) {
-    seed = uint(seed ^ uint(61)) ^ uint(seed >> uint(16));
-    seed *= uint(9);
-    seed = seed ^ (seed >> 4);
-    seed *= uint(0x27d4eb2d);
-    seed = seed ^ (seed >> 15);
-    return seed;
-}
- 
-float rand() {
-    static_seed ++;
-    return float(wang_hash(seed)) / 4294967296.0;
-}
-
-// 半球面均匀采样
-vec3 sampleHemisphere()
-{
-    float z = rand();
-    float r = max(0, sqrt(1 - z*z));
-    float phi = 2.0 * PI * rand();
-    return vec3(r * cos(phi), r * sin(phi), z);
-}
-
-// 将半球上的光线方向转换为世界方向
-vec3 toWorld(vec3 v, vec3 normal)
-{
-    vec3 B, C;
-	if (abs(normal.x) > abs(normal.y))
-	{
-		float inv_len = 1.0 / sqrt(normal.x * normal.x + normal.z * normal.z);
-		C = vec3(normal.z * inv_len, 0.0f, -normal.x * inv_len);
-	}
-	else
-	{
-		float inv_len = 1.0f / sqrt(normal.y * normal.y + normal.z * normal.z);
-		C = vec3(0.0f, normal.z * inv_len, -normal.y * inv_len);
-	}
-	B = cross(C, normal);
-	return B * v.x + C * v.y + normal * v.z;
-}
-
-vec3 SampleGTR2(vec3 V, vec3 N, float alpha) {
-    
-    float xi_1 = rand();
-    float xi_2 = rand();
-    float phi_h = 2.0 * PI * xi_1;
-    float sin_phi_h = sin(phi_h);
-    float cos_phi_h = cos(phi_h);
-
-    float cos_theta_h = sqrt((1.0-xi_2)/(1.0+(alpha*alpha-1.0)*xi_2));
-    float sin_theta_h = sqrt(max(0.0, 1.0 - cos_theta_h * cos_theta_h));
-
-    // 采样 "微平面" 的法向量 作为镜面反射的半角向量 h 
-    vec3 H = vec3(sin_theta_h*cos_phi_h, sin_theta_h*sin_phi_h, cos_theta_h);
-    H = toWorld(H, N);   // 投影到真正的法向半球
-
-    // 根据 "微法线" 计算反射光方向
-    vec3 L = reflect(-V, H);
-
-    return L;
-}
-
-float sqr(float x) { 
-    return x*x; 
-}
 
-vec3 sampleBRDF(vec3 V, vec3 N, in Material material)
-{
-    float alpha_GTR2 = max(0.001, sqr(material.roughness));
-
-    float p_diffuse = 1.0 - material.metallic;
-    float p_specular = material.metallic;
-
-    float r3 = rand();
-
-    if(r3 < p_diffuse)
-    {
-        return toWorld(sampleHemisphere(), N);
-    }
-    else
-    {
-        return SampleGTR2(V, N, alpha_GTR2);
-    }
-}
-
-float pdfBRDF(vec3 V, vec3 N, vec3 L, in Material material)
-{
-    float NdotL = dot(N, L);
-    float NdotV = dot(N, V);
-    if(NdotL < 0 || NdotV < 0) return 0;
+// RESTIR_PASS 由 Render 编译 ReSTIR 的各个pass时定义，见 restir.glsl
+#if defined(RESTIR_PASS) && RESTIR_PASS < 3
+#define ACCUMULATE_NO_OUTPUT
+#endif
+#include "accumulate.glsl"
 
-    vec3 H = normalize(L + V);
-    float NdotH = dot(N, H);
-    float LdotH = dot(L, H);
+#define SAMPLER_BOUNCE_DIMS 8     // BRDF采样3维，环境光采样2维，光源采样3维
+#include "sampler.glsl"
+#include "sampling.glsl"
 
-    float alpha = max(0.001, sqr(material.roughness));
-    float Ds = GTR2(NdotH, alpha); 
-
-    float pdf_diffuse = NdotL / PI;
-    float pdf_specular = Ds * NdotH / (4.0 * dot(L, H));
-
-    float p_diffuse = 1.0 - material.metallic;
-    float p_specular = material.metallic;
-
-    float pdf = p_diffuse   * pdf_diffuse + p_specular * pdf_specular;
-    return max(0, pdf);
-}
+#include "disney_brdf.glsl"
+#include "environment.glsl"
+#include "light_bvh.glsl"
 
 bool hitSphere(Ray ray, Sphere sphere, float t_min, float t_max, out Intersection inter)
 {
@@ -280,6 +119,8 @@ bool hitSphere(Ray ray, Sphere sphere, float t_min, float t_max, out Intersectio
     inter.position = pointAt(root, ray);
     inter.normal = (inter.position - sphere.center) / sphere.radius;
     inter.material = materials[sphere.material_id];
+    inter.material_id = int(sphere.material_id);
+    inter.light_id = -1;
 
     if(dot(inter.normal, ray.dir) > 0)  // 如果光源打到球的内部
     {
@@ -326,17 +167,28 @@ bool hitTriangle(Ray ray, Triangle tri, float t_min, float t_max, out Intersecti
     inter.t = t;
     inter.position = pointAt(t, ray);
     inter.material = materials[tri.material_id];
+    inter.material_id = int(tri.material_id);
     inter.normal = norm;
+    inter.light_id = tri.light_id;
 
     return true;
 }
 
+// 光线逃逸时的环境光
+vec3 background(vec3 dir)
+{
+    if(furnace_test)
+        return vec3(1);
+    return use_environment ? envRadiance(dir) : vec3(0.5);
+}
+
 bool hitWorld(Ray ray, out Intersection inter)
 {
     float closet_inter_t = INFINITY;
     bool if_tag = false;
-    for(int i = 0; i < 12; ++i)
+    for(int i = 0; i < (furnace_test ? 0 : 12); ++i)
     {
+        COUNT_PRIMITIVE();
         Intersection inter_temp;
         if(hitTriangle(ray, tris[i], 0, closet_inter_t, inter_temp))
         {
@@ -347,6 +199,7 @@ bool hitWorld(Ray ray, out Intersection inter)
     }
     for(int i = 0; i < 3; ++i)
     {
+        COUNT_PRIMITIVE();
         Intersection inter_temp;
         if(hitSphere(ray, spheres[i], 0, closet_inter_t, inter_temp))
         {
@@ -359,37 +212,102 @@ bool hitWorld(Ray ray, out Intersection inter)
     return if_tag;
 }
 
+// 对环境光采样一个方向做下一事件估计，与BRDF采样之间按幂启发式加权
+vec3 sampleEnvironmentLight(Intersection inter, vec3 V)
+{
+    vec3 L = sampleEnvironment(vec2(rand(), rand()));
+    vec3 N = inter.normal;
+    float NdotL = dot(N, L);
+    float pdf_light = pdfEnvironment(L);
+    if(NdotL <= 0.0 || pdf_light <= 0.0)
+        return vec3(0);
+
+    Ray shadow_ray;
+    shadow_ray.ori = inter.position + N * 1e-4;
+    shadow_ray.dir = L;
+    Intersection occluder;
+    COUNT_RAY(RAY_SHADOW);
+    if(hitWorld(shadow_ray, occluder))
+        return vec3(0);
+
+    float weight = powerHeuristic(pdf_light, pdfBRDF(V, N, L, inter.material));
+    return brdf(V, N, L, inter.material) * NdotL * envRadiance(L) * weight / pdf_light;
+}
+
+// 通过光源BVH选择一个发光三角形做下一事件估计，与BRDF采样之间按幂启发式加权
+vec3 sampleAreaLight(Intersection inter, vec3 V)
+{
+    vec3 N = inter.normal;
+    LightSample s;
+    if(!sampleLight(inter.position, N, vec3(rand(), rand(), rand()), s))
+        return vec3(0);
+    float NdotL = dot(N, s.L);
+    if(NdotL <= 0.0)
+        return vec3(0);
+
+    Ray shadow_ray;
+    shadow_ray.ori = inter.position + N * 1e-4;
+    shadow_ray.dir = s.L;
+    Intersection occluder;
+    COUNT_RAY(RAY_SHADOW);
+    if(hitWorld(shadow_ray, occluder) && occluder.t < s.dist - 1e-3)
+        return vec3(0);
+
+    float weight = s.hittable ? powerHeuristic(s.pdf, pdfBRDF(V, N, s.L, inter.material)) : 1.0;
+    return brdf(V, N, s.L, inter.material) * NdotL * s.emission * weight / s.pdf;
+}
+
 vec3 trace(Intersection inter, Ray ray)
 {
     vec3 indir_filtration = vec3(1);
     vec3 result = vec3(0);
+    bool env_light = use_environment && !furnace_test && !direct_only;
+    bool area_light = light_count > 0 && !furnace_test;
 
     if(inter.material.emissive != vec3(0))
         return inter.material.emissive;
 
     for(int i = 0; i < DEPTH; ++i)
     {
+        if(direct_only && i > 0)
+            break;
+        startBounce(i);
         vec3 V = -ray.dir;
         vec3 N = inter.normal;
         vec3 L = sampleBRDF(V, N, inter.material);
+
+        // 采样到表面以下的方向时路径终止，光源采样要在这之前完成
+        if(env_light)
+            result += sampleEnvironmentLight(inter, V) * indir_filtration;
+        if(area_light)
+            result += sampleAreaLight(inter, V) * indir_filtration;
+
         float NdotL = dot(L, inter.normal);
         if(NdotL <= 0.0) break;
         
         vec3 f_r = brdf(V, N, L, inter.material);
         float pdf = pdfBRDF(V, N, L, inter.material);
+        if(pdf <= 0.0) break;
         indir_filtration *= f_r * NdotL / pdf;
 
         ray.dir = L;
         ray.ori = inter.position;
         
         Intersection new_inter;
+        COUNT_RAY(RAY_BOUNCE);
         if(!hitWorld(ray, new_inter))
         {
-            result += vec3(0.5) * indir_filtration;
+            // 环境光已经做过下一事件估计，BRDF采样到的只取MIS权重对应的部分
+            float weight = env_light ? powerHeuristic(pdf, pdfEnvironment(L)) : 1.0;
+            if(!direct_only)
+                result += background(L) * weight * indir_filtration;
             break;
         }
         
-        result += new_inter.material.emissive * indir_filtration;
+        float weight = 1.0;
+        if(area_light && new_inter.light_id >= 0)
+            weight = powerHeuristic(pdf, pdfLight(inter.position, N, new_inter.light_id, new_inter.position));
+        result += new_inter.material.emissive * weight * indir_filtration;
         inter = new_inter;
     }
 
@@ -397,26 +315,36 @@ vec3 trace(Intersection inter, Ray ray)
 }
 
 
+#ifdef RESTIR_PASS
+#include "restir.glsl"
+#else
 void main()
 {
-    float u = (gl_FragCoord.x - 0.5 + rand()) / (WIDTH - 1);
-    float v = (gl_FragCoord.y - 0.5 + rand()) / (HEIGHT - 1);
-    Ray ray;
-    ray.ori = camera.ori;
-    ray.dir = normalize(camera.lower_left_corner + u * camera.horizontal + v * camera.vertical - camera.ori);
-
     vec3 color = vec3(0);
-    int spp = 10;
-    static_seed = 0u;
+    float lum2 = 0.0;
+    int spp = adaptiveSpp(10);
+    uint first_sample = accumulatedSamples();
     for(int i = 0; i < spp; ++i)
     {
+        initSampler(uvec2(gl_FragCoord.xy), first_sample + uint(i));
+        float u = (gl_FragCoord.x - 0.5 + rand()) / (WIDTH - 1);
+        float v = (gl_FragCoord.y - 0.5 + rand()) / (HEIGHT - 1);
+        Ray ray;
+        ray.ori = camera.ori;
+        ray.dir = normalize(camera.lower_left_corner + u * camera.horizontal + v * camera.vertical - camera.ori);
+
+        vec3 c = background(ray.dir);
         Intersection inter;
+        COUNT_RAY(RAY_PRIMARY);
         if(hitWorld(ray, inter))
         {
-            color += trace(inter, ray) / spp;
+            recordFirstHit(inter.normal, inter.t, inter.material.emissive != vec3(0) ? vec3(1) : inter.material.baseColor);
+            c = trace(inter, ray);
         }
+        color += c;
+        lum2 += luminance(c) * luminance(c);
     }
 
-    vec3 textureColor = texture(imgTex, TexCoords).rgb;
-    FragColor = vec4(mix(textureColor, color, 1.0 / float(frame_count)), 1.0);
-}
\ No newline at end of file
+    accumulate(color, lum2, spp);
+}
+#endif
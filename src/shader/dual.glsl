@@ -0,0 +1,12 @@
+// 前向自动微分的对偶数，供 ImplicitFunction 生成的 implicitDual 使用
+// vec4 的 x 为函数值，yzw 为对 x y z 的偏导，加减和数乘直接用 vec4 的运算
+
+vec4 mul_dual(vec4 a, vec4 b)
+{
+    return vec4(a.x * b.x, a.x * b.yzw + b.x * a.yzw);
+}
+
+vec4 sqr_dual(vec4 a)
+{
+    return vec4(a.x * a.x, 2.0 * a.x * a.yzw);
+}
@@ -0,0 +1,63 @@
+// HDR环境光的查询、重要性采样与pdf，表由 common/environment.cpp 构建
+// 经纬度映射：θ = acos(y) 对应 v，φ = atan(z, x) 对应 u，u = 0.5 为 +x 方向
+
+uniform bool use_environment;
+uniform sampler2D envTex;               // 辐射度，线性过滤
+uniform sampler2D envConditionalTex;    // 每行的别名表 (阈值, 别名)
+uniform sampler2D envMarginalTex;       // 行的别名表，height x 1
+uniform float env_pdf_scale;            // 像素的uv空间pdf = 亮度 * sinθ * env_pdf_scale
+
+vec2 directionToEnvUV(vec3 dir)
+{
+    return vec2(atan(dir.z, dir.x) / (2.0 * PI) + 0.5, acos(clamp(dir.y, -1.0, 1.0)) / PI);
+}
+
+vec3 envUVToDirection(vec2 uv)
+{
+    float phi = (uv.x - 0.5) * 2.0 * PI;
+    float theta = uv.y * PI;
+    return vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+}
+
+vec3 envRadiance(vec3 dir)
+{
+    return texture(envTex, directionToEnvUV(dir)).rgb;
+}
+
+// 立体角上的pdf，与构建别名表时的权重保持一致：同一像素内按uv均匀分布
+float pdfEnvironment(vec3 dir)
+{
+    ivec2 size = textureSize(envTex, 0);
+    vec2 uv = directionToEnvUV(dir);
+    ivec2 texel = min(ivec2(uv * vec2(size)), size - 1);
+    float sin_theta = sqrt(max(0.0, 1.0 - dir.y * dir.y));
+    if(sin_theta <= 0.0) return 0.0;
+    float row_sin = sin(PI * (float(texel.y) + 0.5) / float(size.y));
+    float pdf_uv = luminance(texelFetch(envTex, texel, 0).rgb) * row_sin * env_pdf_scale;
+    return pdf_uv / (2.0 * PI * PI * sin_theta);
+}
+
+// 别名表查询：比较后剩下的小数部分重新映射到 [0,1)，作为像素内的偏移
+int sampleAlias(sampler2D table, ivec2 base, int n, inout float u)
+{
+    float x = u * float(n);
+    int i = min(int(x), n - 1);
+    u = x - float(i);
+    vec2 entry = texelFetch(table, base + ivec2(i, 0), 0).rg;
+    if(u < entry.x)
+    {
+        u = u / entry.x;
+        return i;
+    }
+    u = (u - entry.x) / (1.0 - entry.x);
+    return int(entry.y);
+}
+
+vec3 sampleEnvironment(vec2 xi)
+{
+    ivec2 size = textureSize(envConditionalTex, 0);
+    int row = sampleAlias(envMarginalTex, ivec2(0), size.y, xi.y);
+    int column = sampleAlias(envConditionalTex, ivec2(0, row), size.x, xi.x);
+    vec2 uv = (vec2(column, row) + clamp(xi, 0.0, 0.9999)) / vec2(size);
+    return envUVToDirection(uv);
+}
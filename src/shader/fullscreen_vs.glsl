@@ -0,0 +1,8 @@
+#version 330 core
+
+// 覆盖整个视口的三角形，不需要顶点缓冲，绑定一个空的vao后绘制3个顶点即可
+void main()
+{
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
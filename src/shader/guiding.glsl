@@ -0,0 +1,125 @@
+// 路径引导：按 common/sd_tree.cpp 学到的空间-方向树采样入射方向
+// 方向用 (cosθ, φ) 映射到单位正方形，映射保面积，正方形上的pdf除以 4π 就是立体角上的pdf
+
+#define GUIDING_ITEMS_PER_ROW 1024  // 与 SDTree::ITEMS_PER_ROW 一致
+#define GUIDING_MAX_DEPTH 20        // 四叉树的最大深度，与 sd_tree.cpp 一致
+
+uniform bool guiding_enabled;       // 还没有学到分布时为 false
+uniform vec3 guiding_min;           // 空间树根节点的包围盒
+uniform vec3 guiding_max;
+uniform sampler2D guidingSpatialTex;    // 每个节点1个像素：(切分轴，叶节点为 -1, 左, 右, 四叉树的根)
+uniform sampler2D guidingQuadTex;       // 每个节点2个像素：(四个子区域的能量), (四个子节点，0 表示叶)，子区域编号为 x + 2 * y
+
+vec4 guidingSpatialTexel(int node)
+{
+    return texelFetch(guidingSpatialTex, ivec2(node % GUIDING_ITEMS_PER_ROW, node / GUIDING_ITEMS_PER_ROW), 0);
+}
+
+vec4 guidingQuadTexel(int node, int k)
+{
+    return texelFetch(guidingQuadTex, ivec2((node % GUIDING_ITEMS_PER_ROW) * 2 + k, node / GUIDING_ITEMS_PER_ROW), 0);
+}
+
+// 包含 P 的空间叶节点的四叉树，没有可用的分布时返回 -1
+int guidingTree(vec3 P)
+{
+    if(!guiding_enabled)
+        return -1;
+    vec3 p = clamp((P - guiding_min) / (guiding_max - guiding_min), 0.0, 1.0);
+    vec4 t = guidingSpatialTexel(0);
+    while(t.x >= 0.0)
+    {
+        int axis = int(t.x);
+        int side = p[axis] < 0.5 ? 0 : 1;
+        p[axis] = p[axis] * 2.0 - float(side);
+        t = guidingSpatialTexel(int(side == 0 ? t.y : t.z));
+    }
+    int root = int(t.w);
+    vec4 sum = guidingQuadTexel(root, 0);
+    return dot(sum, vec4(1)) > 0.0 ? root : -1;
+}
+
+vec2 guidingDirectionToSquare(vec3 d)
+{
+    float phi = atan(d.y, d.x);
+    if(phi < 0.0)
+        phi += 2.0 * PI;
+    return clamp(vec2((d.z + 1.0) * 0.5, phi / (2.0 * PI)), 0.0, 1.0);
+}
+
+vec3 guidingSquareToDirection(vec2 p)
+{
+    float cos_theta = 2.0 * p.x - 1.0;
+    float sin_theta = sqrt(max(0.0, 1.0 - cos_theta * cos_theta));
+    float phi = 2.0 * PI * p.y;
+    return vec3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
+}
+
+// 从根节点按能量随机下降到叶节点，在叶节点内均匀采样
+vec3 sampleGuiding(int root, vec2 xi)
+{
+    int node = root;
+    vec2 origin = vec2(0);
+    float scale = 1.0;
+    for(int depth = 0; depth < GUIDING_MAX_DEPTH; ++depth)
+    {
+        vec4 sum = guidingQuadTexel(node, 0);
+        // 先按左右两列的能量选 x，再在选中的列里按上下选 y
+        float left = sum.x + sum.z;
+        float total = left + sum.y + sum.w;
+        int x;
+        if(xi.x * total < left)
+        {
+            x = 0;
+            xi.x = xi.x * total / left;
+        }
+        else
+        {
+            x = 1;
+            xi.x = (xi.x * total - left) / (total - left);
+        }
+        float bottom = x == 0 ? sum.x : sum.y;
+        float column = x == 0 ? left : total - left;
+        int y;
+        if(xi.y * column < bottom)
+        {
+            y = 0;
+            xi.y = xi.y * column / bottom;
+        }
+        else
+        {
+            y = 1;
+            xi.y = (xi.y * column - bottom) / (column - bottom);
+        }
+        xi = clamp(xi, 0.0, 0.99999994);
+
+        scale *= 0.5;
+        origin += vec2(x, y) * scale;
+        int child = int(guidingQuadTexel(node, 1)[x + 2 * y]);
+        if(child == 0)
+            break;
+        node = child;
+    }
+    return guidingSquareToDirection(origin + xi * scale);
+}
+
+float pdfGuiding(int root, vec3 L)
+{
+    vec2 p = guidingDirectionToSquare(L);
+    int node = root;
+    float pdf = 1.0;
+    for(int depth = 0; depth < GUIDING_MAX_DEPTH; ++depth)
+    {
+        vec4 sum = guidingQuadTexel(node, 0);
+        int x = p.x < 0.5 ? 0 : 1;
+        int y = p.y < 0.5 ? 0 : 1;
+        int q = x + 2 * y;
+        pdf *= 4.0 * sum[q] / dot(sum, vec4(1));
+        int child = int(guidingQuadTexel(node, 1)[q]);
+        if(child == 0 || pdf <= 0.0)
+            break;
+        node = child;
+        p = p * 2.0 - vec2(x, y);
+    }
+    return pdf / (4.0 * PI);
+}
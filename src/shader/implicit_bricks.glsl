@@ -0,0 +1,37 @@
+// ImplicitBricks 的稀疏砖块距离场，见 common/implicit_bricks.h，坐标都在曲面的局部空间中
+// implicitGridTex 每个格子一个纹素，x 为格子内任意一点到曲面距离的下界，y 为砖块编号，空格子为 -1，第 i 个曲面在 z 方向的第 i 段
+// implicitBrickTex 为砖块图集，每个砖块 (IMPLICIT_BRICK + 1)^3 个格点，格点上存的值线性插值后仍是距离的下界
+
+#define IMPLICIT_BRICK 8
+#define IMPLICIT_ATLAS_BRICKS 32
+
+uniform sampler3D implicitGridTex;
+uniform sampler3D implicitBrickTex;
+
+// 包围盒为 [box_min, box_max] 的曲面的砖块中一个体素的边长，取最长的轴
+float implicitVoxelSize(vec3 box_min, vec3 box_max)
+{
+    vec3 size = box_max - box_min;
+    return max(max(size.x, size.y), size.z) / float(textureSize(implicitGridTex, 0).x * IMPLICIT_BRICK);
+}
+
+// p 到第 surface 个曲面距离的下界，p 必须在包围盒内；p 在空格子里时至少走到沿 dir 离开格子的位置
+float implicitDistanceBound(int surface, vec3 box_min, vec3 box_max, vec3 p, vec3 dir)
+{
+    int n = textureSize(implicitGridTex, 0).x;
+    vec3 cell_size = (box_max - box_min) / float(n);
+    vec3 g = clamp((p - box_min) / cell_size, vec3(0.0), vec3(float(n) * 0.99999));
+    ivec3 cell = ivec3(floor(g));
+    vec2 texel = texelFetch(implicitGridTex, cell + ivec3(0, 0, surface * n), 0).xy;
+    if(texel.y < 0.0)
+    {
+        vec3 bound = box_min + (vec3(cell) + step(0.0, dir)) * cell_size;
+        vec3 exit = mix(vec3(INFINITY), (bound - p) / dir, greaterThan(abs(dir), vec3(1e-8)));
+        return max(texel.x, min(min(exit.x, exit.y), exit.z) + 1e-4 * cell_size.x);
+    }
+
+    int b = int(texel.y);
+    ivec3 origin = ivec3(b % IMPLICIT_ATLAS_BRICKS, b / IMPLICIT_ATLAS_BRICKS % IMPLICIT_ATLAS_BRICKS, b / (IMPLICIT_ATLAS_BRICKS * IMPLICIT_ATLAS_BRICKS)) * (IMPLICIT_BRICK + 1);
+    vec3 local = (g - vec3(cell)) * float(IMPLICIT_BRICK) + 0.5;
+    return texture(implicitBrickTex, (vec3(origin) + local) / vec3(textureSize(implicitBrickTex, 0))).x;
+}
@@ -51,155 +51,35 @@ struct Intersection
     float t;
     vec3 normal;
     Material material;
+    int function;   // 打到的隐式曲面的函数编号，三角形为 -1
+};
+
+// 局部空间中的一个隐式曲面
+struct ImplicitSurface
+{
+    int function;   // ImplicitShaderCache 中的函数编号
+    int bricks;     // ImplicitBricks 中的曲面编号
+    vec3 box_min;
+    vec3 box_max;
 };
 
 uniform Material materials[2];
 uniform uint frame_count;
-uniform sampler2D imgTex;
 uniform Camera camera;
-uniform Triangle tris[10];
-uniform vec3 aabb_min;
-uniform vec3 aabb_max;
+uniform bool primary_hits;  // 只求像素中心主光线的第一个交点，输出 (t, 函数编号, 法线与光线夹角的余弦)，没打到为 -1，供 implicit_surface --validate 使用
 
 in vec2 TexCoords;
-out vec4 FragColor;
-
-uint static_seed;
-
-// Reduced Affine Arithmetic
-vec3 IAtoRAA(vec2 ia)   // 区间算术转化为仿射算术
-{
-    vec3 raa;
-    raa.x = (ia.x + ia.y) / 2.0;
-    raa.y = (ia.y - ia.x) / 2.0;
-    raa.z = 0;
-    return raa;
-}
-
-float raa_radius(vec3 raa)
-{
-    return abs(raa.y) + raa.z;
-}
-
-vec3 add_num(vec3 raa, float num)
-{
-    raa.x += num;
-    return raa;
-}
-
-vec3 sub_num(vec3 raa, float num)
-{
-    raa.x -= num;
-    return raa;
-}
-
-vec3 mul_num(vec3 raa, float num)
-{
-    raa.x *= num;
-    raa.y *= num;
-    raa.z *= abs(num);
-    return raa;
-}
-
-vec3 add_raa(vec3 raa, vec3 other)
-{
-    raa += other;
-    return raa;
-}
-
-vec3 sub_raa(vec3 raa, vec3 other)
-{
-    raa.x -= other.x;
-    raa.y -= other.y;
-    raa.z += other.z;
-    return raa; 
-}
-
-vec3 mul_raa(vec3 raa, vec3 other)
-{
-    vec3 ans;
-    ans.x = raa.x * other.x;
-    ans.y = raa.x * other.y + raa.y * other.x;
-    ans.z = abs(raa.x) * other.z + abs(other.x) * raa.z + (abs(raa.y) + raa.z) * (abs(other.y) + other.z);
-    return ans;
-}
-
-vec3 pow_num(vec3 raa, int num)
-{
-    vec3 ans = raa;
-    for(int i = 1; i < num; ++i)
-    {
-        ans = mul_raa(ans, raa);
-    }
-    return ans;
-}
-
-bool rejectTest(vec3 raa_t, vec3 enter, vec3 span)
-{
-    vec3 raa_x = add_num(mul_num(raa_t, span.x), enter.x);
-    vec3 raa_y = add_num(mul_num(raa_t, span.y), enter.y);
-    vec3 raa_z = add_num(mul_num(raa_t, span.z), enter.z);
-
-    vec3 raa_x2 = mul_raa(raa_x, raa_x);
-    vec3 raa_y2 = mul_raa(raa_z, raa_z);
-    vec3 raa_z2 = mul_raa(raa_y, raa_y);
-    vec3 raa_z3 = mul_raa(raa_y, raa_z2);
-    
-    vec3 left = raa_x2 + mul_num(raa_y2, 9.0 / 4.0) + raa_z2;
-    left = pow_num(sub_num(left, 1), 3);
-    vec3 right = mul_raa(raa_x2, raa_z3) + mul_num(mul_raa(raa_y2, raa_z3), 9.0 / 80.0);
-    vec3 r = left - right;
-
-    float radius = raa_radius(r);
-    float low = r.x - radius;
-    float high = r.x + radius;
-    if(low < 0 && high > 0)
-        return true;
-    else return false;
-}
-
-// 生成随机数https://blog.demofox.org/2020/05/25/casual-shadertoy-path-tracing-1-basic-camera-diffuse-emissive/
-uint seed;
 
-uint wang_hash(inout uint seed) {
-    seed = uint(seed ^ uint(61)) ^ uint(seed >> uint(16));
-    seed *= uint(9);
-    seed = seed ^ (seed >> 4);
-    seed *= uint(0x27d4eb2d);
-    seed = seed ^ (seed >> 15);
-    return seed;
-}
- 
-float rand() {
-    return float(wang_hash(seed)) / 4294967296.0;
-}
+#include "accumulate.glsl"
 
-// 半球面均匀采样
-vec3 sampleHemisphere()
-{
-    float z = rand();
-    float r = max(0, sqrt(1 - z*z));
-    float phi = 2.0 * PI * rand();
-    return vec3(r * cos(phi), r * sin(phi), z);
-}
+#include "raa.glsl"
+#include "dual.glsl"
+#include "implicit_function.glsl"    // 由 ImplicitFunction 生成，见 common/implicit_function.h
+#include "implicit_bricks.glsl"
+#include "primitive_bvh.glsl"
 
-// 将半球上的光线方向转换为世界方向
-vec3 toWorld(vec3 v, vec3 normal)
-{
-    vec3 B, C;
-	if (abs(normal.x) > abs(normal.y))
-	{
-		float inv_len = 1.0 / sqrt(normal.x * normal.x + normal.z * normal.z);
-		C = vec3(normal.z * inv_len, 0.0f, -normal.x * inv_len);
-	}
-	else
-	{
-		float inv_len = 1.0f / sqrt(normal.y * normal.y + normal.z * normal.z);
-		C = vec3(0.0f, normal.z * inv_len, -normal.y * inv_len);
-	}
-	B = cross(C, normal);
-	return B * v.x + C * v.y + normal * v.z;
-}
+#include "sampler.glsl"
+#include "sampling.glsl"
 
 bool hitTriangle(Ray ray, Triangle tri, float t_min, float t_max, out Intersection inter)
 {
@@ -238,80 +118,310 @@ bool hitTriangle(Ray ray, Triangle tri, float t_min, float t_max, out Intersecti
     inter.t = t;
     inter.position = pointAt(t, ray);
     inter.material = materials[tri.material_id];
+    inter.function = -1;
     inter.normal = norm;
 
     return true;
 }
 
-bool hitImplicitSurface(Ray ray, float t_min, float t_max, out Intersection inter)
+#define IMPLICIT_MAX_DEPTH 16            // 区间栈的深度，也是最多二分的层数
+#define IMPLICIT_MIN_SPLIT 4.0           // 端点异号的区间短于整段的 1/4 才认为只有一个根，更长时继续二分，防止跳过更近的根
+#define IMPLICIT_MAX_EVALUATIONS 256     // 每条光线 implicitRAA 次数的上限
+#define IMPLICIT_REFINE_STEPS 16
+#define IMPLICIT_MAX_STEPS 128           // 球追踪的步数上限，用完后剩下的部分直接求根
+#define IMPLICIT_NARROW_MARGIN 1e-3      // 缩小后 ε 的范围两端各放宽的量，RAA 没有计入 float 的舍入误差，根在端点上时会被下一层排除
+#define IMPLICIT_TILE 8                  // 与 ImplicitTiles::TILE 一致
+#define IMPLICIT_PENDING 8               // 遍历时最多先记下的隐式曲面数，记满后先求交再从当前节点继续
+#define PRIMITIVE_BVH_MIN 8              // 图元少于这个数时逐个求交，省掉遍历 BVH 的开销；llvmpipe 上 11 个图元时 BVH 已经更快，见 hitWorld
+
+// 在 [a, b] 上求 f(pointAt(t)) 的根，fa 与 fb 异号，用 Illinois 修正的割线法，每步都保持根被夹在区间内
+float refineImplicitRoot(ImplicitSurface surface, Ray ray, float a, float b, float fa, float fb)
+{
+    float t = a;
+    int side = 0;
+    for(int k = 0; k < IMPLICIT_REFINE_STEPS; ++k)
+    {
+        t = (a * fb - b * fa) / (fb - fa);
+        if(!(t > a && t < b))    // 区间已经缩到相邻的两个 float
+            break;
+        float f = implicitValue(surface.function, pointAt(t, ray));
+        if(f * fb > 0.0)
+        {
+            b = t;
+            fb = f;
+            if(side == -1)
+                fa *= 0.5;
+            side = -1;
+        }
+        else if(f * fa > 0.0)
+        {
+            a = t;
+            fa = f;
+            if(side == 1)
+                fb *= 0.5;
+            side = 1;
+        }
+        else
+            break;
+    }
+    return t;
+}
+
+// [lo, hi] 上 f 的仿射形式为 r.x + r.y * ε ± r.z，ε ∈ [-1, 1] 线性对应 t，只有 |r.x + r.y * ε| <= r.z 的 ε 处可能有根
+// 返回可能有根的子区间，为空时 x > y
+vec2 narrowImplicitInterval(ImplicitSurface surface, Ray ray, float lo, float hi)
 {
-    vec3 a = (aabb_min - ray.ori) / ray.dir;
-    vec3 b = (aabb_max - ray.ori) / ray.dir;
+    sample_stats.x += 1.0;
+    COUNT_ITERATION();
+    vec3 t = IAtoRAA(vec2(lo, hi));
+    vec3 r = implicitRAA(surface.function, add_num(mul_num(t, ray.dir.x), ray.ori.x), add_num(mul_num(t, ray.dir.y), ray.ori.y), add_num(mul_num(t, ray.dir.z), ray.ori.z));
+    if(abs(r.y) <= r.z * 1e-3)
+        return abs(r.x) <= r.z + abs(r.y) ? vec2(lo, hi) : vec2(hi, lo);
+    vec2 e = (vec2(-r.x - r.z, -r.x + r.z)) / r.y;
+    e = clamp(vec2(min(e.x, e.y) - IMPLICIT_NARROW_MARGIN, max(e.x, e.y) + IMPLICIT_NARROW_MARGIN), -1.0, 1.0);
+    if(e.x >= e.y)
+        return vec2(hi, lo);
+    return mix(vec2(lo), vec2(hi), e * 0.5 + 0.5);
+}
 
-    float t_enter = max(max(min(a.x, b.x), min(a.y, b.y)), min(a.z, b.z));
-    float t_exit = min(min(max(a.x, b.x), max(a.y, b.y)), max(a.z, b.z));
+// 沿光线深度优先地检查 [t0, t1]，返回第一个根：用仿射形式把区间缩到可能有根的部分，还不能确定时二分，左半先查，右半的终点压栈；
+// 一个区间被排除后从栈中弹出上一层等待的区间，新区间从当前的终点开始，所以栈中只存终点
+bool searchImplicitRoot(ImplicitSurface surface, Ray ray, float t0, float t1, out float t)
+{
+    float stack[IMPLICIT_MAX_DEPTH];
+    int top = 0;
+    float lo = t0, hi = t1;
+    float leaf = (t1 - t0) * exp2(-float(IMPLICIT_MAX_DEPTH));
+    for(int n = 0; n < IMPLICIT_MAX_EVALUATIONS; ++n)
+    {
+        vec2 range = narrowImplicitInterval(surface, ray, lo, hi);
+        if(range.x > range.y)
+        {
+            if(top == 0)
+                break;
+            lo = hi;
+            hi = stack[--top];
+            continue;
+        }
+        // 缩小后右边剩下的部分一定没有根，可以直接丢掉
+        lo = range.x;
+        hi = range.y;
+
+        float f_lo = implicitValue(surface.function, pointAt(lo, ray));
+        float f_hi = implicitValue(surface.function, pointAt(hi, ray));
+        bool bracketed = f_lo * f_hi <= 0.0;
+        // 第 k 层的区间不长于整段的 2^-k，区间缩到 leaf 之前栈不会满
+        if((bracketed && hi - lo <= (t1 - t0) / IMPLICIT_MIN_SPLIT) || hi - lo <= leaf || top == IMPLICIT_MAX_DEPTH)
+        {
+            // 缩到 leaf 仍没有变号时是擦过曲面，取 |f| 较小的端点
+            t = bracketed ? refineImplicitRoot(surface, ray, lo, hi, f_lo, f_hi) : (abs(f_lo) < abs(f_hi) ? lo : hi);
+            return true;
+        }
+        stack[top++] = hi;
+        hi = 0.5 * (lo + hi);
+    }
+    return false;
+}
 
-    if(t_enter > t_exit || t_exit < 0)
+// 在局部空间中求光线与曲面的第一个交点，ray.dir 必须是单位向量
+// 先用砖块距离场球追踪，距离的下界小于一个体素时在之后一个格子长的窗口里精确求根，窗口里没有根就从窗口末端继续追踪
+bool marchImplicitSurface(ImplicitSurface surface, Ray ray, float t_min, float t_max, out float hit)
+{
+    vec2 range = intersectBox(ray.ori, 1.0 / ray.dir, surface.box_min, surface.box_max);
+    float t0 = max(range.x, max(t_min, EPSILON));  // 从曲面上出发的光线不要打到自己
+    float t1 = min(range.y, t_max);
+    if(t0 >= t1)
         return false;
-    
-    vec3 vec_enter = ray.ori + t_enter * ray.dir;
-    vec3 vec_span = ray.dir * (t_exit - t_enter);
-    vec2 ia = vec2(0.0, 1.0);
-    float t_span = 0.5;
-    int d_max = 6;
-    int d = 0;
-
-    for(int i = 0; i < 30; ++i) // 设定一个循环的上限，不然程序会崩溃
+    sample_stats.y += 1.0;     // x: implicitRAA 的次数，y: 进入包围盒的光线数
+
+    float voxel = implicitVoxelSize(surface.box_min, surface.box_max);
+    float window = voxel * float(IMPLICIT_BRICK);
+    float t = t0;
+    bool found = false;
+    for(int n = 0; n < IMPLICIT_MAX_STEPS && t < t1; ++n)
     {
-        ia.y = ia.x + t_span;
-        if(ia.y > 1.0) break;
-        vec3 aa_t = IAtoRAA(ia);
-        if(rejectTest(aa_t, vec_enter, vec_span))
+        COUNT_STEP();
+        float d = implicitDistanceBound(surface.bricks, surface.box_min, surface.box_max, pointAt(t, ray), ray.dir);
+        if(d > voxel)
         {
-            if(d == d_max)
-            {
-                float t = (ia.x + ia.y) / 2;
-                if(t < t_min || t > t_max) return false;
-                inter.position = vec_enter + t * vec_span;
-                inter.t = ((inter.position - ray.ori) / ray.dir).x;
-                inter.normal = normalize(vec3(inter.position));
-                inter.material = materials[1];
-                return true;
-            }
-            t_span *= 0.5;
-            d ++;
+            t += d;
             continue;
         }
-        ia.x = ia.y;
+        // 走出空格子时多走了一点，窗口往回退一点
+        float lo = max(t0, t - 0.01 * voxel);
+        t = min(t + window, t1);
+        found = searchImplicitRoot(surface, ray, lo, t, hit);
+        if(found)
+            break;
     }
+    if(!found && t < t1)
+        found = searchImplicitRoot(surface, ray, t, t1, hit);
+    return found;
+}
 
-    return false;
+uniform sampler2D implicitTileTex;  // 每块主光线与第 implicit_tile_primitive 个图元的交点可能在的 t 范围，空块 x > y，见 implicit_tiles_fs.glsl
+uniform int implicit_tile_primitive;
+
+// 光线变换到第 primitive 个图元的局部空间中求交，方向重新归一化，局部的 t 是世界的 t 的 scale 倍
+// primary 为 true 时是这个像素的主光线，先按所在块的范围裁掉没有根的部分
+bool hitImplicitSurface(int primitive, Ray ray, bool primary, float t_min, float t_max, out Intersection inter)
+{
+    COUNT_PRIMITIVE();
+    if(primary && primitive == implicit_tile_primitive)
+    {
+        vec2 tile = texelFetch(implicitTileTex, ivec2(gl_FragCoord.xy) / IMPLICIT_TILE, 0).xy;
+        t_min = max(t_min, tile.x);
+        t_max = min(t_max, tile.y);
+        if(t_min >= t_max)
+            return false;
+    }
+
+    vec4 head = primitiveTexel(primitive, 0);
+    vec4 r0 = primitiveTexel(primitive, 1);
+    vec4 r1 = primitiveTexel(primitive, 2);
+    vec4 r2 = primitiveTexel(primitive, 3);
+    ImplicitSurface surface;
+    surface.function = int(head.z);
+    surface.bricks = int(head.w);
+    surface.box_min = primitiveTexel(primitive, 4).xyz;
+    surface.box_max = primitiveTexel(primitive, 5).xyz;
+
+    Ray local;
+    local.ori = vec3(dot(r0.xyz, ray.ori) + r0.w, dot(r1.xyz, ray.ori) + r1.w, dot(r2.xyz, ray.ori) + r2.w);
+    vec3 dir = vec3(dot(r0.xyz, ray.dir), dot(r1.xyz, ray.dir), dot(r2.xyz, ray.dir));
+    float scale = length(dir);
+    local.dir = dir / scale;
+
+    float t;
+    if(!marchImplicitSurface(surface, local, t_min * scale, t_max * scale, t))
+        return false;
+
+    // 法线按世界到局部变换的转置变回世界空间
+    vec3 gradient = implicitDual(surface.function, pointAt(t, local)).yzw;
+    inter.t = t / scale;
+    inter.position = pointAt(inter.t, ray);
+    inter.normal = normalize(mat3(r0.xyz, r1.xyz, r2.xyz) * gradient);
+    inter.material = materials[int(head.y)];
+    inter.function = surface.function;
+    return true;
+}
+
+bool hitTrianglePrimitive(int primitive, Ray ray, float t_min, float t_max, out Intersection inter)
+{
+    COUNT_PRIMITIVE();
+    Triangle tri;
+    tri.p0 = primitiveTexel(primitive, 1).xyz;
+    tri.p1 = primitiveTexel(primitive, 2).xyz;
+    tri.p2 = primitiveTexel(primitive, 3).xyz;
+    tri.n0 = primitiveTexel(primitive, 4).xyz;
+    tri.n1 = tri.n0;
+    tri.n2 = tri.n0;
+    tri.material_id = uint(primitiveTexel(primitive, 0).y);
+    return hitTriangle(ray, tri, t_min, t_max, inter);
 }
 
-bool hitWorld(Ray ray, out Intersection inter)
+// 图元少于 PRIMITIVE_BVH_MIN 个时逐个求交：先测所有三角形，再用最近的交点剔除隐式曲面，
+// 隐式曲面的包围盒在 marchImplicitSurface 中测，RAA 求根的代码同样只在第二个循环里
+bool hitWorldFlat(Ray ray, bool primary, out Intersection inter)
 {
     float closet_inter_t = INFINITY;
     bool if_tag = false;
     Intersection inter_temp;
-    for(int i = 0; i < 10; ++i)
+    for(int i = 0; i < primitive_count; ++i)
     {
-        if(hitTriangle(ray, tris[i], 0, closet_inter_t, inter_temp))
+        if(primitiveTexel(i, 0).x < 0.5 && hitTrianglePrimitive(i, ray, 0, closet_inter_t, inter_temp))
         {
             if_tag = true;
             closet_inter_t = inter_temp.t;
             inter = inter_temp;
         }
     }
-    if(hitImplicitSurface(ray, 0, closet_inter_t, inter_temp))
+    for(int i = 0; i < primitive_count; ++i)
+    {
+        if(primitiveTexel(i, 0).x > 0.5 && hitImplicitSurface(i, ray, primary, 0, closet_inter_t, inter_temp))
+        {
+            if_tag = true;
+            closet_inter_t = inter_temp.t;
+            inter = inter_temp;
+        }
+    }
+    return if_tag;
+}
+
+// 沿跳转链接无栈遍历 PrimitiveBVH，入口比当前最近交点远的节点直接跳过
+// 叶节点中的三角形立即求交，隐式曲面先记下来，记满或遍历结束时再按最近的交点剔除后求交，
+// 这样 RAA 求根的代码只有一处且不在遍历的循环里，不会每到一个叶节点都让同一组像素执行一遍
+bool hitWorldBVH(Ray ray, bool primary, out Intersection inter)
+{
+    float closet_inter_t = INFINITY;
+    bool if_tag = false;
+
+    vec3 inv_dir = 1.0 / ray.dir;
+    int pending[IMPLICIT_PENDING];
+    float pending_entry[IMPLICIT_PENDING];
+    Intersection inter_temp;
+    int node = 0;
+    while(node >= 0)
     {
-        if_tag = true;
-        closet_inter_t = inter_temp.t;
-        inter = inter_temp;
+        int pending_count = 0;
+        while(node >= 0 && pending_count < IMPLICIT_PENDING)
+        {
+            vec4 t0 = bvhNodeTexel(node, 0);
+            vec4 t1 = bvhNodeTexel(node, 1);
+            COUNT_BOX();
+            vec2 range = intersectBox(ray.ori, inv_dir, t0.xyz, t1.xyz);
+            if(range.x > range.y || range.y < 0.0 || range.x > closet_inter_t)
+            {
+                node = int(t0.w);
+                continue;
+            }
+            if(t1.w < 0.0)
+            {
+                ++node;
+                continue;
+            }
+
+            int i = int(t1.w);
+            if(primitiveTexel(i, 0).x > 0.5)
+            {
+                pending[pending_count] = i;
+                pending_entry[pending_count++] = range.x;
+            }
+            else if(hitTrianglePrimitive(i, ray, 0, closet_inter_t, inter_temp))
+            {
+                if_tag = true;
+                closet_inter_t = inter_temp.t;
+                inter = inter_temp;
+            }
+            node = int(t0.w);
+        }
+
+        for(int i = 0; i < pending_count; ++i)
+        {
+            if(pending_entry[i] > closet_inter_t)
+                continue;
+            if(hitImplicitSurface(pending[i], ray, primary, 0, closet_inter_t, inter_temp))
+            {
+                if_tag = true;
+                closet_inter_t = inter_temp.t;
+                inter = inter_temp;
+            }
+        }
     }
 
     return if_tag;
 }
 
+// primary 表示 ray 是像素的主光线，见 hitImplicitSurface
+bool hitWorld(Ray ray, bool primary, out Intersection inter)
+{
+    if(primitive_count == 0)
+        return false;
+    if(primitive_count < PRIMITIVE_BVH_MIN)
+        return hitWorldFlat(ray, primary, inter);
+    return hitWorldBVH(ray, primary, inter);
+}
+
 vec3 trace(Intersection inter, Ray ray)
 {
     // 如果打到光源
@@ -323,21 +433,26 @@ vec3 trace(Intersection inter, Ray ray)
 
     for(int i = 0; i < DEPTH; ++i)
     {
-        indir_filtration *= inter.material.color;
-
+        startBounce(i);
         vec3 wi;
         float r = rand();
         if(r < inter.material.specularRate) // 完全镜面反射
         {
             wi = reflect(ray.dir, inter.normal);
+            indir_filtration *= inter.material.color;
         }
         else if(r > inter.material.specularRate && r < inter.material.refractRate)  // 完全折射
         {
             wi = refract(ray.dir, inter.normal, inter.material.refractAngle);
+            indir_filtration *= inter.material.color;
         }
         else
         {
-            wi = toWorld(sampleHemisphere(), inter.normal);    //  得到一条光线的方向
+            wi = toWorld(sampleCosineHemisphere(vec2(rand(), rand())), inter.normal);    //  得到一条光线的方向
+            float NdotL = dot(wi, inter.normal);
+            float pdf = pdfCosineHemisphere(NdotL);
+            if(pdf <= 0.0) break;
+            indir_filtration *= inter.material.color / PI * NdotL / pdf;  // lambert brdf = color / PI
         }
 
         float NdotL = dot(wi, inter.normal);
@@ -346,7 +461,8 @@ vec3 trace(Intersection inter, Ray ray)
         ray.ori = inter.position;
         
         Intersection new_inter;
-        if(!hitWorld(ray, new_inter))
+        COUNT_RAY(RAY_BOUNCE);
+        if(!hitWorld(ray, false, new_inter))
         {
             result += vec3(1) * indir_filtration * NdotL;
             break;
@@ -365,35 +481,40 @@ vec3 trace(Intersection inter, Ray ray)
 
 void main()
 {
-    float u = (gl_FragCoord.x - 0.5 + rand()) / (WIDTH - 1);
-    float v = (gl_FragCoord.y - 0.5 + rand()) / (HEIGHT - 1);
-    Ray ray;
-    ray.ori = camera.ori;
-    ray.dir = normalize(camera.lower_left_corner + u * camera.horizontal + v * camera.vertical - camera.ori);
+    if(primary_hits)
+    {
+        Ray ray;
+        ray.ori = camera.ori;
+        ray.dir = normalize(camera.lower_left_corner + gl_FragCoord.x / (WIDTH - 1) * camera.horizontal + gl_FragCoord.y / (HEIGHT - 1) * camera.vertical - camera.ori);
+        Intersection inter;
+        COUNT_RAY(RAY_PRIMARY);
+        accumulate(hitWorld(ray, true, inter) ? vec3(inter.t, float(inter.function), -dot(inter.normal, ray.dir)) : vec3(-1.0), 0.0, 1);
+        return;
+    }
 
     vec3 color = vec3(0);
-    int spp = 10;
-    static_seed = 0u;
+    float lum2 = 0.0;
+    int spp = adaptiveSpp(10);
+    uint first_sample = accumulatedSamples();
     for(int i = 0; i < spp; ++i)
     {
-        seed = uint(
-            uint(gl_FragCoord.y)  * uint(1973) + 
-            uint(gl_FragCoord.x) * uint(9277) + 
-            uint(frame_count + static_seed) * uint(26699)) | uint(1);
+        initSampler(uvec2(gl_FragCoord.xy), first_sample + uint(i));
+        float u = (gl_FragCoord.x - 0.5 + rand()) / (WIDTH - 1);
+        float v = (gl_FragCoord.y - 0.5 + rand()) / (HEIGHT - 1);
+        Ray ray;
+        ray.ori = camera.ori;
+        ray.dir = normalize(camera.lower_left_corner + u * camera.horizontal + v * camera.vertical - camera.ori);
 
         Intersection inter;
-        if(hitWorld(ray, inter))
+        COUNT_RAY(RAY_PRIMARY);
+        if(hitWorld(ray, true, inter))
         {
-            color += trace(inter, ray) / spp;
+            recordFirstHit(inter.normal, inter.t, inter.material.isEmissive ? vec3(1) : inter.material.color);
+            vec3 c = trace(inter, ray);
+            color += c;
+            lum2 += luminance(c) * luminance(c);
         }
-        static_seed ++;
     }
-    // Intersection inter;
-    // if(hitImplicitSurface(ray, 0, INFINITY, inter))
-    // {
-    //     color = vec3(1);
-    // }
-
-    vec3 textureColor = texture(imgTex, TexCoords).rgb;
-    FragColor = vec4(mix(textureColor, color, 1.0 / float(frame_count)), 1.0);
+
+    accumulate(color, lum2, spp);
 }
\ No newline at end of file
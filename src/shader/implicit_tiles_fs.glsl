@@ -0,0 +1,137 @@
+#version 330 core
+
+// 每个像素对应屏幕上 IMPLICIT_TILE x IMPLICIT_TILE 个像素的一块，块内的主光线都从相机出发，
+// 未归一化的方向 D(u, v) = lower_left_corner + u * horizontal + v * vertical - ori 是 u, v 的线性函数，
+// 光束上的点 ori + s * D 按 s 等分成 IMPLICIT_TILE_STEPS 段，每段用区间算术对整块光束求一次 implicitIA，
+// 输出第一段和最后一段可能有根的部分对应的世界空间 t 的范围，整块都没有根时 x > y
+// 只处理第 implicit_tile_primitive 个图元，由 common/implicit_tiles.cpp 绘制，implicit_fs.glsl 中的主光线用它跳过空的部分
+
+#define WIDTH 600
+#define HEIGHT 600
+
+#define INFINITY 100000000.0
+#define IMPLICIT_TILE 8             // 与 ImplicitTiles::TILE 一致
+#define IMPLICIT_TILE_STEPS 64
+
+struct Camera
+{
+    vec3 ori;
+    vec3 horizontal;
+    vec3 vertical;
+    vec3 lower_left_corner;
+};
+
+uniform Camera camera;
+uniform int implicit_tile_primitive;
+
+out vec4 FragColor;
+
+#include "raa.glsl"
+#include "dual.glsl"
+#include "implicit_function.glsl"    // 由 ImplicitFunction 生成，见 common/implicit_function.h
+#include "primitive_bvh.glsl"
+
+// s >= 0 时 s * [d.x, d.y] 与 [lo, hi] 相交的 s 的范围，不相交时 x > y
+vec2 beamSlab(vec2 d, float lo, float hi)
+{
+    vec2 s = vec2(0.0, INFINITY);
+    // s * d.y >= lo
+    if(d.y > 0.0)
+        s.x = max(s.x, lo / d.y);
+    else if(d.y < 0.0)
+        s.y = min(s.y, lo / d.y);
+    else if(lo > 0.0)
+        s.y = -1.0;
+    // s * d.x <= hi
+    if(d.x > 0.0)
+        s.y = min(s.y, hi / d.x);
+    else if(d.x < 0.0)
+        s.x = max(s.x, hi / d.x);
+    else if(hi < 0.0)
+        s.y = -1.0;
+    return s;
+}
+
+// 光束在 [s0, s1] 这一段上与包围盒的交集中是否可能有根
+bool beamSegmentMayHit(int function, vec3 ori, vec3 d_min, vec3 d_max, vec3 box_min, vec3 box_max, float s0, float s1)
+{
+    vec2 s = vec2(s0, s1);
+    vec2 x = mul_ia(s, vec2(d_min.x, d_max.x)) + ori.x;
+    vec2 y = mul_ia(s, vec2(d_min.y, d_max.y)) + ori.y;
+    vec2 z = mul_ia(s, vec2(d_min.z, d_max.z)) + ori.z;
+    x = vec2(max(x.x, box_min.x), min(x.y, box_max.x));
+    y = vec2(max(y.x, box_min.y), min(y.y, box_max.y));
+    z = vec2(max(z.x, box_min.z), min(z.y, box_max.z));
+    if(x.x > x.y || y.x > y.y || z.x > z.y)
+        return false;
+    vec2 f = implicitIA(function, x, y, z);
+    return f.x <= 0.0 && f.y >= 0.0;
+}
+
+void main()
+{
+    int primitive = implicit_tile_primitive;
+    if(primitive < 0 || primitive >= primitive_count || primitiveTexel(primitive, 0).x < 0.5)
+    {
+        FragColor = vec4(0.0, INFINITY, 0.0, 1.0);
+        return;
+    }
+    vec4 head = primitiveTexel(primitive, 0);
+    vec4 r0 = primitiveTexel(primitive, 1);
+    vec4 r1 = primitiveTexel(primitive, 2);
+    vec4 r2 = primitiveTexel(primitive, 3);
+    vec3 box_min = primitiveTexel(primitive, 4).xyz;
+    vec3 box_max = primitiveTexel(primitive, 5).xyz;
+
+    // implicit_fs.glsl 中第 x 列像素抖动后的 u 在 [x, x + 1] / (WIDTH - 1) 中
+    vec2 lo = floor(gl_FragCoord.xy) * float(IMPLICIT_TILE) / vec2(WIDTH - 1, HEIGHT - 1);
+    vec2 hi = (floor(gl_FragCoord.xy) + 1.0) * float(IMPLICIT_TILE) / vec2(WIDTH - 1, HEIGHT - 1);
+
+    // D 在局部空间中也是线性的，各分量的范围在四个角上取到；|D| 的最大值也在角上，
+    // 最小值在 u, v 各自夹到块内的垂足处（horizontal 与 vertical 垂直）
+    vec3 w = camera.lower_left_corner - camera.ori;
+    vec3 d_min = vec3(INFINITY), d_max = vec3(-INFINITY);
+    float length_max = 0.0;
+    for(int k = 0; k < 4; ++k)
+    {
+        vec2 uv = vec2((k & 1) != 0 ? hi.x : lo.x, (k & 2) != 0 ? hi.y : lo.y);
+        vec3 d = w + uv.x * camera.horizontal + uv.y * camera.vertical;
+        vec3 local = vec3(dot(r0.xyz, d), dot(r1.xyz, d), dot(r2.xyz, d));
+        d_min = min(d_min, local);
+        d_max = max(d_max, local);
+        length_max = max(length_max, length(d));
+    }
+    vec2 foot = clamp(-vec2(dot(w, camera.horizontal) / dot(camera.horizontal, camera.horizontal),
+                            dot(w, camera.vertical) / dot(camera.vertical, camera.vertical)), lo, hi);
+    float length_min = length(w + foot.x * camera.horizontal + foot.y * camera.vertical);
+
+    vec3 ori = vec3(dot(r0.xyz, camera.ori) + r0.w, dot(r1.xyz, camera.ori) + r1.w, dot(r2.xyz, camera.ori) + r2.w);
+    vec2 range = beamSlab(vec2(d_min.x, d_max.x), box_min.x - ori.x, box_max.x - ori.x);
+    vec2 slab_y = beamSlab(vec2(d_min.y, d_max.y), box_min.y - ori.y, box_max.y - ori.y);
+    vec2 slab_z = beamSlab(vec2(d_min.z, d_max.z), box_min.z - ori.z, box_max.z - ori.z);
+    range = vec2(max(range.x, max(slab_y.x, slab_z.x)), min(range.y, min(slab_y.y, slab_z.y)));
+    if(range.x >= range.y)
+    {
+        FragColor = vec4(INFINITY, -INFINITY, 0.0, 1.0);
+        return;
+    }
+
+    int function = int(head.z);
+    float segment = (range.y - range.x) / float(IMPLICIT_TILE_STEPS);
+    int first = 0;
+    while(first < IMPLICIT_TILE_STEPS && !beamSegmentMayHit(function, ori, d_min, d_max, box_min, box_max, range.x + segment * float(first), range.x + segment * float(first + 1)))
+        ++first;
+    if(first == IMPLICIT_TILE_STEPS)
+    {
+        FragColor = vec4(INFINITY, -INFINITY, 0.0, 1.0);
+        return;
+    }
+    int last = IMPLICIT_TILE_STEPS - 1;
+    while(last > first && !beamSegmentMayHit(function, ori, d_min, d_max, box_min, box_max, range.x + segment * float(last), range.x + segment * float(last + 1)))
+        --last;
+
+    // IA 没有计入 float 的舍入误差，两端各多留一段
+    float s0 = max(range.x + segment * float(first - 1), 0.0);
+    float s1 = range.x + segment * float(last + 2);
+    FragColor = vec4(s0 * length_min, s1 * length_max, 0.0, 1.0);
+}
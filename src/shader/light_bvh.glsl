@@ -0,0 +1,165 @@
+// 发光三角形的层次结构，由 common/light_bvh.cpp 构建
+// 从根节点开始按两个子树对着色点的估计贡献随机选择分支，到叶节点得到一个光源及其概率
+
+#define LIGHT_ITEMS_PER_ROW 1024     // 与 LightBVH::ITEMS_PER_ROW 一致
+
+uniform int light_count;            // 为0时不做光源采样
+uniform sampler2D lightNodeTex;     // 每个节点4个像素：(min, 能量) (max, θo) (axis, θe) (左, 右, 父, 光源)
+uniform sampler2D lightTex;         // 每个光源4个像素：(p0, 面积) (p1, 叶节点) (p2, 是否为几何体) (发光, -)
+
+struct LightSample
+{
+    vec3 L;         // 着色点到光源上采样点的方向
+    float dist;
+    vec3 emission;
+    float pdf;      // 立体角上的pdf
+    vec3 point;     // 光源上的采样点
+    int light;
+    float pdf_area; // 光源面积测度上的pdf
+    bool hittable;  // 光源也是场景中的几何体，BSDF 采样可能打到它，为 false 时不与 BSDF 采样做 MIS
+};
+
+vec4 lightNodeTexel(int node, int k)
+{
+    return texelFetch(lightNodeTex, ivec2((node % LIGHT_ITEMS_PER_ROW) * 4 + k, node / LIGHT_ITEMS_PER_ROW), 0);
+}
+
+vec4 lightTexel(int light, int k)
+{
+    return texelFetch(lightTex, ivec2((light % LIGHT_ITEMS_PER_ROW) * 4 + k, light / LIGHT_ITEMS_PER_ROW), 0);
+}
+
+// 子树对着色点贡献的保守估计：能量 * 入射角余弦 * 出射角余弦 / 距离平方，角度都按包围球放宽
+float lightNodeImportance(int node, vec3 P, vec3 N)
+{
+    vec4 t0 = lightNodeTexel(node, 0);
+    vec4 t1 = lightNodeTexel(node, 1);
+    vec4 t2 = lightNodeTexel(node, 2);
+    vec3 center = 0.5 * (t0.xyz + t1.xyz);
+    float radius2 = 0.25 * dot(t1.xyz - t0.xyz, t1.xyz - t0.xyz);
+    vec3 d = center - P;
+    float dist2 = dot(d, d);
+    if(dist2 <= radius2)    // 着色点在包围球内，角度无法界定
+        return t0.w / max(radius2, 1e-8);
+
+    float dist = sqrt(dist2);
+    vec3 w = d / dist;
+    float theta_u = asin(min(1.0, sqrt(radius2 / dist2)));
+
+    float theta_i = acos(clamp(dot(N, w), -1.0, 1.0));
+    float theta_i_bound = max(0.0, theta_i - theta_u);
+    if(theta_i_bound >= PI / 2.0)
+        return 0.0;
+
+    float theta = acos(clamp(dot(t2.xyz, -w), -1.0, 1.0));
+    float theta_bound = max(0.0, theta - t1.w - theta_u);
+    if(theta_bound >= t2.w)
+        return 0.0;
+
+    return t0.w * cos(theta_i_bound) * cos(theta_bound) / dist2;
+}
+
+// 选中 child 的概率，parent 为其父节点
+float lightChildProbability(int parent, int child, vec3 P, vec3 N)
+{
+    vec4 t3 = lightNodeTexel(parent, 3);
+    float left = lightNodeImportance(int(t3.x), P, N);
+    float right = lightNodeImportance(int(t3.y), P, N);
+    if(left + right <= 0.0)
+        return 0.0;
+    return (child == int(t3.x) ? left : right) / (left + right);
+}
+
+// 返回光源编号，u 被逐层重新映射后复用；没有可能产生贡献的光源时返回 -1
+int sampleLightBVH(vec3 P, vec3 N, float u, out float pmf)
+{
+    int node = 0;
+    pmf = 1.0;
+    for(int depth = 0; depth < 64; ++depth)
+    {
+        vec4 t3 = lightNodeTexel(node, 3);
+        if(t3.w >= 0.0)
+            return int(t3.w);
+
+        float left = lightNodeImportance(int(t3.x), P, N);
+        float right = lightNodeImportance(int(t3.y), P, N);
+        if(left + right <= 0.0)
+            return -1;
+        float p = left / (left + right);
+        if(u < p)
+        {
+            u /= p;
+            pmf *= p;
+            node = int(t3.x);
+        }
+        else
+        {
+            u = (u - p) / (1.0 - p);
+            pmf *= 1.0 - p;
+            node = int(t3.y);
+        }
+    }
+    return -1;
+}
+
+// 从叶节点向上累乘各层的选择概率
+float pmfLightBVH(vec3 P, vec3 N, int light)
+{
+    int node = int(lightTexel(light, 1).w);
+    float pmf = 1.0;
+    for(int depth = 0; depth < 64 && node > 0; ++depth)
+    {
+        int parent = int(lightNodeTexel(node, 3).z);
+        pmf *= lightChildProbability(parent, node, P, N);
+        node = parent;
+    }
+    return pmf;
+}
+
+// 选择光源并在三角形上均匀采样一点，xi.x 用于选择光源
+bool sampleLight(vec3 P, vec3 N, vec3 xi, out LightSample s)
+{
+    float pmf;
+    int light = sampleLightBVH(P, N, xi.x, pmf);
+    if(light < 0 || pmf <= 0.0)
+        return false;
+
+    vec4 t0 = lightTexel(light, 0);
+    vec3 p1 = lightTexel(light, 1).xyz;
+    vec4 t2 = lightTexel(light, 2);
+    vec3 p2 = t2.xyz;
+    float su = sqrt(xi.y);
+    vec3 point = (1.0 - su) * t0.xyz + xi.z * su * p1 + (1.0 - xi.z) * su * p2;
+
+    vec3 normal = normalize(cross(p1 - t0.xyz, p2 - t0.xyz));
+    vec3 d = point - P;
+    float dist2 = dot(d, d);
+    s.dist = sqrt(dist2);
+    s.L = d / s.dist;
+    float cos_light = dot(normal, -s.L);
+    if(cos_light <= 0.0)
+        return false;
+
+    s.emission = lightTexel(light, 3).rgb;
+    s.pdf = pmf * dist2 / (t0.w * cos_light);
+    s.point = point;
+    s.light = light;
+    s.pdf_area = pmf / t0.w;
+    s.hittable = t2.w > 0.5;
+    return true;
+}
+
+// BSDF采样打到光源 light 上的 point 时，光源采样策略在立体角上的pdf
+float pdfLight(vec3 P, vec3 N, int light, vec3 point)
+{
+    vec4 t0 = lightTexel(light, 0);
+    vec3 p1 = lightTexel(light, 1).xyz;
+    vec3 p2 = lightTexel(light, 2).xyz;
+    vec3 normal = normalize(cross(p1 - t0.xyz, p2 - t0.xyz));
+    vec3 d = point - P;
+    float dist2 = dot(d, d);
+    float cos_light = dot(normal, -d) / sqrt(dist2);
+    if(cos_light <= 0.0)
+        return 0.0;
+    return pmfLightBVH(P, N, light) * dist2 / (t0.w * cos_light);
+}
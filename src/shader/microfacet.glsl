@@ -0,0 +1,81 @@
+// 与材质无关的微表面函数，disney_brdf.glsl 和 albedo_lut_fs.glsl 共用，需要在 sampling.glsl 之后 #include
+
+float sqr(float x) {
+    return x*x;
+}
+
+float SchlickFresnel(float u)
+{
+    float m = clamp(1-u, 0, 1);
+    float m2 = m * m;
+    return m2 * m2 * m;
+}
+
+float GTR1(float NdotH, float a) {
+    if (a >= 1) return 1/PI;
+    float a2 = a*a;
+    float t = 1 + (a2-1)*NdotH*NdotH;
+    return (a2-1) / (PI*log(a2)*t);
+}
+
+float GTR2(float NdotH, float a) {
+    float a2 = a*a;
+    float t = 1 + (a2-1)*NdotH*NdotH;
+    if(t == 0.0) return 0.0;
+    return a2 / (PI * t*t);
+}
+
+// 返回 G1 / (2 * NdotV)，两个相乘后已包含微表面模型分母中的 4 * NdotL * NdotV
+float smithG_GGX(float NdotV, float alphaG) {
+    float a = alphaG*alphaG;
+    float b = NdotV*NdotV;
+    return 1 / (NdotV + sqrt(a + b - a*b));
+}
+
+// 粗糙度到 GGX alpha 的映射
+float roughnessToAlpha(float roughness)
+{
+    return max(0.001, sqr(roughness));
+}
+
+// 清漆层光泽度到 GTR1 alpha 的映射
+float clearcoatGlossToAlpha(float gloss)
+{
+    return mix(0.1, 0.001, gloss);
+}
+
+// Disney 漫反射的 Fresnel 项，不含 baseColor / PI
+float diffuseFresnel(float NdotL, float NdotV, float LdotH, float roughness)
+{
+    float Fd90 = 0.5 + 2.0 * LdotH * LdotH * roughness;
+    return mix(1.0, Fd90, SchlickFresnel(NdotL)) * mix(1.0, Fd90, SchlickFresnel(NdotV));
+}
+
+// 可见法线采样，Heitz 2018 "Sampling the GGX Distribution of Visible Normals"，V 和返回的 H 都在局部坐标系中
+vec3 sampleGGXVNDF(vec3 V, float alpha, vec2 xi)
+{
+    vec3 Vh = normalize(vec3(alpha * V.x, alpha * V.y, V.z));
+    float lensq = Vh.x * Vh.x + Vh.y * Vh.y;
+    vec3 T1 = lensq > 0 ? vec3(-Vh.y, Vh.x, 0) * inversesqrt(lensq) : vec3(1, 0, 0);
+    vec3 T2 = cross(Vh, T1);
+
+    float r = sqrt(xi.x);
+    float phi = 2.0 * PI * xi.y;
+    float t1 = r * cos(phi);
+    float t2 = r * sin(phi);
+    float s = 0.5 * (1.0 + Vh.z);
+    t2 = (1.0 - s) * sqrt(1.0 - t1 * t1) + s * t2;
+
+    vec3 Nh = t1 * T1 + t2 * T2 + sqrt(max(0.0, 1.0 - t1 * t1 - t2 * t2)) * Vh;
+    return normalize(vec3(alpha * Nh.x, alpha * Nh.y, max(0.0, Nh.z)));
+}
+
+// 按 GTR1 分布采样清漆层的半角向量
+vec3 sampleGTR1(float alpha, vec2 xi)
+{
+    float a2 = alpha * alpha;
+    float cos_theta = sqrt(max(0.0, (1.0 - pow(a2, 1.0 - xi.x)) / (1.0 - a2)));
+    float sin_theta = sqrt(max(0.0, 1.0 - cos_theta * cos_theta));
+    float phi = 2.0 * PI * xi.y;
+    return vec3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
+}
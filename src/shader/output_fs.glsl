@@ -4,15 +4,50 @@ out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D imgTex;
+uniform float tone_map_limit;   // 与 config.h 的 TONE_MAP_LIMIT、DISPLAY_GAMMA 相同，由 Render 设置
+uniform float display_gamma;
+
+// 热度图，0 为关闭，其余与 RayStats::Metric 对应：1~3 为 heatmapRayTex 的 yzw，4~6 为 heatmapPrimitiveTex 的 xyz
+// 显示的是最近一帧每条主光线的计数，heatmap_scale 对应色带的最右端
+uniform int heatmap;
+uniform sampler2D heatmapRayTex;
+uniform sampler2D heatmapPrimitiveTex;
+uniform float heatmap_scale;
 
 vec3 toneMapping(in vec3 c, float limit) {
     float luminance = 0.3*c.x + 0.6*c.y + 0.1*c.z;
     return c * 1.0 / (1.0 + luminance / limit);
 }
 
+// Turbo 色带的多项式近似，t 在 [0, 1]
+vec3 falseColor(float t)
+{
+    const vec4 kRedVec4 = vec4(0.13572138, 4.61539260, -42.66032258, 132.13108234);
+    const vec4 kGreenVec4 = vec4(0.09140261, 2.19418839, 4.84296658, -14.18503333);
+    const vec4 kBlueVec4 = vec4(0.10667330, 12.64194608, -60.58204836, 110.36276771);
+    const vec2 kRedVec2 = vec2(-152.94239396, 59.28637943);
+    const vec2 kGreenVec2 = vec2(4.27729857, 2.82956604);
+    const vec2 kBlueVec2 = vec2(-89.90310912, 27.34824973);
+    t = clamp(t, 0.0, 1.0);
+    vec4 v4 = vec4(1.0, t, t * t, t * t * t);
+    vec2 v2 = v4.zw * v4.z;
+    return vec3(dot(v4, kRedVec4) + dot(v2, kRedVec2),
+                dot(v4, kGreenVec4) + dot(v2, kGreenVec2),
+                dot(v4, kBlueVec4) + dot(v2, kBlueVec2));
+}
+
 void main()
 {
+    if(heatmap > 0)
+    {
+        vec4 rays = texture(heatmapRayTex, TexCoords);
+        vec4 primitives = texture(heatmapPrimitiveTex, TexCoords);
+        float count = heatmap < 4 ? rays[heatmap] : primitives[heatmap - 4];
+        // 被模板跳过或打到背景之外的像素没有主光线，显示为黑色
+        FragColor = rays.x > 0.0 ? vec4(falseColor(count / rays.x / heatmap_scale), 1.0) : vec4(0, 0, 0, 1);
+        return;
+    }
     vec3 color = texture(imgTex, TexCoords).rgb;
-    color = toneMapping(color, 1.5);
-    FragColor = vec4(pow(color, vec3(1.0 / 2.2)), 1.0);
-}
\ No newline at end of file
+    color = toneMapping(color, tone_map_limit);
+    FragColor = vec4(pow(color, vec3(1.0 / display_gamma)), 1.0);
+}
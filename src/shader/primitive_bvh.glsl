@@ -0,0 +1,30 @@
+// 三角形和隐式曲面的层次包围盒，由 common/primitive_bvh.cpp 构建，节点按深度优先的顺序存放，每个叶节点一个图元
+// 遍历时盒子命中就走到下一个节点，否则走到跳过子树后的节点，不需要栈
+
+#define PRIMITIVE_ITEMS_PER_ROW 512  // 与 PrimitiveBVH::ITEMS_PER_ROW 一致
+#define PRIMITIVE_TEXELS 6           // 与 PrimitiveBVH::PRIMITIVE_TEXELS 一致
+
+uniform int primitive_count;
+uniform sampler2D bvhNodeTex;       // 每个节点2个像素：(min, 跳过子树后的节点，-1 为结束) (max, 叶节点的图元，内部节点为 -1)
+uniform sampler2D primitiveTex;     // 每个图元6个像素，第一个为 (类型, 材质, 函数, 砖块)，类型 0 为三角形，1 为隐式曲面
+                                    // 三角形：(p0) (p1) (p2) (法线)；隐式曲面：世界到局部的 3x4 矩阵的三行 (局部包围盒的 min) (max)
+
+vec4 bvhNodeTexel(int node, int k)
+{
+    return texelFetch(bvhNodeTex, ivec2((node % PRIMITIVE_ITEMS_PER_ROW) * 2 + k, node / PRIMITIVE_ITEMS_PER_ROW), 0);
+}
+
+vec4 primitiveTexel(int primitive, int k)
+{
+    return texelFetch(primitiveTex, ivec2((primitive % PRIMITIVE_ITEMS_PER_ROW) * PRIMITIVE_TEXELS + k, primitive / PRIMITIVE_ITEMS_PER_ROW), 0);
+}
+
+// 光线与包围盒相交的参数区间，不相交时 x > y
+vec2 intersectBox(vec3 ori, vec3 inv_dir, vec3 lo, vec3 hi)
+{
+    vec3 a = (lo - ori) * inv_dir;
+    vec3 b = (hi - ori) * inv_dir;
+    vec3 near = min(a, b);
+    vec3 far = max(a, b);
+    return vec2(max(max(near.x, near.y), near.z), min(min(far.x, far.y), far.z));
+}
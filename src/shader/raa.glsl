@@ -0,0 +1,114 @@
+// Reduced Affine Arithmetic 和区间算术，供 ImplicitFunction 生成的代码使用
+// RAA 用 vec3 表示 x + y * ε + z * [-1, 1]，ε 是所有变量共享的噪声符号，z 累积非线性部分的误差
+// 区间用 vec2 表示 [x, y]
+
+vec3 IAtoRAA(vec2 ia)   // 区间算术转化为仿射算术
+{
+    vec3 raa;
+    raa.x = (ia.x + ia.y) / 2.0;
+    raa.y = (ia.y - ia.x) / 2.0;
+    raa.z = 0;
+    return raa;
+}
+
+float raa_radius(vec3 raa)
+{
+    return abs(raa.y) + raa.z;
+}
+
+vec3 add_num(vec3 raa, float num)
+{
+    raa.x += num;
+    return raa;
+}
+
+vec3 sub_num(vec3 raa, float num)
+{
+    raa.x -= num;
+    return raa;
+}
+
+vec3 mul_num(vec3 raa, float num)
+{
+    raa.x *= num;
+    raa.y *= num;
+    raa.z *= abs(num);
+    return raa;
+}
+
+vec3 add_raa(vec3 raa, vec3 other)
+{
+    raa += other;
+    return raa;
+}
+
+vec3 sub_raa(vec3 raa, vec3 other)
+{
+    raa.x -= other.x;
+    raa.y -= other.y;
+    raa.z += other.z;
+    return raa;
+}
+
+vec3 mul_raa(vec3 raa, vec3 other)
+{
+    vec3 ans;
+    ans.x = raa.x * other.x;
+    ans.y = raa.x * other.y + raa.y * other.x;
+    ans.z = abs(raa.x) * other.z + abs(other.x) * raa.z + (abs(raa.y) + raa.z) * (abs(other.y) + other.z);
+    return ans;
+}
+
+// ε^2 ∈ [0, 1] 写成 0.5 + 0.5 * [-1, 1]，比 mul_raa(raa, raa) 紧
+vec3 sqr_raa(vec3 raa)
+{
+    vec3 ans;
+    ans.x = raa.x * raa.x + 0.5 * raa.y * raa.y;
+    ans.y = 2.0 * raa.x * raa.y;
+    ans.z = 0.5 * raa.y * raa.y + 2.0 * (abs(raa.x) + abs(raa.y)) * raa.z + raa.z * raa.z;
+    return ans;
+}
+
+vec3 pow_num(vec3 raa, int num)
+{
+    vec3 ans = raa;
+    for(int i = 1; i < num; ++i)
+    {
+        ans = mul_raa(ans, raa);
+    }
+    return ans;
+}
+
+vec2 add_num_ia(vec2 ia, float num)
+{
+    return ia + num;
+}
+
+vec2 mul_num_ia(vec2 ia, float num)
+{
+    return num >= 0.0 ? ia * num : ia.yx * num;
+}
+
+vec2 add_ia(vec2 ia, vec2 other)
+{
+    return ia + other;
+}
+
+vec2 sub_ia(vec2 ia, vec2 other)
+{
+    return ia - other.yx;
+}
+
+vec2 mul_ia(vec2 ia, vec2 other)
+{
+    vec4 p = ia.xxyy * other.xyxy;
+    return vec2(min(min(p.x, p.y), min(p.z, p.w)), max(max(p.x, p.y), max(p.z, p.w)));
+}
+
+vec2 sqr_ia(vec2 ia)
+{
+    vec2 s = ia * ia;
+    if(ia.x <= 0.0 && ia.y >= 0.0)
+        return vec2(0.0, max(s.x, s.y));
+    return vec2(min(s.x, s.y), max(s.x, s.y));
+}
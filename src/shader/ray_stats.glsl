@@ -0,0 +1,28 @@
+// 光线与求交的计数，被 accumulate.glsl #include；积分器编译时定义 RAY_STATS 才计数，否则下面的宏都为空，没有任何开销
+// 每个像素本帧的计数写到第 4、5 个颜色附件，由 common/ray_stats.cpp 按块求和后异步读回，output_fs.glsl 可以把它们显示成热度图
+// GLSL 330 没有原子计数器，改为逐像素输出再归约
+
+#ifndef RAY_STATS_GLSL
+#define RAY_STATS_GLSL
+
+#define RAY_PRIMARY 0
+#define RAY_BOUNCE 1
+#define RAY_SHADOW 2
+
+#ifdef RAY_STATS
+vec4 ray_stats = vec4(0);           // 主光线、反弹光线、阴影光线、包围盒测试
+vec4 ray_stats_primitives = vec4(0);    // 图元求交测试、隐式曲面区间求根的迭代、砖块距离场的追踪步数
+#define COUNT_RAY(kind) ray_stats[kind] += 1.0
+#define COUNT_BOX() ray_stats.w += 1.0
+#define COUNT_PRIMITIVE() ray_stats_primitives.x += 1.0
+#define COUNT_ITERATION() ray_stats_primitives.y += 1.0
+#define COUNT_STEP() ray_stats_primitives.z += 1.0
+#else
+#define COUNT_RAY(kind)
+#define COUNT_BOX()
+#define COUNT_PRIMITIVE()
+#define COUNT_ITERATION()
+#define COUNT_STEP()
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+#version 330 core
+
+// 把积分器输出的逐像素计数按 RAY_STATS_BLOCK x RAY_STATS_BLOCK 的块求和，由 common/ray_stats.cpp 绘制并读回，见 ray_stats.glsl
+
+#define RAY_STATS_BLOCK 8   // 与 RayStats::BLOCK 一致
+
+layout(location = 0) out vec4 BlockRays;
+layout(location = 1) out vec4 BlockPrimitives;
+
+uniform sampler2D rayStatsTex;
+uniform sampler2D primitiveStatsTex;
+
+void main()
+{
+    ivec2 size = textureSize(rayStatsTex, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * RAY_STATS_BLOCK;
+    vec4 rays = vec4(0);
+    vec4 primitives = vec4(0);
+    for(int y = 0; y < RAY_STATS_BLOCK; ++y)
+    {
+        for(int x = 0; x < RAY_STATS_BLOCK; ++x)
+        {
+            ivec2 p = base + ivec2(x, y);
+            if(p.x < size.x && p.y < size.y)
+            {
+                rays += texelFetch(rayStatsTex, p, 0);
+                primitives += texelFetch(primitiveStatsTex, p, 0);
+            }
+        }
+    }
+    BlockRays = rays;
+    BlockPrimitives = primitives;
+}
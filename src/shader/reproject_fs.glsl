@@ -0,0 +1,111 @@
+#version 330
+
+// 相机移动后的时间复用：Render 把移动前累积的结果留作历史，清空后按新相机追踪一帧，再由这个pass合并两者写回累积的纹理
+// 当前像素第一个交点的世界坐标由新相机和累积的深度重建，投影到 previous_camera 的成像平面上，
+// 在历史中双线性取 4 个像素，深度或法线对不上的（遮挡、出画面）丢弃，其余按权重合并，历史的样本数限制在 REPROJECT_MAX_HISTORY 以内
+
+#define REPROJECT_MAX_HISTORY 32.0  // 历史最多相当于多少个样本，越大越平滑，但光照随视角变化的部分拖影越久
+#define REPROJECT_DEPTH 0.05        // 深度的相对误差上限
+#define REPROJECT_NORMAL 0.9        // 法线夹角余弦的下限
+#define REPROJECT_MISS_DEPTH 1e4    // 没打到物体的像素当作这么远的点投影
+
+struct Camera
+{
+    vec3 ori;
+    vec3 horizontal;
+    vec3 vertical;
+    vec3 lower_left_corner;
+};
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragMoment;
+layout(location = 2) out vec4 FragNormal;
+layout(location = 3) out vec4 FragAlbedo;
+
+uniform Camera camera;              // 从积分器复制
+uniform Camera previous_camera;
+uniform sampler2D imgTex;           // 新相机本帧的结果，与 accumulate.glsl 的含义相同
+uniform sampler2D momentTex;
+uniform sampler2D normalTex;
+uniform sampler2D albedoTex;
+uniform sampler2D historyTex;       // 移动前累积的结果
+uniform sampler2D historyMomentTex;
+uniform sampler2D historyNormalTex;
+uniform sampler2D historyAlbedoTex;
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(imgTex, 0);
+    vec4 color = texelFetch(imgTex, p, 0);
+    vec4 moment = texelFetch(momentTex, p, 0);
+    vec4 normal = texelFetch(normalTex, p, 0);
+    vec4 albedo = texelFetch(albedoTex, p, 0);
+    FragColor = color;
+    FragMoment = moment;
+    FragNormal = normal;
+    FragAlbedo = albedo;
+
+    // 积分器中像素 x 的 u 在 [x, x + 1] / (WIDTH - 1) 中，中心为 gl_FragCoord.x / (WIDTH - 1)
+    vec2 uv = gl_FragCoord.xy / vec2(size - 1);
+    vec3 dir = normalize(camera.lower_left_corner + uv.x * camera.horizontal + uv.y * camera.vertical - camera.ori);
+    bool hit = albedo.w >= 0.5 && normal.w > 0.0;
+    float depth = hit ? normal.w / albedo.w : REPROJECT_MISS_DEPTH;
+    vec3 world = camera.ori + dir * depth;
+
+    // 与上一个相机的成像平面求交，horizontal 与 vertical 垂直
+    vec3 plane_normal = cross(previous_camera.horizontal, previous_camera.vertical);
+    vec3 w = previous_camera.lower_left_corner - previous_camera.ori;
+    vec3 d = world - previous_camera.ori;
+    float denom = dot(d, plane_normal);
+    if(denom * dot(w, plane_normal) <= 0.0)
+        return;
+    vec3 q = previous_camera.ori + d * (dot(w, plane_normal) / denom) - previous_camera.lower_left_corner;
+    vec2 previous_uv = vec2(dot(q, previous_camera.horizontal) / dot(previous_camera.horizontal, previous_camera.horizontal),
+                            dot(q, previous_camera.vertical) / dot(previous_camera.vertical, previous_camera.vertical));
+    vec2 position = previous_uv * vec2(size - 1) - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+    float expected_depth = length(d);
+    vec3 n = hit ? normalize(normal.xyz) : vec3(0);
+
+    vec4 history_color = vec4(0), history_moment = vec4(0), history_normal = vec4(0), history_albedo = vec4(0);
+    float sum_weight = 0.0;
+    for(int k = 0; k < 4; ++k)
+    {
+        ivec2 offset = ivec2(k & 1, k >> 1);
+        ivec2 t = base + offset;
+        if(any(lessThan(t, ivec2(0))) || any(greaterThanEqual(t, size)))
+            continue;
+        vec4 hm = texelFetch(historyMomentTex, t, 0);
+        vec4 hn = texelFetch(historyNormalTex, t, 0);
+        vec4 ha = texelFetch(historyAlbedoTex, t, 0);
+        if(hm.y <= 0.0)
+            continue;
+        bool history_hit = ha.w >= 0.5 && hn.w > 0.0;
+        if(history_hit != hit)
+            continue;
+        if(hit && (abs(hn.w / ha.w - expected_depth) > REPROJECT_DEPTH * expected_depth || dot(normalize(hn.xyz), n) < REPROJECT_NORMAL))
+            continue;
+        float weight = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        history_color += texelFetch(historyTex, t, 0) * weight;
+        history_moment += hm * weight;
+        history_normal += hn * weight;
+        history_albedo += ha * weight;
+        sum_weight += weight;
+    }
+    if(sum_weight < 1e-4)
+        return;
+    history_color /= sum_weight;
+    history_moment /= sum_weight;
+    history_normal /= sum_weight;
+    history_albedo /= sum_weight;
+
+    // 历史当作 m 个样本与本帧的 n 个样本按样本数加权平均，深度换成相对新相机的
+    float m = min(history_moment.y, REPROJECT_MAX_HISTORY);
+    float total = m + moment.y;
+    FragColor = vec4((history_color.rgb * m + color.rgb * moment.y) / total, 1.0);
+    FragMoment = vec4((history_moment.x * m + moment.x * moment.y) / total, total, (history_moment.zw * m + moment.zw * moment.y) / total);
+    FragAlbedo = (history_albedo * m + albedo * moment.y) / total;
+    FragNormal = vec4((history_normal.xyz * m + normal.xyz * moment.y) / total, hit ? depth * FragAlbedo.w : 0.0);
+}
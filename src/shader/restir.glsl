@@ -0,0 +1,297 @@
+// ReSTIR DI（Bitterli et al. 2020），在积分器末尾代替 main() 被 #include，RESTIR_PASS 选择当前的pass
+// 1: 每个像素从光源BVH中抽取候选样本做重采样，再与上一帧同一像素的蓄水池合并（时间复用），同时输出 G-buffer
+// 2: 与屏幕空间内几何相近的邻居合并（空间复用）
+// 3: 对蓄水池中的样本发一条阴影光线着色，结果和路径追踪一样逐帧累积
+// 样本是光源上的一点，目标函数在面积测度上定义，因此在像素间复用时不需要雅可比行列式
+// 只处理面光源的直接光照，目标函数不含可见性，空间复用使用广义平衡启发式的MIS权重，结果是无偏的
+
+#define RESTIR_CANDIDATES 32        // 初始候选样本数
+#define RESTIR_TEMPORAL_CAP 20.0    // 历史蓄水池的样本数最多为当前帧的倍数
+#define RESTIR_SPATIAL_NEIGHBORS 5
+#define RESTIR_SPATIAL_RADIUS 30.0  // 像素
+// 第一个pass用到的采样器维度：像素内抖动 2 维，每个候选样本 4 维（光源采样 3 维和蓄水池更新 1 维），时间复用 2 维；
+// 空间复用的像素和样本序号与第一个pass相同，从这之后的维度开始
+#define RESTIR_PASS1_DIMS (2 + 4 * RESTIR_CANDIDATES + 2)
+
+uniform sampler2D reservoirSampleTex;   // (光源上的点, 光源编号)，没有样本时编号为 -1
+uniform sampler2D reservoirWeightTex;   // (权重和, 样本数 M, 无偏贡献权重 W, -)
+uniform sampler2D gPositionTex;         // (主光线交点, 交点距离)，未命中时距离为 0
+uniform sampler2D gNormalTex;           // (法线, 材质编号)
+
+struct Reservoir
+{
+    vec3 point;
+    int light;
+    float w_sum;
+    float M;
+    float W;
+};
+
+Reservoir emptyReservoir()
+{
+    Reservoir r;
+    r.point = vec3(0);
+    r.light = -1;
+    r.w_sum = 0.0;
+    r.M = 0.0;
+    r.W = 0.0;
+    return r;
+}
+
+Reservoir loadReservoir(ivec2 p)
+{
+    vec4 s = texelFetch(reservoirSampleTex, p, 0);
+    vec4 w = texelFetch(reservoirWeightTex, p, 0);
+    Reservoir r;
+    r.point = s.xyz;
+    r.light = int(s.w);
+    r.w_sum = w.x;
+    r.M = w.y;
+    r.W = w.z;
+    return r;
+}
+
+// 加权蓄水池采样，返回是否选中了新样本
+bool updateReservoir(inout Reservoir r, vec3 point, int light, float w, float M)
+{
+    r.w_sum += w;
+    r.M += M;
+    if(w > 0.0 && rand() * r.w_sum < w)
+    {
+        r.point = point;
+        r.light = light;
+        return true;
+    }
+    return false;
+}
+
+// target 为被选中样本在当前像素上的目标函数值
+void finalizeReservoir(inout Reservoir r, float target)
+{
+    r.W = (target > 0.0 && r.M > 0.0) ? r.w_sum / (r.M * target) : 0.0;
+}
+
+// 不考虑遮挡时光源上的 point 对着色点的贡献 f * Le * cos * cos_light / d^2
+vec3 unshadowedContribution(vec3 P, vec3 N, vec3 V, in Material material, vec3 point, int light)
+{
+    if(light < 0)
+        return vec3(0);
+    vec3 p0 = lightTexel(light, 0).xyz;
+    vec3 p1 = lightTexel(light, 1).xyz;
+    vec3 p2 = lightTexel(light, 2).xyz;
+    vec3 normal = normalize(cross(p1 - p0, p2 - p0));
+    vec3 d = point - P;
+    float dist2 = dot(d, d);
+    vec3 L = d / sqrt(dist2);
+    float NdotL = dot(N, L);
+    float cos_light = dot(normal, -L);
+    if(NdotL <= 0.0 || cos_light <= 0.0)
+        return vec3(0);
+    return brdf(V, N, L, material) * lightTexel(light, 3).rgb * NdotL * cos_light / dist2;
+}
+
+float targetFunction(vec3 P, vec3 N, vec3 V, in Material material, vec3 point, int light)
+{
+    return luminance(unshadowedContribution(P, N, V, material, point, light));
+}
+
+bool visible(vec3 P, vec3 N, vec3 point)
+{
+    vec3 d = point - P;
+    float dist = length(d);
+    Ray shadow_ray;
+    shadow_ray.ori = P + N * 1e-4;
+    shadow_ray.dir = d / dist;
+    Intersection occluder;
+    return !(hitWorld(shadow_ray, occluder) && occluder.t < dist - 1e-3);
+}
+
+Ray primaryRay(vec2 jitter)
+{
+    float u = (gl_FragCoord.x - 0.5 + jitter.x) / (WIDTH - 1);
+    float v = (gl_FragCoord.y - 0.5 + jitter.y) / (HEIGHT - 1);
+    Ray ray;
+    ray.ori = camera.ori;
+    ray.dir = normalize(camera.lower_left_corner + u * camera.horizontal + v * camera.vertical - camera.ori);
+    return ray;
+}
+
+#if RESTIR_PASS == 1
+layout(location = 0) out vec4 ReservoirSample;
+layout(location = 1) out vec4 ReservoirWeight;
+layout(location = 2) out vec4 GPosition;
+layout(location = 3) out vec4 GNormal;
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    initSampler(uvec2(p), frame_count);
+    // 之后的pass通过 G-buffer 使用同一个交点
+    Ray ray = primaryRay(vec2(rand(), rand()));
+    ReservoirSample = vec4(0, 0, 0, -1);
+    ReservoirWeight = vec4(0);
+    GPosition = vec4(0);
+    GNormal = vec4(0);
+
+    Intersection inter;
+    if(!hitWorld(ray, inter))
+        return;
+    GPosition = vec4(inter.position, inter.t);
+    GNormal = vec4(inter.normal, float(inter.material_id));
+    if(light_count <= 0 || inter.material.emissive != vec3(0))
+        return;
+
+    vec3 P = inter.position;
+    vec3 N = inter.normal;
+    vec3 V = -ray.dir;
+
+    // 以光源BVH为源分布的重采样重要性采样
+    Reservoir r = emptyReservoir();
+    float target = 0.0;
+    for(int i = 0; i < RESTIR_CANDIDATES; ++i)
+    {
+        LightSample s;
+        if(!sampleLight(P, N, vec3(rand(), rand(), rand()), s))
+        {
+            r.M += 1.0;
+            continue;
+        }
+        float t = targetFunction(P, N, V, inter.material, s.point, s.light);
+        if(updateReservoir(r, s.point, s.light, t / s.pdf_area, 1.0))
+            target = t;
+    }
+    // 可见性只在着色时检查：如果在这里把被遮挡的样本清零，邻居就覆盖不到当前像素可见而它被遮挡的那部分光源，
+    // 空间复用后半影会整体偏暗
+    finalizeReservoir(r, target);
+
+    // 时间复用：相机静止，上一帧同一像素的蓄水池就是历史
+    Reservoir prev = loadReservoir(p);
+    prev.M = min(prev.M, RESTIR_TEMPORAL_CAP * r.M);
+    Reservoir combined = emptyReservoir();
+    float combined_target = 0.0;
+    if(updateReservoir(combined, r.point, r.light, target * r.W * r.M, r.M))
+        combined_target = target;
+    float prev_target = targetFunction(P, N, V, inter.material, prev.point, prev.light);
+    if(updateReservoir(combined, prev.point, prev.light, prev_target * prev.W * prev.M, prev.M))
+        combined_target = prev_target;
+    finalizeReservoir(combined, combined_target);
+
+    ReservoirSample = vec4(combined.point, float(combined.light));
+    ReservoirWeight = vec4(combined.w_sum, combined.M, combined.W, 0.0);
+}
+
+#elif RESTIR_PASS == 2
+layout(location = 0) out vec4 ReservoirSample;
+layout(location = 1) out vec4 ReservoirWeight;
+
+// 参与空间复用的像素（自身和通过几何检查的邻居）的着色点
+struct ShadingPoint
+{
+    vec3 P;
+    vec3 N;
+    vec3 V;
+    int material;
+};
+
+float targetAt(in ShadingPoint s, vec3 point, int light)
+{
+    return targetFunction(s.P, s.N, s.V, materials[s.material], point, light);
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ReservoirSample = texelFetch(reservoirSampleTex, p, 0);
+    ReservoirWeight = texelFetch(reservoirWeightTex, p, 0);
+    vec4 g_position = texelFetch(gPositionTex, p, 0);
+    vec4 g_normal = texelFetch(gNormalTex, p, 0);
+    if(g_position.w <= 0.0 || materials[int(g_normal.w)].emissive != vec3(0))
+        return;
+
+    initSampler(uvec2(p), frame_count);
+    sampler_dim = uint(RESTIR_PASS1_DIMS);      // 与第一个pass用到的维度错开
+
+    // 先选出几何相近的邻居，法线或深度差别大的邻居的样本分布不同，合并会引入明显的偏差
+    ShadingPoint points[RESTIR_SPATIAL_NEIGHBORS + 1];
+    ivec2 pixels[RESTIR_SPATIAL_NEIGHBORS + 1];
+    points[0] = ShadingPoint(g_position.xyz, g_normal.xyz, normalize(camera.ori - g_position.xyz), int(g_normal.w));
+    pixels[0] = p;
+    int count = 1;
+    for(int i = 0; i < RESTIR_SPATIAL_NEIGHBORS; ++i)
+    {
+        float radius = RESTIR_SPATIAL_RADIUS * sqrt(rand());
+        float phi = 2.0 * PI * rand();
+        ivec2 q = p + ivec2(radius * vec2(cos(phi), sin(phi)));
+        if(q == p || q.x < 0 || q.y < 0 || q.x >= WIDTH || q.y >= HEIGHT)
+            continue;
+        vec4 q_position = texelFetch(gPositionTex, q, 0);
+        vec4 q_normal = texelFetch(gNormalTex, q, 0);
+        if(q_position.w <= 0.0 || dot(q_normal.xyz, points[0].N) < 0.9 || abs(q_position.w - g_position.w) > 0.1 * g_position.w)
+            continue;
+        points[count] = ShadingPoint(q_position.xyz, q_normal.xyz, normalize(camera.ori - q_position.xyz), int(q_normal.w));
+        pixels[count] = q;
+        ++count;
+    }
+
+    // 用广义平衡启发式作为各蓄水池的MIS权重，代替按 M 平均，
+    // 否则光滑表面上邻居几乎不可能采到当前像素高光处的样本，会让重尾的贡献长期偏暗
+    Reservoir combined = emptyReservoir();
+    float combined_target = 0.0;
+    for(int i = 0; i < count; ++i)
+    {
+        Reservoir r = loadReservoir(pixels[i]);
+        if(r.light < 0 || r.W <= 0.0)
+        {
+            combined.M += r.M;
+            continue;
+        }
+        float numerator = 0.0;
+        float denominator = 0.0;
+        for(int j = 0; j < count; ++j)
+        {
+            float M = texelFetch(reservoirWeightTex, pixels[j], 0).y;
+            float t = M * targetAt(points[j], r.point, r.light);
+            denominator += t;
+            if(j == i)
+                numerator = t;
+        }
+        float target = targetAt(points[0], r.point, r.light);
+        float mis = denominator > 0.0 ? numerator / denominator : 0.0;
+        if(updateReservoir(combined, r.point, r.light, mis * target * r.W, r.M))
+            combined_target = target;
+    }
+    // MIS权重之和已经归一化，W 不再除以 M
+    combined.W = combined_target > 0.0 ? combined.w_sum / combined_target : 0.0;
+
+    ReservoirSample = vec4(combined.point, float(combined.light));
+    ReservoirWeight = vec4(combined.w_sum, combined.M, combined.W, 0.0);
+}
+
+#else
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    vec4 g_position = texelFetch(gPositionTex, p, 0);
+    vec4 g_normal = texelFetch(gNormalTex, p, 0);
+    vec3 c;
+    if(g_position.w <= 0.0)
+    {
+        c = background(primaryRay(vec2(0.5)).dir);
+    }
+    else
+    {
+        Material material = materials[int(g_normal.w)];
+        recordFirstHit(g_normal.xyz, distance(camera.ori, g_position.xyz), material.emissive != vec3(0) ? vec3(1) : material.baseColor);
+        c = material.emissive;
+        if(material.emissive == vec3(0))
+        {
+            vec3 P = g_position.xyz;
+            vec3 N = g_normal.xyz;
+            Reservoir r = loadReservoir(p);
+            if(r.light >= 0 && r.W > 0.0 && visible(P, N, r.point))
+                c = unshadowedContribution(P, N, normalize(camera.ori - P), material, r.point, r.light) * r.W;
+        }
+    }
+    accumulate(c, luminance(c) * luminance(c), 1);
+}
+#endif
@@ -0,0 +1,105 @@
+// 采样器模块，rand() 按维度依次返回 [0,1) 的样本
+// 一个样本由 (像素, 样本序号, 维度) 唯一确定：前两维用于像素内抖动，之后每次弹射占 SAMPLER_BOUNCE_DIMS 维
+// 采样表由 common/sampler.cpp 在CPU上生成，维度数和长度需与其保持一致
+
+#define SAMPLER_HASH 0
+#define SAMPLER_SOBOL 1
+#define SAMPLER_RANK1 2
+
+#define SAMPLER_SAMPLES 4096u
+#define SAMPLER_DIMS 64u
+#define BLUE_NOISE_SIZE 64u
+
+#ifndef SAMPLER_BOUNCE_DIMS
+#define SAMPLER_BOUNCE_DIMS 4
+#endif
+
+uniform int sampler_type;
+uniform usampler2D sobolTex;        // SAMPLER_SAMPLES x SAMPLER_DIMS，Owen 扰乱后的 Sobol 点
+uniform usampler2D rank1Tex;        // SAMPLER_DIMS x 1，rank-1 格的生成向量
+uniform sampler2D blueNoiseTex;     // BLUE_NOISE_SIZE x BLUE_NOISE_SIZE
+
+uvec2 sampler_pixel;
+uint sampler_index;
+uint sampler_dim;
+
+// https://github.com/skeeto/hash-prospector
+uint sampler_hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint reverseBits(uint x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+float toUnitFloat(uint v)
+{
+    return float(v >> 8) / 16777216.0;
+}
+
+void initSampler(uvec2 pixel, uint index)
+{
+    sampler_pixel = pixel;
+    sampler_index = index;
+    sampler_dim = 0u;
+}
+
+// 第 bounce 次弹射从固定的维度开始取样，保证各条路径相同用途的随机数落在同一维
+void startBounce(int bounce)
+{
+    sampler_dim = 2u + uint(bounce * SAMPLER_BOUNCE_DIMS);
+}
+
+// 每一维按 R2 序列平移蓝噪声纹理，使相邻维度的旋转量不相关
+float blueNoise(uint dim)
+{
+    uvec2 offset = uvec2(float(dim) * vec2(0.7548776662, 0.5698402910) * float(BLUE_NOISE_SIZE));
+    ivec2 p = ivec2((sampler_pixel + offset) % BLUE_NOISE_SIZE);
+    return texelFetch(blueNoiseTex, p, 0).r;
+}
+
+float sampleDimension(uint dim)
+{
+    uint pixel_seed = sampler_hash(sampler_pixel.x + sampler_hash(sampler_pixel.y));
+    if(sampler_type == SAMPLER_HASH)
+    {
+        return toUnitFloat(sampler_hash(pixel_seed ^ sampler_hash(sampler_index ^ sampler_hash(dim))));
+    }
+
+    // 蓝噪声做 Cranley-Patterson 旋转；超出表长或维度后换一组随机旋转继续使用
+    float rotation = blueNoise(dim);
+    uint wrap = (sampler_index / SAMPLER_SAMPLES) * SAMPLER_DIMS + dim / SAMPLER_DIMS;
+    if(wrap > 0u)
+        rotation += toUnitFloat(sampler_hash(wrap ^ pixel_seed));
+
+    uint v;
+    if(sampler_type == SAMPLER_SOBOL)
+    {
+        // 像素间用下标异或打乱，2^k 长的前缀仍然是网
+        uint i = (sampler_index ^ pixel_seed) % SAMPLER_SAMPLES;
+        v = texelFetch(sobolTex, ivec2(i, dim % SAMPLER_DIMS), 0).r;
+    }
+    else
+    {
+        // 下标按基2逆序，定点数乘法的溢出即为取小数部分
+        uint z = texelFetch(rank1Tex, ivec2(dim % SAMPLER_DIMS, 0), 0).r;
+        v = reverseBits(sampler_index % SAMPLER_SAMPLES) * z;
+    }
+    return fract(toUnitFloat(v) + rotation);
+}
+
+float rand()
+{
+    return sampleDimension(sampler_dim++);
+}
@@ -0,0 +1,94 @@
+// 半球采样的公共模块，被各个积分器 #include
+// 所有采样函数只接收 [0,1) 的随机数，不依赖具体的随机数生成方式
+
+#ifndef PI
+#define PI 3.141592653
+#endif
+
+// 半球面均匀采样，pdf = 1 / (2 * PI)
+vec3 sampleHemisphere(vec2 xi)
+{
+    float z = xi.x;
+    float r = max(0, sqrt(1 - z*z));
+    float phi = 2.0 * PI * xi.y;
+    return vec3(r * cos(phi), r * sin(phi), z);
+}
+
+float pdfHemisphere()
+{
+    return 1.0 / (2.0 * PI);
+}
+
+// 单位圆盘上的同心映射采样（Shirley-Chiu），保持分层结构
+vec2 sampleConcentricDisk(vec2 xi)
+{
+    vec2 offset = 2.0 * xi - vec2(1.0);
+    if(offset.x == 0 && offset.y == 0)
+        return vec2(0);
+
+    float r, theta;
+    if(abs(offset.x) > abs(offset.y))
+    {
+        r = offset.x;
+        theta = PI / 4.0 * (offset.y / offset.x);
+    }
+    else
+    {
+        r = offset.y;
+        theta = PI / 2.0 - PI / 4.0 * (offset.x / offset.y);
+    }
+    return r * vec2(cos(theta), sin(theta));
+}
+
+// 余弦加权半球采样（Malley方法：圆盘上均匀采样后投影到半球），pdf = cos(theta) / PI
+vec3 sampleCosineHemisphere(vec2 xi)
+{
+    vec2 d = sampleConcentricDisk(xi);
+    float z = sqrt(max(0, 1 - d.x*d.x - d.y*d.y));
+    return vec3(d.x, d.y, z);
+}
+
+float pdfCosineHemisphere(float NdotL)
+{
+    return max(0, NdotL) / PI;
+}
+
+// 多重重要性采样的幂启发式（β = 2），pdf_a 为当前采样策略的pdf
+float powerHeuristic(float pdf_a, float pdf_b)
+{
+    float a = pdf_a * pdf_a;
+    float b = pdf_b * pdf_b;
+    return a + b > 0.0 ? a / (a + b) : 0.0;
+}
+
+// 以法线为z轴构造正交基
+void buildBasis(vec3 normal, out vec3 B, out vec3 C)
+{
+	if (abs(normal.x) > abs(normal.y))
+	{
+		float inv_len = 1.0 / sqrt(normal.x * normal.x + normal.z * normal.z);
+		C = vec3(normal.z * inv_len, 0.0f, -normal.x * inv_len);
+	}
+	else
+	{
+		float inv_len = 1.0f / sqrt(normal.y * normal.y + normal.z * normal.z);
+		C = vec3(0.0f, normal.z * inv_len, -normal.y * inv_len);
+	}
+	B = cross(C, normal);
+}
+
+// 将半球上的光线方向转换为世界方向
+vec3 toWorld(vec3 v, vec3 normal)
+{
+    vec3 B, C;
+    buildBasis(normal, B, C);
+	return B * v.x + C * v.y + normal * v.z;
+}
+
+// toWorld 的逆变换
+vec3 toLocal(vec3 v, vec3 normal)
+{
+    vec3 B, C;
+    buildBasis(normal, B, C);
+    return vec3(dot(v, B), dot(v, C), dot(v, normal));
+}
@@ -1,11 +1,20 @@
 #version 330
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragMoment;
+layout(location = 2) out vec4 FragNormal;
+layout(location = 3) out vec4 FragAlbedo;
 in vec2 TexCoords;
 
 uniform sampler2D imgTex;
+uniform sampler2D momentTex;
+uniform sampler2D normalTex;
+uniform sampler2D albedoTex;
 
 void main()
 {
     FragColor = texture(imgTex, TexCoords);
-}
\ No newline at end of file
+    FragMoment = texture(momentTex, TexCoords);
+    FragNormal = texture(normalTex, TexCoords);
+    FragAlbedo = texture(albedoTex, TexCoords);
+}
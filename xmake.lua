@@ -13,6 +13,30 @@ target("GLPathTracer")
     add_links("glfw3")
     add_links("msvcrt", "libcmt", "User32", "gdi32", "shell32") -- windows平台下
 
+-- 固定场景的性能基准，见 src/benchmark.cpp
+target("benchmark")
+    set_kind("binary")
+    add_files("src/benchmark.cpp")
+    add_files("src/*.c")
+    add_files("src/common/*.cpp")
+
+    add_includedirs("third/include")
+    add_linkdirs("third/lib")
+    add_links("glfw3")
+    add_links("msvcrt", "libcmt", "User32", "gdi32", "shell32") -- windows平台下
+
+-- CPU 上的隐式曲面基准，见 src/implicit_bench.cpp；implicit_function 编译着色器用到 Shader，所以同样链接 OpenGL 相关的库
+target("implicit_bench")
+    set_kind("binary")
+    add_files("src/implicit_bench.cpp")
+    add_files("src/*.c")
+    add_files("src/common/*.cpp")
+
+    add_includedirs("third/include")
+    add_linkdirs("third/lib")
+    add_links("glfw3")
+    add_links("msvcrt", "libcmt", "User32", "gdi32", "shell32") -- windows平台下
+
 --
 -- If you want to known more usage about xmake, please see https://xmake.io
 --